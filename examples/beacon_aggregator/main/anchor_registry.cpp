@@ -0,0 +1,243 @@
+#include <esp_log.h>
+#include <math.h>
+#include <nvs.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_matter.h>
+#include <esp_matter_console.h>
+
+#include <anchor_registry.h>
+#include <beacon_proto.h>
+#include <obs_ingest.h>
+
+static const char *TAG = "anchor_registry";
+
+#define NVS_NAMESPACE "anchors"
+#define NVS_KEY_TABLE "table"
+
+using namespace esp_matter;
+
+static beacon_anchor_t s_anchors[BEACON_PROTO_MAX_ANCHORS];
+static size_t s_count;
+
+static const beacon_anchor_t *find(const beacon_anchor_t *table, size_t count, uint16_t mediator)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (table[i].mediator == mediator) {
+            return &table[i];
+        }
+    }
+    return NULL;
+}
+
+static void to_metres(const beacon_anchor_t *anchor, float pos[3])
+{
+    for (int i = 0; i < 3; i++) {
+        pos[i] = anchor->pos_mm[i] * 0.001f;
+    }
+}
+
+static esp_err_t persist(const beacon_anchor_t *table, size_t count)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = count ? nvs_set_blob(handle, NVS_KEY_TABLE, table, count * sizeof(table[0]))
+                : nvs_erase_key(handle, NVS_KEY_TABLE);
+    if (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+/* Anchors moved, added or dropped by a new table, handed to the solvers if `commit` is set
+ *
+ * @return number of changed anchors.
+ */
+static int changes(const beacon_anchor_t *table, size_t count, bool commit)
+{
+    int changed = 0;
+    for (size_t i = 0; i < s_count; i++) {
+        if (!find(table, count, s_anchors[i].mediator)) {
+            if (commit) {
+                obs_ingest_anchor_moved(s_anchors[i].mediator, NULL);
+            }
+            changed++;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        const beacon_anchor_t *old = find(s_anchors, s_count, table[i].mediator);
+        if (old && memcmp(old->pos_mm, table[i].pos_mm, sizeof(old->pos_mm)) == 0) {
+            continue;
+        }
+        float pos[3];
+        to_metres(&table[i], pos);
+        if (commit && obs_ingest_anchor_moved(table[i].mediator, pos) != ESP_OK) {
+            ESP_LOGW(TAG, "No mediator slot left for 0x%04x, it is stored but not solved with", table[i].mediator);
+        }
+        changed++;
+    }
+    return changed;
+}
+
+/* Replaces the table, handing only moved, added and dropped anchors to the solvers. The table is
+ * stored first, so a failed write leaves the solvers as they were. Runs on the CHIP thread. */
+static esp_err_t apply(const beacon_anchor_t *table, size_t count)
+{
+    if (count > BEACON_PROTO_MAX_ANCHORS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (find(table, i, table[i].mediator)) {
+            ESP_LOGE(TAG, "Mediator 0x%04x placed twice", table[i].mediator);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    if (changes(table, count, false) == 0) {
+        return ESP_OK;
+    }
+    esp_err_t err = persist(table, count);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to store anchors: %s", esp_err_to_name(err));
+        return err;
+    }
+    int changed = changes(table, count, true);
+    memmove(s_anchors, table, count * sizeof(table[0]));
+    s_count = count;
+    ESP_LOGI(TAG, "%d anchors changed, %u placed", changed, (unsigned)s_count);
+    return ESP_OK;
+}
+
+static void load()
+{
+    beacon_anchor_t table[BEACON_PROTO_MAX_ANCHORS];
+    size_t size = sizeof(table);
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err == ESP_OK) {
+        err = nvs_get_blob(handle, NVS_KEY_TABLE, table, &size);
+        nvs_close(handle);
+    }
+    if (err != ESP_OK || size % sizeof(table[0]) != 0) {
+        return;
+    }
+    /* Every stored anchor is new to the solvers, none of them is written back */
+    size_t count = size / sizeof(table[0]);
+    for (size_t i = 0; i < count; i++) {
+        float pos[3];
+        to_metres(&table[i], pos);
+        obs_ingest_anchor_moved(table[i].mediator, pos);
+    }
+    memcpy(s_anchors, table, size);
+    s_count = count;
+    ESP_LOGI(TAG, "%u anchors loaded", (unsigned)s_count);
+}
+
+static esp_err_t anchors_override_cb(attribute::callback_type_t type, uint16_t endpoint_id, uint32_t cluster_id,
+                                     uint32_t attribute_id, esp_matter_attr_val_t *val, void *priv_data)
+{
+    if (type == attribute::WRITE) {
+        size_t len = val->val.a.s;
+        if ((len && !val->val.a.b) || len % sizeof(beacon_anchor_t) != 0) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        beacon_anchor_t table[BEACON_PROTO_MAX_ANCHORS];
+        size_t count = len / sizeof(table[0]);
+        if (count > BEACON_PROTO_MAX_ANCHORS) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        memcpy(table, val->val.a.b, len);
+        return apply(table, count);
+    }
+    if (type == attribute::READ) {
+        *val = esp_matter_long_octet_str((uint8_t *)s_anchors, s_count * sizeof(s_anchors[0]));
+    }
+    return ESP_OK;
+}
+
+esp_err_t anchor_registry_create(cluster_t *cluster)
+{
+    /* The initial value sets the largest table the attribute accepts */
+    static uint8_t anchors_buf[BEACON_PROTO_MAX_ANCHORS * sizeof(beacon_anchor_t)];
+    attribute_t *attribute = attribute::create(cluster, BEACON_PROTO_ATTR_ANCHORS_ID,
+                                               ATTRIBUTE_FLAG_WRITABLE | ATTRIBUTE_FLAG_OVERRIDE,
+                                               esp_matter_long_octet_str(anchors_buf, sizeof(anchors_buf)));
+    if (!attribute) {
+        ESP_LOGE(TAG, "Failed to create anchors attribute");
+        return ESP_FAIL;
+    }
+    attribute::set_override_callback(attribute, anchors_override_cb);
+    load();
+    return ESP_OK;
+}
+
+bool anchor_registry_position(uint16_t mediator, float pos[3])
+{
+    const beacon_anchor_t *anchor = find(s_anchors, s_count, mediator);
+    if (!anchor) {
+        return false;
+    }
+    to_metres(anchor, pos);
+    return true;
+}
+
+static esp_err_t anchor_console_handler(int argc, char **argv)
+{
+    if (argc == 0) {
+        printf("%u anchors\n", (unsigned)s_count);
+        printf("mediator         x         y         z\n");
+        for (size_t i = 0; i < s_count; i++) {
+            float pos[3];
+            to_metres(&s_anchors[i], pos);
+            printf("  0x%04x  %8.3f  %8.3f  %8.3f\n", s_anchors[i].mediator, pos[0], pos[1], pos[2]);
+        }
+        return ESP_OK;
+    }
+    bool clear = argc == 2 && strcmp(argv[1], "clear") == 0;
+    if (clear || argc == 4) {
+        uint16_t mediator = static_cast<uint16_t>(strtoul(argv[0], NULL, 0));
+        beacon_anchor_t entry = {};
+        entry.mediator = mediator;
+        for (int i = 0; !clear && i < 3; i++) {
+            entry.pos_mm[i] = static_cast<int32_t>(lrintf(strtof(argv[i + 1], NULL) * 1000.0f));
+        }
+        chip::DeviceLayer::PlatformMgr().LockChipStack();
+        beacon_anchor_t table[BEACON_PROTO_MAX_ANCHORS];
+        size_t count = 0;
+        for (size_t i = 0; i < s_count; i++) {
+            if (s_anchors[i].mediator != mediator) {
+                table[count++] = s_anchors[i];
+            }
+        }
+        esp_err_t err = ESP_ERR_NO_MEM;
+        if (clear || count < BEACON_PROTO_MAX_ANCHORS) {
+            if (!clear) {
+                table[count++] = entry;
+            }
+            err = apply(table, count);
+        }
+        chip::DeviceLayer::PlatformMgr().UnlockChipStack();
+        if (err == ESP_ERR_NO_MEM) {
+            ESP_LOGE(TAG, "No room for another anchor");
+        }
+        return err;
+    }
+    printf("Usage: matter esp anchor [<mediator> <x> <y> <z> | <mediator> clear]\n");
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t anchor_registry_register_commands()
+{
+    static const esp_matter::console::command_t command = {
+        .name = "anchor",
+        .description = "Mediator positions used by the solvers. "
+                       "Usage: matter esp anchor [<mediator> <x> <y> <z> | <mediator> clear]",
+        .handler = anchor_console_handler,
+    };
+    return esp_matter::console::add_commands(&command, 1);
+}
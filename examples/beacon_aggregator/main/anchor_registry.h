@@ -0,0 +1,36 @@
+#pragma once
+
+#include <esp_err.h>
+#include <esp_matter.h>
+#include <stdint.h>
+
+/** Add the Anchors attribute and load the stored anchors
+ *
+ * The registry maps mediator IDs to positions on the site. It is stored in NVS, and can be read
+ * and written as the Anchors attribute of the observation report cluster (see beacon_proto.h)
+ * or edited with the `anchor` console command. Every change is handed to the solvers with
+ * obs_ingest_anchor_moved(), only for the anchors which changed.
+ *
+ * Must be called once the observation store is set up, from obs_ingest_cluster_create().
+ *
+ * @param[in] cluster Observation report cluster.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t anchor_registry_create(esp_matter::cluster_t *cluster);
+
+/** Position of a mediator
+ *
+ * @param[out] pos Metres.
+ *
+ * @return true if the mediator has a position.
+ */
+bool anchor_registry_position(uint16_t mediator, float pos[3]);
+
+/** Register the `anchor` console command
+ *
+ * `matter esp anchor` lists the anchors, `anchor <mediator> <x> <y> <z>` places one, in metres,
+ * and `anchor <mediator> clear` drops it.
+ */
+esp_err_t anchor_registry_register_commands();
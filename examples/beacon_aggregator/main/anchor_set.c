@@ -0,0 +1,332 @@
+#include <math.h>
+#include <string.h>
+
+#include "anchor_set.h"
+#include "multilat.h"
+
+/* Same threshold as multilat.c */
+#define DEGENERATE_RATIO 1e-6f
+
+/* |p| stays below 8/m, so with ranges up to 100 m a product p * r^2 in 8.24 x 16.16 is below
+ * 2^57 and the sum over 16 anchors below 2^61. Larger factors only come from anchors packed
+ * within a few centimetres, whose solutions are meaningless anyway. */
+#define P_MAX 8.0f
+
+/* lambda_max / lambda_min of the symmetric 2x2 [sxx sxy; sxy syy] */
+static float condition(float sxx, float sxy, float syy)
+{
+    float trace = sxx + syy;
+    float det = sxx * syy - sxy * sxy;
+    if (!(det > DEGENERATE_RATIO * trace * trace)) {
+        return INFINITY;
+    }
+    float spread = sqrtf(fmaxf(trace * trace - 4 * det, 0));
+    return (trace + spread) / (trace - spread);
+}
+
+static float triple_condition(const anchor_set_t *set, int a, int b, int c)
+{
+    float cx = (set->pos[a][0] + set->pos[b][0] + set->pos[c][0]) / 3;
+    float cy = (set->pos[a][1] + set->pos[b][1] + set->pos[c][1]) / 3;
+    float sxx = 0, sxy = 0, syy = 0;
+    int idx[3] = {a, b, c};
+    for (int k = 0; k < 3; k++) {
+        float x = set->pos[idx[k]][0] - cx;
+        float y = set->pos[idx[k]][1] - cy;
+        sxx += x * x;
+        sxy += x * y;
+        syy += y * y;
+    }
+    return condition(sxx, sxy, syy);
+}
+
+/* Exhaustive over the subset, at most 560 triples and only on a cache miss */
+static uint16_t best_triple(const anchor_set_t *set, const anchor_subset_t *subset)
+{
+    uint16_t best = 0;
+    float best_cond = INFINITY;
+    for (int i = 0; i < subset->count; i++) {
+        for (int j = i + 1; j < subset->count; j++) {
+            for (int k = j + 1; k < subset->count; k++) {
+                float cond = triple_condition(set, subset->index[i], subset->index[j], subset->index[k]);
+                if (cond < best_cond) {
+                    best_cond = cond;
+                    best = (uint16_t)((1u << subset->index[i]) | (1u << subset->index[j]) |
+                                      (1u << subset->index[k]));
+                }
+            }
+        }
+    }
+    return best;
+}
+
+static q16_t to_q16(float v)
+{
+    return (q16_t)lrintf(v * Q16_ONE);
+}
+
+void anchor_set_load(anchor_set_t *set, const float pos[][3], uint16_t present)
+{
+    memset(set, 0, sizeof(*set));
+    int count = __builtin_popcount(present);
+    if (count == 0) {
+        return;
+    }
+    for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+        if (present & (1u << i)) {
+            set->origin[0] += pos[i][0] / count;
+            set->origin[1] += pos[i][1] / count;
+            set->origin[2] += pos[i][2] / count;
+        }
+    }
+    for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+        if (present & (1u << i)) {
+            set->pos[i][0] = pos[i][0] - set->origin[0];
+            set->pos[i][1] = pos[i][1] - set->origin[1];
+            set->pos[i][2] = pos[i][2] - set->origin[2];
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        set->origin_q16[i] = to_q16(set->origin[i]);
+    }
+    set->present = present;
+}
+
+void anchor_set_move(anchor_set_t *set, int index, const float pos[3])
+{
+    if (index < 0 || index >= ANCHOR_SET_MAX_ANCHORS) {
+        return;
+    }
+    uint16_t bit = (uint16_t)(1u << index);
+    if (pos && set->present == 0) {
+        for (int i = 0; i < 3; i++) {
+            set->origin[i] = pos[i];
+            set->origin_q16[i] = to_q16(pos[i]);
+        }
+    }
+    for (int i = 0; i < ANCHOR_SET_CACHE_SIZE; i++) {
+        if (set->cache_mask[i] & bit) {
+            set->cache_mask[i] = 0;
+            set->stats.invalidated++;
+        }
+    }
+    if (!pos) {
+        set->present &= (uint16_t)~bit;
+        return;
+    }
+    for (int i = 0; i < 3; i++) {
+        set->pos[index][i] = pos[i] - set->origin[i];
+    }
+    set->present |= bit;
+}
+
+/* With coordinates centred on the subset centroid c (see multilat.c),
+ *     [X Y]^T = c + G sum_i [x'_i y'_i]^T (|a'_i|^2 - r_i^2 - 2 z'_i (Z - c_z)),  G = S^-1 / 2
+ * which splits into the constant, z and r^2 terms stored in the subset. */
+static void factor(const anchor_set_t *set, anchor_subset_t *subset, uint16_t mask)
+{
+    memset(subset, 0, sizeof(*subset));
+    subset->mask = mask;
+    float c[3] = {0, 0, 0};
+    for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+        if (mask & (1u << i)) {
+            subset->index[subset->count++] = (uint8_t)i;
+            c[0] += set->pos[i][0];
+            c[1] += set->pos[i][1];
+            c[2] += set->pos[i][2];
+        }
+    }
+    c[0] /= subset->count;
+    c[1] /= subset->count;
+    c[2] /= subset->count;
+
+    float sxx = 0, sxy = 0, syy = 0;
+    for (int k = 0; k < subset->count; k++) {
+        const float *a = set->pos[subset->index[k]];
+        float x = a[0] - c[0];
+        float y = a[1] - c[1];
+        sxx += x * x;
+        sxy += x * y;
+        syy += y * y;
+    }
+    subset->cond = condition(sxx, sxy, syy);
+    if (isinf(subset->cond)) {
+        subset->degenerate = 1;
+        return;
+    }
+    subset->best3 = subset->count == 3 ? mask : best_triple(set, subset);
+    float det = sxx * syy - sxy * sxy;
+
+    subset->k0[0] = c[0];
+    subset->k0[1] = c[1];
+    for (int k = 0; k < subset->count; k++) {
+        const float *a = set->pos[subset->index[k]];
+        float x = a[0] - c[0];
+        float y = a[1] - c[1];
+        float w = a[2] - c[2];
+        float px = (syy * x - sxy * y) / (2 * det);
+        float py = (sxx * y - sxy * x) / (2 * det);
+        float q = x * x + y * y + w * w + 2 * w * c[2];
+        subset->p[0][k] = px;
+        subset->p[1][k] = py;
+        subset->k0[0] += px * q;
+        subset->k0[1] += py * q;
+        subset->kz[0] -= 2 * px * w;
+        subset->kz[1] -= 2 * py * w;
+    }
+
+    subset->fixed_ok = 1;
+    for (int k = 0; k < subset->count; k++) {
+        for (int axis = 0; axis < 2; axis++) {
+            float p = subset->p[axis][k];
+            if (!(fabsf(p) < P_MAX)) {
+                subset->fixed_ok = 0;
+                return;
+            }
+            subset->p_q24[axis][k] = (int32_t)lrintf(p * (1 << 24));
+        }
+    }
+    for (int axis = 0; axis < 2; axis++) {
+        subset->k0_q16[axis] = to_q16(subset->k0[axis]);
+        subset->kz_q16[axis] = to_q16(subset->kz[axis]);
+    }
+}
+
+const anchor_subset_t *anchor_set_subset(anchor_set_t *set, uint16_t mask)
+{
+    if (__builtin_popcount(mask) < 3 || (mask & ~set->present)) {
+        return NULL;
+    }
+    set->clock++;
+    for (int i = 0; i < ANCHOR_SET_CACHE_SIZE; i++) {
+        if (set->cache_mask[i] == mask) {
+            set->cache[i].last_used = set->clock;
+            set->stats.hits++;
+            return &set->cache[i];
+        }
+    }
+
+    int victim = 0;
+    for (int i = 0; i < ANCHOR_SET_CACHE_SIZE && set->cache_mask[victim] != 0; i++) {
+        if (set->cache_mask[i] == 0 || set->cache[i].last_used < set->cache[victim].last_used) {
+            victim = i;
+        }
+    }
+    anchor_subset_t *subset = &set->cache[victim];
+    set->stats.misses++;
+    factor(set, subset, mask);
+    subset->last_used = set->clock;
+    set->cache_mask[victim] = mask;
+    if (subset->degenerate) {
+        set->stats.degenerate++;
+    }
+    return subset;
+}
+
+int anchor_set_solve(anchor_set_t *set, uint16_t mask, const float ranges[ANCHOR_SET_MAX_ANCHORS], float z,
+                     float pos[3])
+{
+    const anchor_subset_t *subset = anchor_set_subset(set, mask);
+    if (!subset || subset->degenerate) {
+        return -1;
+    }
+    float zl = z - set->origin[2];
+    float x = subset->k0[0] + subset->kz[0] * zl;
+    float y = subset->k0[1] + subset->kz[1] * zl;
+    for (int k = 0; k < subset->count; k++) {
+        float r = ranges[subset->index[k]];
+        x -= subset->p[0][k] * r * r;
+        y -= subset->p[1][k] * r * r;
+    }
+    pos[0] = set->origin[0] + x;
+    pos[1] = set->origin[1] + y;
+    pos[2] = z;
+    return 0;
+}
+
+int anchor_set_solve_q16(anchor_set_t *set, uint16_t mask, const q16_t ranges[ANCHOR_SET_MAX_ANCHORS], q16_t z,
+                         q16_t pos[3])
+{
+    const anchor_subset_t *subset = anchor_set_subset(set, mask);
+    if (!subset || subset->degenerate || !subset->fixed_ok) {
+        return -1;
+    }
+    int64_t zl = (int64_t)z - set->origin_q16[2];
+    int64_t sum_x = 0;
+    int64_t sum_y = 0;
+    for (int k = 0; k < subset->count; k++) {
+        int64_t r = ranges[subset->index[k]];
+        r = r < 0 ? 0 : r > ANCHOR_SET_RANGE_MAX_Q16 ? ANCHOR_SET_RANGE_MAX_Q16 : r;
+        int64_t r2 = (r * r + (1 << 15)) >> 16;
+        sum_x += subset->p_q24[0][k] * r2;
+        sum_y += subset->p_q24[1][k] * r2;
+    }
+    /* 8.24 x 16.16 products carry 40 fraction bits */
+    int64_t x = subset->k0_q16[0] + ((subset->kz_q16[0] * zl + (1 << 15)) >> 16) - ((sum_x + (1 << 23)) >> 24);
+    int64_t y = subset->k0_q16[1] + ((subset->kz_q16[1] * zl + (1 << 15)) >> 16) - ((sum_y + (1 << 23)) >> 24);
+    pos[0] = (q16_t)(set->origin_q16[0] + x);
+    pos[1] = (q16_t)(set->origin_q16[1] + y);
+    pos[2] = z;
+    return 0;
+}
+
+int anchor_set_solve_cm(anchor_set_t *set, uint16_t mask, const uint16_t ranges_cm[ANCHOR_SET_MAX_ANCHORS],
+                        int32_t z_cm, int32_t pos_cm[3])
+{
+#if ANCHOR_SET_FIXED_POINT
+    q16_t ranges[ANCHOR_SET_MAX_ANCHORS];
+    for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+        if (mask & (1u << i)) {
+            ranges[i] = (q16_t)(((int64_t)ranges_cm[i] * Q16_ONE + 50) / 100);
+        }
+    }
+    q16_t pos[3];
+    if (anchor_set_solve_q16(set, mask, ranges, (q16_t)(((int64_t)z_cm * Q16_ONE) / 100), pos) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < 2; i++) {
+        int64_t cm = (int64_t)pos[i] * 100;
+        pos_cm[i] = (int32_t)((cm + (cm < 0 ? -(Q16_ONE / 2) : Q16_ONE / 2)) / Q16_ONE);
+    }
+#else
+    float ranges[ANCHOR_SET_MAX_ANCHORS];
+    for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+        if (mask & (1u << i)) {
+            ranges[i] = ranges_cm[i] * 0.01f;
+        }
+    }
+    float pos[3];
+    if (anchor_set_solve(set, mask, ranges, z_cm * 0.01f, pos) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < 2; i++) {
+        pos_cm[i] = (int32_t)lrintf(pos[i] * 100);
+    }
+#endif
+    pos_cm[2] = z_cm;
+    return 0;
+}
+
+float anchor_set_gdop(const anchor_set_t *set, uint16_t mask, const float pos[3])
+{
+    if (mask & ~set->present) {
+        return INFINITY;
+    }
+    float anchors[ANCHOR_SET_MAX_ANCHORS][3];
+    int count = anchor_set_gather(set, mask, anchors);
+    return multilat_gdop(anchors, count, pos);
+}
+
+int anchor_set_gather(const anchor_set_t *set, uint16_t mask, float out[][3])
+{
+    int count = 0;
+    for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+        if (mask & set->present & (1u << i)) {
+            out[count][0] = set->origin[0] + set->pos[i][0];
+            out[count][1] = set->origin[1] + set->pos[i][1];
+            out[count][2] = set->origin[2] + set->pos[i][2];
+            count++;
+        }
+    }
+    return count;
+}
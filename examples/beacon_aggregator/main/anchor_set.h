@@ -0,0 +1,187 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Static anchor layout with per-subset solve factors.
+ *
+ * The linear least squares solve of multilat.c only depends on the anchor geometry up to the
+ * measured ranges, so for each subset of anchors the whole normal equation solve is folded into
+ *     pos = k0 + kz * z - sum_i p_i * r_i^2
+ * and a solve is 2N multiply-adds. Factors are computed on first use of a subset and cached,
+ * keyed by the bitmask of anchors that heard the beacon. The result is that of multilat_solve()
+ * with MULTILAT_LINEAR_ONLY, also for three anchors.
+ *
+ * Anchors are kept relative to their centroid, so single precision keeps millimetres even when
+ * site coordinates are large.
+ *
+ * Subsets also record how well conditioned they are: the condition number of the anchor spread
+ * in x/y, which the linear solve inverts, and the best conditioned three of their anchors.
+ * Degenerate subsets are flagged when factored and never solved.
+ *
+ * Every subset also carries its factors in fixed point for anchor_set_solve_q16(), which only
+ * uses integer arithmetic. Targets without an FPU, such as the ESP32-C3, get it through
+ * anchor_set_solve_cm(); factoring a subset still uses float, but only on a cache miss.
+ */
+
+#ifndef ANCHOR_SET_FIXED_POINT
+#ifdef ESP_PLATFORM
+#include <soc/soc_caps.h>
+#endif
+#if defined(ESP_PLATFORM) && !SOC_CPU_HAS_FPU
+#define ANCHOR_SET_FIXED_POINT 1
+#else
+#define ANCHOR_SET_FIXED_POINT 0
+#endif
+#endif
+
+/* Signed 16.16 fixed point, metres */
+typedef int32_t q16_t;
+#define Q16_ONE 65536
+
+#define ANCHOR_SET_MAX_ANCHORS 16
+#define ANCHOR_SET_CACHE_SIZE 32
+
+typedef struct {
+    uint16_t mask;                          /* Anchors in the subset */
+    uint8_t count;
+    uint8_t degenerate;                     /* Collinear in x/y, no solution */
+    uint8_t fixed_ok;                       /* Factors fit the fixed point ranges */
+    uint8_t index[ANCHOR_SET_MAX_ANCHORS];  /* Anchor index of each factor */
+    float cond;                             /* Condition number of the x/y anchor spread, INFINITY if degenerate */
+    uint16_t best3;                         /* Best conditioned three anchors, for closed form solves */
+    float p[2][ANCHOR_SET_MAX_ANCHORS];
+    float k0[2];
+    float kz[2];
+    int32_t p_q24[2][ANCHOR_SET_MAX_ANCHORS];   /* 1/m, 8.24 */
+    q16_t k0_q16[2];
+    q16_t kz_q16[2];
+    uint32_t last_used;
+} anchor_subset_t;
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t degenerate;
+    uint32_t invalidated;                   /* Subsets dropped by anchor_set_move() */
+} anchor_set_stats_t;
+
+typedef struct {
+    float origin[3];
+    q16_t origin_q16[3];
+    float pos[ANCHOR_SET_MAX_ANCHORS][3];   /* Relative to origin */
+    uint16_t present;
+    uint32_t clock;
+    uint16_t cache_mask[ANCHOR_SET_CACHE_SIZE];         /* Scanned on lookup, 0 for an unused entry */
+    anchor_subset_t cache[ANCHOR_SET_CACHE_SIZE];
+    anchor_set_stats_t stats;
+} anchor_set_t;
+
+/** Load the anchor layout
+ *
+ * Drops every cached subset.
+ *
+ * @param[in] pos Anchor positions, entries not in `present` are ignored.
+ * @param[in] present Bitmask of anchor indices in use.
+ */
+void anchor_set_load(anchor_set_t *set, const float pos[][3], uint16_t present);
+
+/** Add, move or drop a single anchor
+ *
+ * Keeps the origin and drops only the cached subsets holding the anchor, so the factors of every
+ * other subset survive. The first anchor of an empty layout becomes the origin.
+ *
+ * @param[in] index Anchor index.
+ * @param[in] pos New position, NULL to drop the anchor.
+ */
+void anchor_set_move(anchor_set_t *set, int index, const float pos[3]);
+
+/** Factors of a subset, computed on a cache miss
+ *
+ * @return subset, check `degenerate` before use.
+ * @return NULL if the mask has fewer than three anchors or anchors not in the layout.
+ */
+const anchor_subset_t *anchor_set_subset(anchor_set_t *set, uint16_t mask);
+
+/** Linear least squares position of a beacon at height z
+ *
+ * @param[in] mask Anchors that heard the beacon.
+ * @param[in] ranges Range per anchor index, only the entries in `mask` are read.
+ * @param[out] pos x, y and the given z.
+ *
+ * @return 0 on success.
+ * @return -1 if the subset has fewer than three anchors or is degenerate.
+ */
+int anchor_set_solve(anchor_set_t *set, uint16_t mask, const float ranges[ANCHOR_SET_MAX_ANCHORS], float z,
+                     float pos[3]);
+
+/** Fixed point variant of anchor_set_solve()
+ *
+ * Ranges are clamped to ANCHOR_SET_RANGE_MAX_Q16, which keeps every product inside 64 bits.
+ *
+ * @return 0 on success.
+ * @return -1 if the subset has fewer than three anchors, is degenerate or too ill conditioned
+ *         for the fixed point factors.
+ */
+int anchor_set_solve_q16(anchor_set_t *set, uint16_t mask, const q16_t ranges[ANCHOR_SET_MAX_ANCHORS], q16_t z,
+                         q16_t pos[3]);
+
+#define ANCHOR_SET_RANGE_MAX_Q16 (100 * Q16_ONE)
+
+/** Solve from ranges in centimetres, as kept by obs_store, in fixed point on targets without FPU
+ *
+ * @param[out] pos_cm x, y and the given z, in centimetres.
+ *
+ * @return 0 on success.
+ * @return -1 if the subset can not be solved.
+ */
+int anchor_set_solve_cm(anchor_set_t *set, uint16_t mask, const uint16_t ranges_cm[ANCHOR_SET_MAX_ANCHORS],
+                        int32_t z_cm, int32_t pos_cm[3]);
+
+/** Solve many beacons, each heard by its own subset, for site-wide solves on a host
+ *
+ * Beacons are laid out as structure of arrays so the solve vectorizes across them: AVX2 on x86
+ * CPUs that have it, chosen at run time, NEON on 64-bit Arm, plain C elsewhere including the
+ * ESP32 targets. Every path rounds like anchor_set_solve(), so results are bit-identical.
+ *
+ * Each run of beacons with the same mask is one vector pass. On the vector kernels, runs too
+ * short for one are collected in blocks of 1024 beacons, grouped by mask and gathered into
+ * lanes, so the speedup over anchor_set_solve() depends on how well beacons group by mask:
+ * about 10x sorted by mask but 2x in random order on AVX2, and none on the scalar kernel. Any
+ * order gives the same results.
+ *
+ * @param[in] masks Anchor mask of each beacon.
+ * @param[in] ranges Row i holds the range of every beacon to anchor i, one row per anchor index
+ *                   up to ANCHOR_SET_MAX_ANCHORS; rows are `stride` floats apart. Only the
+ *                   anchors in a beacon's mask are read.
+ * @param[in] z Height of each beacon.
+ * @param[out] x, y Position of each beacon, NAN if its subset has fewer than three anchors or is
+ *                  degenerate.
+ *
+ * @return number of beacons solved.
+ */
+size_t anchor_set_solve_batch(anchor_set_t *set, const uint16_t *masks, const float *ranges, size_t stride,
+                              const float *z, size_t count, float *x, float *y);
+
+/** Instruction set anchor_set_solve_batch() runs on: "avx2", "neon" or "scalar" */
+const char *anchor_set_batch_isa(void);
+
+/** Geometric dilution of precision of x and y for a beacon at `pos`, see multilat_gdop()
+ *
+ * @return GDOP, INFINITY if the anchors of the mask are not in the layout or in line seen from `pos`.
+ */
+float anchor_set_gdop(const anchor_set_t *set, uint16_t mask, const float pos[3]);
+
+/** Absolute positions of the anchors in a mask, in index order, for multilat_refine()
+ *
+ * @return number of anchors stored in `out`.
+ */
+int anchor_set_gather(const anchor_set_t *set, uint16_t mask, float out[][3]);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,357 @@
+#include <math.h>
+#include <string.h>
+
+#include "anchor_set.h"
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(ANCHOR_SET_BATCH_NO_SIMD)
+#define BATCH_AVX2 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && !defined(ANCHOR_SET_BATCH_NO_SIMD)
+#define BATCH_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if BATCH_AVX2 || BATCH_NEON
+/* Runs of equal masks at least this long are solved in place. Shorter ones are collected into
+ * blocks of BATCH_BLOCK beacons, sorted by mask and solved through gathered lanes, so beacons in
+ * any order still fill the vectors; a block holds up to BATCH_GROUPS masks. */
+#define BATCH_GATHER 1
+#define BATCH_RUN_MIN 8
+#define BATCH_BLOCK 1024
+#define BATCH_GROUPS 64
+#define BATCH_HASH 128
+#endif
+
+/* Arguments shared by the kernels, the subset is already resolved */
+typedef struct {
+    const anchor_subset_t *subset;
+    const float *origin;
+    const float *ranges;
+    size_t stride;
+    const float *z;
+    float *x;
+    float *y;
+} batch_t;
+
+/* Same operation order as anchor_set_solve(), and no fused multiply-add, so every kernel
+ * rounds identically */
+static inline void solve_one(const batch_t *batch, size_t b)
+{
+    const anchor_subset_t *subset = batch->subset;
+    float zl = batch->z[b] - batch->origin[2];
+    float x = subset->k0[0] + subset->kz[0] * zl;
+    float y = subset->k0[1] + subset->kz[1] * zl;
+    for (int k = 0; k < subset->count; k++) {
+        float r = batch->ranges[subset->index[k] * batch->stride + b];
+        x -= subset->p[0][k] * r * r;
+        y -= subset->p[1][k] * r * r;
+    }
+    batch->x[b] = batch->origin[0] + x;
+    batch->y[b] = batch->origin[1] + y;
+}
+
+static void solve_scalar(const batch_t *batch, size_t begin, size_t end)
+{
+    for (size_t b = begin; b < end; b++) {
+        solve_one(batch, b);
+    }
+}
+
+#if BATCH_GATHER
+static void gather_scalar(const batch_t *batch, const uint32_t *index, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        solve_one(batch, index[i]);
+    }
+}
+#endif
+
+#if BATCH_AVX2
+/* Only AVX, not FMA, is enabled so the compiler can not contract the multiplies */
+__attribute__((target("avx2"))) static void solve_avx2(const batch_t *batch, size_t begin, size_t end)
+{
+    const anchor_subset_t *subset = batch->subset;
+    __m256 origin_x = _mm256_set1_ps(batch->origin[0]);
+    __m256 origin_y = _mm256_set1_ps(batch->origin[1]);
+    __m256 origin_z = _mm256_set1_ps(batch->origin[2]);
+    size_t b = begin;
+    for (; b + 8 <= end; b += 8) {
+        __m256 zl = _mm256_sub_ps(_mm256_loadu_ps(batch->z + b), origin_z);
+        __m256 x = _mm256_add_ps(_mm256_set1_ps(subset->k0[0]), _mm256_mul_ps(_mm256_set1_ps(subset->kz[0]), zl));
+        __m256 y = _mm256_add_ps(_mm256_set1_ps(subset->k0[1]), _mm256_mul_ps(_mm256_set1_ps(subset->kz[1]), zl));
+        for (int k = 0; k < subset->count; k++) {
+            __m256 r = _mm256_loadu_ps(batch->ranges + subset->index[k] * batch->stride + b);
+            x = _mm256_sub_ps(x, _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(subset->p[0][k]), r), r));
+            y = _mm256_sub_ps(y, _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(subset->p[1][k]), r), r));
+        }
+        _mm256_storeu_ps(batch->x + b, _mm256_add_ps(origin_x, x));
+        _mm256_storeu_ps(batch->y + b, _mm256_add_ps(origin_y, y));
+    }
+    solve_scalar(batch, b, end);
+}
+
+/* Beacons scattered over the batch, eight lanes gathered by index; AVX2 has no scatter, so
+ * results go out one by one */
+__attribute__((target("avx2"))) static void gather_avx2(const batch_t *batch, const uint32_t *index, size_t count)
+{
+    const anchor_subset_t *subset = batch->subset;
+    __m256 origin_x = _mm256_set1_ps(batch->origin[0]);
+    __m256 origin_y = _mm256_set1_ps(batch->origin[1]);
+    __m256 origin_z = _mm256_set1_ps(batch->origin[2]);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i lanes = _mm256_loadu_si256((const __m256i *)(index + i));
+        __m256 zl = _mm256_sub_ps(_mm256_i32gather_ps(batch->z, lanes, 4), origin_z);
+        __m256 x = _mm256_add_ps(_mm256_set1_ps(subset->k0[0]), _mm256_mul_ps(_mm256_set1_ps(subset->kz[0]), zl));
+        __m256 y = _mm256_add_ps(_mm256_set1_ps(subset->k0[1]), _mm256_mul_ps(_mm256_set1_ps(subset->kz[1]), zl));
+        for (int k = 0; k < subset->count; k++) {
+            __m256 r = _mm256_i32gather_ps(batch->ranges + subset->index[k] * batch->stride, lanes, 4);
+            x = _mm256_sub_ps(x, _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(subset->p[0][k]), r), r));
+            y = _mm256_sub_ps(y, _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(subset->p[1][k]), r), r));
+        }
+        float out_x[8], out_y[8];
+        _mm256_storeu_ps(out_x, _mm256_add_ps(origin_x, x));
+        _mm256_storeu_ps(out_y, _mm256_add_ps(origin_y, y));
+        for (int l = 0; l < 8; l++) {
+            batch->x[index[i + l]] = out_x[l];
+            batch->y[index[i + l]] = out_y[l];
+        }
+    }
+    gather_scalar(batch, index + i, count - i);
+}
+#endif
+
+#if BATCH_NEON
+static void solve_neon(const batch_t *batch, size_t begin, size_t end)
+{
+    const anchor_subset_t *subset = batch->subset;
+    float32x4_t origin_x = vdupq_n_f32(batch->origin[0]);
+    float32x4_t origin_y = vdupq_n_f32(batch->origin[1]);
+    float32x4_t origin_z = vdupq_n_f32(batch->origin[2]);
+    size_t b = begin;
+    for (; b + 4 <= end; b += 4) {
+        float32x4_t zl = vsubq_f32(vld1q_f32(batch->z + b), origin_z);
+        float32x4_t x = vaddq_f32(vdupq_n_f32(subset->k0[0]), vmulq_n_f32(zl, subset->kz[0]));
+        float32x4_t y = vaddq_f32(vdupq_n_f32(subset->k0[1]), vmulq_n_f32(zl, subset->kz[1]));
+        for (int k = 0; k < subset->count; k++) {
+            float32x4_t r = vld1q_f32(batch->ranges + subset->index[k] * batch->stride + b);
+            x = vsubq_f32(x, vmulq_f32(vmulq_n_f32(r, subset->p[0][k]), r));
+            y = vsubq_f32(y, vmulq_f32(vmulq_n_f32(r, subset->p[1][k]), r));
+        }
+        vst1q_f32(batch->x + b, vaddq_f32(origin_x, x));
+        vst1q_f32(batch->y + b, vaddq_f32(origin_y, y));
+    }
+    solve_scalar(batch, b, end);
+}
+
+/* NEON has no gather, the lanes are loaded one by one */
+static void gather_neon(const batch_t *batch, const uint32_t *index, size_t count)
+{
+    const anchor_subset_t *subset = batch->subset;
+    float32x4_t origin_x = vdupq_n_f32(batch->origin[0]);
+    float32x4_t origin_y = vdupq_n_f32(batch->origin[1]);
+    float32x4_t origin_z = vdupq_n_f32(batch->origin[2]);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float lane[4];
+        for (int l = 0; l < 4; l++) {
+            lane[l] = batch->z[index[i + l]];
+        }
+        float32x4_t zl = vsubq_f32(vld1q_f32(lane), origin_z);
+        float32x4_t x = vaddq_f32(vdupq_n_f32(subset->k0[0]), vmulq_n_f32(zl, subset->kz[0]));
+        float32x4_t y = vaddq_f32(vdupq_n_f32(subset->k0[1]), vmulq_n_f32(zl, subset->kz[1]));
+        for (int k = 0; k < subset->count; k++) {
+            const float *row = batch->ranges + subset->index[k] * batch->stride;
+            for (int l = 0; l < 4; l++) {
+                lane[l] = row[index[i + l]];
+            }
+            float32x4_t r = vld1q_f32(lane);
+            x = vsubq_f32(x, vmulq_f32(vmulq_n_f32(r, subset->p[0][k]), r));
+            y = vsubq_f32(y, vmulq_f32(vmulq_n_f32(r, subset->p[1][k]), r));
+        }
+        float out_x[4], out_y[4];
+        vst1q_f32(out_x, vaddq_f32(origin_x, x));
+        vst1q_f32(out_y, vaddq_f32(origin_y, y));
+        for (int l = 0; l < 4; l++) {
+            batch->x[index[i + l]] = out_x[l];
+            batch->y[index[i + l]] = out_y[l];
+        }
+    }
+    gather_scalar(batch, index + i, count - i);
+}
+#endif
+
+typedef void (*kernel_t)(const batch_t *batch, size_t begin, size_t end);
+
+static kernel_t s_kernel;
+static const char *s_isa;
+
+#if BATCH_GATHER
+typedef void (*gather_t)(const batch_t *batch, const uint32_t *index, size_t count);
+
+static gather_t s_gather;
+#endif
+
+static void select_kernel(void)
+{
+    s_kernel = solve_scalar;
+    s_isa = "scalar";
+#if BATCH_AVX2
+    s_gather = gather_scalar;
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        s_kernel = solve_avx2;
+        s_gather = gather_avx2;
+        s_isa = "avx2";
+    }
+#elif BATCH_NEON
+    s_kernel = solve_neon;
+    s_gather = gather_neon;
+    s_isa = "neon";
+#endif
+}
+
+const char *anchor_set_batch_isa(void)
+{
+    if (!s_kernel) {
+        select_kernel();
+    }
+    return s_isa;
+}
+
+/* Solves a run of beacons of one mask, or marks them unsolvable
+ *
+ * @return number of beacons solved.
+ */
+static size_t solve_run(anchor_set_t *set, batch_t *batch, uint16_t mask, size_t begin, size_t end)
+{
+    batch->subset = anchor_set_subset(set, mask);
+    if (!batch->subset || batch->subset->degenerate) {
+        for (size_t b = begin; b < end; b++) {
+            batch->x[b] = NAN;
+            batch->y[b] = NAN;
+        }
+        return 0;
+    }
+    s_kernel(batch, begin, end);
+    return end - begin;
+}
+
+#if BATCH_GATHER
+/* Beacons of short runs waiting to be solved */
+typedef struct {
+    uint32_t index[BATCH_BLOCK];
+    uint8_t group[BATCH_BLOCK];
+    uint16_t mask[BATCH_GROUPS];
+    uint32_t size[BATCH_GROUPS];
+    uint8_t slot[BATCH_HASH];           /* Group of a mask by hash, open addressing, 0xFF free */
+    int groups;
+    int count;
+} block_t;
+
+static void block_reset(block_t *block)
+{
+    memset(block->slot, 0xFF, sizeof(block->slot));
+    block->groups = 0;
+    block->count = 0;
+}
+
+/* Counting sort of the block by mask, then one gathered pass per mask */
+static size_t block_flush(anchor_set_t *set, batch_t *batch, block_t *block)
+{
+    uint32_t start[BATCH_GROUPS];
+    uint32_t at = 0;
+    for (int g = 0; g < block->groups; g++) {
+        start[g] = at;
+        at += block->size[g];
+    }
+    uint32_t sorted[BATCH_BLOCK];
+    for (int i = 0; i < block->count; i++) {
+        sorted[start[block->group[i]]++] = block->index[i];
+    }
+    size_t solved = 0;
+    for (int g = 0; g < block->groups; g++) {
+        const uint32_t *index = sorted + start[g] - block->size[g];
+        batch->subset = anchor_set_subset(set, block->mask[g]);
+        if (!batch->subset || batch->subset->degenerate) {
+            for (uint32_t i = 0; i < block->size[g]; i++) {
+                batch->x[index[i]] = NAN;
+                batch->y[index[i]] = NAN;
+            }
+            continue;
+        }
+        s_gather(batch, index, block->size[g]);
+        solved += block->size[g];
+    }
+    block_reset(block);
+    return solved;
+}
+
+static size_t block_add(anchor_set_t *set, batch_t *batch, block_t *block, uint16_t mask, size_t begin, size_t end)
+{
+    size_t solved = 0;
+    unsigned h = (mask * 40503u >> 8) % BATCH_HASH;
+    while (block->slot[h] != 0xFF && block->mask[block->slot[h]] != mask) {
+        h = (h + 1) % BATCH_HASH;
+    }
+    if (block->slot[h] == 0xFF && block->groups == BATCH_GROUPS) {
+        solved += block_flush(set, batch, block);
+        return solved + block_add(set, batch, block, mask, begin, end);
+    }
+    if (block->slot[h] == 0xFF) {
+        block->slot[h] = (uint8_t)block->groups;
+        block->mask[block->groups] = mask;
+        block->size[block->groups] = 0;
+        block->groups++;
+    }
+    int g = block->slot[h];
+    for (size_t b = begin; b < end; b++) {
+        if (block->count == BATCH_BLOCK) {
+            solved += block_flush(set, batch, block);
+            return solved + block_add(set, batch, block, mask, b, end);
+        }
+        block->index[block->count] = (uint32_t)b;
+        block->group[block->count++] = (uint8_t)g;
+        block->size[g]++;
+    }
+    return solved;
+}
+#endif
+
+size_t anchor_set_solve_batch(anchor_set_t *set, const uint16_t *masks, const float *ranges, size_t stride,
+                              const float *z, size_t count, float *x, float *y)
+{
+    if (!s_kernel) {
+        select_kernel();
+    }
+    batch_t batch = {
+        .origin = set->origin,
+        .ranges = ranges,
+        .stride = stride,
+        .z = z,
+        .x = x,
+        .y = y,
+    };
+#if BATCH_GATHER
+    block_t block;
+    block_reset(&block);
+#endif
+    size_t solved = 0;
+    size_t end;
+    for (size_t begin = 0; begin < count; begin = end) {
+        uint16_t mask = masks[begin];
+        for (end = begin + 1; end < count && masks[end] == mask; end++) {
+        }
+#if BATCH_GATHER
+        if (end - begin < BATCH_RUN_MIN) {
+            solved += block_add(set, &batch, &block, mask, begin, end);
+            continue;
+        }
+#endif
+        solved += solve_run(set, &batch, mask, begin, end);
+    }
+#if BATCH_GATHER
+    solved += block_flush(set, &batch, &block);
+#endif
+    return solved;
+}
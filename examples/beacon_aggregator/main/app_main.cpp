@@ -6,18 +6,22 @@
 #include <esp_matter_console.h>
 #include <esp_matter_ota.h>
 
+#include <anchor_registry.h>
 #include <app_priv.h>
 #include <app_reset.h>
+#include <calib.h>
+#include <obs_ingest.h>
+#include <radio_map_flash.h>
+#include <range_models.h>
+#include <solve_bench.h>
+
+#include <beacon_proto.h>
 
 #include <app/server/CommissioningWindowManager.h>
 #include <app/server/Server.h>
 static const char *TAG = "app_main";
 uint16_t light_endpoint_id = 0;
 
-uint16_t uuid1;
-uint16_t distance1;
-uint16_t recv_val;
-
 using namespace esp_matter;
 using namespace esp_matter::attribute;
 using namespace esp_matter::endpoint;
@@ -108,11 +112,17 @@ static esp_err_t app_attribute_update_cb(attribute::callback_type_t type, uint16
     esp_err_t err = ESP_OK;
 
     if (type == PRE_UPDATE) {
+        if (cluster_id == BEACON_PROTO_CLUSTER_ID) {
+#if CONFIG_BEACON_AGGREGATOR_PERSIST_REPORTS
+            return obs_ingest_report(attribute_id, val);
+#else
+            /* Reports are ingested by their override callback, see obs_ingest_cluster_create() */
+            return ESP_OK;
+#endif
+        }
         /* Driver update */
         app_driver_handle_t driver_handle = (app_driver_handle_t)priv_data;
         err = app_driver_attribute_update(driver_handle, endpoint_id, cluster_id, attribute_id, val);
-        recv_val = val->val.u16;
-        printf("\n\n\n\n\n\n%u\n\n\n\n\n\n\n",recv_val);
     }
 
     return err;
@@ -125,6 +135,10 @@ extern "C" void app_main()
     /* Initialize the ESP NVS layer */
     nvs_flash_init();
 
+    if (range_models_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to load range models");
+    }
+
     /* Initialize driver */
     app_driver_handle_t light_handle = app_driver_light_init();
     app_driver_handle_t button_handle = app_driver_button_init();
@@ -149,6 +163,10 @@ extern "C" void app_main()
         ESP_LOGE(TAG, "Matter node creation failed");
     }
 
+    if (obs_ingest_cluster_create(endpoint) != ESP_OK) {
+        ESP_LOGE(TAG, "Observation report cluster creation failed");
+    }
+
     uint16_t sensor_endpoint_id = endpoint::get_id(endpoint);
     ESP_LOGI(TAG, "Light created with endpoint_id %d", sensor_endpoint_id);
 
@@ -171,6 +189,12 @@ extern "C" void app_main()
 #if CONFIG_ENABLE_CHIP_SHELL
     esp_matter::console::diagnostics_register_commands();
     esp_matter::console::wifi_register_commands();
+    obs_ingest_register_commands();
+    anchor_registry_register_commands();
+    calib_register_commands();
+    range_models_register_commands();
+    solve_bench_register_commands();
+    radio_map_register_commands();
     esp_matter::console::init();
 #endif
 }
@@ -0,0 +1,253 @@
+#include <math.h>
+#include <string.h>
+
+#include "beacon_track.h"
+
+/* Filtered state entries: positions of the filtered axes first, then their velocities */
+static int state_index(uint8_t dims, int k)
+{
+    return k < dims ? k : 3 + (k - dims);
+}
+
+/* With the covariance split into 3x3 position, cross and velocity blocks A, B, C, the
+ * transition [I dt I; 0 I] gives
+ *     A' = A + dt (B + B^T) + dt^2 C,  B' = B + dt C,  C' = C
+ * plus the white acceleration noise q [dt^3/3 dt^2/2; dt^2/2 dt] on each axis. */
+void beacon_track_predict(beacon_track_t *track, uint8_t dims, float accel_noise, float dt)
+{
+    if (!(dt > 0)) {
+        return;
+    }
+    float (*p)[6] = track->p;
+    for (int i = 0; i < dims; i++) {
+        track->x[i] += dt * track->x[3 + i];
+        for (int j = 0; j < dims; j++) {
+            float c = p[3 + i][3 + j];
+            p[i][j] += dt * (p[i][3 + j] + p[3 + i][j]) + dt * dt * c;
+            p[i][3 + j] += dt * c;
+            p[3 + i][j] += dt * c;
+        }
+    }
+    float q = accel_noise;
+    for (int i = 0; i < dims; i++) {
+        p[i][i] += q * dt * dt * dt / 3;
+        p[i][3 + i] += q * dt * dt / 2;
+        p[3 + i][i] += q * dt * dt / 2;
+        p[3 + i][3 + i] += q * dt;
+    }
+}
+
+/* Scalar measurement with gradient h on the position: x += K nu, P -= P h h^T P / s */
+static void scalar_update(beacon_track_t *track, uint8_t dims, const float h[3], float nu, float s)
+{
+    float ph[6];
+    int n = 2 * dims;
+    for (int k = 0; k < n; k++) {
+        int row = state_index(dims, k);
+        ph[k] = 0;
+        for (int d = 0; d < dims; d++) {
+            ph[k] += track->p[row][d] * h[d];
+        }
+    }
+    for (int k = 0; k < n; k++) {
+        int row = state_index(dims, k);
+        track->x[row] += ph[k] / s * nu;
+        for (int l = 0; l < n; l++) {
+            track->p[row][state_index(dims, l)] -= ph[k] * ph[l] / s;
+        }
+    }
+}
+
+static float innovation_variance(const beacon_track_t *track, uint8_t dims, const float h[3], float r)
+{
+    float s = r;
+    for (int i = 0; i < dims; i++) {
+        for (int j = 0; j < dims; j++) {
+            s += h[i] * track->p[i][j] * h[j];
+        }
+    }
+    return s;
+}
+
+/* nu^T (P_pos + r I)^-1 nu through a Cholesky factorization, negative if not positive definite */
+static float fix_distance(const beacon_track_t *track, uint8_t dims, const float nu[3], float r)
+{
+    float l[3][3] = {{0}};
+    for (int i = 0; i < dims; i++) {
+        for (int j = 0; j <= i; j++) {
+            float sum = track->p[i][j] + (i == j ? r : 0);
+            for (int k = 0; k < j; k++) {
+                sum -= l[i][k] * l[j][k];
+            }
+            if (i == j) {
+                if (!(sum > 0)) {
+                    return -1;
+                }
+                l[i][i] = sqrtf(sum);
+            } else {
+                l[i][j] = sum / l[j][j];
+            }
+        }
+    }
+    float distance = 0;
+    float y[3];
+    for (int i = 0; i < dims; i++) {
+        float sum = nu[i];
+        for (int k = 0; k < i; k++) {
+            sum -= l[i][k] * y[k];
+        }
+        y[i] = sum / l[i][i];
+        distance += y[i] * y[i];
+    }
+    return distance;
+}
+
+static int find_slot(const beacon_tracks_t *tracks, uint32_t beacon)
+{
+    for (int i = 0; i < tracks->count; i++) {
+        if (tracks->beacon_id[i] == beacon) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void advance(beacon_tracks_t *tracks, beacon_track_t *track, uint32_t time_ms)
+{
+    int32_t elapsed = (int32_t)(time_ms - track->time_ms);
+    if (elapsed > 0) {
+        beacon_track_predict(track, tracks->dims, tracks->accel_noise, elapsed * 0.001f);
+        track->time_ms = time_ms;
+    }
+}
+
+void beacon_tracks_init(beacon_tracks_t *tracks, uint8_t dims, float accel_noise)
+{
+    memset(tracks, 0, sizeof(*tracks));
+    tracks->dims = dims == 3 ? 3 : 2;
+    tracks->accel_noise = accel_noise;
+}
+
+const beacon_track_t *beacon_tracks_find(const beacon_tracks_t *tracks, uint32_t beacon)
+{
+    int slot = find_slot(tracks, beacon);
+    return slot < 0 ? NULL : &tracks->track[slot];
+}
+
+static int alloc_slot(beacon_tracks_t *tracks)
+{
+    if (tracks->count < BEACON_TRACK_MAX) {
+        return tracks->count++;
+    }
+    int slot = 0;
+    for (int i = 1; i < BEACON_TRACK_MAX; i++) {
+        if ((int32_t)(tracks->last_update_ms[i] - tracks->last_update_ms[slot]) < 0) {
+            slot = i;
+        }
+    }
+    tracks->stats.evicted++;
+    return slot;
+}
+
+static void start_track(beacon_tracks_t *tracks, int slot, uint32_t beacon, const float pos[3], float sigma,
+                        uint32_t time_ms)
+{
+    tracks->beacon_id[slot] = beacon;
+    tracks->last_update_ms[slot] = time_ms;
+
+    beacon_track_t *track = &tracks->track[slot];
+    memset(track, 0, sizeof(*track));
+    memcpy(track->x, pos, 3 * sizeof(float));
+    for (int i = 0; i < tracks->dims; i++) {
+        track->p[i][i] = sigma * sigma;
+        track->p[3 + i][3 + i] = BEACON_TRACK_INITIAL_SPEED * BEACON_TRACK_INITIAL_SPEED;
+    }
+    track->time_ms = time_ms;
+    track->updates = 1;
+}
+
+int beacon_tracks_fix(beacon_tracks_t *tracks, uint32_t beacon, const float pos[3], float sigma, uint32_t time_ms)
+{
+    int slot = find_slot(tracks, beacon);
+    if (slot < 0) {
+        start_track(tracks, alloc_slot(tracks), beacon, pos, sigma, time_ms);
+        tracks->stats.created++;
+        return 0;
+    }
+    beacon_track_t *track = &tracks->track[slot];
+    advance(tracks, track, time_ms);
+
+    uint8_t dims = tracks->dims;
+    float r = sigma * sigma;
+    float nu[3];
+    for (int i = 0; i < dims; i++) {
+        nu[i] = pos[i] - track->x[i];
+    }
+    float distance = fix_distance(track, dims, nu, r);
+    if (distance < 0 || distance > (dims == 3 ? BEACON_TRACK_GATE_3D : BEACON_TRACK_GATE_2D)) {
+        track->rejected++;
+        tracks->stats.rejected++;
+        if (++track->misses < BEACON_TRACK_MAX_MISSES) {
+            return -1;
+        }
+        /* Keep the height of a 2D track, the fix does not carry one */
+        float start[3] = {pos[0], pos[1], dims == 3 ? pos[2] : track->x[2]};
+        start_track(tracks, slot, beacon, start, sigma, time_ms);
+        tracks->stats.restarted++;
+        return 0;
+    }
+
+    /* Independent coordinate errors, so the axes can be applied one after the other */
+    for (int i = 0; i < dims; i++) {
+        float h[3] = {0, 0, 0};
+        h[i] = 1;
+        scalar_update(track, dims, h, pos[i] - track->x[i], innovation_variance(track, dims, h, r));
+    }
+    track->updates++;
+    track->misses = 0;
+    tracks->last_update_ms[slot] = time_ms;
+    return 0;
+}
+
+int beacon_tracks_range(beacon_tracks_t *tracks, uint32_t beacon, const float anchor[3], float range, float sigma,
+                        uint32_t time_ms)
+{
+    int slot = find_slot(tracks, beacon);
+    if (slot < 0) {
+        return -1;
+    }
+    beacon_track_t *track = &tracks->track[slot];
+    advance(tracks, track, time_ms);
+
+    uint8_t dims = tracks->dims;
+    float g[3];
+    for (int i = 0; i < 3; i++) {
+        g[i] = track->x[i] - anchor[i];
+    }
+    float predicted = sqrtf(g[0] * g[0] + g[1] * g[1] + g[2] * g[2]);
+    if (predicted < 1e-3f) {
+        return -1;
+    }
+    float h[3];
+    for (int i = 0; i < 3; i++) {
+        h[i] = g[i] / predicted;
+    }
+    float nu = range - predicted;
+    float s = innovation_variance(track, dims, h, sigma * sigma);
+    if (!(nu * nu <= BEACON_TRACK_GATE_1D * s)) {
+        track->rejected++;
+        tracks->stats.rejected++;
+        return -1;
+    }
+    scalar_update(track, dims, h, nu, s);
+    track->updates++;
+    tracks->last_update_ms[slot] = time_ms;
+    return 0;
+}
+
+void beacon_tracks_predict_all(beacon_tracks_t *tracks, uint32_t now_ms)
+{
+    for (int i = 0; i < tracks->count; i++) {
+        advance(tracks, &tracks->track[i], now_ms);
+    }
+}
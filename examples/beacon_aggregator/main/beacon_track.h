@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Constant velocity Kalman tracking of beacons.
+ *
+ * Each tracked beacon keeps a position and velocity with their covariance in a fixed size
+ * slot. Solved fixes and single ranges both update the same state: fixes as a direct position
+ * measurement, ranges through the linearized distance to their anchor, so a beacon heard by
+ * fewer than three anchors still moves. Motion between measurements is modeled as white
+ * acceleration noise.
+ *
+ * In 2D the height stays at the one given with the first fix and only x and y are filtered.
+ *
+ * Measurements whose innovation falls outside a chi-square gate are rejected, so a single
+ * reflected range or a bad fix does not drag the track. A track that keeps rejecting fixes has
+ * lost the beacon and restarts at the next one.
+ *
+ * Not thread safe.
+ */
+
+#ifndef BEACON_TRACK_MAX
+#define BEACON_TRACK_MAX 64
+#endif
+
+/* 99% chi-square bounds of the squared normalized innovation for 1, 2 and 3 degrees of freedom */
+#define BEACON_TRACK_GATE_1D 6.63f
+#define BEACON_TRACK_GATE_2D 9.21f
+#define BEACON_TRACK_GATE_3D 11.34f
+
+#define BEACON_TRACK_INITIAL_SPEED 1.5f     /* m/s, standard deviation of the velocity of a new track */
+#define BEACON_TRACK_MAX_MISSES 3           /* Consecutive gated out fixes after which a track restarts */
+
+typedef struct {
+    float x[6];             /* x, y, z, then their velocities */
+    float p[6][6];          /* Covariance */
+    uint32_t time_ms;       /* Time the state refers to */
+    uint16_t updates;
+    uint16_t rejected;      /* Measurements outside the gate */
+    uint8_t misses;         /* Fixes rejected since the last accepted one */
+} beacon_track_t;
+
+typedef struct {
+    uint32_t created;
+    uint32_t evicted;
+    uint32_t rejected;
+    uint32_t restarted;
+} beacon_tracks_stats_t;
+
+typedef struct {
+    uint32_t beacon_id[BEACON_TRACK_MAX];
+    uint32_t last_update_ms[BEACON_TRACK_MAX];
+    beacon_track_t track[BEACON_TRACK_MAX];
+    uint16_t count;
+    uint8_t dims;           /* 2 or 3 */
+    float accel_noise;      /* Acceleration noise density, m^2/s^3 */
+    beacon_tracks_stats_t stats;
+} beacon_tracks_t;
+
+/** Clear the table
+ *
+ * @param[in] dims 2 to filter x and y at the height of the first fix, 3 to filter z as well.
+ * @param[in] accel_noise Acceleration noise density in m^2/s^3, about 0.5 for people walking.
+ */
+void beacon_tracks_init(beacon_tracks_t *tracks, uint8_t dims, float accel_noise);
+
+/** Track of a beacon
+ *
+ * @return track, NULL if the beacon is not tracked.
+ */
+const beacon_track_t *beacon_tracks_find(const beacon_tracks_t *tracks, uint32_t beacon);
+
+/** Update a beacon with a solved position
+ *
+ * Starts a track on the first fix, evicting the one updated least recently if the table is full,
+ * and restarts it after BEACON_TRACK_MAX_MISSES fixes in a row fell outside the gate.
+ *
+ * @param[in] pos Position, pos[2] only read in 3D and for a new track.
+ * @param[in] sigma Standard deviation of each coordinate of the fix, metres.
+ *
+ * @return 0 if the fix was applied.
+ * @return -1 if it was rejected by the gate.
+ */
+int beacon_tracks_fix(beacon_tracks_t *tracks, uint32_t beacon, const float pos[3], float sigma, uint32_t time_ms);
+
+/** Update a tracked beacon with one range
+ *
+ * @param[in] sigma Standard deviation of the range, see multilat_range_sigma().
+ *
+ * @return 0 if the range was applied.
+ * @return -1 if the beacon has no track yet, which takes a fix, or the range was rejected.
+ */
+int beacon_tracks_range(beacon_tracks_t *tracks, uint32_t beacon, const float anchor[3], float range, float sigma,
+                        uint32_t time_ms);
+
+/** Predict every track forward to `now_ms`
+ *
+ * Tracks already at or past `now_ms` are left alone.
+ */
+void beacon_tracks_predict_all(beacon_tracks_t *tracks, uint32_t now_ms);
+
+/** Predict one track forward by `dt` seconds */
+void beacon_track_predict(beacon_track_t *track, uint8_t dims, float accel_noise, float dt);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,134 @@
+#include <esp_log.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_matter.h>
+#include <esp_matter_console.h>
+
+#include <anchor_registry.h>
+#include <calib.h>
+
+static const char *TAG = "calib";
+
+#define CALIB_MAX_REFERENCES 8
+
+typedef struct {
+    uint32_t id;
+    float pos[3];
+} placed_t;
+
+static pathloss_cal_t s_cal;
+static bool s_cal_ready;
+static placed_t s_references[CALIB_MAX_REFERENCES];
+static int s_reference_count;
+static uint16_t s_slot_mediator[PATHLOSS_CAL_MAX_MEDIATORS];
+
+static const placed_t *find(const placed_t *table, int count, uint32_t id)
+{
+    for (int i = 0; i < count; i++) {
+        if (table[i].id == id) {
+            return &table[i];
+        }
+    }
+    return NULL;
+}
+
+/* Adds or moves an entry */
+static esp_err_t place(placed_t *table, int *count, int max, uint32_t id, const float pos[3])
+{
+    placed_t *entry = const_cast<placed_t *>(find(table, *count, id));
+    if (!entry) {
+        if (*count == max) {
+            return ESP_ERR_NO_MEM;
+        }
+        entry = &table[(*count)++];
+        entry->id = id;
+    }
+    memcpy(entry->pos, pos, sizeof(entry->pos));
+    return ESP_OK;
+}
+
+static void calib_reset()
+{
+    /* About 15 minutes of memory for a reference beacon heard every second */
+    pathloss_cal_init(&s_cal, 0.999f, 5.0f);
+    s_cal_ready = true;
+}
+
+void calib_observe(uint8_t slot, uint16_t mediator, uint32_t beacon, float level_db)
+{
+    if (!s_cal_ready) {
+        calib_reset();
+    }
+    if (slot >= PATHLOSS_CAL_MAX_MEDIATORS) {
+        return;
+    }
+    s_slot_mediator[slot] = mediator;
+
+    const placed_t *reference = find(s_references, s_reference_count, beacon);
+    float anchor[3];
+    if (reference && anchor_registry_position(mediator, anchor)) {
+        float dx = reference->pos[0] - anchor[0];
+        float dy = reference->pos[1] - anchor[1];
+        float dz = reference->pos[2] - anchor[2];
+        pathloss_cal_observe(&s_cal, slot, sqrtf(dx * dx + dy * dy + dz * dz), level_db);
+    }
+}
+
+bool calib_model(uint8_t slot, pathloss_model_t *model)
+{
+    if (!s_cal_ready || slot >= PATHLOSS_CAL_MAX_MEDIATORS ||
+        s_cal.mediator[slot].samples < PATHLOSS_CAL_MIN_SAMPLES) {
+        return false;
+    }
+    *model = pathloss_cal_model(&s_cal, slot);
+    return true;
+}
+
+static esp_err_t calib_console_handler(int argc, char **argv)
+{
+    if (argc == 0) {
+        printf("%d reference beacons, mediators are placed with `matter esp anchor`\n", s_reference_count);
+        printf("mediator  samples  exponent  offset(dB)  rms(dB)\n");
+        for (int i = 0; i < PATHLOSS_CAL_MAX_MEDIATORS; i++) {
+            const pathloss_cal_mediator_t *m = &s_cal.mediator[i];
+            if (m->samples == 0) {
+                continue;
+            }
+            printf("  0x%04x  %7u  %8.2f  %10.1f  %7.1f%s\n", s_slot_mediator[i], m->samples, m->model.exponent,
+                   m->model.offset_db, m->rms_db, m->samples < PATHLOSS_CAL_MIN_SAMPLES ? "  (not applied yet)" : "");
+        }
+        return ESP_OK;
+    }
+    if (argc == 1 && strcmp(argv[0], "reset") == 0) {
+        chip::DeviceLayer::PlatformMgr().LockChipStack();
+        calib_reset();
+        chip::DeviceLayer::PlatformMgr().UnlockChipStack();
+        return ESP_OK;
+    }
+    if (argc == 5 && strcmp(argv[0], "ref") == 0) {
+        uint32_t id = strtoul(argv[1], NULL, 0);
+        float pos[3] = {strtof(argv[2], NULL), strtof(argv[3], NULL), strtof(argv[4], NULL)};
+        chip::DeviceLayer::PlatformMgr().LockChipStack();
+        esp_err_t err = place(s_references, &s_reference_count, CALIB_MAX_REFERENCES, id, pos);
+        chip::DeviceLayer::PlatformMgr().UnlockChipStack();
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "No room for another reference beacon");
+        }
+        return err;
+    }
+    printf("Usage: matter esp calib [reset | ref <beacon> <x> <y> <z>]\n");
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t calib_register_commands()
+{
+    static const esp_matter::console::command_t command = {
+        .name = "calib",
+        .description = "Path loss calibration from reference beacons. "
+                       "Usage: matter esp calib [reset | ref <beacon> <x> <y> <z>]",
+        .handler = calib_console_handler,
+    };
+    return esp_matter::console::add_commands(&command, 1);
+}
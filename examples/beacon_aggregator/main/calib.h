@@ -0,0 +1,30 @@
+#pragma once
+
+#include <esp_err.h>
+#include <stdint.h>
+
+#include <pathloss_cal.h>
+
+/** Add an observation to the calibration of its mediator, if the beacon is a reference
+ *
+ * See pathloss_cal.h. Called on the CHIP thread for every observation.
+ *
+ * @param[in] slot Mediator slot in the observation store.
+ * @param[in] mediator Mediator ID.
+ * @param[in] level_db tx_power - rssi of the observation.
+ */
+void calib_observe(uint8_t slot, uint16_t mediator, uint32_t beacon, float level_db);
+
+/** Calibrated path loss model of a mediator
+ *
+ * @return true once the mediator's fit has enough observations.
+ */
+bool calib_model(uint8_t slot, pathloss_model_t *model);
+
+/** Register the `calib` console command
+ *
+ * `matter esp calib` lists the fitted models, `calib ref <beacon> <x> <y> <z>` places a
+ * reference beacon, in metres, and `calib reset` starts over. Mediator positions come from
+ * anchor_registry.h.
+ */
+esp_err_t calib_register_commands();
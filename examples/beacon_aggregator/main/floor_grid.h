@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Rasterized floor plan: one bit per square cell, set where nobody can stand (walls, machines,
+ * racks). Rows run along x, bit (x % 8) of byte row * stride + x / 8. The bitmap is only read,
+ * so it can be a const array in flash. Everything outside the grid counts as blocked.
+ */
+
+typedef struct {
+    float origin[2];        /* Site coordinates of the corner of cell (0, 0), metres */
+    float cell;             /* Cell size, metres */
+    uint16_t width;         /* Cells along x */
+    uint16_t height;        /* Cells along y */
+    uint16_t stride;        /* Bytes per row, at least (width + 7) / 8 */
+    const uint8_t *bits;
+} floor_grid_t;
+
+static inline int floor_grid_blocked_cell(const floor_grid_t *grid, int cx, int cy)
+{
+    if (cx < 0 || cy < 0 || cx >= grid->width || cy >= grid->height) {
+        return 1;
+    }
+    return (grid->bits[cy * grid->stride + (cx >> 3)] >> (cx & 7)) & 1;
+}
+
+static inline int floor_grid_blocked(const floor_grid_t *grid, float x, float y)
+{
+    float fx = (x - grid->origin[0]) / grid->cell;
+    float fy = (y - grid->origin[1]) / grid->cell;
+    /* Compare before converting, a float outside the int range has no defined conversion */
+    if (!(fx >= 0 && fy >= 0 && fx < grid->width && fy < grid->height)) {
+        return 1;
+    }
+    return floor_grid_blocked_cell(grid, (int)fx, (int)fy);
+}
+
+#ifdef __cplusplus
+}
+#endif
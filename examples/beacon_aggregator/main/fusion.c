@@ -0,0 +1,139 @@
+#include <math.h>
+#include <string.h>
+
+#include "fusion.h"
+#include "multilat.h"
+
+void fusion_init(fusion_t *fusion, const fusion_config_t *config)
+{
+    memset(fusion, 0, sizeof(*fusion));
+    fusion->config = *config;
+}
+
+/* Ring entry of the newest capture, backlog can arrive out of order */
+static int newest_sample(const obs_store_t *store, int slot, int m)
+{
+    const uint32_t *time = store->time_ms[slot][m];
+    int newest = -1;
+    for (int i = 0; i < store->fill[slot][m]; i++) {
+        if (newest < 0 || (int32_t)(time[i] - time[newest]) > 0) {
+            newest = i;
+        }
+    }
+    return newest;
+}
+
+/* Least squares range rate over the samples up to max_ms before the newest, in m/s
+ *
+ * @return 0 on success, -1 if they span less than FUSION_MIN_BASELINE_MS.
+ */
+static int range_rate(const obs_store_t *store, int slot, int m, int newest, uint32_t max_ms, float *rate)
+{
+    const uint16_t *distance = store->distance_cm[slot][m];
+    const uint32_t *time = store->time_ms[slot][m];
+    float st = 0, sd = 0, stt = 0, std = 0;
+    int32_t span = 0;
+    int n = 0;
+    for (int i = 0; i < store->fill[slot][m]; i++) {
+        int32_t before = (int32_t)(time[newest] - time[i]);
+        if (before < 0 || (uint32_t)before > max_ms) {
+            continue;
+        }
+        float t = -before * 0.001f;
+        float d = distance[i] * 0.01f;
+        st += t;
+        sd += d;
+        stt += t * t;
+        std += t * d;
+        span = before > span ? before : span;
+        n++;
+    }
+    if (span < FUSION_MIN_BASELINE_MS) {
+        return -1;
+    }
+    *rate = (n * std - st * sd) / (n * stt - st * st);
+    return 0;
+}
+
+int fusion_offer(fusion_t *fusion, const obs_store_t *store, int slot, uint32_t now_ms, fusion_set_t *set)
+{
+    const fusion_config_t *config = &fusion->config;
+    uint32_t beacon = store->beacon_id[slot];
+    uint32_t fix_ms = store->beacon_last_ms[slot];
+    int known = fusion->has_set[slot] && fusion->beacon_id[slot] == beacon;
+    if (known && (int32_t)(now_ms - fusion->last_set_ms[slot]) < (int32_t)config->holdoff_ms) {
+        fusion->stats.held++;
+        return FUSION_HELD;
+    }
+
+    memset(set, 0, sizeof(*set));
+    set->beacon = beacon;
+    set->time_ms = fix_ms;
+    int fresh = 0;
+    uint32_t discarded = 0;
+    obs_store_anchor_t anchors[OBS_STORE_MAX_MEDIATORS];
+    size_t summaries = obs_store_query(store, slot, fix_ms, config->max_extrapolate_ms, anchors);
+    size_t summary = 0;
+    uint32_t mask = store->anchor_mask[slot];
+    while (mask) {
+        int m = __builtin_ctz(mask);
+        mask &= mask - 1;
+
+        int newest = newest_sample(store, slot, m);
+        if (newest < 0) {
+            continue;
+        }
+        const uint16_t *distance = store->distance_cm[slot][m];
+        const uint32_t *time = store->time_ms[slot][m];
+        int32_t age = (int32_t)(fix_ms - time[newest]);
+        if (age < 0) {
+            age = 0;
+        }
+        float range = distance[newest] * 0.01f;
+        if ((uint32_t)age > config->window_ms) {
+            float rate;
+            if ((uint32_t)age > config->max_extrapolate_ms ||
+                range_rate(store, slot, m, newest, config->max_extrapolate_ms, &rate) != 0) {
+                discarded++;
+                continue;
+            }
+            rate = rate > FUSION_MAX_SPEED ? FUSION_MAX_SPEED : rate < -FUSION_MAX_SPEED ? -FUSION_MAX_SPEED : rate;
+            range += rate * age * 0.001f;
+            if (range < 0) {
+                range = 0;
+            }
+            set->extrapolated++;
+        } else {
+            fresh++;
+        }
+        /* Query results come in mediator slot order, as this loop */
+        while (summary < summaries && anchors[summary].mediator < m) {
+            summary++;
+        }
+        float var = 0;
+        if (summary < summaries && anchors[summary].mediator == m) {
+            var = anchors[summary].var_cm2 * 1e-4f;
+        }
+        float model = multilat_range_sigma(range, 0, 1, config->sigma_db, config->exponent);
+        set->ranges[m] = range;
+        set->sigmas[m] = fmaxf(sqrtf(model * model + var), FUSION_MIN_SIGMA);
+        set->mask |= 1u << m;
+        set->count++;
+        if ((uint32_t)age > set->age_spread_ms) {
+            set->age_spread_ms = (uint32_t)age;
+        }
+    }
+
+    if (set->count < config->min_anchors || fresh < config->min_fresh) {
+        fusion->stats.waiting++;
+        return FUSION_WAITING;
+    }
+    fusion->beacon_id[slot] = beacon;
+    fusion->last_set_ms[slot] = now_ms;
+    fusion->has_set[slot] = 1;
+    fusion->stats.sets++;
+    fusion->stats.extrapolated += set->extrapolated;
+    fusion->stats.discarded += discarded;
+    fusion->stats.age_spread_ms += set->age_spread_ms;
+    return FUSION_READY;
+}
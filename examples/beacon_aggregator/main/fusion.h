@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "obs_store.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Time aligned range sets for the solvers.
+ *
+ * Mediators report on their own schedule, so the latest range of each anchor of a beacon can be
+ * seconds older than the others, and for a moving beacon the ranges then describe different
+ * positions. The fusion window takes the capture time of the beacon's newest range as the time
+ * of the fix and builds the set from obs_store.h samples around it:
+ *
+ *  - a range captured within window_ms of that time is used as is,
+ *  - an older one, up to max_extrapolate_ms, is moved forward along the least squares trend of
+ *    its samples over that time, at no more than FUSION_MAX_SPEED,
+ *  - anything older, or old without a trend, is left out.
+ *
+ * A set is only released once min_anchors ranges are in, min_fresh of them within the window,
+ * and at most once per holdoff_ms per beacon, on the clock of the offers. An offer inside the
+ * holdoff is held rather than dropped: the caller offers the beacon again once the holdoff is
+ * over, so the newest ranges still make a set even if no more come in. Each set reports its age
+ * spread, how much older its oldest capture is than the fix.
+ *
+ * Each range also carries its standard deviation for the weighted solvers and the tracker: the
+ * path loss model error of multilat_range_sigma() at that range, plus the sample variance of
+ * the pair over max_extrapolate_ms before the fix, in full since the range is a single sample.
+ *
+ * State is one entry per obs_store beacon slot, so memory is fixed whatever the report rate.
+ * Not thread safe.
+ */
+
+#define FUSION_MAX_SPEED 3.0f           /* m/s, bound on the range rate used to extrapolate */
+#define FUSION_MIN_BASELINE_MS 200      /* Samples closer in time give no usable trend */
+#define FUSION_MIN_SIGMA 0.1f           /* m, a range next to the mediator must not take all the weight */
+
+/* fusion_offer() results */
+#define FUSION_WAITING 0                /* Not enough ranges, a new sample offers the beacon again */
+#define FUSION_READY 1
+#define FUSION_HELD 2                   /* Within the holdoff, offer again after it */
+
+typedef struct {
+    uint32_t window_ms;
+    uint32_t max_extrapolate_ms;
+    uint8_t min_anchors;
+    uint8_t min_fresh;
+    uint32_t holdoff_ms;
+    float sigma_db;                     /* RSSI error the path loss model leaves, see multilat_range_sigma() */
+    float exponent;                     /* Path loss exponent the ranges were computed with */
+} fusion_config_t;
+
+#define FUSION_CONFIG_DEFAULT() {       \
+    .window_ms = 300,                   \
+    .max_extrapolate_ms = 2000,         \
+    .min_anchors = 3,                   \
+    .min_fresh = 2,                     \
+    .holdoff_ms = 250,                  \
+    .sigma_db = 2.0f,                   \
+    .exponent = 2.0f,                   \
+}
+
+typedef struct {
+    uint32_t beacon;
+    uint32_t time_ms;                   /* Capture time of the newest range, the ranges are aligned to it */
+    uint16_t mask;                      /* Mediator slots with a range */
+    uint8_t count;
+    uint8_t extrapolated;
+    uint32_t age_spread_ms;             /* Fix time minus the oldest capture used */
+    float ranges[OBS_STORE_MAX_MEDIATORS];      /* Metres, by mediator slot */
+    float sigmas[OBS_STORE_MAX_MEDIATORS];      /* Standard deviation of each range, metres */
+} fusion_set_t;
+
+typedef struct {
+    uint32_t sets;
+    uint32_t waiting;                   /* Offers without enough ranges */
+    uint32_t held;                      /* Offers within the holdoff of the last set */
+    uint32_t extrapolated;              /* Ranges moved forward, over all sets */
+    uint32_t discarded;                 /* Ranges too old for their set */
+    uint64_t age_spread_ms;             /* Sum over all sets */
+} fusion_stats_t;
+
+typedef struct {
+    fusion_config_t config;
+    uint32_t beacon_id[OBS_STORE_MAX_BEACONS];  /* Beacon the slot held at its last set */
+    uint32_t last_set_ms[OBS_STORE_MAX_BEACONS];    /* Offer time of the last set */
+    uint8_t has_set[OBS_STORE_MAX_BEACONS];
+    fusion_stats_t stats;
+} fusion_t;
+
+void fusion_init(fusion_t *fusion, const fusion_config_t *config);
+
+/** Build the set of a beacon after new samples came in
+ *
+ * @param[in] slot Beacon slot, as returned by obs_store_insert().
+ * @param[in] now_ms Time of the offer, which the holdoff is measured on.
+ * @param[out] set Aligned ranges.
+ *
+ * @return FUSION_READY if the set is ready to solve, FUSION_WAITING if the beacon is waiting
+ *         for more ranges, FUSION_HELD if its last set was released less than holdoff_ms ago.
+ */
+int fusion_offer(fusion_t *fusion, const obs_store_t *store, int slot, uint32_t now_ms, fusion_set_t *set);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,227 @@
+#include <math.h>
+#include <string.h>
+
+#include "grid_locator.h"
+
+/* Ranges of one solve, in the units of the distance table */
+typedef struct {
+    int count;
+    uint8_t column[ANCHOR_SET_MAX_ANCHORS];
+    float range_cm[ANCHOR_SET_MAX_ANCHORS];
+    float weight[ANCHOR_SET_MAX_ANCHORS];  /* 1 / (2 sigma^2), 1/cm^2 */
+} query_t;
+
+/* Cost of a range that misses by GRID_LOCATOR_OUTLIER_SIGMAS or more */
+#define OUTLIER_COST (0.5f * GRID_LOCATOR_OUTLIER_SIGMAS * GRID_LOCATOR_OUTLIER_SIGMAS)
+
+typedef struct {
+    uint16_t cx;
+    uint16_t cy;
+    float cost;
+} candidate_t;
+
+void grid_locator_build(grid_locator_t *loc, const anchor_set_t *set, const floor_grid_t *grid, float z,
+                        uint16_t *storage)
+{
+    memset(loc, 0, sizeof(*loc));
+    loc->grid = *grid;
+    loc->z = z;
+    loc->distance_cm = storage;
+    loc->step = (uint16_t)ceilf(GRID_LOCATOR_COARSE_SPACING / grid->cell);
+    if (loc->step < 1) {
+        loc->step = 1;
+    }
+
+    float anchors[ANCHOR_SET_MAX_ANCHORS][3];
+    for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+        if (set->present & (1u << i)) {
+            loc->column[i] = loc->anchors;
+            for (int d = 0; d < 3; d++) {
+                anchors[loc->anchors][d] = set->origin[d] + set->pos[i][d];
+            }
+            loc->anchors++;
+        }
+    }
+    loc->present = set->present;
+
+    uint16_t *out = storage;
+    for (int cy = 0; cy < grid->height; cy++) {
+        float y = grid->origin[1] + (cy + 0.5f) * grid->cell;
+        for (int cx = 0; cx < grid->width; cx++) {
+            float x = grid->origin[0] + (cx + 0.5f) * grid->cell;
+            for (int k = 0; k < loc->anchors; k++) {
+                float dx = x - anchors[k][0];
+                float dy = y - anchors[k][1];
+                float dz = z - anchors[k][2];
+                float cm = sqrtf(dx * dx + dy * dy + dz * dz) * 100.0f + 0.5f;
+                *out++ = cm < 65535.0f ? (uint16_t)cm : 65535;
+            }
+        }
+    }
+}
+
+static int prepare(const grid_locator_t *loc, uint16_t mask, const float ranges[], const float sigmas[], query_t *q)
+{
+    if (mask == 0 || (mask & ~loc->present) != 0) {
+        return -1;
+    }
+    q->count = 0;
+    for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+        if (mask & (1u << i)) {
+            float sigma_cm = (sigmas ? sigmas[i] : 1.0f) * 100.0f;
+            q->column[q->count] = loc->column[i];
+            q->range_cm[q->count] = ranges[i] * 100.0f;
+            q->weight[q->count] = 0.5f / (sigma_cm * sigma_cm);
+            q->count++;
+        }
+    }
+    return 0;
+}
+
+static float cell_cost(const grid_locator_t *loc, const query_t *q, int cx, int cy)
+{
+    const uint16_t *distance = loc->distance_cm + ((size_t)cy * loc->grid.width + cx) * loc->anchors;
+    float cost = 0;
+    for (int k = 0; k < q->count; k++) {
+        float e = distance[q->column[k]] - q->range_cm[k];
+        cost += fminf(e * e * q->weight[k], OUTLIER_COST);
+    }
+    return cost;
+}
+
+static int blocked(const grid_locator_t *loc, int cx, int cy)
+{
+    return loc->grid.bits && floor_grid_blocked_cell(&loc->grid, cx, cy);
+}
+
+/* Keeps the lowest cost candidates, sorted */
+static int offer(candidate_t best[], int found, int cx, int cy, float cost)
+{
+    if (found == GRID_LOCATOR_CANDIDATES && cost >= best[found - 1].cost) {
+        return found;
+    }
+    int i = found < GRID_LOCATOR_CANDIDATES ? found++ : GRID_LOCATOR_CANDIDATES - 1;
+    while (i > 0 && best[i - 1].cost > cost) {
+        best[i] = best[i - 1];
+        i--;
+    }
+    best[i].cx = (uint16_t)cx;
+    best[i].cy = (uint16_t)cy;
+    best[i].cost = cost;
+    return found;
+}
+
+int grid_locator_solve(const grid_locator_t *loc, uint16_t mask, const float ranges[ANCHOR_SET_MAX_ANCHORS],
+                       const float sigmas[ANCHOR_SET_MAX_ANCHORS], grid_locator_fix_t *fix)
+{
+    query_t q;
+    if (prepare(loc, mask, ranges, sigmas, &q) != 0) {
+        return -1;
+    }
+    int width = loc->grid.width;
+    int height = loc->grid.height;
+    int step = loc->step;
+    memset(fix, 0, sizeof(*fix));
+
+    /* Coarse pass, blocked cells included: a corridor narrower than the step still gets the
+     * candidates around it, and the fine pass skips the blocked cells */
+    candidate_t candidates[GRID_LOCATOR_CANDIDATES];
+    int found = 0;
+    for (int cy = step / 2; cy < height; cy += step) {
+        for (int cx = step / 2; cx < width; cx += step) {
+            found = offer(candidates, found, cx, cy, cell_cost(loc, &q, cx, cy));
+            fix->evaluated++;
+        }
+    }
+
+    /* Fine pass over the cells up to the coarse neighbours of each candidate. The
+     * likelihood weighted moments of the window are summed relative to its best cell so far,
+     * rescaled when a better one turns up. */
+    float best = INFINITY;
+    for (int c = 0; c < found; c++) {
+        float window_best = INFINITY;
+        int best_x = 0, best_y = 0;
+        float s0 = 0, sx = 0, sy = 0, s2 = 0;
+        for (int cy = candidates[c].cy - step; cy <= candidates[c].cy + step; cy++) {
+            for (int cx = candidates[c].cx - step; cx <= candidates[c].cx + step; cx++) {
+                if (cx < 0 || cy < 0 || cx >= width || cy >= height || blocked(loc, cx, cy)) {
+                    continue;
+                }
+                float cost = cell_cost(loc, &q, cx, cy);
+                fix->evaluated++;
+                if (cost < window_best) {
+                    float scale = isinf(window_best) ? 0 : expf(cost - window_best);
+                    s0 *= scale;
+                    sx *= scale;
+                    sy *= scale;
+                    s2 *= scale;
+                    window_best = cost;
+                    best_x = cx;
+                    best_y = cy;
+                }
+                float w = expf(window_best - cost);
+                float dx = (float)(cx - candidates[c].cx);
+                float dy = (float)(cy - candidates[c].cy);
+                s0 += w;
+                sx += w * dx;
+                sy += w * dy;
+                s2 += w * (dx * dx + dy * dy);
+            }
+        }
+        if (!(window_best < best)) {
+            continue;
+        }
+        best = window_best;
+        float cell = loc->grid.cell;
+        float mx = sx / s0;
+        float my = sy / s0;
+        fix->pos[0] = loc->grid.origin[0] + (candidates[c].cx + mx + 0.5f) * cell;
+        fix->pos[1] = loc->grid.origin[1] + (candidates[c].cy + my + 0.5f) * cell;
+        fix->spread = sqrtf(fmaxf(s2 / s0 - mx * mx - my * my, 0)) * cell;
+        if (loc->grid.bits && floor_grid_blocked(&loc->grid, fix->pos[0], fix->pos[1])) {
+            fix->pos[0] = loc->grid.origin[0] + (best_x + 0.5f) * cell;
+            fix->pos[1] = loc->grid.origin[1] + (best_y + 0.5f) * cell;
+        }
+    }
+    if (isinf(best)) {
+        return -1;
+    }
+    fix->pos[2] = loc->z;
+    fix->cost = best;
+    return 0;
+}
+
+int grid_locator_surface(const grid_locator_t *loc, uint16_t mask, const float ranges[ANCHOR_SET_MAX_ANCHORS],
+                         const float sigmas[ANCHOR_SET_MAX_ANCHORS], float *surface)
+{
+    query_t q;
+    if (prepare(loc, mask, ranges, sigmas, &q) != 0) {
+        return -1;
+    }
+    int width = loc->grid.width;
+    int height = loc->grid.height;
+    float best = INFINITY;
+    int peak = -1;
+    for (int cy = 0, i = 0; cy < height; cy++) {
+        for (int cx = 0; cx < width; cx++, i++) {
+            surface[i] = blocked(loc, cx, cy) ? INFINITY : cell_cost(loc, &q, cx, cy);
+            if (surface[i] < best) {
+                best = surface[i];
+                peak = i;
+            }
+        }
+    }
+    if (peak < 0) {
+        return -1;
+    }
+    float total = 0;
+    int cells = width * height;
+    for (int i = 0; i < cells; i++) {
+        surface[i] = expf(best - surface[i]);
+        total += surface[i];
+    }
+    for (int i = 0; i < cells; i++) {
+        surface[i] /= total;
+    }
+    return peak;
+}
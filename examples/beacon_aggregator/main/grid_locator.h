@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "anchor_set.h"
+#include "floor_grid.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Position estimate by scoring the cells of a floor grid.
+ *
+ * Every cell is a candidate position at the beacon height, scored by the likelihood of the
+ * measured ranges: the cost of a cell is half the sum of the squared range errors over their
+ * variances, and the likelihood exp(-cost). A range that misses by more than
+ * GRID_LOCATOR_OUTLIER_SIGMAS standard deviations costs no more than that, so one reflected range
+ * pulls the estimate far less than it pulls a least squares solve, and with two or three
+ * ranges the estimate is still where the circles come closest instead of failing.
+ *
+ * The distance from every cell to every anchor of an anchor_set_t layout is computed once, when
+ * the layout is loaded, into a table the caller provides. A solve then only subtracts and
+ * squares: first on every step-th cell of the grid, then on every cell around the best
+ * GRID_LOCATOR_CANDIDATES coarse cells. Blocked cells of the floor grid are never candidates.
+ *
+ * grid_locator_surface() scores every cell instead and returns the normalized likelihood of
+ * each, for display or for fusing with other estimates.
+ */
+
+#ifndef GRID_LOCATOR_COARSE_SPACING
+#define GRID_LOCATOR_COARSE_SPACING 1.0f    /* Metres between the cells of the coarse pass */
+#endif
+#ifndef GRID_LOCATOR_CANDIDATES
+#define GRID_LOCATOR_CANDIDATES 4
+#endif
+#define GRID_LOCATOR_OUTLIER_SIGMAS 3.0f
+
+/* uint16_t entries of the distance table for a grid and a number of anchors */
+#define GRID_LOCATOR_STORAGE(width, height, anchors) ((size_t)(width) * (height) * (anchors))
+
+typedef struct {
+    floor_grid_t grid;              /* bits may be NULL for a floor without obstacles */
+    float z;                        /* Beacon height */
+    uint16_t present;               /* Anchors with distances in the table */
+    uint8_t anchors;
+    uint8_t column[ANCHOR_SET_MAX_ANCHORS];     /* Table column of each anchor index */
+    uint16_t step;                  /* Cells between coarse pass cells */
+    uint16_t *distance_cm;          /* [cell][column], cells row by row along x */
+} grid_locator_t;
+
+typedef struct {
+    float pos[3];
+    float spread;                   /* Likelihood weighted RMS distance of the cells around pos, metres */
+    float cost;                     /* Cost of the best cell */
+    uint32_t evaluated;             /* Cells scored */
+} grid_locator_fix_t;
+
+/** Compute the cell to anchor distances of a layout
+ *
+ * Call again whenever the layout changes.
+ *
+ * @param[in] grid Grid geometry and obstacles, copied; the bitmap must outlive the locator.
+ * @param[in] z Height of the beacons.
+ * @param[in] storage GRID_LOCATOR_STORAGE(width, height, anchors present in the set) entries,
+ *                    kept for the life of the locator.
+ */
+void grid_locator_build(grid_locator_t *loc, const anchor_set_t *set, const floor_grid_t *grid, float z,
+                        uint16_t *storage);
+
+/** Best cell for a set of ranges, coarse to fine
+ *
+ * @param[in] mask Anchors that heard the beacon.
+ * @param[in] ranges Range per anchor index, only the entries in `mask` are read.
+ * @param[in] sigmas Standard deviation per anchor index, NULL for 1 m each.
+ * @param[out] fix Likelihood weighted mean of the cells around the best one, or the best cell
+ *                 if the mean falls in a blocked cell.
+ *
+ * @return 0 on success.
+ * @return -1 if the mask is empty or has anchors without distances, or every cell is blocked.
+ */
+int grid_locator_solve(const grid_locator_t *loc, uint16_t mask, const float ranges[ANCHOR_SET_MAX_ANCHORS],
+                       const float sigmas[ANCHOR_SET_MAX_ANCHORS], grid_locator_fix_t *fix);
+
+/** Likelihood of every cell
+ *
+ * @param[out] surface width * height values, row by row along x, summing to 1; 0 on blocked cells.
+ *
+ * @return index of the most likely cell.
+ * @return -1 if the mask is empty or has anchors without distances, or every cell is blocked.
+ */
+int grid_locator_surface(const grid_locator_t *loc, uint16_t mask, const float ranges[ANCHOR_SET_MAX_ANCHORS],
+                         const float sigmas[ANCHOR_SET_MAX_ANCHORS], float *surface);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,371 @@
+#include <math.h>
+
+#include "multilat.h"
+#include "trilateration.h"
+
+/* Determinants below this fraction of the squared trace mean collinear anchors */
+#define DEGENERATE_RATIO 1e-6f
+#define GN_STEP_DONE 1e-3f
+/* Keep weights finite for ranges and sigmas at or near zero */
+#define MIN_WEIGHT_RANGE 0.1f
+#define MIN_SIGMA 0.01f
+
+static int solve_closed_form(const float anchors[][3], const float ranges[], float z, float pos[3])
+{
+    float ab[3];
+    float ac[3];
+    calc_line_eq((float *)anchors[0], (float *)anchors[1], ranges[0], ranges[1], z, ab);
+    calc_line_eq((float *)anchors[0], (float *)anchors[2], ranges[0], ranges[2], z, ac);
+    if (calc_x_from_lines(ab, ac, &pos[0]) != 0) {
+        return -1;
+    }
+    /* Anchors level in y leave one line without a y term, take y from the other */
+    calc_y_from_x(fabsf(ab[1]) >= fabsf(ac[1]) ? ab : ac, pos[0], &pos[1]);
+    pos[2] = z;
+    return isfinite(pos[0]) && isfinite(pos[1]) ? 0 : -1;
+}
+
+/* Subtracting the mean range equation from each one leaves, with coordinates centred on the
+ * anchor centroid c:
+ *     2 x'_i X + 2 y'_i Y = |a'_i|^2 - r_i^2 - 2 z'_i Z' - mean(...)
+ * The mean term drops out of A^T b because the x'_i and y'_i sum to zero. With weights the same
+ * holds for the weighted centroid and weighted mean. */
+static int solve_linear(const float anchors[][3], const float ranges[], const float weights[], int count, float z,
+                        float pos[3])
+{
+    float c[3] = {0, 0, 0};
+    float total = 0;
+    for (int i = 0; i < count; i++) {
+        float w = weights ? weights[i] : 1.0f;
+        c[0] += w * anchors[i][0];
+        c[1] += w * anchors[i][1];
+        c[2] += w * anchors[i][2];
+        total += w;
+    }
+    if (!(total > 0)) {
+        return -1;
+    }
+    c[0] /= total;
+    c[1] /= total;
+    c[2] /= total;
+
+    float sxx = 0, sxy = 0, syy = 0, sxb = 0, syb = 0;
+    float zc = z - c[2];
+    for (int i = 0; i < count; i++) {
+        float w = weights ? weights[i] : 1.0f;
+        float x = anchors[i][0] - c[0];
+        float y = anchors[i][1] - c[1];
+        float h = anchors[i][2] - c[2];
+        float b = x * x + y * y + h * h - ranges[i] * ranges[i] - 2 * h * zc;
+        sxx += w * x * x;
+        sxy += w * x * y;
+        syy += w * y * y;
+        sxb += w * x * b;
+        syb += w * y * b;
+    }
+
+    /* Normal equations 4 S [X Y]^T = 2 [sxb syb]^T */
+    float det = sxx * syy - sxy * sxy;
+    float trace = sxx + syy;
+    if (!(det > DEGENERATE_RATIO * trace * trace)) {
+        return -1;
+    }
+    pos[0] = c[0] + (syy * sxb - sxy * syb) / (2 * det);
+    pos[1] = c[1] + (sxx * syb - sxy * sxb) / (2 * det);
+    pos[2] = z;
+    return 0;
+}
+
+static int refine(const float anchors[][3], const float ranges[], const float weights[], int count, float pos[3],
+                  int max_iterations)
+{
+    int iteration = 0;
+    while (iteration < max_iterations) {
+        float jxx = 0, jxy = 0, jyy = 0, jxf = 0, jyf = 0;
+        for (int i = 0; i < count; i++) {
+            float dx = pos[0] - anchors[i][0];
+            float dy = pos[1] - anchors[i][1];
+            float dz = pos[2] - anchors[i][2];
+            float d = sqrtf(dx * dx + dy * dy + dz * dz);
+            if (d < 1e-6f) {
+                continue;
+            }
+            float w = weights ? weights[i] : 1.0f;
+            float gx = dx / d;
+            float gy = dy / d;
+            float f = d - ranges[i];
+            jxx += w * gx * gx;
+            jxy += w * gx * gy;
+            jyy += w * gy * gy;
+            jxf += w * gx * f;
+            jyf += w * gy * f;
+        }
+        float det = jxx * jyy - jxy * jxy;
+        if (!(det > 1e-12f * (jxx + jyy) * (jxx + jyy))) {
+            break;
+        }
+        float step_x = -(jyy * jxf - jxy * jyf) / det;
+        float step_y = -(jxx * jyf - jxy * jxf) / det;
+        pos[0] += step_x;
+        pos[1] += step_y;
+        iteration++;
+        if (fabsf(step_x) + fabsf(step_y) < GN_STEP_DONE) {
+            break;
+        }
+    }
+    return iteration;
+}
+
+int multilat_refine(const float anchors[][3], const float ranges[], int count, float pos[3], int max_iterations)
+{
+    return refine(anchors, ranges, NULL, count, pos, max_iterations);
+}
+
+/* Unit vectors from the anchors to the position are the rows of H, GDOP is sqrt(trace((H^T H)^-1)) */
+float multilat_gdop(const float anchors[][3], int count, const float pos[3])
+{
+    float hxx = 0, hxy = 0, hyy = 0;
+    for (int i = 0; i < count; i++) {
+        float dx = pos[0] - anchors[i][0];
+        float dy = pos[1] - anchors[i][1];
+        float dz = pos[2] - anchors[i][2];
+        float d2 = dx * dx + dy * dy + dz * dz;
+        if (d2 < 1e-12f) {
+            continue;
+        }
+        hxx += dx * dx / d2;
+        hxy += dx * dy / d2;
+        hyy += dy * dy / d2;
+    }
+    float det = hxx * hyy - hxy * hxy;
+    float trace = hxx + hyy;
+    if (!(det > DEGENERATE_RATIO * trace * trace)) {
+        return INFINITY;
+    }
+    return sqrtf(trace / det);
+}
+
+float multilat_rms(const float anchors[][3], const float ranges[], int count, const float pos[3])
+{
+    float sum = 0;
+    for (int i = 0; i < count; i++) {
+        float dx = pos[0] - anchors[i][0];
+        float dy = pos[1] - anchors[i][1];
+        float dz = pos[2] - anchors[i][2];
+        float f = sqrtf(dx * dx + dy * dy + dz * dz) - ranges[i];
+        sum += f * f;
+    }
+    return sqrtf(sum / count);
+}
+
+int multilat_solve(const float anchors[][3], const float ranges[], int count, float z, int gn_iterations,
+                   multilat_fix_t *fix)
+{
+    if (count < 3 || count > MULTILAT_MAX_ANCHORS) {
+        return -1;
+    }
+    int err = count == 3 && gn_iterations == 0 ? solve_closed_form(anchors, ranges, z, fix->pos)
+                                               : solve_linear(anchors, ranges, NULL, count, z, fix->pos);
+    if (err != 0) {
+        return err;
+    }
+    fix->iterations = gn_iterations > 0 ? refine(anchors, ranges, NULL, count, fix->pos, gn_iterations) : 0;
+    fix->rms = multilat_rms(anchors, ranges, count, fix->pos);
+    fix->dims = 2;
+    fix->gdop = multilat_gdop(anchors, count, fix->pos);
+    fix->vdop = 0;
+    return 0;
+}
+
+int multilat_solve_weighted(const float anchors[][3], const float ranges[], const float sigmas[], int count, float z,
+                            int gn_iterations, multilat_fix_t *fix)
+{
+    if (count < 3 || count > MULTILAT_MAX_ANCHORS) {
+        return -1;
+    }
+    /* A range error dr moves r^2 by 2 r dr, so the linearized equations get 1 / (r sigma)^2 */
+    float linear[MULTILAT_MAX_ANCHORS];
+    float range[MULTILAT_MAX_ANCHORS];
+    for (int i = 0; i < count; i++) {
+        float r = fmaxf(ranges[i], MIN_WEIGHT_RANGE);
+        float sigma = fmaxf(sigmas[i], MIN_SIGMA);
+        range[i] = 1.0f / (sigma * sigma);
+        linear[i] = range[i] / (r * r);
+    }
+    if (solve_linear(anchors, ranges, linear, count, z, fix->pos) != 0) {
+        return -1;
+    }
+    fix->iterations = gn_iterations > 0 ? refine(anchors, ranges, range, count, fix->pos, gn_iterations) : 0;
+    fix->rms = multilat_rms(anchors, ranges, count, fix->pos);
+    fix->dims = 2;
+    fix->gdop = multilat_gdop(anchors, count, fix->pos);
+    fix->vdop = 0;
+    return 0;
+}
+
+/*------------------------------ 3D ------------------------------*/
+
+/* Inverse of a symmetric 3x3 matrix, fails below the same relative determinant as the 2D case */
+static int inverse3(const float m[3][3], float inv[3][3])
+{
+    float c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+    float c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+    float c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+    float det = m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02;
+    float trace = m[0][0] + m[1][1] + m[2][2];
+    if (!(det > DEGENERATE_RATIO * trace * trace * trace)) {
+        return -1;
+    }
+    inv[0][0] = c00 / det;
+    inv[0][1] = inv[1][0] = c01 / det;
+    inv[0][2] = inv[2][0] = c02 / det;
+    inv[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) / det;
+    inv[1][2] = inv[2][1] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) / det;
+    inv[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) / det;
+    return 0;
+}
+
+/* As solve_linear() with Z among the unknowns: 2 a'_i . u = |a'_i|^2 - r_i^2 - mean(...) */
+static int solve_linear_3d(const float anchors[][3], const float ranges[], const float weights[], int count,
+                           float pos[3])
+{
+    float c[3] = {0, 0, 0};
+    float total = 0;
+    for (int i = 0; i < count; i++) {
+        float w = weights ? weights[i] : 1.0f;
+        for (int d = 0; d < 3; d++) {
+            c[d] += w * anchors[i][d];
+        }
+        total += w;
+    }
+    if (!(total > 0)) {
+        return -1;
+    }
+    for (int d = 0; d < 3; d++) {
+        c[d] /= total;
+    }
+
+    float normal[3][3] = {{0}};
+    float rhs[3] = {0, 0, 0};
+    for (int i = 0; i < count; i++) {
+        float w = weights ? weights[i] : 1.0f;
+        float a[3] = {anchors[i][0] - c[0], anchors[i][1] - c[1], anchors[i][2] - c[2]};
+        float b = a[0] * a[0] + a[1] * a[1] + a[2] * a[2] - ranges[i] * ranges[i];
+        for (int r = 0; r < 3; r++) {
+            for (int k = 0; k < 3; k++) {
+                normal[r][k] += w * a[r] * a[k];
+            }
+            rhs[r] += w * a[r] * b;
+        }
+    }
+    float inv[3][3];
+    if (inverse3(normal, inv) != 0) {
+        return -1;
+    }
+    for (int r = 0; r < 3; r++) {
+        pos[r] = c[r] + (inv[r][0] * rhs[0] + inv[r][1] * rhs[1] + inv[r][2] * rhs[2]) / 2;
+    }
+    return 0;
+}
+
+/* Gauss-Newton on the ranges in x, y and z. Returns the iterations run, or -1 if the Jacobian
+ * became singular. `jtj` is left holding the unweighted J^T J at the final position. */
+static int refine_3d(const float anchors[][3], const float ranges[], const float weights[], int count,
+                     float pos[3], int max_iterations, float jtj[3][3])
+{
+    int iteration = 0;
+    for (;;) {
+        float normal[3][3] = {{0}};
+        float grad[3] = {0, 0, 0};
+        for (int r = 0; r < 3; r++) {
+            for (int k = 0; k < 3; k++) {
+                jtj[r][k] = 0;
+            }
+        }
+        for (int i = 0; i < count; i++) {
+            float g[3] = {pos[0] - anchors[i][0], pos[1] - anchors[i][1], pos[2] - anchors[i][2]};
+            float d = sqrtf(g[0] * g[0] + g[1] * g[1] + g[2] * g[2]);
+            if (d < 1e-6f) {
+                continue;
+            }
+            float w = weights ? weights[i] : 1.0f;
+            float f = d - ranges[i];
+            for (int r = 0; r < 3; r++) {
+                g[r] /= d;
+            }
+            for (int r = 0; r < 3; r++) {
+                for (int k = 0; k < 3; k++) {
+                    jtj[r][k] += g[r] * g[k];
+                    normal[r][k] += w * g[r] * g[k];
+                }
+                grad[r] += w * g[r] * f;
+            }
+        }
+        if (iteration == max_iterations) {
+            return iteration;
+        }
+        float inv[3][3];
+        if (inverse3(normal, inv) != 0) {
+            return -1;
+        }
+        float step_size = 0;
+        for (int r = 0; r < 3; r++) {
+            float step = -(inv[r][0] * grad[0] + inv[r][1] * grad[1] + inv[r][2] * grad[2]);
+            pos[r] += step;
+            step_size += fabsf(step);
+        }
+        iteration++;
+        if (step_size < GN_STEP_DONE) {
+            /* One more pass refreshes jtj at the final position */
+            max_iterations = iteration;
+        }
+    }
+}
+
+int multilat_solve_3d(const float anchors[][3], const float ranges[], const float sigmas[], int count,
+                      float z_fallback, int gn_iterations, multilat_fix_t *fix)
+{
+    if (count < 3 || count > MULTILAT_MAX_ANCHORS) {
+        return -1;
+    }
+    float range[MULTILAT_MAX_ANCHORS];
+    float linear[MULTILAT_MAX_ANCHORS];
+    if (sigmas) {
+        for (int i = 0; i < count; i++) {
+            float r = fmaxf(ranges[i], MIN_WEIGHT_RANGE);
+            float sigma = fmaxf(sigmas[i], MIN_SIGMA);
+            range[i] = 1.0f / (sigma * sigma);
+            linear[i] = range[i] / (r * r);
+        }
+    }
+
+    /* z comes from Gauss-Newton alone, the linear solve only places x and y */
+    if (count >= 4 && gn_iterations > 0 &&
+        solve_linear_3d(anchors, ranges, sigmas ? linear : NULL, count, fix->pos) == 0) {
+        /* With anchors close to one plane the ranges fit a mirror image on its far side about as
+         * well; starting from the expected height keeps Gauss-Newton on the near side */
+        fix->pos[2] = z_fallback;
+        float jtj[3][3];
+        int iterations = refine_3d(anchors, ranges, sigmas ? range : NULL, count, fix->pos, gn_iterations, jtj);
+        float dop[3][3];
+        if (iterations > 0 && inverse3(jtj, dop) == 0 && dop[2][2] < MULTILAT_MAX_VDOP * MULTILAT_MAX_VDOP) {
+            fix->iterations = iterations;
+            fix->rms = multilat_rms(anchors, ranges, count, fix->pos);
+            fix->dims = 3;
+            fix->gdop = sqrtf(dop[0][0] + dop[1][1] + dop[2][2]);
+            fix->vdop = sqrtf(dop[2][2]);
+            return 0;
+        }
+    }
+
+    /* Geometry can not carry z, fall back to the given height */
+    return sigmas ? multilat_solve_weighted(anchors, ranges, sigmas, count, z_fallback, gn_iterations, fix)
+                  : multilat_solve(anchors, ranges, count, z_fallback, gn_iterations, fix);
+}
+
+float multilat_range_sigma(float range, float sample_var, int samples, float sigma_db, float exponent)
+{
+    /* d = 10^((P - RSSI) / (10 n)), so dd / d = ln(10) / (10 n) dRSSI */
+    float model = range * 0.230259f / exponent * sigma_db;
+    return sqrtf(model * model + (samples > 1 ? sample_var / samples : 0));
+}
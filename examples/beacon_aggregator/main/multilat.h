@@ -0,0 +1,122 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Least squares multilateration over any number of anchors.
+ *
+ * The range equations are linearized by subtracting their mean, which uses every anchor instead
+ * of the two line equations of trilateration.c, and the result can be refined with Gauss-Newton
+ * iterations on the nonlinear ranges. The height of the beacon is given, as for calc_line_eq(),
+ * except for multilat_solve_3d(). Three anchors without refinement go through the closed form
+ * of trilateration.c.
+ *
+ * Coordinates and ranges share one unit, metres on the aggregator.
+ */
+
+#define MULTILAT_MAX_ANCHORS 16
+
+#define MULTILAT_MAX_VDOP 4.0f
+
+/* gn_iterations for the linear least squares solution without refinement, for three anchors as
+ * well: 0 takes the closed form there. Any negative value does the same. */
+#define MULTILAT_LINEAR_ONLY (-1)
+
+typedef struct {
+    float pos[3];       /* x, y and z, the given one unless solved in 3D */
+    float rms;          /* RMS of the range residuals */
+    int iterations;     /* Gauss-Newton iterations run */
+    uint8_t dims;       /* 3 if z was solved, 2 if it was given */
+    float gdop;         /* Geometric dilution of precision of the solved coordinates at pos */
+    float vdop;         /* Vertical dilution of precision of a 3D solve */
+} multilat_fix_t;
+
+/** Solve the position of a beacon at height z
+ *
+ * @param[in] anchors Anchor positions.
+ * @param[in] ranges Measured range to each anchor.
+ * @param[in] count Number of anchors, 3 to MULTILAT_MAX_ANCHORS.
+ * @param[in] z Height of the beacon.
+ * @param[in] gn_iterations Upper bound on Gauss-Newton refinement iterations, 0 for the linear solution only
+ *                          (the closed form for three anchors), MULTILAT_LINEAR_ONLY for the linear
+ *                          least squares solution for any count.
+ * @param[out] fix Position and residual.
+ *
+ * @return 0 on success.
+ * @return -1 if there are too few anchors or they are (nearly) collinear in x/y.
+ */
+int multilat_solve(const float anchors[][3], const float ranges[], int count, float z, int gn_iterations,
+                   multilat_fix_t *fix);
+
+/** Solve with a standard deviation per range
+ *
+ * Weighted variant of multilat_solve(): the linear solve weights each equation by
+ * 1 / (r_i sigma_i)^2, since a range error enters it through r_i^2, and the Gauss-Newton
+ * refinement by 1 / sigma_i^2. There is no closed form fast path.
+ *
+ * @param[in] sigmas Standard deviation of each range, see multilat_range_sigma().
+ *
+ * @return 0 on success.
+ * @return -1 if there are too few anchors or they are (nearly) collinear in x/y.
+ */
+int multilat_solve_weighted(const float anchors[][3], const float ranges[], const float sigmas[], int count, float z,
+                            int gn_iterations, multilat_fix_t *fix);
+
+/** Solve x, y and z
+ *
+ * Linear least squares in three unknowns followed by Gauss-Newton refinement of all three. Needs
+ * four anchors that are not coplanar; anchors mounted at one ceiling height can not resolve z.
+ * z is refined from `z_fallback`, so it takes at least one Gauss-Newton iteration. When there are
+ * fewer anchors, `gn_iterations` is 0, the normal matrix is singular, or the vertical dilution of
+ * precision at the solution exceeds MULTILAT_MAX_VDOP, the beacon is solved in 2D at
+ * `z_fallback` instead and `fix->dims` is 2.
+ *
+ * @param[in] sigmas Standard deviation of each range, NULL to weight all ranges the same.
+ * @param[in] z_fallback Height used for the 2D fallback.
+ *
+ * @return 0 on success, in 3D or 2D.
+ * @return -1 if neither solve succeeded.
+ */
+int multilat_solve_3d(const float anchors[][3], const float ranges[], const float sigmas[], int count,
+                      float z_fallback, int gn_iterations, multilat_fix_t *fix);
+
+/** Standard deviation of an RSSI based range
+ *
+ * Combines the error of the log-distance path loss model, which grows with the distance
+ * (an RSSI error of sigma_db dB scales the distance by about ln(10) / (10 n) sigma_db) and
+ * does not average out, with the spread of the samples averaged into the range.
+ *
+ * @param[in] range Range, mean of the samples.
+ * @param[in] sample_var Variance of the samples, in the unit of the range squared.
+ * @param[in] samples Number of samples averaged.
+ * @param[in] sigma_db RSSI error the path loss model leaves, in dB.
+ * @param[in] exponent Path loss exponent n, 2 on the mediators.
+ */
+float multilat_range_sigma(float range, float sample_var, int samples, float sigma_db, float exponent);
+
+/** Refine a position with Gauss-Newton iterations on the range equations, z stays fixed
+ *
+ * Stops early once a step is below 1 mm.
+ *
+ * @return number of iterations run.
+ */
+int multilat_refine(const float anchors[][3], const float ranges[], int count, float pos[3], int max_iterations);
+
+/** Geometric dilution of precision of x and y at a position
+ *
+ * Range error to position error gain of the anchor geometry seen from `pos`: 1 inside four
+ * well spread anchors, 2 / sqrt(n) for n, growing as the anchors line up behind each other.
+ *
+ * @return GDOP, INFINITY if the anchors seen from `pos` are (nearly) in line.
+ */
+float multilat_gdop(const float anchors[][3], int count, const float pos[3]);
+
+/** RMS of the range residuals at a position */
+float multilat_rms(const float anchors[][3], const float ranges[], int count, const float pos[3]);
+
+#ifdef __cplusplus
+}
+#endif
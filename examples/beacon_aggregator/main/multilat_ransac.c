@@ -0,0 +1,208 @@
+#include <math.h>
+#include <string.h>
+
+#include "multilat_ransac.h"
+
+/* How often the clock is read, in hypotheses */
+#define CLOCK_EVERY 4
+
+static float residual(const float anchor[3], float range, const float pos[3])
+{
+    float dx = pos[0] - anchor[0];
+    float dy = pos[1] - anchor[1];
+    float dz = pos[2] - anchor[2];
+    return sqrtf(dx * dx + dy * dy + dz * dz) - range;
+}
+
+/* MSAC cost: squared normalized residuals, each capped at 1 */
+static float score(const float anchors[][3], const float ranges[], const float scale[], int count, const float pos[3])
+{
+    float cost = 0;
+    for (int i = 0; i < count; i++) {
+        float e = residual(anchors[i], ranges[i], pos) * scale[i];
+        cost += fminf(e * e, 1.0f);
+    }
+    return cost;
+}
+
+static uint16_t inlier_mask(const float anchors[][3], const float ranges[], const float scale[], int count,
+                            const float pos[3])
+{
+    uint16_t mask = 0;
+    for (int i = 0; i < count; i++) {
+        if (fabsf(residual(anchors[i], ranges[i], pos) * scale[i]) <= 1.0f) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+}
+
+static int refit(const float anchors[][3], const float ranges[], const float sigmas[], uint16_t mask, float z,
+                 int gn_iterations, multilat_fix_t *fix)
+{
+    float a[MULTILAT_MAX_ANCHORS][3];
+    float r[MULTILAT_MAX_ANCHORS];
+    float s[MULTILAT_MAX_ANCHORS];
+    int n = 0;
+    for (; mask; mask &= mask - 1) {
+        int i = __builtin_ctz(mask);
+        memcpy(a[n], anchors[i], sizeof(a[n]));
+        r[n] = ranges[i];
+        s[n] = sigmas ? sigmas[i] : 0;
+        n++;
+    }
+    return sigmas ? multilat_solve_weighted(a, r, s, n, z, gn_iterations, fix)
+                  : multilat_solve(a, r, n, z, gn_iterations, fix);
+}
+
+/* Hypotheses needed to draw an all-inlier triple with probability p at inlier ratio w */
+static float hypotheses_needed(float w, float p)
+{
+    float good = w * w * w;
+    if (good >= 1.0f) {
+        return 0;
+    }
+    if (good <= 0) {
+        return INFINITY;
+    }
+    return logf(1.0f - p) / logf(1.0f - good);
+}
+
+static uint32_t seed_from(const float ranges[], int count)
+{
+    uint32_t seed = 2166136261u;
+    for (int i = 0; i < count; i++) {
+        uint32_t bits;
+        memcpy(&bits, &ranges[i], sizeof(bits));
+        seed = (seed ^ bits) * 16777619u;
+    }
+    return seed ? seed : 1;
+}
+
+static uint32_t xorshift(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+/* Next triple i < j < k in lexicographic order, false after the last one */
+static int next_triple(int idx[3], int count)
+{
+    for (int d = 2; d >= 0; d--) {
+        if (idx[d] < count - 3 + d) {
+            idx[d]++;
+            for (int e = d + 1; e < 3; e++) {
+                idx[e] = idx[e - 1] + 1;
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void sample_triple(int idx[3], int count, uint32_t *rng)
+{
+    idx[0] = xorshift(rng) % count;
+    do {
+        idx[1] = xorshift(rng) % count;
+    } while (idx[1] == idx[0]);
+    do {
+        idx[2] = xorshift(rng) % count;
+    } while (idx[2] == idx[0] || idx[2] == idx[1]);
+}
+
+int multilat_ransac(const float anchors[][3], const float ranges[], const float sigmas[], int count, float z,
+                    const multilat_ransac_config_t *config, multilat_ransac_fix_t *out)
+{
+    if (count < 3 || count > MULTILAT_MAX_ANCHORS) {
+        return -1;
+    }
+    uint16_t all = (uint16_t)((1u << count) - 1);
+    if (count == 3) {
+        out->inliers = all;
+        out->inlier_count = 3;
+        out->hypotheses = 0;
+        out->confidence = 0;
+        return refit(anchors, ranges, sigmas, all, z, config->gn_iterations, &out->fix);
+    }
+
+    float scale[MULTILAT_MAX_ANCHORS];
+    for (int i = 0; i < count; i++) {
+        float unit = sigmas ? sigmas[i] * config->threshold : config->threshold;
+        scale[i] = 1.0f / fmaxf(unit, 1e-3f);
+    }
+
+    int triples = count * (count - 1) * (count - 2) / 6;
+    int exhaustive = triples <= config->max_hypotheses;
+    int limit = exhaustive ? triples : config->max_hypotheses;
+    int64_t deadline = config->budget_us && config->clock_us ? config->clock_us() + config->budget_us : 0;
+    uint32_t rng = seed_from(ranges, count);
+
+    int idx[3] = {0, 1, 2};
+    float best_cost = INFINITY;
+    float best_pos[3] = {0, 0, z};
+    float needed = INFINITY;
+    int tried = 0;
+    while (tried < limit && tried < needed) {
+        if (deadline && tried % CLOCK_EVERY == 0 && tried > 0 && config->clock_us() >= deadline) {
+            break;
+        }
+        if (exhaustive) {
+            if (tried > 0 && !next_triple(idx, count)) {
+                break;
+            }
+        } else {
+            sample_triple(idx, count, &rng);
+        }
+        tried++;
+
+        float a[3][3];
+        float r[3];
+        for (int t = 0; t < 3; t++) {
+            memcpy(a[t], anchors[idx[t]], sizeof(a[t]));
+            r[t] = ranges[idx[t]];
+        }
+        multilat_fix_t hypothesis;
+        if (multilat_solve(a, r, 3, z, 0, &hypothesis) != 0) {
+            continue;
+        }
+        float cost = score(anchors, ranges, scale, count, hypothesis.pos);
+        if (cost < best_cost) {
+            best_cost = cost;
+            memcpy(best_pos, hypothesis.pos, sizeof(best_pos));
+            int inliers = __builtin_popcount(inlier_mask(anchors, ranges, scale, count, best_pos));
+            needed = hypotheses_needed((float)inliers / count, config->confidence);
+        }
+    }
+    if (!isfinite(best_cost)) {
+        return -1;
+    }
+
+    /* Refit the consensus set, then once more if the refit changed it */
+    uint16_t mask = inlier_mask(anchors, ranges, scale, count, best_pos);
+    if (__builtin_popcount(mask) < 3 ||
+        refit(anchors, ranges, sigmas, mask, z, config->gn_iterations, &out->fix) != 0) {
+        return -1;
+    }
+    uint16_t refit_mask = inlier_mask(anchors, ranges, scale, count, out->fix.pos);
+    multilat_fix_t fix;
+    if (refit_mask != mask && __builtin_popcount(refit_mask) >= 3 &&
+        refit(anchors, ranges, sigmas, refit_mask, z, config->gn_iterations, &fix) == 0) {
+        out->fix = fix;
+        mask = refit_mask;
+    }
+
+    out->inliers = mask;
+    out->inlier_count = (uint8_t)__builtin_popcount(mask);
+    out->hypotheses = (uint16_t)tried;
+    if (exhaustive && tried == triples) {
+        out->confidence = 1.0f;
+    } else {
+        float w = (float)out->inlier_count / count;
+        out->confidence = 1.0f - powf(1.0f - w * w * w, (float)tried);
+    }
+    return 0;
+}
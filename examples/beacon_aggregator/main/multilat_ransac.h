@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "multilat.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Outlier rejection for multilateration.
+ *
+ * A reflected path makes a mediator report a range that can be metres off, and a least squares
+ * solve spreads that error over the whole fix. RANSAC solves hypotheses from three anchors
+ * through the closed form of trilateration.c, scores each against every range (MSAC, residuals
+ * capped at the threshold) and refits the anchors consistent with the best one.
+ *
+ * When all three anchor subsets fit in the hypothesis budget they are enumerated, otherwise they
+ * are sampled with a generator seeded from the ranges, so a solve is reproducible. Sampling
+ * stops once an all-inlier subset has been drawn with the requested confidence, after
+ * `max_hypotheses`, or when the time budget runs out.
+ */
+
+typedef struct {
+    float threshold;            /* Inlier bound on a range residual, metres, or standard deviations with sigmas */
+    float confidence;           /* Stop once an all-inlier subset was drawn with this probability */
+    int max_hypotheses;
+    uint32_t budget_us;         /* Time budget, 0 for none */
+    int64_t (*clock_us)(void);  /* Clock for budget_us, esp_timer_get_time() on the target */
+    int gn_iterations;          /* Gauss-Newton iterations of the refit */
+} multilat_ransac_config_t;
+
+#define MULTILAT_RANSAC_CONFIG_DEFAULT() {  \
+    .threshold = 1.5f,                      \
+    .confidence = 0.99f,                    \
+    .max_hypotheses = 64,                   \
+    .budget_us = 0,                         \
+    .clock_us = NULL,                       \
+    .gn_iterations = 5,                     \
+}
+
+typedef struct {
+    multilat_fix_t fix;         /* Refit over the inliers */
+    uint16_t inliers;           /* Bit i set if ranges[i] is an inlier */
+    uint8_t inlier_count;
+    uint16_t hypotheses;        /* Hypotheses scored */
+    float confidence;           /* Probability that an all-inlier subset was among them */
+} multilat_ransac_fix_t;
+
+/** Solve the position of a beacon at height z, rejecting outlying ranges
+ *
+ * With three anchors there is nothing to reject against; the plain solve is returned with every
+ * range an inlier and a confidence of 0.
+ *
+ * @param[in] sigmas Standard deviation of each range, NULL to compare residuals in metres.
+ *                   With sigmas the refit is weighted as by multilat_solve_weighted().
+ * @param[in] count Number of anchors, 3 to MULTILAT_MAX_ANCHORS.
+ *
+ * @return 0 on success.
+ * @return -1 if there are too few anchors, no hypothesis has three inliers or the refit failed.
+ */
+int multilat_ransac(const float anchors[][3], const float ranges[], const float sigmas[], int count, float z,
+                    const multilat_ransac_config_t *config, multilat_ransac_fix_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+/* Header-only multilateration with the anchor count and precision fixed at compile time.
+ *
+ * Same linear least squares as anchor_set.c: the geometry of a fixed anchor layout is folded
+ * once, in the constructor, into
+ *     pos = c + k0 + kz * z - sum_i p_i * r_i^2
+ * and solve() is Dims x NAnchors multiply-adds which the compiler fully unrolls. Dims is 2 for
+ * a beacon at a given height, or 3 to solve the height as well, which needs anchors at more than
+ * one height.
+ *
+ * Multilaterator<Scalar, multilaterator::Dynamic, Dims> takes the anchor count at run time, up
+ * to multilaterator::k_max_anchors, for subsets that are not known when compiling.
+ */
+
+#if defined(__GNUC__)
+#define MULTILATERATOR_UNROLL _Pragma("GCC unroll 16")
+#else
+#define MULTILATERATOR_UNROLL
+#endif
+
+namespace multilaterator {
+
+/** Anchor count of the variant which takes it at run time */
+constexpr std::size_t Dynamic = 0;
+constexpr std::size_t k_max_anchors = 16;
+
+} // namespace multilaterator
+
+namespace multilaterator_detail {
+
+template <typename Scalar, std::size_t Dims>
+using Matrix = std::array<std::array<Scalar, Dims>, Dims>;
+
+template <typename Scalar, std::size_t Dims>
+struct Inverse;
+
+/* Inverse of the symmetric normal matrix through its adjugate. Returns false if the
+ * determinant is below 1e-6 of the trace raised to Dims, i.e. the anchors are (nearly) collinear
+ * or, in 3D, coplanar. */
+template <typename Scalar>
+struct Inverse<Scalar, 2> {
+    static bool apply(const Matrix<Scalar, 2> &m, Matrix<Scalar, 2> &inv)
+    {
+        Scalar det = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+        Scalar trace = m[0][0] + m[1][1];
+        if (!(det > Scalar(1e-6) * trace * trace)) {
+            return false;
+        }
+        inv[0][0] = m[1][1] / det;
+        inv[1][1] = m[0][0] / det;
+        inv[0][1] = inv[1][0] = -m[0][1] / det;
+        return true;
+    }
+};
+
+template <typename Scalar>
+struct Inverse<Scalar, 3> {
+    static bool apply(const Matrix<Scalar, 3> &m, Matrix<Scalar, 3> &inv)
+    {
+        Scalar c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+        Scalar c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+        Scalar c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+        Scalar det = m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02;
+        Scalar trace = m[0][0] + m[1][1] + m[2][2];
+        if (!(det > Scalar(1e-6) * trace * trace * trace)) {
+            return false;
+        }
+        inv[0][0] = c00 / det;
+        inv[0][1] = inv[1][0] = c01 / det;
+        inv[0][2] = inv[2][0] = c02 / det;
+        inv[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) / det;
+        inv[1][2] = inv[2][1] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) / det;
+        inv[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) / det;
+        return true;
+    }
+};
+
+/* Solve factors shared by the fixed and dynamic variants. `count` is a constant after inlining
+ * in the fixed variant, which is what lets the loops unroll. */
+template <typename Scalar, std::size_t Dims, std::size_t Capacity>
+struct Factors {
+    std::array<Scalar, 3> origin{};
+    std::array<Scalar, Dims> k0{};
+    std::array<Scalar, Dims> kz{};
+    std::array<std::array<Scalar, Capacity>, Dims> p{};
+    bool valid = false;
+
+    void build(const std::array<Scalar, 3> *anchors, std::size_t count)
+    {
+        origin = {};
+        MULTILATERATOR_UNROLL
+        for (std::size_t i = 0; i < count; i++) {
+            for (std::size_t d = 0; d < 3; d++) {
+                origin[d] += anchors[i][d] / Scalar(count);
+            }
+        }
+
+        Matrix<Scalar, Dims> normal{};
+        MULTILATERATOR_UNROLL
+        for (std::size_t i = 0; i < count; i++) {
+            for (std::size_t r = 0; r < Dims; r++) {
+                for (std::size_t c = 0; c < Dims; c++) {
+                    normal[r][c] += (anchors[i][r] - origin[r]) * (anchors[i][c] - origin[c]);
+                }
+            }
+        }
+        Matrix<Scalar, Dims> inv;
+        valid = Inverse<Scalar, Dims>::apply(normal, inv);
+        if (!valid) {
+            return;
+        }
+
+        k0 = {};
+        kz = {};
+        MULTILATERATOR_UNROLL
+        for (std::size_t i = 0; i < count; i++) {
+            std::array<Scalar, 3> a;
+            for (std::size_t d = 0; d < 3; d++) {
+                a[d] = anchors[i][d] - origin[d];
+            }
+            /* In 2D the height difference moves to the right hand side, scaled by the given z */
+            Scalar q = a[0] * a[0] + a[1] * a[1] + a[2] * a[2];
+            for (std::size_t r = 0; r < Dims; r++) {
+                Scalar pr = 0;
+                for (std::size_t c = 0; c < Dims; c++) {
+                    pr += inv[r][c] * a[c];
+                }
+                pr /= 2;
+                p[r][i] = pr;
+                k0[r] += pr * q;
+                if (Dims == 2) {
+                    kz[r] -= 2 * pr * a[2];
+                }
+            }
+        }
+    }
+
+    std::array<Scalar, 3> solve(const Scalar *ranges, std::size_t count, Scalar z) const
+    {
+        std::array<Scalar, Dims> u = k0;
+        Scalar zl = z - origin[2];
+        for (std::size_t r = 0; r < Dims; r++) {
+            u[r] += kz[r] * zl;
+        }
+        MULTILATERATOR_UNROLL
+        for (std::size_t i = 0; i < count; i++) {
+            Scalar r2 = ranges[i] * ranges[i];
+            for (std::size_t r = 0; r < Dims; r++) {
+                u[r] -= p[r][i] * r2;
+            }
+        }
+        std::array<Scalar, 3> pos;
+        pos[0] = origin[0] + u[0];
+        pos[1] = origin[1] + u[1];
+        pos[2] = Dims == 3 ? origin[2] + u[Dims - 1] : z;
+        return pos;
+    }
+};
+
+} // namespace multilaterator_detail
+
+template <typename Scalar, std::size_t NAnchors, std::size_t Dims = 2>
+class Multilaterator {
+    static_assert(Dims == 2 || Dims == 3, "Dims is 2 (given height) or 3");
+    static_assert(NAnchors >= Dims + 1, "Not enough anchors for the dimensions");
+
+public:
+    static constexpr std::size_t anchor_count = NAnchors;
+    static constexpr std::size_t dims = Dims;
+    using Point = std::array<Scalar, 3>;
+    using Anchors = std::array<Point, NAnchors>;
+    using Ranges = std::array<Scalar, NAnchors>;
+
+    explicit Multilaterator(const Anchors &anchors)
+    {
+        m_factors.build(anchors.data(), NAnchors);
+    }
+
+    /** False if the anchors are degenerate for Dims, solve() must not be used then */
+    bool valid() const
+    {
+        return m_factors.valid;
+    }
+
+    /** Position from the ranges to each anchor, z is only used for Dims == 2 */
+    Point solve(const Ranges &ranges, Scalar z = 0) const
+    {
+        return m_factors.solve(ranges.data(), NAnchors, z);
+    }
+
+private:
+    multilaterator_detail::Factors<Scalar, Dims, NAnchors> m_factors;
+};
+
+template <typename Scalar, std::size_t Dims>
+class Multilaterator<Scalar, multilaterator::Dynamic, Dims> {
+    static_assert(Dims == 2 || Dims == 3, "Dims is 2 (given height) or 3");
+
+public:
+    static constexpr std::size_t dims = Dims;
+    using Point = std::array<Scalar, 3>;
+
+    /** @param[in] count Number of anchors, Dims + 1 to multilaterator::k_max_anchors */
+    Multilaterator(const Point *anchors, std::size_t count) : m_count(count)
+    {
+        if (count >= Dims + 1 && count <= multilaterator::k_max_anchors) {
+            m_factors.build(anchors, count);
+        }
+    }
+
+    bool valid() const
+    {
+        return m_factors.valid;
+    }
+
+    std::size_t size() const
+    {
+        return m_count;
+    }
+
+    /** @param[in] ranges One range per anchor, size() entries */
+    Point solve(const Scalar *ranges, Scalar z = 0) const
+    {
+        return m_factors.solve(ranges, m_count, z);
+    }
+
+private:
+    std::size_t m_count;
+    multilaterator_detail::Factors<Scalar, Dims, multilaterator::k_max_anchors> m_factors;
+};
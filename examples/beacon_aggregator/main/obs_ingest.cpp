@@ -0,0 +1,1001 @@
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_matter.h>
+#include <esp_matter_console.h>
+
+#include <anchor_registry.h>
+#include <anchor_set.h>
+#include <beacon_proto.h>
+#include <beacon_track.h>
+#include <fusion.h>
+#include <grid_locator.h>
+#include <multilat.h>
+#include <multilat_ransac.h>
+#include <obs_ingest.h>
+#include <obs_store.h>
+#include <particle_filter.h>
+#include <pathloss_cal.h>
+#include <presence.h>
+#include <range_models.h>
+#include <seq_tracker.h>
+#include <solve_sched.h>
+
+#include <app/util/af.h>
+
+static const char *TAG = "obs_ingest";
+
+using namespace esp_matter;
+
+typedef struct {
+    uint32_t reports;
+    uint32_t observations;
+    uint32_t backlog;
+    uint32_t malformed;
+    uint32_t fixes;
+    uint32_t unsolved;          /* Sets neither least squares nor the grid could solve */
+    uint32_t grid_fixes;        /* Sets least squares could not solve, located on the grid */
+    uint32_t ransac_solves;     /* Sets with enough anchors for RANSAC */
+    uint32_t outliers;          /* Ranges RANSAC left out */
+    uint32_t track_rejected;    /* Fixes the tracker gated out */
+    uint32_t particle_reseeds;  /* Particle filters that lost every particle and were seeded again */
+} ingest_stats_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+} latency_t;
+
+/* Last fix of a beacon, by obs_store beacon slot */
+typedef struct {
+    uint32_t beacon;
+    uint32_t time_ms;           /* Capture time the ranges were aligned to */
+    uint32_t age_spread_ms;     /* How much older than time_ms the oldest range was */
+    int32_t pos_cm[3];
+    float gdop;
+    float spread;               /* Likelihood spread of a grid fix, metres */
+    uint16_t outliers;          /* Mediator slots RANSAC left out of the fix */
+    float confidence;           /* RANSAC confidence in the inliers, 0 if it did not run */
+    uint8_t anchors;
+    uint8_t flags;              /* BEACON_POSITION_FLAG_GRID, BEACON_POSITION_FLAG_3D */
+    uint8_t valid;
+} fix_t;
+
+/* Particle filter of a beacon slot, CONFIG_BEACON_AGGREGATOR_PARTICLE_FILTER */
+typedef struct {
+    particle_filter_t pf;
+    uint32_t beacon;            /* Beacon the particles were seeded for, the slot may have changed hands */
+    uint32_t time_ms;           /* Capture time of the last set */
+    bool seeded;
+} particle_track_t;
+
+/* Grid locator over the anchor layout, built on the solve tick after the anchors changed */
+typedef struct {
+    grid_locator_t loc;
+    uint16_t *table;
+    bool stale;
+} grid_fallback_t;
+
+static ingest_stats_t s_stats;
+static latency_t s_handle_latency;
+static seq_tracker_t s_seq_tracker;
+static obs_store_t s_store;
+static fusion_t s_fusion;
+static anchor_set_t s_anchors;
+static grid_fallback_t s_grid;
+static multilat_ransac_config_t s_ransac_config;
+static particle_track_t *s_particles;      /* NULL unless in particle filter mode */
+static float *s_particle_storage;
+static solve_sched_t s_sched;
+static fix_t s_fixes[OBS_STORE_MAX_BEACONS];
+static beacon_tracks_t s_tracks;
+static bool s_fixes_changed;
+static uint32_t s_positions_published_ms;
+static presence_t s_presence;
+static uint32_t s_presence_expired_ms;
+static uint16_t s_endpoint_id;
+static esp_timer_handle_t s_link_stats_timer;
+static esp_timer_handle_t s_solve_timer;
+
+static constexpr uint64_t k_link_stats_period_us = 5 * 1000 * 1000;
+static constexpr uint32_t k_positions_period_ms = 1000;
+/* Tracker tuning: people walking */
+static constexpr float k_track_accel_noise = 0.5f;
+/* Refinement of the weighted solve, it settles within a few */
+static constexpr int k_gn_iterations = 3;
+/* RANSAC needs two anchors beyond a three anchor hypothesis to tell which range is off */
+static constexpr int k_ransac_min_anchors = 5;
+/* Inlier bound in range sigmas */
+static constexpr float k_ransac_threshold = 2.5f;
+static constexpr uint32_t k_presence_expire_period_ms = 1000;
+static constexpr int32_t k_beacon_height_cm = CONFIG_BEACON_AGGREGATOR_BEACON_HEIGHT_CM;
+static constexpr uint64_t k_solve_period_us = CONFIG_BEACON_AGGREGATOR_SOLVE_PERIOD_MS * 1000ULL;
+static constexpr uint32_t k_solve_budget_us = CONFIG_BEACON_AGGREGATOR_SOLVE_BUDGET_US;
+static constexpr int32_t k_grid_cell_cm = CONFIG_BEACON_AGGREGATOR_GRID_CELL_CM;
+static constexpr size_t k_grid_max_bytes = CONFIG_BEACON_AGGREGATOR_GRID_MAX_KB * 1024;
+#if CONFIG_BEACON_AGGREGATOR_PARTICLE_FILTER
+static constexpr uint32_t k_particles = CONFIG_BEACON_AGGREGATOR_PARTICLES;
+#else
+static constexpr uint32_t k_particles = 0;
+#endif
+/* Step of the particles per second between sets, a brisk walk */
+static constexpr float k_particle_speed = 1.5f;
+/* Floor beyond the outermost anchors the grid covers */
+static constexpr float k_grid_margin_m = 2.0f;
+
+static_assert(OBS_STORE_MAX_MEDIATORS == ANCHOR_SET_MAX_ANCHORS, "mediator slots are anchor indices");
+
+/* Mediator ID used by `ingest bench` */
+static constexpr uint16_t k_bench_mediator = 0xFFFF;
+
+/* While `ingest bench` runs, its reports take the same attribute write path but are handled
+ * against this private state, so live beacons are neither evicted nor fed to the presence
+ * table, the calibration or the solver. The range model is skipped for the same reason, the
+ * distance in the report is stored as it is. */
+typedef struct {
+    seq_tracker_t seq_tracker;
+    obs_store_t store;
+    solve_sched_t sched;
+} bench_state_t;
+
+static bench_state_t *s_bench;
+
+#if CONFIG_BEACON_AGGREGATOR_PERSIST_REPORTS
+static const char *k_report_path = "persisted";
+#else
+static const char *k_report_path = "RAM only";
+#endif
+
+static void latency_add(latency_t *latency, uint32_t us)
+{
+    if (latency->count == 0 || us < latency->min_us) {
+        latency->min_us = us;
+    }
+    if (us > latency->max_us) {
+        latency->max_us = us;
+    }
+    latency->count++;
+    latency->total_us += us;
+}
+
+static uint16_t presence_mediator_id(int slot)
+{
+    return slot == PRESENCE_NOWHERE ? 0 : obs_store_mediator_id(&s_store, static_cast<uint8_t>(slot));
+}
+
+static void presence_log(const presence_event_t *event)
+{
+    if (event->to == PRESENCE_NOWHERE) {
+        ESP_LOGI(TAG, "beacon 0x%08x left mediator 0x%04x", event->beacon, presence_mediator_id(event->from));
+    } else if (event->from == PRESENCE_NOWHERE) {
+        ESP_LOGI(TAG, "beacon 0x%08x at mediator 0x%04x", event->beacon, presence_mediator_id(event->to));
+    } else {
+        ESP_LOGI(TAG, "beacon 0x%08x moved from mediator 0x%04x to 0x%04x", event->beacon,
+                 presence_mediator_id(event->from), presence_mediator_id(event->to));
+    }
+}
+
+/* Mediators turn RSSI into distance as 10^((tx_power - rssi) / 20) m, inverting that gives back
+ * the RSSI below the beacon's tx power, up to the mediator's own offset */
+static void presence_feed(uint32_t beacon, uint8_t mediator, uint16_t distance_cm, uint32_t time_ms)
+{
+    float level_db = -20.0f * log10f((distance_cm ? distance_cm : 1) / 100.0f);
+    presence_event_t event;
+    if (presence_observe(&s_presence, beacon, mediator, level_db, time_ms, &event)) {
+        presence_log(&event);
+    }
+}
+
+static void presence_expire_due(uint32_t now_ms)
+{
+    if (now_ms - s_presence_expired_ms < k_presence_expire_period_ms) {
+        return;
+    }
+    presence_event_t events[8];
+    int count = presence_expire(&s_presence, now_ms, events, 8);
+    for (int i = 0; i < count; i++) {
+        presence_log(&events[i]);
+    }
+    s_presence_expired_ms = now_ms;
+}
+
+/* Covers the anchors plus k_grid_margin_m, unless the table would not fit in
+ * CONFIG_BEACON_AGGREGATOR_GRID_MAX_KB */
+static void grid_rebuild()
+{
+    s_grid.stale = false;
+    free(s_grid.table);
+    s_grid.table = NULL;
+    if (k_grid_cell_cm == 0 || s_anchors.present == 0) {
+        return;
+    }
+    float min[2] = {INFINITY, INFINITY};
+    float max[2] = {-INFINITY, -INFINITY};
+    for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+        if (s_anchors.present & (1u << i)) {
+            for (int d = 0; d < 2; d++) {
+                min[d] = fminf(min[d], s_anchors.origin[d] + s_anchors.pos[i][d]);
+                max[d] = fmaxf(max[d], s_anchors.origin[d] + s_anchors.pos[i][d]);
+            }
+        }
+    }
+    const float cell = k_grid_cell_cm * 0.01f;
+    const floor_grid_t grid = {
+        .origin = {min[0] - k_grid_margin_m, min[1] - k_grid_margin_m},
+        .cell = cell,
+        .width = static_cast<uint16_t>(ceilf((max[0] - min[0] + 2 * k_grid_margin_m) / cell)),
+        .height = static_cast<uint16_t>(ceilf((max[1] - min[1] + 2 * k_grid_margin_m) / cell)),
+        .stride = 0,
+        .bits = NULL,
+    };
+    size_t bytes =
+        GRID_LOCATOR_STORAGE(grid.width, grid.height, __builtin_popcount(s_anchors.present)) * sizeof(uint16_t);
+    if (bytes > k_grid_max_bytes) {
+        ESP_LOGW(TAG, "Grid of %ux%u cells needs %u KB, over the %u KB allowed, no grid fallback", grid.width,
+                 grid.height, bytes / 1024, k_grid_max_bytes / 1024);
+        return;
+    }
+    s_grid.table = static_cast<uint16_t *>(malloc(bytes));
+    if (!s_grid.table) {
+        ESP_LOGW(TAG, "No memory for the %u KB grid table, no grid fallback", bytes / 1024);
+        return;
+    }
+    grid_locator_build(&s_grid.loc, &s_anchors, &grid, k_beacon_height_cm * 0.01f, s_grid.table);
+    ESP_LOGI(TAG, "Grid fallback: %ux%u cells of %d cm, %u KB", grid.width, grid.height, k_grid_cell_cm,
+             bytes / 1024);
+}
+
+/* Two ranges still narrow the beacon down to where their circles meet, one does not */
+static int grid_solve(const fusion_set_t *set, uint16_t mask, int32_t pos_cm[3], float *spread)
+{
+    if (!s_grid.table || __builtin_popcount(mask) < 2) {
+        return -1;
+    }
+    grid_locator_fix_t fix;
+    if (grid_locator_solve(&s_grid.loc, mask, set->ranges, set->sigmas, &fix) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < 3; i++) {
+        pos_cm[i] = static_cast<int32_t>(lrintf(fix.pos[i] * 100));
+    }
+    *spread = fix.spread;
+    return 0;
+}
+
+/* Least squares, each range weighted by its sigma. Four anchors or more also solve z, unless
+ * they can not resolve it, as when all hang at one ceiling height; the beacon is then solved at
+ * the configured height and `flags` gets no BEACON_POSITION_FLAG_3D. Five or more first go
+ * through RANSAC, and the ranges it rejects are dropped from `mask` and left out of the solve.
+ * Without an FPU the fixed point solve of the cached subset factors stays, unweighted, 2D and
+ * without RANSAC: Gauss-Newton in soft float would take most of the tick budget. */
+static int least_squares(const fusion_set_t *set, uint16_t *mask, int32_t pos_cm[3], uint8_t *flags,
+                         float *confidence)
+{
+#if ANCHOR_SET_FIXED_POINT
+    uint16_t ranges_cm[ANCHOR_SET_MAX_ANCHORS];
+    for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+        if (*mask & (1u << i)) {
+            float cm = set->ranges[i] * 100.0f + 0.5f;
+            ranges_cm[i] = cm < 65535.0f ? static_cast<uint16_t>(cm) : 65535;
+        }
+    }
+    return anchor_set_solve_cm(&s_anchors, *mask, ranges_cm, k_beacon_height_cm, pos_cm);
+#else
+    float anchors[ANCHOR_SET_MAX_ANCHORS][3];
+    float ranges[ANCHOR_SET_MAX_ANCHORS];
+    float sigmas[ANCHOR_SET_MAX_ANCHORS];
+    int count = anchor_set_gather(&s_anchors, *mask, anchors);
+    int k = 0;
+    for (uint32_t m = *mask; m; m &= m - 1, k++) {
+        ranges[k] = set->ranges[__builtin_ctz(m)];
+        sigmas[k] = set->sigmas[__builtin_ctz(m)];
+    }
+    uint16_t used = *mask;
+    float ransac_confidence = 0;
+    if (count >= k_ransac_min_anchors) {
+        multilat_ransac_fix_t ransac;
+        s_stats.ransac_solves++;
+        if (multilat_ransac(anchors, ranges, sigmas, count, k_beacon_height_cm * 0.01f, &s_ransac_config,
+                            &ransac) == 0) {
+            /* Compact the inliers in place, they keep their order */
+            int kept = 0;
+            k = 0;
+            for (uint32_t m = *mask; m; m &= m - 1, k++) {
+                if (!(ransac.inliers & (1u << k))) {
+                    used &= ~(1u << __builtin_ctz(m));
+                    continue;
+                }
+                memmove(anchors[kept], anchors[k], sizeof(anchors[k]));
+                ranges[kept] = ranges[k];
+                sigmas[kept] = sigmas[k];
+                kept++;
+            }
+            count = kept;
+            ransac_confidence = ransac.confidence;
+        }
+    }
+    multilat_fix_t solved;
+    if (multilat_solve_3d(anchors, ranges, sigmas, count, k_beacon_height_cm * 0.01f, k_gn_iterations, &solved) !=
+        0) {
+        return -1;
+    }
+    for (int i = 0; i < 3; i++) {
+        pos_cm[i] = static_cast<int32_t>(lrintf(solved.pos[i] * 100));
+    }
+    if (solved.dims == 3) {
+        *flags |= BEACON_POSITION_FLAG_3D;
+    }
+    *mask = used;
+    *confidence = ransac_confidence;
+    return 0;
+#endif
+}
+
+/* Sigma that, the same for every range of the set, carries as much information as theirs */
+static float set_sigma(const fusion_set_t *set, uint16_t mask)
+{
+    float information = 0;
+    for (uint32_t m = mask; m; m &= m - 1) {
+        float sigma = set->sigmas[__builtin_ctz(m)];
+        information += 1 / (sigma * sigma);
+    }
+    return sqrtf(__builtin_popcount(mask) / information);
+}
+
+/* Particle filter mode: the particles of the slot walk for the time since its last set, then its
+ * ranges weight them. A slot new to the beacon, or whose particles all lost their weight, is
+ * seeded around the fix instead. There is no floor plan on the aggregator, the particles roam
+ * freely at the height of the first fix. */
+static void particles_fix(int slot, const fusion_set_t *set, uint16_t mask, const float pos[3], float sigma)
+{
+    particle_track_t *track = &s_particles[slot];
+    if (!track->seeded || track->beacon != set->beacon) {
+        particle_filter_init(&track->pf, NULL, s_particle_storage + slot * PARTICLE_FILTER_STORAGE(k_particles),
+                             k_particles, pos[2], set->beacon | 1);
+        particle_filter_seed(&track->pf, pos[0], pos[1], sigma);
+        track->beacon = set->beacon;
+        track->time_ms = set->time_ms;
+        track->seeded = true;
+        return;
+    }
+    float anchors[ANCHOR_SET_MAX_ANCHORS][3];
+    float ranges[ANCHOR_SET_MAX_ANCHORS];
+    float sigmas[ANCHOR_SET_MAX_ANCHORS];
+    int count = anchor_set_gather(&s_anchors, mask, anchors);
+    int k = 0;
+    for (uint32_t m = mask; m; m &= m - 1, k++) {
+        ranges[k] = set->ranges[__builtin_ctz(m)];
+        sigmas[k] = set->sigmas[__builtin_ctz(m)];
+    }
+    int32_t dt_ms = static_cast<int32_t>(set->time_ms - track->time_ms);
+    if (dt_ms > 0) {
+        particle_filter_predict(&track->pf, k_particle_speed * dt_ms * 0.001f);
+        track->time_ms = set->time_ms;
+    }
+    if (particle_filter_update(&track->pf, anchors, ranges, sigmas, count) != 0) {
+        particle_filter_seed(&track->pf, pos[0], pos[1], sigma);
+        s_stats.particle_reseeds++;
+    }
+}
+
+/* Ranges of mediators without a position are left out. Sets least squares can not solve, with
+ * fewer than three placed anchors or anchors in a line, are located on the grid instead.
+ *
+ * @return 0 with the position and its GDOP in `fix`, -1 if the set can not be solved.
+ */
+static int solve(const fusion_set_t *set, int slot)
+{
+    fix_t *fix = &s_fixes[slot];
+    const uint16_t heard = set->mask & s_anchors.present;
+    uint16_t mask = heard;
+    int32_t pos_cm[3];
+    float spread = 0;
+    float confidence = 0;
+    uint8_t flags = 0;
+    if (least_squares(set, &mask, pos_cm, &flags, &confidence) != 0) {
+        if (grid_solve(set, mask, pos_cm, &spread) != 0) {
+            s_stats.unsolved++;
+            return -1;
+        }
+        flags = BEACON_POSITION_FLAG_GRID;
+        s_stats.grid_fixes++;
+    }
+    const float pos[3] = {pos_cm[0] * 0.01f, pos_cm[1] * 0.01f, pos_cm[2] * 0.01f};
+    fix->beacon = set->beacon;
+    fix->time_ms = set->time_ms;
+    fix->age_spread_ms = set->age_spread_ms;
+    memcpy(fix->pos_cm, pos_cm, sizeof(fix->pos_cm));
+    fix->gdop = anchor_set_gdop(&s_anchors, mask, pos);
+    fix->spread = spread;
+    fix->outliers = heard & ~mask;
+    fix->confidence = confidence;
+    fix->anchors = static_cast<uint8_t>(__builtin_popcount(mask));
+    fix->flags = flags;
+    fix->valid = 1;
+    /* A fix is as good as its ranges scaled by the geometry. One captured before the last tick
+     * is applied at the time the track was predicted to. A grid fix has no usable GDOP, its
+     * likelihood spread stands in, no tighter than a single range. */
+    float range_sigma = set_sigma(set, mask);
+    float sigma = flags & BEACON_POSITION_FLAG_GRID ? fmaxf(spread, range_sigma) : range_sigma * fix->gdop;
+    if (s_particles) {
+        particles_fix(slot, set, mask, pos, sigma);
+    } else if (beacon_tracks_fix(&s_tracks, set->beacon, pos, sigma, set->time_ms) != 0) {
+        s_stats.track_rejected++;
+    }
+    s_stats.fixes++;
+    s_stats.outliers += __builtin_popcount(fix->outliers);
+    ESP_LOGD(TAG, "beacon 0x%08x at %d, %d, %d cm (%dD) from %d anchors%s, %d outliers, GDOP %.2f, age spread %u ms",
+             set->beacon, pos_cm[0], pos_cm[1], pos_cm[2], flags & BEACON_POSITION_FLAG_3D ? 3 : 2, fix->anchors,
+             flags & BEACON_POSITION_FLAG_GRID ? " on the grid" : "", __builtin_popcount(fix->outliers), fix->gdop,
+             set->age_spread_ms);
+    return 0;
+}
+
+static uint32_t solve_clock_us(void *ctx)
+{
+    return static_cast<uint32_t>(esp_timer_get_time());
+}
+
+/* A beacon held by the fusion holdoff stays dirty, with the time it was first marked, so its
+ * newest ranges are solved on a later tick even if no more samples come in. One still waiting
+ * for ranges is marked again by its next sample. */
+static void solve_slot(void *ctx, int slot)
+{
+    uint32_t now_ms = *static_cast<const uint32_t *>(ctx);
+    fusion_set_t set;
+    switch (fusion_offer(&s_fusion, &s_store, slot, now_ms, &set)) {
+    case FUSION_READY:
+        if (solve(&set, slot) == 0) {
+            s_fixes_changed = true;
+        }
+        break;
+    case FUSION_HELD:
+        solve_sched_defer(&s_sched, slot);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Fix of a slot, if the slot still holds the beacon it was solved for */
+static const fix_t *slot_fix(int slot)
+{
+    const fix_t *fix = &s_fixes[slot];
+    return fix->valid && slot < s_store.beacon_count && s_store.beacon_id[slot] == fix->beacon ? fix : NULL;
+}
+
+/* Filtered x and y of a fix's beacon: the particle estimate in particle filter mode, the Kalman
+ * track otherwise
+ *
+ * @return BEACON_POSITION_FLAG_PARTICLES or BEACON_POSITION_FLAG_TRACKED, 0 if the beacon is not
+ *         tracked.
+ */
+static uint8_t tracked_position(int slot, const fix_t *fix, float pos[2])
+{
+    if (s_particles) {
+        const particle_track_t *track = &s_particles[slot];
+        if (!track->seeded || track->beacon != fix->beacon) {
+            return 0;
+        }
+        float estimate[3];
+        particle_filter_estimate(&track->pf, estimate, NULL);
+        pos[0] = estimate[0];
+        pos[1] = estimate[1];
+        return BEACON_POSITION_FLAG_PARTICLES;
+    }
+    const beacon_track_t *track = beacon_tracks_find(&s_tracks, fix->beacon);
+    if (!track) {
+        return 0;
+    }
+    pos[0] = track->x[0];
+    pos[1] = track->x[1];
+    return BEACON_POSITION_FLAG_TRACKED;
+}
+
+static void positions_publish(uint32_t now_ms)
+{
+    static beacon_position_t entries[OBS_STORE_MAX_BEACONS];
+    size_t count = 0;
+    for (int slot = 0; slot < OBS_STORE_MAX_BEACONS; slot++) {
+        const fix_t *fix = slot_fix(slot);
+        if (!fix) {
+            continue;
+        }
+        beacon_position_t *entry = &entries[count++];
+        entry->beacon = fix->beacon;
+        for (int i = 0; i < 3; i++) {
+            entry->pos_mm[i] = fix->pos_cm[i] * 10;
+        }
+        entry->flags = fix->flags;
+        float tracked[2];
+        uint8_t tracked_flag = tracked_position(slot, fix, tracked);
+        if (tracked_flag) {
+            entry->pos_mm[0] = static_cast<int32_t>(lrintf(tracked[0] * 1000));
+            entry->pos_mm[1] = static_cast<int32_t>(lrintf(tracked[1] * 1000));
+            entry->flags |= tracked_flag;
+        }
+        entry->age_ms = now_ms - fix->time_ms;
+        entry->age_spread_ms = fix->age_spread_ms < 65535 ? static_cast<uint16_t>(fix->age_spread_ms) : 65535;
+        float centi = fix->flags & BEACON_POSITION_FLAG_GRID ? fix->spread : fix->gdop;
+        entry->gdop_centi = centi < 655.35f ? static_cast<uint16_t>(lrintf(centi * 100)) : 65535;
+        entry->anchors = fix->anchors;
+        entry->outliers = static_cast<uint8_t>(__builtin_popcount(fix->outliers));
+        entry->confidence_pct = static_cast<uint8_t>(lrintf(fix->confidence * 100));
+    }
+    esp_matter_attr_val_t val = esp_matter_long_octet_str((uint8_t *)entries, count * sizeof(entries[0]));
+    attribute::update(s_endpoint_id, BEACON_PROTO_CLUSTER_ID, BEACON_PROTO_ATTR_POSITIONS_ID, &val);
+    s_fixes_changed = false;
+    s_positions_published_ms = now_ms;
+}
+
+static void solve_tick(intptr_t arg)
+{
+    uint32_t now_ms = static_cast<uint32_t>(esp_timer_get_time() / 1000);
+    if (s_grid.stale) {
+        grid_rebuild();
+    }
+    solve_sched_tick(&s_sched, now_ms, k_solve_budget_us, solve_clock_us, solve_slot, &now_ms);
+    beacon_tracks_predict_all(&s_tracks, now_ms);
+    if (s_fixes_changed && now_ms - s_positions_published_ms >= k_positions_period_ms) {
+        positions_publish(now_ms);
+    }
+}
+
+static void solve_timer_cb(void *arg)
+{
+    chip::DeviceLayer::PlatformMgr().ScheduleWork(solve_tick, 0);
+}
+
+esp_err_t obs_ingest_anchor_moved(uint16_t mediator, const float pos[3])
+{
+    /* A dropped anchor without a slot was never solved with, it must not take one now */
+    int slot = pos ? obs_store_mediator_slot(&s_store, mediator) : obs_store_mediator_find(&s_store, mediator);
+    if (slot < 0) {
+        return pos ? ESP_ERR_NO_MEM : ESP_OK;
+    }
+    anchor_set_move(&s_anchors, slot, pos);
+    s_grid.stale = true;
+    return ESP_OK;
+}
+
+static void link_stats_publish(intptr_t arg)
+{
+    static beacon_link_stats_t entries[SEQ_TRACKER_MAX_MEDIATORS];
+    size_t count = 0;
+    for (int i = 0; i < SEQ_TRACKER_MAX_MEDIATORS; i++) {
+        const seq_link_t *link = &s_seq_tracker.links[i];
+        if (!link->used) {
+            continue;
+        }
+        beacon_link_stats_t *entry = &entries[count++];
+        entry->mediator = link->mediator;
+        entry->loss_permille = static_cast<uint16_t>(seq_link_loss_permille(link));
+        entry->received = link->counters.received;
+        entry->lost = link->counters.lost;
+        entry->reordered = link->counters.reordered;
+        entry->duplicate = link->counters.duplicate;
+        entry->recovered = link->counters.recovered;
+    }
+    esp_matter_attr_val_t val = esp_matter_long_octet_str((uint8_t *)entries, count * sizeof(entries[0]));
+    attribute::update(s_endpoint_id, BEACON_PROTO_CLUSTER_ID, BEACON_PROTO_ATTR_LINK_STATS_ID, &val);
+}
+
+static void link_stats_timer_cb(void *arg)
+{
+    chip::DeviceLayer::PlatformMgr().ScheduleWork(link_stats_publish, 0);
+}
+
+#if !CONFIG_BEACON_AGGREGATOR_PERSIST_REPORTS
+/* Reports are consumed straight from the write, esp_matter neither keeps a copy of the value
+ * nor stores it in NVS, and the PRE_UPDATE driver callback is not run. */
+static esp_err_t report_override_cb(attribute::callback_type_t type, uint16_t endpoint_id, uint32_t cluster_id,
+                                    uint32_t attribute_id, esp_matter_attr_val_t *val, void *priv_data)
+{
+    if (type == attribute::WRITE) {
+        return obs_ingest_report(attribute_id, val);
+    }
+    if (type == attribute::READ) {
+        *val = esp_matter_long_octet_str(NULL, 0);
+    }
+    return ESP_OK;
+}
+#endif
+
+esp_err_t obs_ingest_cluster_create(endpoint_t *endpoint)
+{
+    cluster_t *cluster = cluster::create(endpoint, BEACON_PROTO_CLUSTER_ID, CLUSTER_FLAG_SERVER);
+    if (!cluster) {
+        ESP_LOGE(TAG, "Failed to create observation report cluster");
+        return ESP_FAIL;
+    }
+
+    /* The initial value sets the largest report the attribute accepts */
+    static uint8_t report_buf[BEACON_PROTO_REPORT_MAX_SIZE];
+#if CONFIG_BEACON_AGGREGATOR_PERSIST_REPORTS
+    uint8_t report_flags = ATTRIBUTE_FLAG_WRITABLE | ATTRIBUTE_FLAG_NONVOLATILE;
+#else
+    uint8_t report_flags = ATTRIBUTE_FLAG_WRITABLE | ATTRIBUTE_FLAG_OVERRIDE;
+#endif
+    attribute_t *attribute = attribute::create(cluster, BEACON_PROTO_ATTR_REPORT_ID, report_flags,
+                                               esp_matter_long_octet_str(report_buf, sizeof(report_buf)));
+    if (!attribute) {
+        ESP_LOGE(TAG, "Failed to create observation report attribute");
+        return ESP_FAIL;
+    }
+#if !CONFIG_BEACON_AGGREGATOR_PERSIST_REPORTS
+    attribute::set_override_callback(attribute, report_override_cb);
+#endif
+
+    static uint8_t link_stats_buf[SEQ_TRACKER_MAX_MEDIATORS * sizeof(beacon_link_stats_t)];
+    attribute = attribute::create(cluster, BEACON_PROTO_ATTR_LINK_STATS_ID, ATTRIBUTE_FLAG_NONE,
+                                  esp_matter_long_octet_str(link_stats_buf, sizeof(link_stats_buf)));
+    if (!attribute) {
+        ESP_LOGE(TAG, "Failed to create link statistics attribute");
+        return ESP_FAIL;
+    }
+
+    static uint8_t positions_buf[OBS_STORE_MAX_BEACONS * sizeof(beacon_position_t)];
+    attribute = attribute::create(cluster, BEACON_PROTO_ATTR_POSITIONS_ID, ATTRIBUTE_FLAG_NONE,
+                                  esp_matter_long_octet_str(positions_buf, sizeof(positions_buf)));
+    if (!attribute) {
+        ESP_LOGE(TAG, "Failed to create positions attribute");
+        return ESP_FAIL;
+    }
+
+    obs_store_init(&s_store);
+    const fusion_config_t fusion_config = FUSION_CONFIG_DEFAULT();
+    fusion_init(&s_fusion, &fusion_config);
+    multilat_ransac_config_t ransac_config = MULTILAT_RANSAC_CONFIG_DEFAULT();
+    ransac_config.threshold = k_ransac_threshold;
+    ransac_config.budget_us = CONFIG_BEACON_AGGREGATOR_RANSAC_BUDGET_US;
+    ransac_config.clock_us = esp_timer_get_time;
+    ransac_config.gn_iterations = k_gn_iterations;
+    s_ransac_config = ransac_config;
+    const presence_config_t presence_config = PRESENCE_CONFIG_DEFAULT();
+    presence_init(&s_presence, &presence_config);
+    solve_sched_init(&s_sched);
+    beacon_tracks_init(&s_tracks, 2, k_track_accel_noise);
+    if (k_particles) {
+        s_particles = static_cast<particle_track_t *>(calloc(OBS_STORE_MAX_BEACONS, sizeof(particle_track_t)));
+        s_particle_storage = static_cast<float *>(
+            malloc(OBS_STORE_MAX_BEACONS * PARTICLE_FILTER_STORAGE(k_particles) * sizeof(float)));
+        if (!s_particles || !s_particle_storage) {
+            ESP_LOGW(TAG, "No memory for %u particles per beacon, tracking with the Kalman filter", k_particles);
+            free(s_particles);
+            free(s_particle_storage);
+            s_particles = NULL;
+            s_particle_storage = NULL;
+        }
+    }
+    anchor_set_load(&s_anchors, NULL, 0);
+    if (anchor_registry_create(cluster) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    s_endpoint_id = endpoint::get_id(endpoint);
+    const esp_timer_create_args_t timer_args = {
+        .callback = link_stats_timer_cb,
+        .name = "link_stats",
+    };
+    if (esp_timer_create(&timer_args, &s_link_stats_timer) != ESP_OK ||
+        esp_timer_start_periodic(s_link_stats_timer, k_link_stats_period_us) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start link statistics timer");
+        return ESP_FAIL;
+    }
+    const esp_timer_create_args_t solve_timer_args = {
+        .callback = solve_timer_cb,
+        .name = "solve",
+    };
+    if (esp_timer_create(&solve_timer_args, &s_solve_timer) != ESP_OK ||
+        esp_timer_start_periodic(s_solve_timer, k_solve_period_us) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start solve timer");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t obs_ingest_report(uint32_t attribute_id, esp_matter_attr_val_t *val)
+{
+    if (attribute_id != BEACON_PROTO_ATTR_REPORT_ID) {
+        return ESP_OK;
+    }
+
+    int64_t started_us = esp_timer_get_time();
+    const uint8_t *buf = val->val.a.b;
+    size_t len = val->val.a.s;
+    beacon_report_head_t head;
+    if (!buf || len < sizeof(head)) {
+        s_stats.malformed++;
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(&head, buf, sizeof(head));
+    if (head.version < BEACON_PROTO_MIN_VERSION || head.version > BEACON_PROTO_VERSION || head.count > BEACON_PROTO_MAX_OBS ||
+        len != BEACON_PROTO_REPORT_SIZE(head.count)) {
+        ESP_LOGW(TAG, "Malformed report from mediator 0x%04x, version %u, %u bytes", head.mediator, head.version,
+                 (unsigned)len);
+        s_stats.malformed++;
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bool live = !(s_bench && head.mediator == k_bench_mediator);
+    seq_tracker_t *tracker = live ? &s_seq_tracker : &s_bench->seq_tracker;
+    obs_store_t *store = live ? &s_store : &s_bench->store;
+    solve_sched_t *sched = live ? &s_sched : &s_bench->sched;
+    if (live) {
+        s_stats.reports++;
+        s_stats.observations += head.count;
+    }
+    uint32_t now_ms = static_cast<uint32_t>(started_us / 1000);
+    int mediator = obs_store_mediator_slot(store, head.mediator);
+    if (mediator < 0) {
+        store->stats.mediator_overflow += head.count;
+    }
+    for (uint8_t i = 0; i < head.count; i++) {
+        beacon_obs_t obs;
+        memcpy(&obs, buf + sizeof(head) + i * sizeof(obs), sizeof(obs));
+        if (live && (obs.flags & BEACON_OBS_FLAG_BACKLOG)) {
+            s_stats.backlog++;
+        }
+        seq_tracker_observe(tracker, head.mediator, head.boot_seq, obs.seq);
+        float level_db = (obs.flags & BEACON_OBS_FLAG_RAW_RSSI)
+            ? static_cast<float>(obs.raw.measured_power - obs.raw.rssi)
+            : pathloss_level_from_distance(obs.distance_cm * 0.01f);
+        /* Replayed observations from before a mediator reboot have no usable capture time */
+        if (mediator >= 0 && !(obs.flags & BEACON_OBS_FLAG_AGE_UNKNOWN)) {
+            uint16_t distance_cm = live ? range_models_distance(static_cast<uint8_t>(mediator), head.mediator,
+                                                                obs.beacon, level_db)
+                                        : obs.distance_cm;
+            int slot = obs_store_insert(store, obs.beacon, static_cast<uint8_t>(mediator), distance_cm,
+                                        now_ms - obs.age_ms);
+            solve_sched_mark(sched, slot, now_ms);
+            if (live) {
+                presence_feed(obs.beacon, static_cast<uint8_t>(mediator), distance_cm, now_ms - obs.age_ms);
+            }
+        }
+        ESP_LOGD(TAG, "mediator 0x%04x seq %u beacon 0x%08x level %.1f dB age %u ms%s", head.mediator, obs.seq,
+                 obs.beacon, level_db, obs.age_ms, (obs.flags & BEACON_OBS_FLAG_BACKLOG) ? " (backlog)" : "");
+    }
+    if (live) {
+        presence_expire_due(now_ms);
+        latency_add(&s_handle_latency, static_cast<uint32_t>(esp_timer_get_time() - started_us));
+    }
+    return ESP_OK;
+}
+
+static esp_err_t seq_console_handler(int argc, char **argv)
+{
+    printf("reports: %u observations: %u backlog: %u malformed: %u untracked: %u\n", s_stats.reports,
+           s_stats.observations, s_stats.backlog, s_stats.malformed, s_seq_tracker.overflow);
+    printf("mediator  received      lost  loss(%%)  gaps  reordered  duplicate  recovered  backlog  reboots\n");
+    for (int i = 0; i < SEQ_TRACKER_MAX_MEDIATORS; i++) {
+        const seq_link_t *link = &s_seq_tracker.links[i];
+        if (!link->used) {
+            continue;
+        }
+        const seq_counters_t *c = &link->counters;
+        uint32_t permille = seq_link_loss_permille(link);
+        printf("  0x%04x  %8u  %8u  %3u.%u  %5u  %9u  %9u  %9u  %7u  %7u\n", link->mediator, c->received,
+               c->lost, permille / 10, permille % 10, c->gaps, c->reordered, c->duplicate, c->recovered, c->backlog,
+               c->reboots);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t presence_console_handler(int argc, char **argv)
+{
+    const presence_stats_t *stats = &s_presence.stats;
+    printf("%u beacons, %u observations, %u transitions, %u held by dwell, %u evicted\n", s_presence.count,
+           stats->observations, stats->transitions, stats->held, stats->evicted);
+    printf("  beacon    mediator  level(dB)  heard by\n");
+    for (int i = 0; i < s_presence.count; i++) {
+        const presence_beacon_t *b = &s_presence.beacon[i];
+        if (b->room == PRESENCE_NOWHERE) {
+            printf("  0x%08x  -\n", s_presence.beacon_id[i]);
+            continue;
+        }
+        printf("  0x%08x  0x%04x    %9.1f  %d\n", s_presence.beacon_id[i], presence_mediator_id(b->room),
+               b->level[b->room], __builtin_popcount(b->heard));
+    }
+    return ESP_OK;
+}
+
+static esp_err_t position_console_handler(int argc, char **argv)
+{
+    uint32_t now_ms = static_cast<uint32_t>(esp_timer_get_time() / 1000);
+    const beacon_tracks_stats_t *stats = &s_tracks.stats;
+    if (s_particles) {
+        printf("particle filter, %u particles per beacon, %u reseeded\n", k_particles, s_stats.particle_reseeds);
+    } else {
+        printf("%u tracks, %u created, %u restarted, %u evicted, %u fixes gated out\n", s_tracks.count,
+               stats->created, stats->restarted, stats->evicted, s_stats.track_rejected);
+    }
+    printf("  beacon      fix x    fix y  track x  track y  z (m)  dims  GDOP  anchors  age (ms)  spread (ms)\n");
+    for (int slot = 0; slot < OBS_STORE_MAX_BEACONS; slot++) {
+        const fix_t *fix = slot_fix(slot);
+        if (!fix) {
+            continue;
+        }
+        float tracked[2];
+        printf("  0x%08x  %7.2f  %7.2f  ", fix->beacon, fix->pos_cm[0] * 0.01f, fix->pos_cm[1] * 0.01f);
+        if (tracked_position(slot, fix, tracked)) {
+            printf("%7.2f  %7.2f", tracked[0], tracked[1]);
+        } else {
+            printf("      -        -");
+        }
+        printf("  %5.2f  %4d  %4.2f  %7u  %8u  %11u", fix->pos_cm[2] * 0.01f,
+               fix->flags & BEACON_POSITION_FLAG_3D ? 3 : 2, fix->gdop, fix->anchors, now_ms - fix->time_ms,
+               fix->age_spread_ms);
+        if (fix->flags & BEACON_POSITION_FLAG_GRID) {
+            printf("  grid, %.2f m likely", fix->spread);
+        }
+        if (fix->confidence > 0) {
+            printf("  RANSAC %.0f%%", fix->confidence * 100);
+        }
+        for (uint32_t m = fix->outliers; m; m &= m - 1) {
+            printf("  outlier 0x%04x", obs_store_mediator_id(&s_store, static_cast<uint8_t>(__builtin_ctz(m))));
+        }
+        printf("\n");
+    }
+    return ESP_OK;
+}
+
+/*------------------------------ Benchmark ------------------------------*/
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Writes synthetic reports through the same attribute write path a mediator's write takes */
+static esp_err_t ingest_bench(uint32_t writes, uint8_t obs_per_report)
+{
+    uint32_t *samples = (uint32_t *)malloc(writes * sizeof(uint32_t));
+    bench_state_t *bench = (bench_state_t *)calloc(1, sizeof(bench_state_t));
+    if (!samples || !bench) {
+        free(samples);
+        free(bench);
+        return ESP_ERR_NO_MEM;
+    }
+    obs_store_init(&bench->store);
+    solve_sched_init(&bench->sched);
+    chip::DeviceLayer::PlatformMgr().LockChipStack();
+    s_bench = bench;
+    chip::DeviceLayer::PlatformMgr().UnlockChipStack();
+    /* Long octet strings are passed with a little endian length prefix */
+    static uint8_t buf[2 + BEACON_PROTO_REPORT_MAX_SIZE];
+    size_t len = BEACON_PROTO_REPORT_SIZE(obs_per_report);
+    buf[0] = len & 0xFF;
+    buf[1] = len >> 8;
+    beacon_report_head_t head = {
+        .version = BEACON_PROTO_VERSION,
+        .count = obs_per_report,
+        .mediator = k_bench_mediator,
+        .boot_seq = static_cast<uint32_t>(esp_timer_get_time()),
+    };
+    memcpy(buf + 2, &head, sizeof(head));
+
+    uint32_t seq = 0;
+    uint32_t failed = 0;
+    for (uint32_t i = 0; i < writes; i++) {
+        for (uint8_t j = 0; j < obs_per_report; j++) {
+            beacon_obs_t obs = {};
+            obs.beacon = j;
+            obs.distance_cm = 100 + j;
+            obs.seq = seq++;
+            memcpy(buf + 2 + sizeof(head) + j * sizeof(obs), &obs, sizeof(obs));
+        }
+        chip::DeviceLayer::PlatformMgr().LockChipStack();
+        int64_t started_us = esp_timer_get_time();
+        EmberAfStatus status = emberAfWriteAttribute(s_endpoint_id, BEACON_PROTO_CLUSTER_ID,
+                                                     BEACON_PROTO_ATTR_REPORT_ID, buf,
+                                                     ZCL_LONG_OCTET_STRING_ATTRIBUTE_TYPE);
+        samples[i] = static_cast<uint32_t>(esp_timer_get_time() - started_us);
+        chip::DeviceLayer::PlatformMgr().UnlockChipStack();
+        if (status != EMBER_ZCL_STATUS_SUCCESS) {
+            failed++;
+        }
+    }
+
+    chip::DeviceLayer::PlatformMgr().LockChipStack();
+    s_bench = nullptr;
+    chip::DeviceLayer::PlatformMgr().UnlockChipStack();
+    uint32_t inserted = bench->store.stats.inserted;
+    free(bench);
+
+    qsort(samples, writes, sizeof(samples[0]), compare_u32);
+    uint64_t total_us = 0;
+    for (uint32_t i = 0; i < writes; i++) {
+        total_us += samples[i];
+    }
+    printf("%s, %u writes of %u observations, %u failed, %u stored apart from the live beacons\n",
+           k_report_path, writes, obs_per_report, failed, inserted);
+    printf("write latency us: min %u p50 %u p99 %u max %u avg %llu\n", samples[0], samples[writes / 2],
+           samples[writes * 99 / 100], samples[writes - 1], total_us / writes);
+    free(samples);
+    return ESP_OK;
+}
+
+static esp_err_t ingest_console_handler(int argc, char **argv)
+{
+    if (argc >= 1 && strcmp(argv[0], "bench") == 0) {
+        uint32_t writes = argc >= 2 ? strtoul(argv[1], NULL, 0) : 200;
+        uint32_t obs_per_report = argc >= 3 ? strtoul(argv[2], NULL, 0) : 8;
+        if (writes == 0 || obs_per_report == 0 || obs_per_report > BEACON_PROTO_MAX_OBS) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        return ingest_bench(writes, static_cast<uint8_t>(obs_per_report));
+    }
+    if (argc >= 1) {
+        printf("Usage: matter esp ingest [bench [writes] [observations per report]]\n");
+        return ESP_ERR_INVALID_ARG;
+    }
+    printf("report path: %s\n", k_report_path);
+    printf("store: %u/%u beacons, %u/%u mediators, inserted %u evicted %u mediator_overflow %u\n",
+           s_store.beacon_count, OBS_STORE_MAX_BEACONS, s_store.mediator_count, OBS_STORE_MAX_MEDIATORS,
+           s_store.stats.inserted, s_store.stats.evicted, s_store.stats.mediator_overflow);
+    const fusion_stats_t *fusion = &s_fusion.stats;
+    printf("fusion: %u sets, age spread avg %llu ms, %u ranges extrapolated, %u discarded, %u waiting, %u held\n",
+           fusion->sets, fusion->sets ? fusion->age_spread_ms / fusion->sets : 0, fusion->extrapolated,
+           fusion->discarded, fusion->waiting, fusion->held);
+    printf("solver: %u fixes, %u on the grid, %u unsolved, %d anchors, subsets %u hits %u misses %u invalidated\n",
+           s_stats.fixes, s_stats.grid_fixes, s_stats.unsolved, __builtin_popcount(s_anchors.present),
+           s_anchors.stats.hits, s_anchors.stats.misses, s_anchors.stats.invalidated);
+    printf("  RANSAC: %u sets, %u ranges left out, budget %u us\n", s_stats.ransac_solves, s_stats.outliers,
+           s_ransac_config.budget_us);
+    if (s_grid.table) {
+        printf("  grid fallback: %ux%u cells of %d cm\n", s_grid.loc.grid.width, s_grid.loc.grid.height,
+               k_grid_cell_cm);
+    } else {
+        printf("  grid fallback: %s\n", k_grid_cell_cm ? "not built" : "disabled");
+    }
+    const solve_sched_stats_t *sched = &s_sched.stats;
+    printf("scheduler: %d dirty, %u ticks, %u solved, %u marks coalesced, %u held back, solve cost avg %u us\n",
+           solve_sched_pending(&s_sched), sched->ticks, sched->solved, sched->coalesced, sched->deferred,
+           s_sched.cost_us);
+    if (sched->ticks > 0) {
+        printf("  budget used avg %llu%% max %u of %u us, wait avg %llu ms max %u ms, %u ticks deferred\n",
+               sched->budget_us ? sched->used_us * 100 / sched->budget_us : 0, sched->max_used_us, k_solve_budget_us,
+               sched->solved ? sched->wait_ms / sched->solved : 0, sched->max_wait_ms, sched->deferred_ticks);
+        printf("  backlogs cleared %u, last in %u ms, max %u ms%s\n", sched->backlogs, sched->last_backlog_ms,
+               sched->max_backlog_ms, s_sched.backlog ? ", one pending" : "");
+    }
+    if (s_handle_latency.count > 0) {
+        printf("handling latency us: min %u max %u avg %llu over %u reports\n", s_handle_latency.min_us,
+               s_handle_latency.max_us, s_handle_latency.total_us / s_handle_latency.count, s_handle_latency.count);
+    }
+    return ESP_OK;
+}
+
+esp_err_t obs_ingest_register_commands()
+{
+    static const esp_matter::console::command_t commands[] = {
+        {
+            .name = "seq",
+            .description = "Per-mediator sequence and loss statistics. Usage: matter esp seq",
+            .handler = seq_console_handler,
+        },
+        {
+            .name = "ingest",
+            .description = "Report handling latency and write benchmark. "
+                           "Usage: matter esp ingest [bench [writes] [observations per report]]",
+            .handler = ingest_console_handler,
+        },
+        {
+            .name = "presence",
+            .description = "Mediator each beacon is assigned to. Usage: matter esp presence",
+            .handler = presence_console_handler,
+        },
+        {
+            .name = "position",
+            .description = "Last fix and tracked position of each beacon. Usage: matter esp position",
+            .handler = position_console_handler,
+        },
+    };
+    return esp_matter::console::add_commands(commands, sizeof(commands) / sizeof(commands[0]));
+}
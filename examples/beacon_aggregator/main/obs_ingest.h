@@ -0,0 +1,49 @@
+#pragma once
+
+#include <esp_err.h>
+#include <esp_matter.h>
+
+/** Add the observation report cluster
+ *
+ * Creates the vendor cluster mediators write their observation reports to (see beacon_proto.h),
+ * along with the read only LinkStats attribute which publishes per-mediator loss statistics.
+ *
+ * The report attribute is RAM only: writes are handed to obs_ingest_report() by an override
+ * callback without being stored or passed to the attribute update callback, and it reads back
+ * empty. CONFIG_BEACON_AGGREGATOR_PERSIST_REPORTS restores the regular persisted path.
+ *
+ * @param[in] endpoint Endpoint to add the cluster to.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t obs_ingest_cluster_create(esp_matter::endpoint_t *endpoint);
+
+/** Handle a write to the observation report attribute
+ *
+ * Called by the report attribute's override callback, or from the common
+ * `app_attribute_update_cb()` when reports are persisted.
+ *
+ * @param[in] attribute_id Attribute ID of the attribute.
+ * @param[in] val Pointer to `esp_matter_attr_val_t` holding the report.
+ *
+ * @return ESP_OK on success.
+ * @return ESP_ERR_INVALID_ARG if the report is malformed.
+ */
+esp_err_t obs_ingest_report(uint32_t attribute_id, esp_matter_attr_val_t *val);
+
+/** Place, move or drop the anchor of a mediator for the solvers
+ *
+ * Called on the CHIP thread by anchor_registry.cpp whenever a position changes. A placed mediator
+ * gets its observation store slot here if it has not reported yet, so anchor indices and mediator
+ * slots stay the same; dropping one that has no slot does nothing.
+ *
+ * @param[in] pos Position in metres, NULL to drop the anchor.
+ *
+ * @return ESP_OK on success.
+ * @return ESP_ERR_NO_MEM if every mediator slot is taken.
+ */
+esp_err_t obs_ingest_anchor_moved(uint16_t mediator, const float pos[3]);
+
+/** Register the `seq`, `ingest`, `presence` and `position` console commands */
+esp_err_t obs_ingest_register_commands();
@@ -0,0 +1,185 @@
+#include <string.h>
+
+#include "obs_store.h"
+
+#define HASH_MASK (OBS_STORE_HASH_SIZE - 1)
+
+/* Beacon IDs are major << 16 | minor and often sequential, spread them over the table */
+static uint32_t home(uint32_t beacon)
+{
+    beacon ^= beacon >> 16;
+    beacon *= 0x7feb352d;
+    beacon ^= beacon >> 15;
+    beacon *= 0x846ca68b;
+    beacon ^= beacon >> 16;
+    return beacon & HASH_MASK;
+}
+
+void obs_store_init(obs_store_t *store)
+{
+    memset(store, 0, sizeof(*store));
+    memset(store->hash, 0xFF, sizeof(store->hash));
+}
+
+int obs_store_mediator_find(const obs_store_t *store, uint16_t mediator)
+{
+    for (int i = 0; i < store->mediator_count; i++) {
+        if (store->mediator_id[i] == mediator) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int obs_store_mediator_slot(obs_store_t *store, uint16_t mediator)
+{
+    int slot = obs_store_mediator_find(store, mediator);
+    if (slot >= 0) {
+        return slot;
+    }
+    if (store->mediator_count == OBS_STORE_MAX_MEDIATORS) {
+        return -1;
+    }
+    store->mediator_id[store->mediator_count] = mediator;
+    return store->mediator_count++;
+}
+
+int obs_store_find(const obs_store_t *store, uint32_t beacon)
+{
+    for (uint32_t i = home(beacon);; i = (i + 1) & HASH_MASK) {
+        int slot = store->hash[i];
+        if (slot < 0 || store->beacon_id[slot] == beacon) {
+            return slot;
+        }
+    }
+}
+
+/* Backward shift deletion keeps probe sequences intact without tombstones */
+static void unlink_beacon(obs_store_t *store, int slot)
+{
+    uint32_t i = home(store->beacon_id[slot]);
+    while (store->hash[i] != slot) {
+        i = (i + 1) & HASH_MASK;
+    }
+    store->hash[i] = -1;
+    for (uint32_t j = (i + 1) & HASH_MASK; store->hash[j] >= 0; j = (j + 1) & HASH_MASK) {
+        uint32_t k = home(store->beacon_id[store->hash[j]]);
+        /* Move the entry back unless its home lies cyclically in (i, j] */
+        if (((j - k) & HASH_MASK) >= ((j - i) & HASH_MASK)) {
+            store->hash[i] = store->hash[j];
+            store->hash[j] = -1;
+            i = j;
+        }
+    }
+}
+
+static int alloc_beacon(obs_store_t *store, uint32_t beacon, uint32_t now_ms)
+{
+    int slot;
+    if (store->beacon_count < OBS_STORE_MAX_BEACONS) {
+        slot = store->beacon_count++;
+    } else {
+        slot = 0;
+        for (int i = 1; i < OBS_STORE_MAX_BEACONS; i++) {
+            if ((int32_t)(store->beacon_last_ms[i] - store->beacon_last_ms[slot]) < 0) {
+                slot = i;
+            }
+        }
+        unlink_beacon(store, slot);
+        store->stats.evicted++;
+    }
+
+    store->beacon_id[slot] = beacon;
+    store->beacon_last_ms[slot] = now_ms;
+    store->anchor_mask[slot] = 0;
+    memset(store->head[slot], 0, sizeof(store->head[slot]));
+    memset(store->fill[slot], 0, sizeof(store->fill[slot]));
+
+    uint32_t i = home(beacon);
+    while (store->hash[i] >= 0) {
+        i = (i + 1) & HASH_MASK;
+    }
+    store->hash[i] = (int16_t)slot;
+    return slot;
+}
+
+int obs_store_insert(obs_store_t *store, uint32_t beacon, uint8_t mediator, uint16_t distance_cm, uint32_t time_ms)
+{
+    int slot = obs_store_find(store, beacon);
+    if (slot < 0) {
+        slot = alloc_beacon(store, beacon, time_ms);
+    }
+
+    uint8_t head = store->head[slot][mediator];
+    store->distance_cm[slot][mediator][head] = distance_cm;
+    store->time_ms[slot][mediator][head] = time_ms;
+    store->head[slot][mediator] = (head + 1) % OBS_STORE_DEPTH;
+    if (store->fill[slot][mediator] < OBS_STORE_DEPTH) {
+        store->fill[slot][mediator]++;
+    }
+    store->anchor_mask[slot] |= 1u << mediator;
+    if ((int32_t)(time_ms - store->beacon_last_ms[slot]) > 0) {
+        store->beacon_last_ms[slot] = time_ms;
+    }
+    store->stats.inserted++;
+    return slot;
+}
+
+size_t obs_store_query(const obs_store_t *store, int slot, uint32_t now_ms, uint32_t max_age_ms,
+                       obs_store_anchor_t *out)
+{
+    size_t count = 0;
+    uint32_t mask = store->anchor_mask[slot];
+    while (mask) {
+        int m = __builtin_ctz(mask);
+        mask &= mask - 1;
+
+        const uint16_t *distance = store->distance_cm[slot][m];
+        const uint32_t *time = store->time_ms[slot][m];
+        uint32_t sum = 0;
+        uint8_t n = 0;
+        int32_t latest_age = INT32_MAX;
+        uint16_t latest = 0;
+        for (int i = 0; i < store->fill[slot][m]; i++) {
+            int32_t age = (int32_t)(now_ms - time[i]);
+            if (age < 0) {
+                /* Captured after `now` by a mediator clock running ahead */
+                age = 0;
+            }
+            if ((uint32_t)age > max_age_ms) {
+                continue;
+            }
+            sum += distance[i];
+            n++;
+            if (age < latest_age) {
+                latest_age = age;
+                latest = distance[i];
+            }
+        }
+        if (n == 0) {
+            continue;
+        }
+        obs_store_anchor_t *anchor = &out[count++];
+        anchor->mediator = (uint8_t)m;
+        anchor->count = n;
+        anchor->latest_cm = latest;
+        anchor->mean_cm = (uint16_t)((sum + n / 2) / n);
+        anchor->var_cm2 = 0;
+        anchor->age_ms = (uint32_t)latest_age;
+        if (n > 1) {
+            /* Second pass over the same few samples, deviations from the mean never overflow */
+            uint32_t mean = anchor->mean_cm;
+            uint64_t squares = 0;
+            for (int i = 0; i < store->fill[slot][m]; i++) {
+                int32_t age = (int32_t)(now_ms - time[i]);
+                if (age > 0 && (uint32_t)age > max_age_ms) {
+                    continue;
+                }
+                int32_t dev = (int32_t)distance[i] - (int32_t)mean;
+                squares += (uint64_t)((int64_t)dev * dev);
+            }
+            anchor->var_cm2 = (uint32_t)(squares / (n - 1));
+        }
+    }
+    return count;
+}
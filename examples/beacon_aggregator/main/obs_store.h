@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Windowed store of recent distances per (beacon, mediator) pair.
+ *
+ * Statically sized and laid out as structure of arrays: every pair keeps a ring of the last
+ * OBS_STORE_DEPTH timestamped distances, and the rings of one beacon's mediators sit next to
+ * each other, so gathering a beacon's anchors scans a few contiguous cache lines. Beacons are
+ * found through an open addressing hash table and mediators through a short slot table, which
+ * makes an insert O(1).
+ *
+ * When every beacon slot is taken, the beacon heard least recently is evicted.
+ *
+ * Not thread safe. On the aggregator it is only used from the CHIP thread.
+ */
+
+#ifndef OBS_STORE_MAX_BEACONS
+#define OBS_STORE_MAX_BEACONS 64            /* Power of two */
+#endif
+#define OBS_STORE_MAX_MEDIATORS 16          /* Mediator slots, one bit each in anchor masks */
+#define OBS_STORE_DEPTH 4                   /* Distances kept per pair */
+#define OBS_STORE_HASH_SIZE (OBS_STORE_MAX_BEACONS * 2)
+
+typedef struct {
+    uint32_t inserted;
+    uint32_t evicted;           /* Beacons dropped to make room for a new one */
+    uint32_t mediator_overflow; /* Observations from mediators beyond OBS_STORE_MAX_MEDIATORS */
+} obs_store_stats_t;
+
+typedef struct {
+    /* Beacon slots */
+    uint32_t beacon_id[OBS_STORE_MAX_BEACONS];
+    uint32_t beacon_last_ms[OBS_STORE_MAX_BEACONS];
+    uint16_t anchor_mask[OBS_STORE_MAX_BEACONS];        /* Mediator slots holding samples */
+    int16_t hash[OBS_STORE_HASH_SIZE];                  /* Beacon slot or -1 */
+    uint16_t beacon_count;
+
+    /* Mediator slots */
+    uint16_t mediator_id[OBS_STORE_MAX_MEDIATORS];
+    uint8_t mediator_count;
+
+    /* Pair rings, indexed [beacon slot][mediator slot][sample] */
+    uint8_t head[OBS_STORE_MAX_BEACONS][OBS_STORE_MAX_MEDIATORS];
+    uint8_t fill[OBS_STORE_MAX_BEACONS][OBS_STORE_MAX_MEDIATORS];
+    uint16_t distance_cm[OBS_STORE_MAX_BEACONS][OBS_STORE_MAX_MEDIATORS][OBS_STORE_DEPTH];
+    uint32_t time_ms[OBS_STORE_MAX_BEACONS][OBS_STORE_MAX_MEDIATORS][OBS_STORE_DEPTH];
+
+    obs_store_stats_t stats;
+} obs_store_t;
+
+/* Summary of one anchor of a beacon over the query window */
+typedef struct {
+    uint8_t mediator;           /* Mediator slot, see obs_store_mediator_id() */
+    uint8_t count;              /* Samples inside the window */
+    uint16_t latest_cm;
+    uint16_t mean_cm;
+    uint32_t var_cm2;           /* Sample variance inside the window, 0 for a single sample */
+    uint32_t age_ms;            /* Age of the latest sample */
+} obs_store_anchor_t;
+
+void obs_store_init(obs_store_t *store);
+
+/** Slot of a mediator, allocated on first use
+ *
+ * @return mediator slot.
+ * @return -1 if all mediator slots are taken.
+ */
+int obs_store_mediator_slot(obs_store_t *store, uint16_t mediator);
+
+/** Slot of a mediator, without taking one
+ *
+ * @return mediator slot, -1 if the mediator has none.
+ */
+int obs_store_mediator_find(const obs_store_t *store, uint16_t mediator);
+
+static inline uint16_t obs_store_mediator_id(const obs_store_t *store, uint8_t slot)
+{
+    return store->mediator_id[slot];
+}
+
+/** Record a distance
+ *
+ * @param[in] mediator Mediator slot from obs_store_mediator_slot().
+ * @param[in] time_ms Capture time of the observation.
+ *
+ * @return beacon slot.
+ */
+int obs_store_insert(obs_store_t *store, uint32_t beacon, uint8_t mediator, uint16_t distance_cm, uint32_t time_ms);
+
+/** Slot of a beacon
+ *
+ * @return beacon slot.
+ * @return -1 if the beacon is not in the store.
+ */
+int obs_store_find(const obs_store_t *store, uint32_t beacon);
+
+/** Anchors of a beacon heard within a window
+ *
+ * @param[in] slot Beacon slot.
+ * @param[in] max_age_ms Samples older than this are ignored.
+ * @param[out] out Anchors, room for OBS_STORE_MAX_MEDIATORS entries.
+ *
+ * @return number of anchors stored in `out`.
+ */
+size_t obs_store_query(const obs_store_t *store, int slot, uint32_t now_ms, uint32_t max_age_ms,
+                       obs_store_anchor_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,221 @@
+#include <math.h>
+#include <string.h>
+
+#include "particle_filter.h"
+
+#define SEED_ATTEMPTS 8
+
+static uint32_t next_random(particle_filter_t *pf)
+{
+    uint32_t x = pf->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return pf->rng = x;
+}
+
+static float uniform(particle_filter_t *pf)
+{
+    return (next_random(pf) >> 8) * (1.0f / 16777216.0f);
+}
+
+/* Sum of the four bytes of one draw, scaled to unit variance: close enough to a normal
+ * distribution for the random steps, at the cost of one generator call */
+static float normal(particle_filter_t *pf)
+{
+    uint32_t r = next_random(pf);
+    int sum = (int)(r & 0xFF) + (int)((r >> 8) & 0xFF) + (int)((r >> 16) & 0xFF) + (int)(r >> 24);
+    return (sum - 510) * (1.0f / 147.8f);
+}
+
+/* Checks points every half cell along the step, enough for steps that are short next to walls */
+static int move_blocked(const floor_grid_t *grid, float x0, float y0, float x1, float y1)
+{
+    float scale = 1.0f / grid->cell;
+    float cx = (x0 - grid->origin[0]) * scale;
+    float cy = (y0 - grid->origin[1]) * scale;
+    float dx = (x1 - x0) * scale;
+    float dy = (y1 - y0) * scale;
+    int steps = (int)ceilf(2 * fmaxf(fabsf(dx), fabsf(dy)));
+    if (steps < 1) {
+        steps = 1;
+    }
+    for (int i = 1; i <= steps; i++) {
+        float t = (float)i / steps;
+        float x = cx + t * dx;
+        float y = cy + t * dy;
+        if (!(x >= 0 && y >= 0 && x < grid->width && y < grid->height) ||
+            floor_grid_blocked_cell(grid, (int)x, (int)y)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void particle_filter_init(particle_filter_t *pf, const floor_grid_t *grid, float *storage, uint32_t count, float z,
+                          uint32_t seed)
+{
+    memset(pf, 0, sizeof(*pf));
+    pf->grid = grid;
+    pf->x = storage;
+    pf->y = storage + count;
+    pf->w = storage + 2 * count;
+    pf->scratch_x = storage + 3 * count;
+    pf->scratch_y = storage + 4 * count;
+    pf->count = count;
+    pf->z = z;
+    pf->rng = seed ? seed : 1;
+}
+
+void particle_filter_seed(particle_filter_t *pf, float x, float y, float spread)
+{
+    uint32_t free_count = 0;
+    for (uint32_t i = 0; i < pf->count; i++) {
+        int blocked = 1;
+        for (int attempt = 0; attempt < SEED_ATTEMPTS && blocked; attempt++) {
+            pf->x[i] = x + spread * normal(pf);
+            pf->y[i] = y + spread * normal(pf);
+            blocked = pf->grid && floor_grid_blocked(pf->grid, pf->x[i], pf->y[i]);
+        }
+        pf->w[i] = blocked ? 0 : 1;
+        free_count += !blocked;
+    }
+    for (uint32_t i = 0; i < pf->count; i++) {
+        pf->w[i] = free_count ? pf->w[i] / free_count : 1.0f / pf->count;
+    }
+}
+
+void particle_filter_predict(particle_filter_t *pf, float step_sigma)
+{
+    for (uint32_t i = 0; i < pf->count; i++) {
+        float x = pf->x[i] + step_sigma * normal(pf);
+        float y = pf->y[i] + step_sigma * normal(pf);
+        if (pf->grid && pf->w[i] > 0 && move_blocked(pf->grid, pf->x[i], pf->y[i], x, y)) {
+            pf->w[i] = 0;
+            pf->blocked_moves++;
+            continue;
+        }
+        pf->x[i] = x;
+        pf->y[i] = y;
+    }
+}
+
+/* One uniform offset, then evenly spaced picks through the cumulative weights */
+static void resample(particle_filter_t *pf)
+{
+    uint32_t n = pf->count;
+    float step = 1.0f / n;
+    float u = uniform(pf) * step;
+    float cumulative = pf->w[0];
+    uint32_t j = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        while (u > cumulative && j < n - 1) {
+            cumulative += pf->w[++j];
+        }
+        pf->scratch_x[i] = pf->x[j];
+        pf->scratch_y[i] = pf->y[j];
+        u += step;
+    }
+    float *x = pf->x;
+    float *y = pf->y;
+    pf->x = pf->scratch_x;
+    pf->y = pf->scratch_y;
+    pf->scratch_x = x;
+    pf->scratch_y = y;
+    for (uint32_t i = 0; i < n; i++) {
+        pf->w[i] = step;
+    }
+    pf->resamples++;
+}
+
+int particle_filter_update(particle_filter_t *pf, const float anchors[][3], const float ranges[], const float sigmas[],
+                           int count)
+{
+    float inv_var[PARTICLE_FILTER_MAX_RANGES];
+    if (count > PARTICLE_FILTER_MAX_RANGES) {
+        return -1;
+    }
+    for (int k = 0; k < count; k++) {
+        inv_var[k] = 0.5f / (sigmas[k] * sigmas[k]);
+    }
+
+    /* Log likelihoods go to the scratch array, subtracting the largest keeps expf() in range */
+    float *log_l = pf->scratch_x;
+    float best = -INFINITY;
+    for (uint32_t i = 0; i < pf->count; i++) {
+        if (!(pf->w[i] > 0)) {
+            continue;
+        }
+        float l = 0;
+        for (int k = 0; k < count; k++) {
+            float dx = pf->x[i] - anchors[k][0];
+            float dy = pf->y[i] - anchors[k][1];
+            float dz = pf->z - anchors[k][2];
+            float e = sqrtf(dx * dx + dy * dy + dz * dz) - ranges[k];
+            l -= e * e * inv_var[k];
+        }
+        log_l[i] = l;
+        best = fmaxf(best, l);
+    }
+    if (isinf(best)) {
+        return -1;
+    }
+
+    float total = 0;
+    for (uint32_t i = 0; i < pf->count; i++) {
+        if (pf->w[i] > 0) {
+            pf->w[i] *= expf(log_l[i] - best);
+            total += pf->w[i];
+        }
+    }
+    if (!(total > 0)) {
+        return -1;
+    }
+    float squares = 0;
+    for (uint32_t i = 0; i < pf->count; i++) {
+        pf->w[i] /= total;
+        squares += pf->w[i] * pf->w[i];
+    }
+    /* Effective sample size 1 / sum w^2 */
+    if (squares * pf->count > 2.0f) {
+        resample(pf);
+    }
+    return 0;
+}
+
+void particle_filter_estimate(const particle_filter_t *pf, float pos[3], float *spread)
+{
+    float mx = 0, my = 0;
+    for (uint32_t i = 0; i < pf->count; i++) {
+        mx += pf->w[i] * pf->x[i];
+        my += pf->w[i] * pf->y[i];
+    }
+    if (spread) {
+        float var = 0;
+        for (uint32_t i = 0; i < pf->count; i++) {
+            float dx = pf->x[i] - mx;
+            float dy = pf->y[i] - my;
+            var += pf->w[i] * (dx * dx + dy * dy);
+        }
+        *spread = sqrtf(var);
+    }
+    /* A cloud split by a wall averages into it; live particles only ever stand on free cells */
+    if (pf->grid && floor_grid_blocked(pf->grid, mx, my)) {
+        float nearest = INFINITY;
+        float nx = mx, ny = my;
+        for (uint32_t i = 0; i < pf->count; i++) {
+            float dx = pf->x[i] - mx;
+            float dy = pf->y[i] - my;
+            if (pf->w[i] > 0 && dx * dx + dy * dy < nearest) {
+                nearest = dx * dx + dy * dy;
+                nx = pf->x[i];
+                ny = pf->y[i];
+            }
+        }
+        mx = nx;
+        my = ny;
+    }
+    pos[0] = mx;
+    pos[1] = my;
+    pos[2] = pf->z;
+}
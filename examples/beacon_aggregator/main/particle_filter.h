@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "floor_grid.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Particle filter tracking of one beacon on a floor plan.
+ *
+ * Particles are x/y hypotheses at the beacon height, kept as structure of arrays in storage the
+ * caller provides, so the particle budget can be a few hundred per beacon on the aggregator or
+ * thousands on a host. Each tick the particles take a random step; a step that ends in or
+ * crosses a blocked cell of the floor grid is impossible and the particle is dropped. Ranges
+ * then weight the particles by their likelihood, and the set is resampled systematically once
+ * the effective sample size falls below half the budget.
+ *
+ * Unlike a least squares fix, the estimate can not settle inside a wall or machine: when the
+ * weighted mean falls into a blocked cell the nearest live particle is reported instead.
+ *
+ * Not thread safe.
+ */
+
+#define PARTICLE_FILTER_MAX_RANGES 16
+
+/* Floats of storage for `n` particles: x, y and weight, and x and y again to resample into */
+#define PARTICLE_FILTER_STORAGE(n) (5 * (n))
+
+typedef struct {
+    const floor_grid_t *grid;   /* NULL for no floor plan */
+    float *x;
+    float *y;
+    float *w;                   /* Normalized weights */
+    float *scratch_x;
+    float *scratch_y;
+    uint32_t count;
+    float z;                    /* Beacon height */
+    uint32_t rng;
+    uint32_t resamples;
+    uint32_t blocked_moves;     /* Steps that ended in or crossed a blocked cell */
+} particle_filter_t;
+
+/** Set up a filter over caller provided storage
+ *
+ * @param[in] storage PARTICLE_FILTER_STORAGE(count) floats, kept for the life of the filter.
+ * @param[in] seed Random seed, non-zero.
+ */
+void particle_filter_init(particle_filter_t *pf, const floor_grid_t *grid, float *storage, uint32_t count, float z,
+                          uint32_t seed);
+
+/** Spread the particles around a position, on free cells only
+ *
+ * @param[in] spread Standard deviation of the spread, metres.
+ */
+void particle_filter_seed(particle_filter_t *pf, float x, float y, float spread);
+
+/** Move every particle by a random step
+ *
+ * @param[in] step_sigma Standard deviation of the step along each axis, metres; about the
+ *                       walking speed times the time since the last prediction.
+ */
+void particle_filter_predict(particle_filter_t *pf, float step_sigma);
+
+/** Weight the particles by a set of ranges and resample if needed
+ *
+ * @param[in] sigmas Standard deviation of each range.
+ * @param[in] count Number of ranges, up to PARTICLE_FILTER_MAX_RANGES.
+ *
+ * @return 0 on success.
+ * @return -1 if there are too many ranges, or no particle is left with any weight and the
+ *         filter needs particle_filter_seed().
+ */
+int particle_filter_update(particle_filter_t *pf, const float anchors[][3], const float ranges[], const float sigmas[],
+                           int count);
+
+/** Estimated position
+ *
+ * @param[out] pos Weighted mean, or the live particle nearest to it if the mean is in a blocked cell.
+ * @param[out] spread RMS distance of the particles from the mean, may be NULL.
+ */
+void particle_filter_estimate(const particle_filter_t *pf, float pos[3], float *spread);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,80 @@
+#include <math.h>
+#include <string.h>
+
+#include "pathloss_cal.h"
+
+/* Closer than this the 1 m reference of the model stops making sense */
+#define MIN_DISTANCE 0.1f
+
+void pathloss_cal_init(pathloss_cal_t *cal, float forgetting, float prior_weight)
+{
+    memset(cal, 0, sizeof(*cal));
+    cal->forgetting = forgetting;
+    cal->prior_weight = prior_weight;
+    const pathloss_model_t free_space = PATHLOSS_MODEL_FREE_SPACE;
+    for (int i = 0; i < PATHLOSS_CAL_MAX_MEDIATORS; i++) {
+        cal->mediator[i].model = free_space;
+    }
+}
+
+/* Minimizes sum w (y - a - n x)^2 + prior_weight (n - 2)^2 over a and n */
+static void refit(const pathloss_cal_t *cal, pathloss_cal_mediator_t *m)
+{
+    const float prior_exponent = 2.0f;
+    float sxx = m->sxx + cal->prior_weight;
+    float sxy = m->sxy + cal->prior_weight * prior_exponent;
+    float det = m->s0 * sxx - m->sx * m->sx;
+    if (!(det > 0)) {
+        return;
+    }
+    float a = (sxx * m->sy - m->sx * sxy) / det;
+    float n = (m->s0 * sxy - m->sx * m->sy) / det;
+    if (n < PATHLOSS_MIN_EXPONENT || n > PATHLOSS_MAX_EXPONENT) {
+        /* Refit the offset alone with the exponent at the bound */
+        n = n < PATHLOSS_MIN_EXPONENT ? PATHLOSS_MIN_EXPONENT : PATHLOSS_MAX_EXPONENT;
+        a = (m->sy - n * m->sx) / m->s0;
+    }
+    m->model.offset_db = a;
+    m->model.exponent = n;
+    /* sum w (y - a - n x)^2 expanded over the running sums */
+    float residual = m->syy - 2 * a * m->sy - 2 * n * m->sxy + a * a * m->s0 + 2 * a * n * m->sx + n * n * m->sxx;
+    m->rms_db = sqrtf(fmaxf(residual, 0) / m->s0);
+}
+
+void pathloss_cal_observe(pathloss_cal_t *cal, uint8_t mediator, float distance, float level_db)
+{
+    if (mediator >= PATHLOSS_CAL_MAX_MEDIATORS) {
+        return;
+    }
+    pathloss_cal_mediator_t *m = &cal->mediator[mediator];
+    float x = 10.0f * log10f(fmaxf(distance, MIN_DISTANCE));
+    float y = level_db;
+    float keep = cal->forgetting;
+    m->s0 = keep * m->s0 + 1;
+    m->sx = keep * m->sx + x;
+    m->sy = keep * m->sy + y;
+    m->sxx = keep * m->sxx + x * x;
+    m->sxy = keep * m->sxy + x * y;
+    m->syy = keep * m->syy + y * y;
+    m->samples++;
+    refit(cal, m);
+}
+
+pathloss_model_t pathloss_cal_model(const pathloss_cal_t *cal, uint8_t mediator)
+{
+    const pathloss_model_t free_space = PATHLOSS_MODEL_FREE_SPACE;
+    if (mediator >= PATHLOSS_CAL_MAX_MEDIATORS || cal->mediator[mediator].samples < PATHLOSS_CAL_MIN_SAMPLES) {
+        return free_space;
+    }
+    return cal->mediator[mediator].model;
+}
+
+float pathloss_model_distance(const pathloss_model_t *model, float level_db)
+{
+    return powf(10.0f, (level_db - model->offset_db) / (10.0f * model->exponent));
+}
+
+float pathloss_level_from_distance(float distance)
+{
+    return 20.0f * log10f(fmaxf(distance, MIN_DISTANCE));
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Online calibration of the log-distance path loss model of each mediator.
+ *
+ * Mediators turn RSSI into distance with 10^((tx_power - rssi) / 20) m, which is free space
+ * with the beacon's measured power as the 1 m reference. Factory halls attenuate faster, and
+ * every mediator's receiver and antenna add their own offset. The model fitted here is
+ *     tx_power - rssi = offset_db + exponent * 10 log10(d)
+ * per mediator, from reference beacons at known positions: each of their observations pairs
+ * the true distance to the mediator with the level heard.
+ *
+ * The fit is a recursive least squares with exponential forgetting, so it follows slow changes
+ * of the hall, and with a prior that pulls the exponent towards 2. Reference beacons that all
+ * sit about the same distance from a mediator only tell the level at that distance; the prior
+ * keeps such a fit to an offset instead of an arbitrary exponent.
+ *
+ * Not thread safe.
+ */
+
+#define PATHLOSS_CAL_MAX_MEDIATORS 16
+#define PATHLOSS_CAL_MIN_SAMPLES 20     /* Observations before a mediator's fit is used */
+#define PATHLOSS_MIN_EXPONENT 1.5f
+#define PATHLOSS_MAX_EXPONENT 5.0f
+
+typedef struct {
+    float offset_db;        /* Level at 1 m */
+    float exponent;
+} pathloss_model_t;
+
+/* The mediators' own conversion */
+#define PATHLOSS_MODEL_FREE_SPACE {0.0f, 2.0f}
+
+typedef struct {
+    /* Weighted sums of 1, x, y, x^2, x y, y^2 with x = 10 log10(d), y the level */
+    float s0, sx, sy, sxx, sxy, syy;
+    uint32_t samples;
+    pathloss_model_t model;
+    float rms_db;           /* Residual of the fit */
+} pathloss_cal_mediator_t;
+
+typedef struct {
+    float forgetting;       /* Weight kept by past observations at each new one, below 1 */
+    float prior_weight;     /* Weight of the exponent prior, in observations */
+    pathloss_cal_mediator_t mediator[PATHLOSS_CAL_MAX_MEDIATORS];
+} pathloss_cal_t;
+
+/** Clear every fit
+ *
+ * @param[in] forgetting 0.999 keeps about the last 1000 observations of each mediator.
+ * @param[in] prior_weight 5 lets a spread of reference distances move the exponent quickly.
+ */
+void pathloss_cal_init(pathloss_cal_t *cal, float forgetting, float prior_weight);
+
+/** Add an observation of a reference beacon and refit the mediator
+ *
+ * @param[in] mediator Mediator slot.
+ * @param[in] distance True distance from the mediator to the beacon, metres.
+ * @param[in] level_db tx_power - rssi of the observation.
+ */
+void pathloss_cal_observe(pathloss_cal_t *cal, uint8_t mediator, float distance, float level_db);
+
+/** Model of a mediator
+ *
+ * @return fitted model, free space until PATHLOSS_CAL_MIN_SAMPLES observations are in.
+ */
+pathloss_model_t pathloss_cal_model(const pathloss_cal_t *cal, uint8_t mediator);
+
+/** Distance in metres of a level under a model */
+float pathloss_model_distance(const pathloss_model_t *model, float level_db);
+
+/** tx_power - rssi recovered from a distance the mediator computed, metres */
+float pathloss_level_from_distance(float distance);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,139 @@
+#include <string.h>
+
+#include "presence.h"
+
+void presence_init(presence_t *presence, const presence_config_t *config)
+{
+    memset(presence, 0, sizeof(*presence));
+    presence->config = *config;
+}
+
+static int find(const presence_t *presence, uint32_t beacon)
+{
+    for (int i = 0; i < presence->count; i++) {
+        if (presence->beacon_id[i] == beacon) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int slot_for(presence_t *presence, uint32_t beacon)
+{
+    int slot = find(presence, beacon);
+    if (slot >= 0) {
+        return slot;
+    }
+    if (presence->count < PRESENCE_MAX_BEACONS) {
+        slot = presence->count++;
+    } else {
+        slot = 0;
+        for (int i = 1; i < presence->count; i++) {
+            if ((int32_t)(presence->last_ms[i] - presence->last_ms[slot]) < 0) {
+                slot = i;
+            }
+        }
+        presence->stats.evicted++;
+    }
+    presence->beacon_id[slot] = beacon;
+    memset(&presence->beacon[slot], 0, sizeof(presence->beacon[slot]));
+    presence->beacon[slot].room = PRESENCE_NOWHERE;
+    presence->beacon[slot].challenger = PRESENCE_NOWHERE;
+    return slot;
+}
+
+static int strongest(const presence_beacon_t *b)
+{
+    int best = PRESENCE_NOWHERE;
+    for (int m = 0; m < PRESENCE_MAX_MEDIATORS; m++) {
+        if ((b->heard & (1u << m)) && (best < 0 || b->level[m] > b->level[best])) {
+            best = m;
+        }
+    }
+    return best;
+}
+
+static int move(presence_beacon_t *b, uint32_t beacon, int to, uint32_t time_ms, presence_event_t *event)
+{
+    event->beacon = beacon;
+    event->from = b->room;
+    event->to = (int8_t)to;
+    event->time_ms = time_ms;
+    b->room = (int8_t)to;
+    b->challenger = PRESENCE_NOWHERE;
+    return 1;
+}
+
+int presence_observe(presence_t *presence, uint32_t beacon, uint8_t mediator, float level_db, uint32_t time_ms,
+                     presence_event_t *event)
+{
+    if (mediator >= PRESENCE_MAX_MEDIATORS) {
+        return 0;
+    }
+    const presence_config_t *config = &presence->config;
+    int slot = slot_for(presence, beacon);
+    presence_beacon_t *b = &presence->beacon[slot];
+    presence->last_ms[slot] = time_ms;
+    presence->stats.observations++;
+
+    if (b->heard & (1u << mediator)) {
+        b->level[mediator] += config->smoothing * (level_db - b->level[mediator]);
+        /* Backlog from a mediator that was offline arrives late, it does not make it heard now */
+        if ((int32_t)(time_ms - b->heard_ms[mediator]) > 0) {
+            b->heard_ms[mediator] = time_ms;
+        }
+    } else {
+        b->level[mediator] = level_db;
+        b->heard |= 1u << mediator;
+        b->heard_ms[mediator] = time_ms;
+    }
+
+    int best = strongest(b);
+    if (b->room == PRESENCE_NOWHERE) {
+        presence->stats.transitions++;
+        return move(b, beacon, best, time_ms, event);
+    }
+    /* A room that dropped out has no level left to beat */
+    int room_heard = (b->heard >> b->room) & 1;
+    if (best == b->room || (room_heard && b->level[best] < b->level[b->room] + config->hysteresis_db)) {
+        if (b->challenger != PRESENCE_NOWHERE) {
+            presence->stats.held++;
+            b->challenger = PRESENCE_NOWHERE;
+        }
+        return 0;
+    }
+    if (b->challenger != best) {
+        b->challenger = (int8_t)best;
+        b->challenger_ms = time_ms;
+    }
+    if ((int32_t)(time_ms - b->challenger_ms) < (int32_t)config->dwell_ms) {
+        return 0;
+    }
+    presence->stats.transitions++;
+    return move(b, beacon, best, time_ms, event);
+}
+
+int presence_expire(presence_t *presence, uint32_t now_ms, presence_event_t events[], int max)
+{
+    int count = 0;
+    for (int i = 0; i < presence->count; i++) {
+        presence_beacon_t *b = &presence->beacon[i];
+        for (int m = 0; m < PRESENCE_MAX_MEDIATORS; m++) {
+            int32_t silent_ms = (int32_t)(now_ms - b->heard_ms[m]);
+            if ((b->heard & (1u << m)) && silent_ms > (int32_t)presence->config.timeout_ms) {
+                b->heard &= ~(1u << m);
+            }
+        }
+        if (b->heard == 0 && b->room != PRESENCE_NOWHERE && count < max) {
+            presence->stats.transitions++;
+            count += move(b, presence->beacon_id[i], PRESENCE_NOWHERE, now_ms, &events[count]);
+        }
+    }
+    return count;
+}
+
+int presence_room(const presence_t *presence, uint32_t beacon)
+{
+    int slot = find(presence, beacon);
+    return slot < 0 ? PRESENCE_NOWHERE : presence->beacon[slot].room;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Room level presence: which mediator each beacon is closest to.
+ *
+ * Each beacon keeps an exponentially filtered signal level per mediator and is assigned to the
+ * strongest one. Where mediators stand one per room or zone, that is the room the beacon is in,
+ * from a single mediator and without solving anything.
+ *
+ * Assignments do not flap between two mediators of about the same level: a challenger has to
+ * beat the current mediator by the hysteresis margin, and keep beating it for the dwell time,
+ * before the beacon moves. A mediator not heard for the timeout drops out; once none is left
+ * the beacon is nowhere. Only these transitions are reported as events.
+ *
+ * Mediators are the slots of obs_store.h. Not thread safe.
+ */
+
+#ifndef PRESENCE_MAX_BEACONS
+#define PRESENCE_MAX_BEACONS 64
+#endif
+#define PRESENCE_MAX_MEDIATORS 16
+#define PRESENCE_NOWHERE (-1)
+
+typedef struct {
+    float hysteresis_db;        /* Margin a challenger must beat the current mediator by */
+    uint32_t dwell_ms;          /* Time the challenger must hold that margin */
+    uint32_t timeout_ms;        /* A mediator not heard for this long drops out */
+    float smoothing;            /* Weight of a new sample in the filtered level, 0 to 1 */
+} presence_config_t;
+
+#define PRESENCE_CONFIG_DEFAULT() {     \
+    .hysteresis_db = 4.0f,              \
+    .dwell_ms = 1000,                   \
+    .timeout_ms = 10000,                \
+    .smoothing = 0.5f,                  \
+}
+
+typedef struct {
+    float level[PRESENCE_MAX_MEDIATORS];        /* Filtered level, dB, larger is closer */
+    uint32_t heard_ms[PRESENCE_MAX_MEDIATORS];
+    uint16_t heard;             /* Mediators heard within the timeout */
+    int8_t room;                /* Assigned mediator or PRESENCE_NOWHERE */
+    int8_t challenger;          /* Mediator holding the margin over room, or PRESENCE_NOWHERE */
+    uint32_t challenger_ms;     /* Since when */
+} presence_beacon_t;
+
+typedef struct {
+    uint32_t beacon;
+    int8_t from;                /* Mediator or PRESENCE_NOWHERE */
+    int8_t to;
+    uint32_t time_ms;
+} presence_event_t;
+
+typedef struct {
+    uint32_t observations;
+    uint32_t transitions;
+    uint32_t held;              /* Challengers that lost the margin before the dwell time was up */
+    uint32_t evicted;
+} presence_stats_t;
+
+typedef struct {
+    presence_config_t config;
+    uint32_t beacon_id[PRESENCE_MAX_BEACONS];
+    uint32_t last_ms[PRESENCE_MAX_BEACONS];
+    presence_beacon_t beacon[PRESENCE_MAX_BEACONS];
+    uint16_t count;
+    presence_stats_t stats;
+} presence_t;
+
+void presence_init(presence_t *presence, const presence_config_t *config);
+
+/** Feed one observation of a beacon
+ *
+ * A beacon seen for the first time goes straight to the mediator that heard it. When the table
+ * is full, the beacon heard least recently is dropped without an event.
+ *
+ * @param[in] mediator Mediator slot, below PRESENCE_MAX_MEDIATORS.
+ * @param[in] level_db Signal level, any offset common to all mediators.
+ * @param[out] event Transition caused by the observation.
+ *
+ * @return 1 if the beacon changed mediator and `event` is set, 0 otherwise.
+ */
+int presence_observe(presence_t *presence, uint32_t beacon, uint8_t mediator, float level_db, uint32_t time_ms,
+                     presence_event_t *event);
+
+/** Drop mediators not heard within the timeout
+ *
+ * Beacons left with no mediator go nowhere; beacons whose mediator dropped out move to the
+ * strongest remaining one once the dwell time is up, at their next observation.
+ *
+ * @param[out] events Room for `max` events.
+ *
+ * @return number of events stored.
+ */
+int presence_expire(presence_t *presence, uint32_t now_ms, presence_event_t events[], int max);
+
+/** Mediator a beacon is assigned to
+ *
+ * @return mediator slot, PRESENCE_NOWHERE if the beacon is unknown or not heard.
+ */
+int presence_room(const presence_t *presence, uint32_t beacon);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,174 @@
+#include <math.h>
+#include <string.h>
+
+#include "radio_map.h"
+
+/* Visiting a range pushes its two halves, so the stack never holds more than the depth of the
+ * tree plus one entries, 17 for a balanced tree of 65535 points */
+#define STACK_SIZE 24
+
+/* Ranges this small are compared point by point, cheaper than splitting them further */
+#define LEAF_SIZE 8
+
+/* Range still to visit. offset holds, per dimension, how far the query lies outside the
+ * range's bounding box, and bound2 their sum of squares: a lower bound on the squared distance
+ * from the query to any point of the range. */
+typedef struct {
+    uint16_t lo;
+    uint16_t hi;
+    uint32_t bound2;
+    uint8_t offset[RADIO_MAP_MAX_MEDIATORS];
+} pending_t;
+
+static size_t align4(size_t offset)
+{
+    return (offset + 3) & ~(size_t)3;
+}
+
+int radio_map_open(radio_map_t *map, const void *image, size_t size)
+{
+    memset(map, 0, sizeof(*map));
+    const radio_map_header_t *header = (const radio_map_header_t *)image;
+    if (size < sizeof(*header) || memcmp(header->magic, RADIO_MAP_MAGIC, 4) != 0 ||
+        header->version != RADIO_MAP_VERSION || header->mediators == 0 ||
+        header->mediators > RADIO_MAP_MAX_MEDIATORS) {
+        return -1;
+    }
+    size_t points = header->points;
+    size_t offset = sizeof(*header);
+    size_t ids = offset;
+    offset = align4(offset + header->mediators * sizeof(uint16_t));
+    size_t x = offset;
+    offset = align4(offset + points * sizeof(int16_t));
+    size_t y = offset;
+    offset = align4(offset + points * sizeof(int16_t));
+    size_t split = offset;
+    offset = align4(offset + points);
+    size_t rssi = offset;
+    offset += points * header->mediators;
+    if (offset > size) {
+        return -1;
+    }
+
+    const uint8_t *base = (const uint8_t *)image;
+    map->header = header;
+    map->mediator_id = (const uint16_t *)(base + ids);
+    map->x_dm = (const int16_t *)(base + x);
+    map->y_dm = (const int16_t *)(base + y);
+    map->split = base + split;
+    map->rssi = (const int8_t *)(base + rssi);
+    return 0;
+}
+
+int radio_map_mediator_index(const radio_map_t *map, uint16_t mediator)
+{
+    for (int i = 0; i < map->header->mediators; i++) {
+        if (map->mediator_id[i] == mediator) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static uint32_t distance2(const int8_t *a, const int8_t *b, int dims)
+{
+    uint32_t sum = 0;
+    for (int d = 0; d < dims; d++) {
+        int32_t e = (int32_t)a[d] - b[d];
+        sum += (uint32_t)(e * e);
+    }
+    return sum;
+}
+
+/* Insertion into the k best, kept sorted nearest first */
+static int offer(radio_map_match_t best[], int found, int k, uint16_t point, uint32_t d2)
+{
+    if (found == k && d2 >= best[k - 1].distance2) {
+        return found;
+    }
+    int i = found < k ? found++ : k - 1;
+    while (i > 0 && best[i - 1].distance2 > d2) {
+        best[i] = best[i - 1];
+        i--;
+    }
+    best[i].point = point;
+    best[i].distance2 = d2;
+    return found;
+}
+
+int radio_map_knn(radio_map_t *map, const int8_t rssi[], int k, radio_map_match_t out[])
+{
+    int dims = map->header->mediators;
+    int points = map->header->points;
+    k = k < 1 ? 1 : k > RADIO_MAP_MAX_K ? RADIO_MAP_MAX_K : k;
+    map->visited = 0;
+
+    pending_t stack[STACK_SIZE];
+    int depth = 1;
+    int found = 0;
+    memset(&stack[0], 0, sizeof(stack[0]));
+    stack[0].hi = (uint16_t)points;
+
+    while (depth > 0) {
+        pending_t *range = &stack[--depth];
+        int lo = range->lo;
+        int hi = range->hi;
+        if (lo >= hi || (found == k && range->bound2 >= out[k - 1].distance2)) {
+            continue;
+        }
+        if (hi - lo <= LEAF_SIZE) {
+            for (int i = lo; i < hi; i++) {
+                found = offer(out, found, k, (uint16_t)i, distance2(rssi, map->rssi + (size_t)i * dims, dims));
+            }
+            map->visited += hi - lo;
+            continue;
+        }
+        int mid = (lo + hi) / 2;
+        const int8_t *point = map->rssi + (size_t)mid * dims;
+        found = offer(out, found, k, (uint16_t)mid, distance2(rssi, point, dims));
+        map->visited++;
+
+        /* Points across the split are at least |diff| away on its axis, and no closer than the
+         * query already was to the whole range. The near side keeps the range's bound and is
+         * pushed last so it is popped first. The far side reuses the popped entry in place. */
+        int axis = map->split[mid];
+        int32_t diff = (int32_t)rssi[axis] - point[axis];
+        uint32_t distance = (uint32_t)(diff < 0 ? -diff : diff);
+        pending_t *far = range;
+        pending_t *near = &stack[depth + 1];
+        *near = *far;
+        if (distance > far->offset[axis]) {
+            far->bound2 += distance * distance - (uint32_t)far->offset[axis] * far->offset[axis];
+            far->offset[axis] = (uint8_t)distance;
+        }
+        if (diff < 0) {
+            far->lo = (uint16_t)(mid + 1);
+            near->hi = (uint16_t)mid;
+        } else {
+            far->hi = (uint16_t)mid;
+            near->lo = (uint16_t)(mid + 1);
+        }
+        depth += 2;
+    }
+    return found;
+}
+
+int radio_map_locate(radio_map_t *map, const int8_t rssi[], int k, float pos[2])
+{
+    radio_map_match_t best[RADIO_MAP_MAX_K];
+    int found = radio_map_knn(map, rssi, k, best);
+    if (found == 0) {
+        return -1;
+    }
+    float x = 0, y = 0, total = 0;
+    for (int i = 0; i < found; i++) {
+        /* +1 dB keeps an exact match finite */
+        float w = 1.0f / (sqrtf((float)best[i].distance2) + 1.0f);
+        x += w * map->x_dm[best[i].point];
+        y += w * map->y_dm[best[i].point];
+        total += w;
+    }
+    pos[0] = x / total * 0.1f;
+    pos[1] = y / total * 0.1f;
+    return 0;
+}
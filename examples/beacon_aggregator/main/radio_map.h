@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* RSSI fingerprint map with a k-d tree index.
+ *
+ * The map is a read-only image built on a host by tools/radio_map.py from a survey: at each
+ * surveyed point, the RSSI heard by every mediator. The image is used in place, from a flash
+ * partition mapped into memory, and holds the points as structure of arrays in the order of an
+ * implicit k-d tree: the point in the middle of a range splits it, on the dimension stored with
+ * it, into the points before and after. No pointers, so nothing is unpacked at boot.
+ *
+ * A query is the vector of RSSIs of the mediators of the map, missing ones at the map's floor
+ * value, and the k nearest fingerprints are found in integer arithmetic.
+ *
+ * Image layout, little endian, every array starting on a 4 byte boundary:
+ *     header              radio_map_header_t
+ *     mediator ids        uint16_t[mediators]
+ *     x, y                int16_t[points] each, decimetres
+ *     split dimension     uint8_t[points]
+ *     RSSI                int8_t[points][mediators], dBm
+ */
+
+#define RADIO_MAP_MAGIC "RMAP"
+#define RADIO_MAP_VERSION 1
+#define RADIO_MAP_MAX_MEDIATORS 16
+#define RADIO_MAP_MAX_K 8
+
+typedef struct {
+    char magic[4];
+    uint8_t version;
+    uint8_t mediators;
+    int8_t floor_dbm;       /* RSSI of a mediator that did not hear the point */
+    uint8_t reserved;
+    uint16_t points;
+    uint16_t reserved2;
+} radio_map_header_t;
+
+typedef struct {
+    const radio_map_header_t *header;
+    const uint16_t *mediator_id;
+    const int16_t *x_dm;
+    const int16_t *y_dm;
+    const uint8_t *split;
+    const int8_t *rssi;
+    uint32_t visited;       /* Points compared by the last query */
+} radio_map_t;
+
+typedef struct {
+    uint16_t point;
+    uint32_t distance2;     /* Squared RSSI distance, dBm^2 */
+} radio_map_match_t;
+
+/** Use a map image in place
+ *
+ * @return 0 on success.
+ * @return -1 if the image is truncated or not a radio map of this version.
+ */
+int radio_map_open(radio_map_t *map, const void *image, size_t size);
+
+/** Index of a mediator in the query vector
+ *
+ * @return index, -1 if the mediator is not in the map.
+ */
+int radio_map_mediator_index(const radio_map_t *map, uint16_t mediator);
+
+/** The k fingerprints nearest to a query
+ *
+ * @param[in] rssi RSSI per mediator of the map, floor_dbm where not heard.
+ * @param[in] k 1 to RADIO_MAP_MAX_K.
+ * @param[out] out Matches, nearest first.
+ *
+ * @return number of matches, min(k, points).
+ */
+int radio_map_knn(radio_map_t *map, const int8_t rssi[], int k, radio_map_match_t out[]);
+
+/** Position estimate from the k nearest fingerprints, weighted by inverse RSSI distance
+ *
+ * @param[out] pos x and y, metres.
+ *
+ * @return 0 on success.
+ * @return -1 if the map is empty.
+ */
+int radio_map_locate(radio_map_t *map, const int8_t rssi[], int k, float pos[2]);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,131 @@
+#include <esp_log.h>
+#include <esp_partition.h>
+#include <hal/cpu_hal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_matter_console.h>
+
+#include <radio_map_flash.h>
+
+static const char *TAG = "radio_map";
+
+#define BENCH_K 4
+
+static radio_map_t s_map;
+static bool s_mapped;
+static spi_flash_mmap_handle_t s_mmap_handle;
+
+radio_map_t *radio_map_flash_get()
+{
+    if (s_mapped) {
+        return &s_map;
+    }
+    const esp_partition_t *partition =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "radiomap");
+    if (!partition) {
+        ESP_LOGW(TAG, "No radiomap partition");
+        return NULL;
+    }
+    const void *image;
+    esp_err_t err = esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &image, &s_mmap_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to map the radiomap partition: %d", err);
+        return NULL;
+    }
+    if (radio_map_open(&s_map, image, partition->size) != 0) {
+        ESP_LOGW(TAG, "No valid radio map in the radiomap partition");
+        spi_flash_munmap(s_mmap_handle);
+        return NULL;
+    }
+    s_mapped = true;
+    ESP_LOGI(TAG, "Radio map: %u points, %u mediators", s_map.header->points, s_map.header->mediators);
+    return &s_map;
+}
+
+/* Reference for the bench: compares the query with every point */
+static uint32_t nearest_linear(const radio_map_t *map, const int8_t rssi[])
+{
+    int dims = map->header->mediators;
+    uint32_t best = UINT32_MAX;
+    for (int i = 0; i < map->header->points; i++) {
+        const int8_t *point = map->rssi + (size_t)i * dims;
+        uint32_t sum = 0;
+        for (int d = 0; d < dims; d++) {
+            int32_t e = (int32_t)rssi[d] - point[d];
+            sum += (uint32_t)(e * e);
+        }
+        best = sum < best ? sum : best;
+    }
+    return best;
+}
+
+/* Queries are fingerprints of the map with a few dB of noise, as a beacon near a surveyed point */
+static void bench(radio_map_t *map, uint32_t queries)
+{
+    int dims = map->header->mediators;
+    int8_t rssi[RADIO_MAP_MAX_MEDIATORS];
+    radio_map_match_t best[BENCH_K];
+    uint32_t tree_cycles = 0, linear_cycles = 0, mismatches = 0;
+    uint64_t visited = 0;
+
+    srand(1);
+    for (uint32_t q = 0; q < queries; q++) {
+        const int8_t *point = map->rssi + (size_t)(rand() % map->header->points) * dims;
+        for (int d = 0; d < dims; d++) {
+            int v = point[d] + rand() % 9 - 4;
+            rssi[d] = (int8_t)(v < map->header->floor_dbm ? map->header->floor_dbm : v);
+        }
+        uint32_t started = cpu_hal_get_cycle_count();
+        radio_map_knn(map, rssi, BENCH_K, best);
+        tree_cycles += cpu_hal_get_cycle_count() - started;
+        visited += map->visited;
+
+        started = cpu_hal_get_cycle_count();
+        uint32_t nearest = nearest_linear(map, rssi);
+        linear_cycles += cpu_hal_get_cycle_count() - started;
+        mismatches += nearest != best[0].distance2;
+    }
+    printf("k-d tree (k=%d): %8u cycles/query  %u points visited\n", BENCH_K, tree_cycles / queries,
+           (uint32_t)(visited / queries));
+    printf("linear scan:     %8u cycles/query  %u points visited\n", linear_cycles / queries, map->header->points);
+    if (mismatches) {
+        ESP_LOGE(TAG, "%u queries disagree with the linear scan", mismatches);
+    }
+}
+
+static esp_err_t radio_map_console_handler(int argc, char **argv)
+{
+    if (argc < 1 || (strcmp(argv[0], "info") != 0 && strcmp(argv[0], "bench") != 0)) {
+        printf("Usage: matter esp radiomap info|bench [queries]\n");
+        return ESP_ERR_INVALID_ARG;
+    }
+    radio_map_t *map = radio_map_flash_get();
+    if (!map) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (strcmp(argv[0], "info") == 0) {
+        printf("%u points, %u mediators, floor %d dBm\n", map->header->points, map->header->mediators,
+               map->header->floor_dbm);
+        for (int i = 0; i < map->header->mediators; i++) {
+            printf("  mediator %u\n", map->mediator_id[i]);
+        }
+        return ESP_OK;
+    }
+    uint32_t queries = argc >= 2 ? strtoul(argv[1], NULL, 0) : 1000;
+    if (queries == 0 || map->header->points == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    bench(map, queries);
+    return ESP_OK;
+}
+
+esp_err_t radio_map_register_commands()
+{
+    static const esp_matter::console::command_t command = {
+        .name = "radiomap",
+        .description = "RSSI fingerprint map. Usage: matter esp radiomap info|bench [queries]",
+        .handler = radio_map_console_handler,
+    };
+    return esp_matter::console::add_commands(&command, 1);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <esp_err.h>
+
+#include <radio_map.h>
+
+/** Map the fingerprint map in the `radiomap` partition
+ *
+ * The partition is memory mapped once and the map used in place, see radio_map.h. Later calls
+ * return the same map.
+ *
+ * @return the map, NULL if there is no partition or it does not hold a valid image.
+ */
+radio_map_t *radio_map_flash_get();
+
+/** Register the `radiomap` console command
+ *
+ * `matter esp radiomap info` describes the map in flash, `matter esp radiomap bench [queries]`
+ * times k nearest neighbour queries on it against a linear scan.
+ */
+esp_err_t radio_map_register_commands();
@@ -0,0 +1,109 @@
+#include <math.h>
+#include <string.h>
+
+#include "range_model.h"
+
+void range_model_log_distance(range_model_t *model, float offset_db, float exponent)
+{
+    memset(model, 0, sizeof(*model));
+    model->kind = RANGE_MODEL_LOG_DISTANCE;
+    model->offset_db = offset_db;
+    model->exponent = exponent;
+}
+
+void range_model_two_slope(range_model_t *model, float offset_db, float exponent, float breakpoint_m,
+                           float exponent_far)
+{
+    memset(model, 0, sizeof(*model));
+    model->kind = RANGE_MODEL_TWO_SLOPE;
+    model->offset_db = offset_db;
+    model->exponent = exponent;
+    model->breakpoint_m = breakpoint_m;
+    model->exponent_far = exponent_far;
+}
+
+int range_model_lut(range_model_t *model, const float level_db[], const float distance_m[], int count)
+{
+    if (count < 2 || count > RANGE_MODEL_LUT_POINTS) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!(distance_m[i] > 0) || (i > 0 && !(level_db[i] > level_db[i - 1]))) {
+            return -1;
+        }
+    }
+    memset(model, 0, sizeof(*model));
+    model->kind = RANGE_MODEL_LUT;
+    model->lut_count = (uint8_t)count;
+    memcpy(model->lut_level_db, level_db, count * sizeof(float));
+    memcpy(model->lut_distance_m, distance_m, count * sizeof(float));
+    return 0;
+}
+
+static float lut_distance(const range_model_t *model, float level_db)
+{
+    /* Segment holding the level, or the end segment to extrapolate along */
+    int i = 1;
+    while (i < model->lut_count - 1 && level_db > model->lut_level_db[i]) {
+        i++;
+    }
+    float l0 = model->lut_level_db[i - 1];
+    float l1 = model->lut_level_db[i];
+    float d0 = log10f(model->lut_distance_m[i - 1]);
+    float d1 = log10f(model->lut_distance_m[i]);
+    return powf(10.0f, d0 + (level_db - l0) * (d1 - d0) / (l1 - l0));
+}
+
+float range_model_distance(const range_model_t *model, float level_db)
+{
+    switch (model->kind) {
+    case RANGE_MODEL_TWO_SLOPE: {
+        float level_bp = model->offset_db + 10.0f * model->exponent * log10f(model->breakpoint_m);
+        if (level_db > level_bp) {
+            return model->breakpoint_m * powf(10.0f, (level_db - level_bp) / (10.0f * model->exponent_far));
+        }
+        return powf(10.0f, (level_db - model->offset_db) / (10.0f * model->exponent));
+    }
+    case RANGE_MODEL_LUT:
+        return lut_distance(model, level_db);
+    default:
+        return powf(10.0f, (level_db - model->offset_db) / (10.0f * model->exponent));
+    }
+}
+
+const range_model_t *range_model_table_find(const range_model_table_t *table, uint16_t mediator)
+{
+    for (int i = 0; i < table->count; i++) {
+        if (table->mediator[i] == mediator) {
+            return &table->model[i];
+        }
+    }
+    return NULL;
+}
+
+int range_model_table_set(range_model_table_t *table, uint16_t mediator, const range_model_t *model)
+{
+    range_model_t *entry = (range_model_t *)range_model_table_find(table, mediator);
+    if (!entry) {
+        if (table->count == RANGE_MODEL_TABLE_SIZE) {
+            return -1;
+        }
+        table->mediator[table->count] = mediator;
+        entry = &table->model[table->count++];
+    }
+    *entry = *model;
+    return 0;
+}
+
+int range_model_table_remove(range_model_table_t *table, uint16_t mediator)
+{
+    for (int i = 0; i < table->count; i++) {
+        if (table->mediator[i] == mediator) {
+            table->count--;
+            table->mediator[i] = table->mediator[table->count];
+            table->model[i] = table->model[table->count];
+            return 0;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Models turning a received level into a distance, and a table of them per mediator.
+ *
+ * The level is tx_power - rssi in dB: how far below the beacon's measured power at 1 m the
+ * mediator heard it. Three models are supported:
+ *
+ *  - log distance: level = offset + 10 n log10(d)
+ *  - two slope: log distance with exponent n up to a breakpoint distance, n_far beyond it,
+ *    for halls where the first Fresnel zone clears the floor only close to the mediator
+ *  - lookup table: up to RANGE_MODEL_LUT_POINTS (level, distance) points measured on site,
+ *    interpolated linearly in level and log distance, extrapolated along the end segments
+ *
+ * The table is plain data, so it can be stored and loaded as a blob.
+ */
+
+#define RANGE_MODEL_LUT_POINTS 8
+#define RANGE_MODEL_TABLE_SIZE 16
+
+typedef enum {
+    RANGE_MODEL_LOG_DISTANCE = 0,
+    RANGE_MODEL_TWO_SLOPE = 1,
+    RANGE_MODEL_LUT = 2,
+} range_model_kind_t;
+
+typedef struct {
+    uint8_t kind;                   /* range_model_kind_t */
+    uint8_t lut_count;
+    uint8_t reserved[2];
+    float offset_db;                /* Log distance and two slope: level at 1 m */
+    float exponent;
+    float breakpoint_m;             /* Two slope only */
+    float exponent_far;
+    float lut_level_db[RANGE_MODEL_LUT_POINTS];     /* Ascending */
+    float lut_distance_m[RANGE_MODEL_LUT_POINTS];
+} range_model_t;
+
+typedef struct {
+    uint16_t mediator[RANGE_MODEL_TABLE_SIZE];
+    range_model_t model[RANGE_MODEL_TABLE_SIZE];
+    uint8_t count;
+} range_model_table_t;
+
+void range_model_log_distance(range_model_t *model, float offset_db, float exponent);
+
+void range_model_two_slope(range_model_t *model, float offset_db, float exponent, float breakpoint_m,
+                           float exponent_far);
+
+/** Lookup table model
+ *
+ * @param[in] level_db, distance_m Points in ascending level order, 2 to RANGE_MODEL_LUT_POINTS.
+ *
+ * @return 0 on success.
+ * @return -1 if there are too few or too many points, levels are not ascending or a distance
+ *         is not positive.
+ */
+int range_model_lut(range_model_t *model, const float level_db[], const float distance_m[], int count);
+
+/** Distance in metres of a level */
+float range_model_distance(const range_model_t *model, float level_db);
+
+/** Model of a mediator
+ *
+ * @return model, NULL if the mediator has no entry.
+ */
+const range_model_t *range_model_table_find(const range_model_table_t *table, uint16_t mediator);
+
+/** Set or replace the model of a mediator
+ *
+ * @return 0 on success, -1 if the table is full.
+ */
+int range_model_table_set(range_model_table_t *table, uint16_t mediator, const range_model_t *model);
+
+/** Drop the entry of a mediator
+ *
+ * @return 0 on success, -1 if the mediator has no entry.
+ */
+int range_model_table_remove(range_model_table_t *table, uint16_t mediator);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,179 @@
+#include <esp_log.h>
+#include <nvs.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_matter.h>
+#include <esp_matter_console.h>
+
+#include <calib.h>
+#include <pathloss_cal.h>
+#include <range_model.h>
+#include <range_models.h>
+
+static const char *TAG = "range_models";
+
+#define NVS_NAMESPACE "range_models"
+#define NVS_KEY_TABLE "table"
+
+static range_model_table_t s_table;
+
+esp_err_t range_models_init()
+{
+    size_t size = sizeof(s_table);
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err == ESP_OK) {
+        err = nvs_get_blob(handle, NVS_KEY_TABLE, &s_table, &size);
+        nvs_close(handle);
+    }
+    if (err == ESP_OK && (size != sizeof(s_table) || s_table.count > RANGE_MODEL_TABLE_SIZE)) {
+        ESP_LOGW(TAG, "Stored models do not match this firmware, ignored");
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    if (err != ESP_OK) {
+        memset(&s_table, 0, sizeof(s_table));
+        return err == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : err;
+    }
+    ESP_LOGI(TAG, "%u mediator models loaded", s_table.count);
+    return ESP_OK;
+}
+
+static esp_err_t persist(const range_model_table_t *table)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(handle, NVS_KEY_TABLE, table, sizeof(*table));
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+uint16_t range_models_distance(uint8_t slot, uint16_t mediator, uint32_t beacon, float level_db)
+{
+    calib_observe(slot, mediator, beacon, level_db);
+    float distance;
+    const range_model_t *model = range_model_table_find(&s_table, mediator);
+    if (model) {
+        distance = range_model_distance(model, level_db);
+    } else {
+        pathloss_model_t pathloss = PATHLOSS_MODEL_FREE_SPACE;
+        calib_model(slot, &pathloss);
+        distance = pathloss_model_distance(&pathloss, level_db);
+    }
+    float cm = distance * 100.0f + 0.5f;
+    return cm < 65535.0f ? static_cast<uint16_t>(cm) : 65535;
+}
+
+/*------------------------------ Console ------------------------------*/
+
+static void print_model(uint16_t mediator, const range_model_t *model)
+{
+    switch (model->kind) {
+    case RANGE_MODEL_TWO_SLOPE:
+        printf("  0x%04x  two slope     offset %.1f dB, n %.2f up to %.1f m, %.2f beyond\n", mediator,
+               model->offset_db, model->exponent, model->breakpoint_m, model->exponent_far);
+        break;
+    case RANGE_MODEL_LUT:
+        printf("  0x%04x  lookup table ", mediator);
+        for (int i = 0; i < model->lut_count; i++) {
+            printf(" %.1f:%.2f", model->lut_level_db[i], model->lut_distance_m[i]);
+        }
+        printf("\n");
+        break;
+    default:
+        printf("  0x%04x  log distance  offset %.1f dB, n %.2f\n", mediator, model->offset_db, model->exponent);
+        break;
+    }
+}
+
+/* Model from the arguments after the mediator ID */
+static esp_err_t parse_model(int argc, char **argv, range_model_t *model)
+{
+    if (argc == 3 && strcmp(argv[0], "log") == 0) {
+        range_model_log_distance(model, strtof(argv[1], NULL), strtof(argv[2], NULL));
+        return model->exponent > 0 ? ESP_OK : ESP_ERR_INVALID_ARG;
+    }
+    if (argc == 5 && strcmp(argv[0], "two") == 0) {
+        range_model_two_slope(model, strtof(argv[1], NULL), strtof(argv[2], NULL), strtof(argv[3], NULL),
+                              strtof(argv[4], NULL));
+        return model->exponent > 0 && model->breakpoint_m > 0 && model->exponent_far > 0 ? ESP_OK
+                                                                                          : ESP_ERR_INVALID_ARG;
+    }
+    if (argc >= 2 && strcmp(argv[0], "lut") == 0) {
+        float level_db[RANGE_MODEL_LUT_POINTS];
+        float distance_m[RANGE_MODEL_LUT_POINTS];
+        int count = argc - 1;
+        if (count > RANGE_MODEL_LUT_POINTS) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        for (int i = 0; i < count; i++) {
+            char *end;
+            level_db[i] = strtof(argv[i + 1], &end);
+            if (*end != ':') {
+                return ESP_ERR_INVALID_ARG;
+            }
+            distance_m[i] = strtof(end + 1, NULL);
+        }
+        return range_model_lut(model, level_db, distance_m, count) == 0 ? ESP_OK : ESP_ERR_INVALID_ARG;
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t range_models_console_handler(int argc, char **argv)
+{
+    if (argc == 0) {
+        printf("%u mediator models, others use their calibration or free space\n", s_table.count);
+        for (int i = 0; i < s_table.count; i++) {
+            print_model(s_table.mediator[i], &s_table.model[i]);
+        }
+        return ESP_OK;
+    }
+    if (argc >= 2) {
+        uint16_t mediator = static_cast<uint16_t>(strtoul(argv[0], NULL, 0));
+        range_model_t model;
+        bool clear = argc == 2 && strcmp(argv[1], "clear") == 0;
+        if (clear || parse_model(argc - 1, argv + 1, &model) == ESP_OK) {
+            range_model_table_t table;
+            chip::DeviceLayer::PlatformMgr().LockChipStack();
+            int ret = clear ? range_model_table_remove(&s_table, mediator)
+                            : range_model_table_set(&s_table, mediator, &model);
+            table = s_table;
+            chip::DeviceLayer::PlatformMgr().UnlockChipStack();
+            if (ret != 0) {
+                if (clear) {
+                    ESP_LOGE(TAG, "No model for mediator 0x%04x", mediator);
+                } else {
+                    ESP_LOGE(TAG, "No room for a model of mediator 0x%04x", mediator);
+                }
+                return ESP_ERR_NOT_FOUND;
+            }
+            esp_err_t err = persist(&table);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to store models: %s", esp_err_to_name(err));
+            }
+            return err;
+        }
+    }
+    printf("Usage: matter esp rangemodel [<mediator> log <offset> <n> | <mediator> two <offset> <n> <breakpoint> "
+           "<n_far> | <mediator> lut <level>:<distance> ... | <mediator> clear]\n");
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t range_models_register_commands()
+{
+    static const esp_matter::console::command_t command = {
+        .name = "rangemodel",
+        .description = "Range model of each mediator. "
+                       "Usage: matter esp rangemodel [<mediator> log <offset> <n> | "
+                       "<mediator> two <offset> <n> <breakpoint> <n_far> | "
+                       "<mediator> lut <level>:<distance> ... | <mediator> clear]",
+        .handler = range_models_console_handler,
+    };
+    return esp_matter::console::add_commands(&command, 1);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <esp_err.h>
+#include <stdint.h>
+
+/** Load the per-mediator range models stored in NVS, see range_model.h */
+esp_err_t range_models_init();
+
+/** Distance of an observation under the model of its mediator
+ *
+ * The model set for the mediator with `rangemodel` wins, then its calibrated path loss model
+ * once calib.h has one, then free space, which reproduces the distance the mediator itself would
+ * have sent. The observation is also added to the calibration. Called on the CHIP thread for
+ * every observation.
+ *
+ * @param[in] slot Mediator slot in the observation store.
+ * @param[in] mediator Mediator ID.
+ * @param[in] level_db tx_power - rssi of the observation.
+ *
+ * @return distance in centimetres.
+ */
+uint16_t range_models_distance(uint8_t slot, uint16_t mediator, uint32_t beacon, float level_db);
+
+/** Register the `rangemodel` console command
+ *
+ * `matter esp rangemodel` lists the models, `rangemodel <mediator> log <offset> <n>`,
+ * `rangemodel <mediator> two <offset> <n> <breakpoint> <n_far>` and
+ * `rangemodel <mediator> lut <level>:<distance> ...` set one, in dB and metres, and
+ * `rangemodel <mediator> clear` drops it. Changes are stored in NVS.
+ */
+esp_err_t range_models_register_commands();
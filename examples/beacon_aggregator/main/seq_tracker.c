@@ -0,0 +1,125 @@
+#include <string.h>
+
+#include "seq_tracker.h"
+
+static seq_link_t *find_link(seq_tracker_t *tracker, uint16_t mediator)
+{
+    seq_link_t *free_link = NULL;
+    for (int i = 0; i < SEQ_TRACKER_MAX_MEDIATORS; i++) {
+        seq_link_t *link = &tracker->links[i];
+        if (link->used && link->mediator == mediator) {
+            return link;
+        }
+        if (!link->used && !free_link) {
+            free_link = link;
+        }
+    }
+    return free_link;
+}
+
+static void restart(seq_link_t *link, uint32_t boot_seq, uint32_t seq)
+{
+    link->boot_seq = boot_seq;
+    link->highest = seq;
+    /* Numbers before the first one seen are not ours to count */
+    link->window = ~0ULL;
+    link->lost_from = seq + 1;
+    link->prev_highest = boot_seq - 1;
+}
+
+/* Before the first number seen, or between the last one seen from the previous boot and the
+ * current boot: such numbers only show up replayed from the backlog and were never counted as
+ * lost, nor as arrived by a window */
+static int never_counted(const seq_link_t *link, uint32_t seq)
+{
+    return (int32_t)(seq - link->lost_from) < 0 ||
+           ((int32_t)(seq - link->prev_highest) > 0 && (int32_t)(seq - link->boot_seq) < 0);
+}
+
+seq_link_t *seq_tracker_observe(seq_tracker_t *tracker, uint16_t mediator, uint32_t boot_seq, uint32_t seq)
+{
+    seq_link_t *link = find_link(tracker, mediator);
+    if (!link) {
+        tracker->overflow++;
+        return NULL;
+    }
+    seq_counters_t *c = &link->counters;
+    c->received++;
+
+    if (!link->used) {
+        link->used = 1;
+        link->mediator = mediator;
+        restart(link, boot_seq, seq);
+        return link;
+    }
+
+    if (boot_seq != link->boot_seq) {
+        c->reboots++;
+        if ((int32_t)(boot_seq - link->boot_seq) < 0) {
+            /* Sequence numbers went backwards, the mediator lost its persisted counter */
+            restart(link, boot_seq, seq);
+            return link;
+        }
+        /* Numbers between the last one seen and the new boot were never assigned; close
+         * the window on the previous boot and mark the skipped range as accounted for. */
+        link->boot_seq = boot_seq;
+        link->prev_highest = link->highest;
+        if ((int32_t)(boot_seq - 1 - link->highest) > 0) {
+            link->counters.lost += SEQ_TRACKER_WINDOW - __builtin_popcountll(link->window);
+            link->highest = boot_seq - 1;
+            link->window = ~0ULL;
+        }
+    }
+
+    int32_t d = (int32_t)(seq - link->highest);
+    if (d < 0 && never_counted(link, seq)) {
+        c->backlog++;
+        return link;
+    }
+    if (d > 0) {
+        uint32_t shift = (uint32_t)d;
+        uint32_t out_unset;
+        if (shift >= SEQ_TRACKER_WINDOW) {
+            out_unset = (SEQ_TRACKER_WINDOW - __builtin_popcountll(link->window)) + (shift - SEQ_TRACKER_WINDOW);
+            link->window = 0;
+        } else {
+            out_unset = shift - __builtin_popcountll(link->window >> (SEQ_TRACKER_WINDOW - shift));
+            link->window <<= shift;
+        }
+        if (shift > 1) {
+            c->gaps++;
+        }
+        c->lost += out_unset;
+        link->window |= 1;
+        link->highest = seq;
+        /* Keep both ranges within reach of the signed comparisons */
+        if ((int32_t)(seq - link->lost_from) > (1 << 30)) {
+            link->lost_from = seq - (1 << 30);
+        }
+        if ((int32_t)(seq - link->boot_seq) > (1 << 30)) {
+            link->prev_highest = link->boot_seq - 1;
+        }
+    } else if ((uint32_t)-d < SEQ_TRACKER_WINDOW) {
+        uint64_t bit = 1ULL << (uint32_t)-d;
+        if (link->window & bit) {
+            c->duplicate++;
+            c->received--;
+        } else {
+            link->window |= bit;
+            c->reordered++;
+        }
+    } else {
+        /* Older than the window, it was already counted as lost */
+        c->recovered++;
+        if (c->lost > 0) {
+            c->lost--;
+        }
+    }
+    return link;
+}
+
+uint32_t seq_link_loss_permille(const seq_link_t *link)
+{
+    uint64_t total = (uint64_t)link->counters.received + link->counters.lost;
+    return total ? (uint32_t)((uint64_t)link->counters.lost * 1000 / total) : 0;
+}
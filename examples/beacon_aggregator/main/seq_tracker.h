@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Per-mediator sequence number accounting.
+ *
+ * Every observation carries a sequence number assigned by its mediator at capture time. The
+ * tracker keeps a bitmap of the last SEQ_TRACKER_WINDOW numbers per mediator: a number only
+ * counts as lost once it falls out of the window without having arrived, so reordering inside
+ * the window is not mistaken for loss. Observations replayed from a mediator's flash backlog
+ * usually arrive after their window has passed; those which were counted as lost are counted as
+ * recovered and taken back out of the loss count. Numbers which never were, older than the first
+ * one seen or assigned by a previous boot after the last one seen from it, count as backlog.
+ */
+
+#define SEQ_TRACKER_WINDOW 64
+#define SEQ_TRACKER_MAX_MEDIATORS 32
+
+typedef struct {
+    uint32_t received;
+    uint32_t lost;
+    uint32_t gaps;          /* Forward jumps of more than one */
+    uint32_t reordered;
+    uint32_t duplicate;
+    uint32_t recovered;     /* Arrived after being counted as lost */
+    uint32_t backlog;       /* Arrived late without having been counted as lost */
+    uint32_t reboots;
+} seq_counters_t;
+
+typedef struct {
+    uint16_t mediator;
+    uint8_t used;
+    uint32_t boot_seq;      /* First sequence number of the mediator's current boot */
+    uint32_t highest;
+    uint64_t window;        /* Bit i set: highest - i has arrived */
+    uint32_t lost_from;     /* Numbers before this one were never counted as lost */
+    uint32_t prev_highest;  /* Last number seen from the previous boot */
+    seq_counters_t counters;
+} seq_link_t;
+
+typedef struct {
+    seq_link_t links[SEQ_TRACKER_MAX_MEDIATORS];
+    uint32_t overflow;      /* Observations from mediators that did not fit in the table */
+} seq_tracker_t;
+
+/** Account for one observation
+ *
+ * @param[in] mediator Mediator ID from the report header.
+ * @param[in] boot_seq First sequence number of the mediator's current boot, from the report header.
+ * @param[in] seq Sequence number of the observation.
+ *
+ * @return link of the mediator.
+ * @return NULL if the table is full.
+ */
+seq_link_t *seq_tracker_observe(seq_tracker_t *tracker, uint16_t mediator, uint32_t boot_seq, uint32_t seq);
+
+/** Loss rate of a link in 1/1000, numbers still inside the window are not counted */
+uint32_t seq_link_loss_permille(const seq_link_t *link);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,409 @@
+#include <esp_log.h>
+#include <hal/cpu_hal.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_matter_console.h>
+
+#include <anchor_set.h>
+#include <beacon_track.h>
+#include <grid_locator.h>
+#include <multilat_ransac.h>
+#include <multilaterator.h>
+#include <particle_filter.h>
+#include <presence.h>
+#include <solve_bench.h>
+extern "C" {
+#include <trilateration.h>
+}
+
+static const char *TAG = "solve_bench";
+
+#define BENCH_CASES 64
+
+typedef struct {
+    uint16_t mask;
+    float ranges[ANCHOR_SET_MAX_ANCHORS];
+    q16_t ranges_q16[ANCHOR_SET_MAX_ANCHORS];
+    float truth[2];
+    float reflected;            /* Excess range of the first anchor for bench_ransac() */
+} bench_case_t;
+
+static anchor_set_t s_set;
+static float s_anchors[ANCHOR_SET_MAX_ANCHORS][3];
+static bench_case_t s_cases[BENCH_CASES];
+
+/* 4 x 4 anchors on a 10 m grid at 3 m, beacons at 1 m heard by 3 to 8 anchors */
+static void bench_setup()
+{
+    uint16_t present = 0;
+    for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+        s_anchors[i][0] = (i % 4) * 10.0f;
+        s_anchors[i][1] = (i / 4) * 10.0f;
+        s_anchors[i][2] = 3.0f;
+        present |= 1u << i;
+    }
+    anchor_set_load(&s_set, s_anchors, present);
+
+    srand(1);
+    for (int c = 0; c < BENCH_CASES; c++) {
+        bench_case_t *bench = &s_cases[c];
+        bench->truth[0] = (rand() % 3000) / 100.0f;
+        bench->truth[1] = (rand() % 3000) / 100.0f;
+        int count = 3 + c % 6;
+        bench->mask = 0;
+        while (__builtin_popcount(bench->mask) < count) {
+            bench->mask |= 1u << (rand() % ANCHOR_SET_MAX_ANCHORS);
+        }
+        for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+            float dx = bench->truth[0] - s_anchors[i][0];
+            float dy = bench->truth[1] - s_anchors[i][1];
+            float dz = 1.0f - s_anchors[i][2];
+            bench->ranges[i] = sqrtf(dx * dx + dy * dy + dz * dz);
+            bench->ranges_q16[i] = (q16_t)lrintf(bench->ranges[i] * Q16_ONE);
+        }
+        bench->reflected = 3.0f + (rand() % 700) / 100.0f;
+    }
+}
+
+static void bench_closed_form(uint32_t solves)
+{
+    float sink = 0;
+    uint32_t started = cpu_hal_get_cycle_count();
+    for (uint32_t n = 0; n < solves; n++) {
+        const bench_case_t *bench = &s_cases[n % BENCH_CASES];
+        const anchor_subset_t *subset = anchor_set_subset(&s_set, bench->mask);
+        if (subset->degenerate) {
+            continue;
+        }
+        uint16_t best3 = subset->best3;
+        int idx[3];
+        for (int k = 0; k < 3; k++) {
+            idx[k] = __builtin_ctz(best3);
+            best3 &= best3 - 1;
+        }
+        float ab[3];
+        float ac[3];
+        float x;
+        float y;
+        calc_line_eq(s_anchors[idx[0]], s_anchors[idx[1]], bench->ranges[idx[0]], bench->ranges[idx[1]], 1.0f, ab);
+        calc_line_eq(s_anchors[idx[0]], s_anchors[idx[2]], bench->ranges[idx[0]], bench->ranges[idx[2]], 1.0f, ac);
+        if (calc_x_from_lines(ab, ac, &x) != 0) {
+            continue;
+        }
+        calc_y_from_x(fabsf(ab[1]) >= fabsf(ac[1]) ? ab : ac, x, &y);
+        sink += x + y;
+    }
+    uint32_t cycles = cpu_hal_get_cycle_count() - started;
+    printf("calc_* (best 3):       %6u cycles/solve  (%d)\n", cycles / solves, (int)sink & 1);
+}
+
+static void bench_float(uint32_t solves)
+{
+    float error = 0;
+    float pos[3];
+    uint32_t started = cpu_hal_get_cycle_count();
+    for (uint32_t n = 0; n < solves; n++) {
+        const bench_case_t *bench = &s_cases[n % BENCH_CASES];
+        anchor_set_solve(&s_set, bench->mask, bench->ranges, 1.0f, pos);
+    }
+    uint32_t cycles = cpu_hal_get_cycle_count() - started;
+    float gdop = 0;
+    for (int c = 0; c < BENCH_CASES; c++) {
+        anchor_set_solve(&s_set, s_cases[c].mask, s_cases[c].ranges, 1.0f, pos);
+        error = fmaxf(error, hypotf(pos[0] - s_cases[c].truth[0], pos[1] - s_cases[c].truth[1]));
+        gdop = fmaxf(gdop, anchor_set_gdop(&s_set, s_cases[c].mask, pos));
+    }
+    printf("anchor_set float:      %6u cycles/solve  max error %.2f mm  max GDOP %.1f\n", cycles / solves,
+           error * 1000, gdop);
+}
+
+static void bench_q16(uint32_t solves)
+{
+    float error = 0;
+    q16_t pos[3];
+    uint32_t started = cpu_hal_get_cycle_count();
+    for (uint32_t n = 0; n < solves; n++) {
+        const bench_case_t *bench = &s_cases[n % BENCH_CASES];
+        anchor_set_solve_q16(&s_set, bench->mask, bench->ranges_q16, Q16_ONE, pos);
+    }
+    uint32_t cycles = cpu_hal_get_cycle_count() - started;
+    for (int c = 0; c < BENCH_CASES; c++) {
+        anchor_set_solve_q16(&s_set, s_cases[c].mask, s_cases[c].ranges_q16, Q16_ONE, pos);
+        error = fmaxf(error, hypotf((float)pos[0] / Q16_ONE - s_cases[c].truth[0],
+                                    (float)pos[1] / Q16_ONE - s_cases[c].truth[1]));
+    }
+    printf("anchor_set q16:        %6u cycles/solve  max error %.2f mm\n", cycles / solves, error * 1000);
+}
+
+/* All cases solved with the first eight anchors, which every case has ranges for */
+static void bench_template(uint32_t solves)
+{
+    Multilaterator<float, 8, 2>::Anchors anchors;
+    for (size_t i = 0; i < anchors.size(); i++) {
+        anchors[i] = {s_anchors[i][0], s_anchors[i][1], s_anchors[i][2]};
+    }
+    Multilaterator<float, 8, 2> solver(anchors);
+    static Multilaterator<float, 8, 2>::Ranges ranges[BENCH_CASES];
+    for (int c = 0; c < BENCH_CASES; c++) {
+        memcpy(ranges[c].data(), s_cases[c].ranges, sizeof(ranges[c]));
+    }
+    float error = 0;
+    float sink = 0;
+    uint32_t started = cpu_hal_get_cycle_count();
+    for (uint32_t n = 0; n < solves; n++) {
+        sink += solver.solve(ranges[n % BENCH_CASES], 1.0f)[0];
+    }
+    uint32_t cycles = cpu_hal_get_cycle_count() - started;
+    for (int c = 0; c < BENCH_CASES; c++) {
+        Multilaterator<float, 8, 2>::Point pos = solver.solve(ranges[c], 1.0f);
+        error = fmaxf(error, hypotf(pos[0] - s_cases[c].truth[0], pos[1] - s_cases[c].truth[1]));
+    }
+    printf("Multilaterator<8, 2>:  %6u cycles/solve  max error %.2f mm  (%d)\n", cycles / solves, error * 1000,
+           (int)sink & 1);
+
+    /* The same anchors with the count given at run time */
+    Multilaterator<float, multilaterator::Dynamic, 2> dynamic(anchors.data(), anchors.size());
+    started = cpu_hal_get_cycle_count();
+    for (uint32_t n = 0; n < solves; n++) {
+        sink += dynamic.solve(ranges[n % BENCH_CASES].data(), 1.0f)[0];
+    }
+    cycles = cpu_hal_get_cycle_count() - started;
+    printf("Multilaterator<Dynamic, 2> with 8: %6u cycles/solve  (%d)\n", cycles / solves, (int)sink & 1);
+}
+
+/* Cases with five or more anchors, the first of them reflected 3 to 10 m long */
+static void bench_ransac(uint32_t solves)
+{
+    static float anchors[BENCH_CASES][MULTILAT_MAX_ANCHORS][3];
+    static float ranges[BENCH_CASES][MULTILAT_MAX_ANCHORS];
+    int count[BENCH_CASES];
+    int cases = 0;
+    for (int c = 0; c < BENCH_CASES; c++) {
+        const bench_case_t *bench = &s_cases[c];
+        if (__builtin_popcount(bench->mask) < 5) {
+            continue;
+        }
+        count[cases] = 0;
+        for (uint16_t mask = bench->mask; mask; mask &= mask - 1) {
+            int i = __builtin_ctz(mask);
+            memcpy(anchors[cases][count[cases]], s_anchors[i], sizeof(s_anchors[i]));
+            ranges[cases][count[cases]] = bench->ranges[i];
+            count[cases]++;
+        }
+        ranges[cases][0] += bench->reflected;
+        cases++;
+    }
+
+    multilat_ransac_config_t config = MULTILAT_RANSAC_CONFIG_DEFAULT();
+    multilat_ransac_fix_t fix;
+    uint32_t hypotheses = 0;
+    uint32_t started = cpu_hal_get_cycle_count();
+    for (uint32_t n = 0; n < solves; n++) {
+        int c = n % cases;
+        multilat_ransac(anchors[c], ranges[c], NULL, count[c], 1.0f, &config, &fix);
+        hypotheses += fix.hypotheses;
+    }
+    uint32_t cycles = cpu_hal_get_cycle_count() - started;
+
+    float error = 0;
+    float ls_error = 0;
+    int rejected = 0;
+    int c = 0;
+    for (int b = 0; b < BENCH_CASES; b++) {
+        const bench_case_t *bench = &s_cases[b];
+        if (__builtin_popcount(bench->mask) < 5) {
+            continue;
+        }
+        multilat_fix_t ls;
+        multilat_solve(anchors[c], ranges[c], count[c], 1.0f, config.gn_iterations, &ls);
+        ls_error = fmaxf(ls_error, hypotf(ls.pos[0] - bench->truth[0], ls.pos[1] - bench->truth[1]));
+        if (multilat_ransac(anchors[c], ranges[c], NULL, count[c], 1.0f, &config, &fix) == 0) {
+            error = fmaxf(error, hypotf(fix.fix.pos[0] - bench->truth[0], fix.fix.pos[1] - bench->truth[1]));
+            rejected += !(fix.inliers & 1);
+        }
+        c++;
+    }
+    printf("ransac (1 reflection): %6u cycles/solve  %.1f hypotheses, max error %.2f m (least squares %.2f m), "
+           "%d/%d rejected\n", cycles / solves, (float)hypotheses / solves, error, ls_error, rejected, cases);
+}
+
+/* One tracked beacon per case, fed its true position at 1 s intervals */
+static void bench_track(uint32_t solves)
+{
+    static beacon_tracks_t tracks;
+    beacon_tracks_init(&tracks, 2, 0.5f);
+    uint32_t updates = 0;
+    uint32_t update_cycles = 0;
+    uint32_t predict_cycles = 0;
+    for (uint32_t n = 0; n < solves; n++) {
+        uint32_t time_ms = (n / BENCH_CASES) * 1000;
+        const bench_case_t *bench = &s_cases[n % BENCH_CASES];
+        float pos[3] = {bench->truth[0], bench->truth[1], 1.0f};
+        uint32_t started = cpu_hal_get_cycle_count();
+        beacon_tracks_fix(&tracks, n % BENCH_CASES, pos, 1.0f, time_ms);
+        update_cycles += cpu_hal_get_cycle_count() - started;
+        updates++;
+        if (n % BENCH_CASES == BENCH_CASES - 1) {
+            started = cpu_hal_get_cycle_count();
+            beacon_tracks_predict_all(&tracks, time_ms + 500);
+            predict_cycles += cpu_hal_get_cycle_count() - started;
+        }
+    }
+    uint32_t rounds = solves / BENCH_CASES;
+    printf("track fix update:      %6u cycles/update  predict %u cycles/track\n", update_cycles / updates,
+           rounds ? predict_cycles / rounds / tracks.count : 0);
+}
+
+#define BENCH_PARTICLES 256
+
+/* One beacon fed the bench cases in turn on a 40 x 40 m grid of 0.5 m cells with a wall
+ * through x = 15 m, open between y = 14 and 16 m. The cases jump around, so the filter also
+ * reseeds now and then, as it would when a beacon reappears. */
+static void bench_particles(uint32_t solves)
+{
+    static uint8_t bits[80 * 10];
+    static float storage[PARTICLE_FILTER_STORAGE(BENCH_PARTICLES)];
+    memset(bits, 0, sizeof(bits));
+    const int wall = (15 + 5) * 2;
+    for (int cy = 0; cy < 80; cy++) {
+        if (cy < (14 + 5) * 2 || cy >= (16 + 5) * 2) {
+            bits[cy * 10 + wall / 8] |= 1u << (wall & 7);
+        }
+    }
+    const floor_grid_t grid = {{-5.0f, -5.0f}, 0.5f, 80, 80, 10, bits};
+
+    particle_filter_t pf;
+    particle_filter_init(&pf, &grid, storage, BENCH_PARTICLES, 1.0f, 1);
+    particle_filter_seed(&pf, s_cases[0].truth[0], s_cases[0].truth[1], 2.0f);
+    float anchors[ANCHOR_SET_MAX_ANCHORS][3];
+    float ranges[ANCHOR_SET_MAX_ANCHORS];
+    float sigmas[ANCHOR_SET_MAX_ANCHORS];
+    uint32_t ticks = solves / BENCH_PARTICLES + 1;
+    uint32_t started = cpu_hal_get_cycle_count();
+    for (uint32_t n = 0; n < ticks; n++) {
+        const bench_case_t *bench = &s_cases[n % BENCH_CASES];
+        int count = anchor_set_gather(&s_set, bench->mask, anchors);
+        for (int k = 0, i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+            if (bench->mask & (1u << i)) {
+                ranges[k] = bench->ranges[i];
+                sigmas[k++] = 1.0f;
+            }
+        }
+        particle_filter_predict(&pf, 0.7f);
+        if (particle_filter_update(&pf, anchors, ranges, sigmas, count) != 0) {
+            particle_filter_seed(&pf, bench->truth[0], bench->truth[1], 2.0f);
+        }
+    }
+    uint32_t cycles = cpu_hal_get_cycle_count() - started;
+    printf("particles (%d):       %6u cycles/particle/tick  %u resamples\n", BENCH_PARTICLES,
+           cycles / (ticks * BENCH_PARTICLES), pf.resamples);
+}
+
+/* Room level presence fed the same ranges, one observation per anchor that heard the beacon,
+ * to compare with a solve per beacon */
+static void bench_presence(uint32_t solves)
+{
+    static presence_t presence;
+    const presence_config_t config = PRESENCE_CONFIG_DEFAULT();
+    presence_init(&presence, &config);
+    uint32_t started = cpu_hal_get_cycle_count();
+    for (uint32_t n = 0; n < solves; n++) {
+        const bench_case_t *bench = &s_cases[n % BENCH_CASES];
+        uint32_t time_ms = (n / BENCH_CASES) * 1000;
+        presence_event_t event;
+        for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+            if (bench->mask & (1u << i)) {
+                presence_observe(&presence, n % BENCH_CASES, i, -20.0f * log10f(bench->ranges[i]), time_ms, &event);
+            }
+        }
+    }
+    uint32_t cycles = cpu_hal_get_cycle_count() - started;
+    printf("presence:              %6u cycles/beacon  %u transitions\n", cycles / solves,
+           presence.stats.transitions);
+}
+
+/* Cells of `cell` m over the 30 x 30 m of the bench cases, the table is 32 KB for the 16 anchors
+ * at 1 m and four times that per halving; a table that does not fit in the heap is skipped.
+ * Accuracy on the exact ranges is the quantization of the cells, the reflected one adds the
+ * bench_ransac() excess to the first anchor of each case. */
+static void bench_grid(uint32_t solves, float cell)
+{
+    const uint16_t cells = (uint16_t)lrintf(32.0f / cell);
+    const floor_grid_t grid = {{-1.0f, -1.0f}, cell, cells, cells, 0, NULL};
+    size_t bytes = GRID_LOCATOR_STORAGE(cells, cells, ANCHOR_SET_MAX_ANCHORS) * sizeof(uint16_t);
+    uint16_t *storage = (uint16_t *)malloc(bytes);
+    if (!storage) {
+        printf("grid (%.2f m cells):   no memory for the %u KB table\n", cell, bytes / 1024);
+        return;
+    }
+    grid_locator_t loc;
+    uint32_t started = cpu_hal_get_cycle_count();
+    grid_locator_build(&loc, &s_set, &grid, 1.0f, storage);
+    uint32_t build_cycles = cpu_hal_get_cycle_count() - started;
+
+    float error = 0, reflected_error = 0;
+    uint32_t evaluated = 0;
+    started = cpu_hal_get_cycle_count();
+    for (uint32_t n = 0; n < solves; n++) {
+        const bench_case_t *bench = &s_cases[n % BENCH_CASES];
+        grid_locator_fix_t fix;
+        if (grid_locator_solve(&loc, bench->mask, bench->ranges, NULL, &fix) == 0) {
+            error += hypotf(fix.pos[0] - bench->truth[0], fix.pos[1] - bench->truth[1]);
+            evaluated += fix.evaluated;
+        }
+    }
+    uint32_t cycles = cpu_hal_get_cycle_count() - started;
+    for (int c = 0; c < BENCH_CASES; c++) {
+        const bench_case_t *bench = &s_cases[c];
+        float ranges[ANCHOR_SET_MAX_ANCHORS];
+        memcpy(ranges, bench->ranges, sizeof(ranges));
+        ranges[__builtin_ctz(bench->mask)] += bench->reflected;
+        grid_locator_fix_t fix;
+        if (grid_locator_solve(&loc, bench->mask, ranges, NULL, &fix) == 0) {
+            reflected_error += hypotf(fix.pos[0] - bench->truth[0], fix.pos[1] - bench->truth[1]);
+        }
+    }
+    free(storage);
+    printf("grid (%.2f m cells):   %6u cycles/solve  %u cells  %.2f m, %.2f m reflected  build %u cycles  %u KB\n",
+           cell, cycles / solves, evaluated / solves, error / solves, reflected_error / BENCH_CASES, build_cycles,
+           bytes / 1024);
+}
+
+static esp_err_t solver_console_handler(int argc, char **argv)
+{
+    if (argc < 1 || strcmp(argv[0], "bench") != 0) {
+        printf("Usage: matter esp solver bench [solves]\n");
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint32_t solves = argc >= 2 ? strtoul(argv[1], NULL, 0) : 10000;
+    if (solves == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    bench_setup();
+    printf("%u solves, %s build\n", solves, ANCHOR_SET_FIXED_POINT ? "fixed point" : "float");
+    bench_closed_form(solves);
+    bench_float(solves);
+    bench_q16(solves);
+    bench_template(solves);
+    bench_ransac(solves);
+    bench_track(solves);
+    bench_particles(solves);
+    bench_grid(solves, 1.0f);
+    bench_grid(solves, 0.5f);
+    bench_grid(solves, 0.25f);
+    bench_presence(solves);
+    ESP_LOGI(TAG, "Subset cache: %u hits, %u misses", s_set.stats.hits, s_set.stats.misses);
+    return ESP_OK;
+}
+
+esp_err_t solve_bench_register_commands()
+{
+    static const esp_matter::console::command_t command = {
+        .name = "solver",
+        .description = "Position solver benchmark. Usage: matter esp solver bench [solves]",
+        .handler = solver_console_handler,
+    };
+    return esp_matter::console::add_commands(&command, 1);
+}
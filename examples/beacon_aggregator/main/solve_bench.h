@@ -0,0 +1,10 @@
+#pragma once
+
+#include <esp_err.h>
+
+/** Register the `solver` console command
+ *
+ * `matter esp solver bench [solves]` times the position solvers on a synthetic anchor layout
+ * and prints CPU cycles per solve, to compare them on the target itself.
+ */
+esp_err_t solve_bench_register_commands();
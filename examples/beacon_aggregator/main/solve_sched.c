@@ -0,0 +1,120 @@
+#include <string.h>
+
+#include "solve_sched.h"
+
+void solve_sched_init(solve_sched_t *sched)
+{
+    memset(sched, 0, sizeof(*sched));
+}
+
+void solve_sched_mark(solve_sched_t *sched, int slot, uint32_t now_ms)
+{
+    if (slot < 0 || slot >= SOLVE_SCHED_MAX_SLOTS) {
+        return;
+    }
+    uint32_t bit = 1u << (slot % 32);
+    if (sched->dirty[slot / 32] & bit) {
+        sched->stats.coalesced++;
+        return;
+    }
+    sched->dirty[slot / 32] |= bit;
+    sched->marked_ms[slot] = now_ms;
+    sched->stats.marked++;
+}
+
+void solve_sched_defer(solve_sched_t *sched, int slot)
+{
+    if (slot < 0 || slot >= SOLVE_SCHED_MAX_SLOTS) {
+        return;
+    }
+    sched->dirty[slot / 32] |= 1u << (slot % 32);
+    sched->stats.deferred++;
+}
+
+int solve_sched_pending(const solve_sched_t *sched)
+{
+    int count = 0;
+    for (int w = 0; w < SOLVE_SCHED_WORDS; w++) {
+        count += __builtin_popcount(sched->dirty[w]);
+    }
+    return count;
+}
+
+/* Dirty slots, longest waiting first. Insertion sort, the set is at most a few dozen slots. */
+static int gather(const solve_sched_t *sched, uint32_t now_ms, int *order, uint32_t *wait_ms)
+{
+    int count = 0;
+    for (int w = 0; w < SOLVE_SCHED_WORDS; w++) {
+        uint32_t bits = sched->dirty[w];
+        while (bits) {
+            int slot = w * 32 + __builtin_ctz(bits);
+            bits &= bits - 1;
+            int32_t wait = (int32_t)(now_ms - sched->marked_ms[slot]);
+            uint32_t key = wait < 0 ? 0 : (uint32_t)wait;
+            int i = count++;
+            while (i > 0 && wait_ms[i - 1] < key) {
+                order[i] = order[i - 1];
+                wait_ms[i] = wait_ms[i - 1];
+                i--;
+            }
+            order[i] = slot;
+            wait_ms[i] = key;
+        }
+    }
+    return count;
+}
+
+int solve_sched_tick(solve_sched_t *sched, uint32_t now_ms, uint32_t budget_us, solve_sched_clock_t clock,
+                     solve_sched_solve_t solve, void *ctx)
+{
+    solve_sched_stats_t *stats = &sched->stats;
+    int order[SOLVE_SCHED_MAX_SLOTS];
+    uint32_t wait_ms[SOLVE_SCHED_MAX_SLOTS];
+    int count = gather(sched, now_ms, order, wait_ms);
+
+    uint32_t started_us = clock(ctx);
+    uint32_t elapsed_us = 0;
+    int done = 0;
+    while (done < count) {
+        if (done > 0 && elapsed_us + sched->cost_us > budget_us) {
+            break;
+        }
+        int slot = order[done];
+        sched->dirty[slot / 32] &= ~(1u << (slot % 32));
+        solve(ctx, slot);
+        uint32_t now_us = clock(ctx);
+        uint32_t cost_us = now_us - started_us - elapsed_us;
+        elapsed_us = now_us - started_us;
+        sched->cost_us = sched->cost_us ? (7 * sched->cost_us + cost_us + 4) / 8 : cost_us;
+
+        stats->solved++;
+        stats->wait_ms += wait_ms[done];
+        if (wait_ms[done] > stats->max_wait_ms) {
+            stats->max_wait_ms = wait_ms[done];
+        }
+        done++;
+    }
+
+    stats->ticks++;
+    stats->used_us += elapsed_us;
+    stats->budget_us += budget_us;
+    if (elapsed_us > stats->max_used_us) {
+        stats->max_used_us = elapsed_us;
+    }
+    int left = solve_sched_pending(sched);
+    if (left > 0) {
+        stats->deferred_ticks++;
+        if (!sched->backlog) {
+            sched->backlog = 1;
+            sched->backlog_ms = now_ms;
+        }
+    } else if (sched->backlog) {
+        sched->backlog = 0;
+        stats->backlogs++;
+        stats->last_backlog_ms = now_ms - sched->backlog_ms;
+        if (stats->last_backlog_ms > stats->max_backlog_ms) {
+            stats->max_backlog_ms = stats->last_backlog_ms;
+        }
+    }
+    return left;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "obs_store.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Dirty set scheduling of beacon solves.
+ *
+ * Most beacons get no new range between two solve ticks, so instead of solving every beacon on
+ * every tick, an observation marks its beacon slot dirty and a tick solves only the dirty slots,
+ * the longest waiting first. A tick stops before the next solve would overrun its time budget,
+ * judged from a running average of the solve cost; whatever is left stays dirty, and keeps its
+ * place in the order, for the next tick. Every tick solves at least one slot, so a budget below
+ * the cost of a single solve still makes progress.
+ *
+ * Stats report the share of each tick budget used, how long beacons waited to be solved, and
+ * how long a backlog took to clear: from the first tick which left slots dirty to the tick which
+ * emptied the set.
+ *
+ * State is one bit and one timestamp per obs_store beacon slot. Not thread safe.
+ */
+
+#define SOLVE_SCHED_MAX_SLOTS OBS_STORE_MAX_BEACONS
+#define SOLVE_SCHED_WORDS ((SOLVE_SCHED_MAX_SLOTS + 31) / 32)
+
+/** Microsecond clock used to hold the budget */
+typedef uint32_t (*solve_sched_clock_t)(void *ctx);
+
+/** Solve of a beacon slot */
+typedef void (*solve_sched_solve_t)(void *ctx, int slot);
+
+typedef struct {
+    uint32_t ticks;
+    uint32_t marked;                /* Slots made dirty */
+    uint32_t coalesced;             /* Marks of slots which were already dirty */
+    uint32_t solved;
+    uint32_t deferred;              /* Slots put back by their solve */
+    uint32_t deferred_ticks;        /* Ticks that left slots dirty */
+    uint64_t used_us;               /* Sum over ticks */
+    uint32_t max_used_us;
+    uint64_t budget_us;             /* Sum over ticks */
+    uint64_t wait_ms;               /* Sum over solves of the time since the slot was marked */
+    uint32_t max_wait_ms;
+    uint32_t backlogs;              /* Backlogs cleared */
+    uint32_t last_backlog_ms;
+    uint32_t max_backlog_ms;
+} solve_sched_stats_t;
+
+typedef struct {
+    uint32_t dirty[SOLVE_SCHED_WORDS];
+    uint32_t marked_ms[SOLVE_SCHED_MAX_SLOTS];  /* When each dirty slot was first marked */
+    uint32_t cost_us;               /* Running average of one solve */
+    uint8_t backlog;
+    uint32_t backlog_ms;            /* Time of the tick which started the backlog */
+    solve_sched_stats_t stats;
+} solve_sched_t;
+
+void solve_sched_init(solve_sched_t *sched);
+
+/** Mark a beacon slot for the next tick
+ *
+ * A slot already dirty keeps its original mark time, so a beacon heard on every report still
+ * reaches the front of the order.
+ */
+void solve_sched_mark(solve_sched_t *sched, int slot, uint32_t now_ms);
+
+/** Put back a slot its solve could not handle yet
+ *
+ * Called from the solve callback. The slot is dirty again for the next tick with its original
+ * mark time, so the wait stats and the order still count from the first mark.
+ */
+void solve_sched_defer(solve_sched_t *sched, int slot);
+
+/** Solve dirty slots, longest waiting first, within a time budget
+ *
+ * Slots are cleared before their solve, which may mark or defer them again; either way they
+ * wait for the next tick.
+ *
+ * @param[in] now_ms Time of the tick, on the clock of solve_sched_mark().
+ * @param[in] budget_us Time the tick may take.
+ *
+ * @return number of slots left dirty.
+ */
+int solve_sched_tick(solve_sched_t *sched, uint32_t now_ms, uint32_t budget_us, solve_sched_clock_t clock,
+                     solve_sched_solve_t solve, void *ctx);
+
+/** Number of dirty slots */
+int solve_sched_pending(const solve_sched_t *sched);
+
+#ifdef __cplusplus
+}
+#endif
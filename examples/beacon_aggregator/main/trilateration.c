@@ -14,12 +14,18 @@ void calc_line_eq(float a[3],float b[3],float ra,float rb,float z,float c[3]){
   c[2] = ABr;
 }
 
-void calc_x_from_lines(float a[3],float b[3],float *x){
+/* 2直線が(ほぼ)平行，つまり3点が(ほぼ)一直線上にあるときは解かずに-1を返す */
+int calc_x_from_lines(float a[3],float b[3],float *x){
   float ABx = a[0] * b[1];
   float ABr = a[2] * b[1];
   float ACx = a[1] * b[0];
   float ACr = a[1] * b[2];
-  *x = (ABr - ACr) / (ABx - ACx);
+  float det = ABx - ACx;
+  if (!(fabsf(det) > 1e-3f * hypotf(a[0], a[1]) * hypotf(b[0], b[1]))) {
+    return -1;
+  }
+  *x = (ABr - ACr) / det;
+  return 0;
 }
 
 void calc_y_from_x(float a[3],float x,float *y){
@@ -3,6 +3,6 @@
 
 void calc_line_eq(float a[3],float b[3],float ra,float rb,float z,float c[3]);
 
-void calc_x_from_lines(float a[3],float b[3],float *x);
+int calc_x_from_lines(float a[3],float b[3],float *x);
 
 void calc_y_from_x(float a[3],float x,float *y);
\ No newline at end of file
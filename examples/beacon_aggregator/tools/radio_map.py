@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""Build the RSSI fingerprint map image read by main/radio_map.c.
+
+The survey is a CSV file with one row per RSSI sample:
+
+    x,y,mediator,rssi
+    12.40,3.10,17,-71
+
+x and y in metres, the mediator by its node ID and the RSSI in dBm. Samples of the same point
+and mediator are averaged. A mediator that never heard a point gets the floor value.
+
+    radio_map.py build survey.csv -o radiomap.bin
+    radio_map.py info radiomap.bin
+    radio_map.py synth --points 2000 --mediators 8 -o survey.csv
+
+The image goes into the radiomap partition:
+
+    parttool.py write_partition --partition-name radiomap --input radiomap.bin
+"""
+
+import argparse
+import csv
+import math
+import random
+import struct
+import sys
+from collections import defaultdict
+
+MAGIC = b'RMAP'
+VERSION = 1
+MAX_MEDIATORS = 16
+MAX_POINTS = 65535
+HEADER = struct.Struct('<4sBBbBHH')
+
+
+def read_survey(path, floor_dbm):
+    samples = defaultdict(list)
+    mediators = set()
+    with open(path, newline='') as f:
+        for row in csv.DictReader(f):
+            point = (round(float(row['x']), 1), round(float(row['y']), 1))
+            mediator = int(row['mediator'], 0)
+            samples[(point, mediator)].append(float(row['rssi']))
+            mediators.add(mediator)
+
+    mediators = sorted(mediators)
+    if not mediators or len(mediators) > MAX_MEDIATORS:
+        sys.exit('radio map needs 1 to {} mediators, survey has {}'.format(MAX_MEDIATORS, len(mediators)))
+    index = {m: i for i, m in enumerate(mediators)}
+
+    points = {}
+    for (point, mediator), values in samples.items():
+        rssi = points.setdefault(point, [floor_dbm] * len(mediators))
+        mean = sum(values) / len(values)
+        rssi[index[mediator]] = max(floor_dbm, min(127, int(round(mean))))
+    if len(points) > MAX_POINTS:
+        sys.exit('radio map holds up to {} points, survey has {}'.format(MAX_POINTS, len(points)))
+    return mediators, [(x, y, rssi) for (x, y), rssi in points.items()]
+
+
+def build_tree(points, lo, hi, split):
+    """Orders points[lo:hi] as an implicit k-d tree, recording the split axis of each node"""
+    if hi - lo <= 0:
+        return
+    dims = len(points[lo][2])
+    axis = max(range(dims), key=lambda d: max(p[2][d] for p in points[lo:hi]) - min(p[2][d] for p in points[lo:hi]))
+    points[lo:hi] = sorted(points[lo:hi], key=lambda p: p[2][axis])
+    mid = (lo + hi) // 2
+    split[mid] = axis
+    build_tree(points, lo, mid, split)
+    build_tree(points, mid + 1, hi, split)
+
+
+def pad4(data):
+    return data + b'\0' * (-len(data) % 4)
+
+
+def to_dm(metres):
+    dm = int(round(metres * 10))
+    if not -32768 <= dm <= 32767:
+        sys.exit('coordinate {} m is outside the +-3276 m the map can hold'.format(metres))
+    return dm
+
+
+def build(args):
+    mediators, points = read_survey(args.survey, args.floor)
+    split = [0] * len(points)
+    build_tree(points, 0, len(points), split)
+
+    image = HEADER.pack(MAGIC, VERSION, len(mediators), args.floor, 0, len(points), 0)
+    image = pad4(image + struct.pack('<{}H'.format(len(mediators)), *mediators))
+    image = pad4(image + struct.pack('<{}h'.format(len(points)), *(to_dm(p[0]) for p in points)))
+    image = pad4(image + struct.pack('<{}h'.format(len(points)), *(to_dm(p[1]) for p in points)))
+    image = pad4(image + bytes(split))
+    image += b''.join(struct.pack('<{}b'.format(len(mediators)), *p[2]) for p in points)
+
+    with open(args.output, 'wb') as f:
+        f.write(image)
+    print('{}: {} points, {} mediators, {} bytes'.format(args.output, len(points), len(mediators), len(image)))
+
+
+def info(args):
+    with open(args.image, 'rb') as f:
+        image = f.read()
+    magic, version, mediators, floor_dbm, _, points, _ = HEADER.unpack_from(image)
+    if magic != MAGIC:
+        sys.exit('not a radio map')
+    ids = struct.unpack_from('<{}H'.format(mediators), image, HEADER.size)
+    print('version {}, {} points, {} mediators, floor {} dBm, {} bytes'.format(version, points, mediators, floor_dbm,
+                                                                             len(image)))
+    print('mediators: ' + ' '.join(str(m) for m in ids))
+
+
+def synth(args):
+    """Survey on a square grid with log-distance path loss and shadowing, for benchmarks"""
+    rng = random.Random(args.seed)
+    side = math.sqrt(args.points) * args.spacing
+    anchors = []
+    for i in range(args.mediators):
+        angle = 2 * math.pi * i / args.mediators
+        anchors.append((side / 2 * (1 + 0.9 * math.cos(angle)), side / 2 * (1 + 0.9 * math.sin(angle))))
+    per_row = int(math.ceil(math.sqrt(args.points)))
+    with open(args.output, 'w', newline='') as f:
+        out = csv.writer(f)
+        out.writerow(['x', 'y', 'mediator', 'rssi'])
+        for n in range(args.points):
+            x = (n % per_row) * args.spacing
+            y = (n // per_row) * args.spacing
+            for m, (ax, ay) in enumerate(anchors):
+                d = max(0.5, math.hypot(x - ax, y - ay))
+                rssi = -59 - 10 * args.exponent * math.log10(d) + rng.gauss(0, args.shadowing)
+                if rssi >= args.floor:
+                    out.writerow(['{:.2f}'.format(x), '{:.2f}'.format(y), 100 + m, '{:.1f}'.format(rssi)])
+    print('{}: {} points, {} mediators, {:.0f} m square'.format(args.output, args.points, args.mediators, side))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest='command')
+    sub.required = True
+
+    p = sub.add_parser('build', help='build a map image from a survey')
+    p.add_argument('survey')
+    p.add_argument('-o', '--output', default='radiomap.bin')
+    p.add_argument('--floor', type=int, default=-100, help='RSSI of a mediator that did not hear a point, dBm')
+    p.set_defaults(func=build)
+
+    p = sub.add_parser('info', help='describe a map image')
+    p.add_argument('image')
+    p.set_defaults(func=info)
+
+    p = sub.add_parser('synth', help='write a synthetic survey')
+    p.add_argument('--points', type=int, default=1000)
+    p.add_argument('--mediators', type=int, default=8)
+    p.add_argument('--spacing', type=float, default=1.0, help='grid spacing, metres')
+    p.add_argument('--exponent', type=float, default=2.5, help='path loss exponent')
+    p.add_argument('--shadowing', type=float, default=4.0, help='shadowing standard deviation, dB')
+    p.add_argument('--floor', type=int, default=-100)
+    p.add_argument('--seed', type=int, default=1)
+    p.add_argument('-o', '--output', default='survey.csv')
+    p.set_defaults(func=synth)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == '__main__':
+    main()
@@ -32,15 +32,20 @@
 
 #include "math.h"
 
+#include <commission_queue.h>
 #include <is_commissioned.h>
-
-uint64_t pincode = static_cast<uint64_t>(20202021);
+#include <obs_uplink.h>
 
 /*-----------------------------BLE start-----------------------------*/
 static int blecent_gap_event(struct ble_gap_event *event, void *arg);
 extern "C" void ble_store_config_init(void);
 static const char *tag = "NimBLE_BLE_CENT";
 
+#if CONFIG_BEACON_MEDIATOR_RAW_RSSI
+/* Same cut as distance < 10 below: pow(10, level / 20) * 25.5 < 10 for integer levels */
+constexpr int k_raw_gate_level_db = -9;
+#endif
+
 /**
  * Initiates the GAP general discovery procedure.
  */
@@ -129,24 +134,26 @@ blecent_gap_event(struct ble_gap_event *event, void *arg)
           tx_power = ibeacon_data->ibeacon_vendor.measured_power;
           rssi = event->disc.rssi;
           printf("RSSI: %d\nMeasured_Power: %d\n",rssi,tx_power);
+#if CONFIG_BEACON_MEDIATOR_RAW_RSSI
+          printf("is_commissioned: %d\n",is_commissioned);
+          if(is_commissioned && tx_power - rssi <= k_raw_gate_level_db){
+            uint32_t beacon = static_cast<uint32_t>(major) << 16 | minor;
+            if (obs_uplink_push_rssi(beacon, rssi, tx_power) != ESP_OK) {
+              ESP_LOGW(tag, "Uplink queue full, observation dropped");
+            }
+          }
+#else
           double distance = pow(10.0, (tx_power - rssi) / 20.0) * 25.5;
-          uint8_t distance_meter = static_cast<uint8_t>(distance);
-          double distance_after = static_cast<double>(distance_meter);
-          printf("Distance(lf): %lf\nDistance_recv(lf): %lf\n\n",distance/25.5,distance_after/25.5);
+          printf("Distance(lf): %lf\n\n",distance/25.5);
           printf("is_commissioned: %d\n",is_commissioned);
-          uint16_t msg_i = distance_meter << 8 | static_cast<uint8_t>(minor);
-          char msg[10];
-          sprintf(msg,"%u",msg_i);
-          printf("%s\n",msg);
-          uint8_t receive_uuid = msg_i & 0x00FF;
-          uint8_t receive_distance = (msg_i & 0xFF00) >> 8;
-          printf("%u\n%u\n",receive_uuid,receive_distance);
-          /* Write command */
           if(is_commissioned && distance<10){
-            using namespace chip::app::Clusters;
-            chip::DeviceLayer::StackLock lock;
-            esp_matter::controller::send_write_attr_command(static_cast<uint64_t>(1), static_cast<uint16_t>(1), OnOff::Id, OnOff::Attributes::OffWaitTime::Id,msg);
+            uint32_t beacon = static_cast<uint32_t>(major) << 16 | minor;
+            uint16_t distance_cm = static_cast<uint16_t>(distance / 25.5 * 100);
+            if (obs_uplink_push(beacon, distance_cm) != ESP_OK) {
+              ESP_LOGW(tag, "Uplink queue full, observation dropped");
+            }
           }
+#endif
         }
         return 0;
 
@@ -247,7 +254,11 @@ static void app_event_cb(const ChipDeviceEvent *event, intptr_t arg)
 static void app_driver_button_toggle_cb(void*, void*)
 {
       ESP_LOGI(TAG, "Toggle button pressed");
-      controller::pairing_on_network(static_cast<uint64_t>(1), pincode);
+      esp_err_t err = commission_queue_add(CONFIG_BEACON_MEDIATOR_AGGREGATOR_NODE_ID,
+                                           CONFIG_BEACON_MEDIATOR_AGGREGATOR_SETUP_CODE, false);
+      if (err != ESP_OK) {
+          ESP_LOGE(TAG, "Failed to queue the aggregator for commissioning: %s", esp_err_to_name(err));
+      }
 }
 
 static app_driver_handle_t app_driver_button_init()
@@ -263,10 +274,11 @@ static app_driver_handle_t app_driver_button_init()
 extern "C" void app_main()
 {
     int rc;
-    is_commissioned = 0;
     esp_err_t err = ESP_OK;
     /* Initialize the ESP NVS layer */
     nvs_flash_init();
+    /* Uplink pushes stay gated until the aggregator is commissioned; after a reboot the record in NVS says so */
+    is_commissioned = commission_queue_is_commissioned(CONFIG_BEACON_MEDIATOR_AGGREGATOR_NODE_ID) ? 1 : 0;
     ESP_ERROR_CHECK(esp_nimble_hci_and_controller_init());
     nimble_port_init();
 
@@ -292,12 +304,23 @@ extern "C" void app_main()
         /// ESP_LOGE(TAG, "Matter start failed: %d", err);
     }
 
+    err = obs_uplink_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Observation uplink init failed: %d", err);
+    }
+
     esp_matter::console::diagnostics_register_commands();
     esp_matter::console::wifi_register_commands();
+    obs_uplink_register_commands();
+    commission_queue_register_commands();
     esp_matter::console::init();
 
     esp_matter::lock::chip_stack_lock(portMAX_DELAY);
     esp_matter::commissioner::init(5580);
+    err = commission_queue_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Commissioning queue init failed: %d", err);
+    }
     esp_matter::lock::chip_stack_unlock();
 
     esp_matter::console::controller_register_commands();
@@ -0,0 +1,579 @@
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <nvs.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_matter.h>
+#include <esp_matter_commissioner.h>
+#include <esp_matter_console.h>
+
+#include <controller/CHIPDeviceController.h>
+#include <setup_payload/ManualSetupPayloadParser.h>
+#include <setup_payload/QRCodeSetupPayloadParser.h>
+
+#include <commission_queue.h>
+#include <is_commissioned.h>
+
+static const char *TAG = "commission_queue";
+
+using namespace esp_matter;
+
+/* The DeviceCommissioner runs PASE establishment and the commissioning stages for one device at a
+ * time. The queue pipelines around that: a single DNS-SD browse resolves every pending device,
+ * PASE sessions are opened ahead while another device is being commissioned, and up to
+ * CHIP_CONFIG_CONTROLLER_MAX_ACTIVE_DEVICES devices hold a session at once. */
+#ifndef CHIP_CONFIG_CONTROLLER_MAX_ACTIVE_DEVICES
+#define CHIP_CONFIG_CONTROLLER_MAX_ACTIVE_DEVICES 4
+#endif
+
+#define QUEUE_LEN 64
+#define SETUP_CODE_LEN 24
+#define MAX_ATTEMPTS 5
+#define NVS_NAMESPACE "commission"
+#define NVS_KEY_LIST "queue"
+#define NVS_KEY_DONE "done"
+
+static constexpr uint32_t k_tick_ms = 500;
+static constexpr int64_t k_stage_timeout_us = 90 * 1000 * 1000;
+static constexpr int64_t k_retry_backoff_us = 5 * 1000 * 1000;
+static constexpr int64_t k_rediscover_us = 30 * 1000 * 1000;
+
+typedef enum {
+    ENTRY_FREE,
+    ENTRY_QUEUED,
+    ENTRY_DISCOVERED,
+    ENTRY_PASE,
+    ENTRY_PASE_READY,
+    ENTRY_COMMISSIONING,
+    ENTRY_DONE,
+    ENTRY_FAILED,
+} entry_state_t;
+
+static const char *state_names[] = {"free", "queued", "discovered", "pase", "pase_ready", "commissioning", "done",
+                                    "failed"};
+
+typedef struct {
+    uint64_t node_id;
+    char setup_code[SETUP_CODE_LEN];
+} persisted_entry_t;
+
+typedef struct {
+    entry_state_t state;
+    uint64_t node_id;
+    char setup_code[SETUP_CODE_LEN];
+    uint32_t pincode;
+    uint16_t discriminator;
+    bool has_discriminator;
+    bool short_discriminator;
+    bool persisted;
+    chip::Transport::PeerAddress peer;
+    uint8_t attempts;
+    int64_t stage_started_us;
+    int64_t retry_at_us;
+} entry_t;
+
+static entry_t s_entries[QUEUE_LEN];
+static entry_t *s_pase_entry;
+static entry_t *s_commissioning_entry;
+static bool s_discovering;
+static int64_t s_discovery_started_us;
+
+/* Throughput of the current run, from the first add after the queue went idle */
+static bool s_run_active;
+static int64_t s_run_started_us;
+static int64_t s_run_last_done_us;
+static uint32_t s_run_done;
+static uint32_t s_run_failed;
+
+static esp_err_t persist_list();
+static esp_err_t persist_done(uint64_t node_id);
+
+static chip::Controller::DeviceCommissioner *commissioner_get()
+{
+    return commissioner::get_device_commissioner();
+}
+
+static bool parse_setup_code(const char *code, entry_t *entry)
+{
+    chip::SetupPayload payload;
+    entry->has_discriminator = false;
+    entry->short_discriminator = false;
+    if (strncmp(code, "MT:", 3) == 0) {
+        if (chip::QRCodeSetupPayloadParser(code).populatePayload(payload) != CHIP_NO_ERROR) {
+            return false;
+        }
+        entry->has_discriminator = true;
+    } else if (strlen(code) == 11 || strlen(code) == 21) {
+        if (chip::ManualSetupPayloadParser(code).populatePayload(payload) != CHIP_NO_ERROR) {
+            return false;
+        }
+        entry->has_discriminator = true;
+        entry->short_discriminator = true;
+    } else {
+        char *end;
+        unsigned long pin = strtoul(code, &end, 10);
+        if (*code == '\0' || *end != '\0' || pin == 0 || pin > 99999998) {
+            return false;
+        }
+        entry->pincode = static_cast<uint32_t>(pin);
+        return true;
+    }
+    entry->pincode = payload.setUpPINCode;
+    entry->discriminator = payload.discriminator;
+    return true;
+}
+
+static size_t count_in(entry_state_t first, entry_state_t last)
+{
+    size_t count = 0;
+    for (int i = 0; i < QUEUE_LEN; i++) {
+        if (s_entries[i].state >= first && s_entries[i].state <= last) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static void fail(entry_t *entry, const char *stage, CHIP_ERROR err)
+{
+    entry->attempts++;
+    ESP_LOGW(TAG, "Node 0x%llx: %s failed (attempt %u/%u), err:%" CHIP_ERROR_FORMAT, entry->node_id, stage,
+             entry->attempts, MAX_ATTEMPTS, err.Format());
+    if (entry->attempts >= MAX_ATTEMPTS) {
+        entry->state = ENTRY_FAILED;
+        s_run_failed++;
+        return;
+    }
+    /* Back to discovery, the device may have moved or reopened its window on another address */
+    entry->state = ENTRY_QUEUED;
+    entry->retry_at_us = esp_timer_get_time() + k_retry_backoff_us * entry->attempts;
+}
+
+static void complete(entry_t *entry)
+{
+    int64_t now = esp_timer_get_time();
+    entry->state = ENTRY_DONE;
+    s_run_done++;
+    s_run_last_done_us = now;
+    ESP_LOGI(TAG, "Node 0x%llx commissioned in %u attempt(s), %u done in this run", entry->node_id,
+             entry->attempts + 1, s_run_done);
+    if (entry->persisted) {
+        entry->persisted = false;
+        persist_list();
+    }
+    persist_done(entry->node_id);
+    if (entry->node_id == CONFIG_BEACON_MEDIATOR_AGGREGATOR_NODE_ID) {
+        is_commissioned = 1;
+    }
+}
+
+/*------------------------------ Delegates ------------------------------*/
+
+class queue_delegate : public chip::Controller::DevicePairingDelegate,
+                       public chip::Controller::DeviceDiscoveryDelegate {
+public:
+    void OnStatusUpdate(chip::Controller::DevicePairingDelegate::Status status) override {}
+
+    /* PASE result, only one device is ever in PASE establishment */
+    void OnPairingComplete(CHIP_ERROR error) override
+    {
+        entry_t *entry = s_pase_entry;
+        s_pase_entry = nullptr;
+        if (!entry || entry->state != ENTRY_PASE) {
+            return;
+        }
+        if (error != CHIP_NO_ERROR) {
+            fail(entry, "PASE", error);
+            return;
+        }
+        entry->state = ENTRY_PASE_READY;
+    }
+
+    void OnPairingDeleted(CHIP_ERROR error) override {}
+
+    void OnCommissioningComplete(chip::NodeId deviceId, CHIP_ERROR error) override
+    {
+        entry_t *entry = s_commissioning_entry;
+        s_commissioning_entry = nullptr;
+        if (!entry || entry->state != ENTRY_COMMISSIONING || entry->node_id != deviceId) {
+            return;
+        }
+        if (error != CHIP_NO_ERROR) {
+            fail(entry, "commissioning", error);
+            return;
+        }
+        complete(entry);
+    }
+
+    void OnDiscoveredDevice(const chip::Dnssd::DiscoveredNodeData &nodeData) override
+    {
+        if (nodeData.commissionData.commissioningMode == 0 || nodeData.resolutionData.numIPs == 0) {
+            return;
+        }
+        const chip::Inet::IPAddress &address = nodeData.resolutionData.ipAddress[0];
+        chip::Inet::InterfaceId interface_id =
+            address.IsIPv6LinkLocal() ? nodeData.resolutionData.interfaceId : chip::Inet::InterfaceId::Null();
+        chip::Transport::PeerAddress peer =
+            chip::Transport::PeerAddress::UDP(address, nodeData.resolutionData.port, interface_id);
+        uint16_t discriminator = nodeData.commissionData.longDiscriminator;
+
+        /* Ignore devices already claimed by another entry */
+        for (int i = 0; i < QUEUE_LEN; i++) {
+            if (s_entries[i].state >= ENTRY_DISCOVERED && s_entries[i].state <= ENTRY_COMMISSIONING &&
+                s_entries[i].peer == peer) {
+                return;
+            }
+        }
+
+        /* Entries with a discriminator get their own device; a bare PIN takes the first unclaimed one */
+        entry_t *match = nullptr;
+        int64_t now = esp_timer_get_time();
+        for (int i = 0; i < QUEUE_LEN; i++) {
+            entry_t *entry = &s_entries[i];
+            if (entry->state != ENTRY_QUEUED || entry->retry_at_us > now) {
+                continue;
+            }
+            if (entry->has_discriminator) {
+                bool same = entry->short_discriminator ? (entry->discriminator >> 8) == (discriminator >> 8)
+                                                       : entry->discriminator == discriminator;
+                if (same) {
+                    match = entry;
+                    break;
+                }
+            } else if (!match) {
+                match = entry;
+            }
+        }
+        if (match) {
+            match->peer = peer;
+            match->state = ENTRY_DISCOVERED;
+        }
+    }
+};
+
+static queue_delegate s_delegate;
+
+/*------------------------------ Scheduler ------------------------------*/
+
+static void schedule(chip::System::Layer *layer, void *arg);
+
+static void start_timer()
+{
+    chip::DeviceLayer::SystemLayer().StartTimer(chip::System::Clock::Milliseconds32(k_tick_ms), schedule, nullptr);
+}
+
+static void check_timeouts(int64_t now)
+{
+    for (int i = 0; i < QUEUE_LEN; i++) {
+        entry_t *entry = &s_entries[i];
+        bool active = entry->state == ENTRY_PASE || entry->state == ENTRY_PASE_READY ||
+            entry->state == ENTRY_COMMISSIONING;
+        if (!active || now - entry->stage_started_us < k_stage_timeout_us) {
+            continue;
+        }
+        commissioner_get()->StopPairing(entry->node_id);
+        if (entry == s_pase_entry) {
+            s_pase_entry = nullptr;
+        }
+        if (entry == s_commissioning_entry) {
+            s_commissioning_entry = nullptr;
+        }
+        fail(entry, state_names[entry->state], CHIP_ERROR_TIMEOUT);
+    }
+}
+
+static void schedule(chip::System::Layer *layer, void *arg)
+{
+    chip::Controller::DeviceCommissioner *commissioner = commissioner_get();
+    int64_t now = esp_timer_get_time();
+    check_timeouts(now);
+
+    /* Keep one browse running while anything still needs an address */
+    size_t queued = count_in(ENTRY_QUEUED, ENTRY_QUEUED);
+    if (queued > 0 && (!s_discovering || now - s_discovery_started_us > k_rediscover_us)) {
+        commissioner->RegisterDeviceDiscoveryDelegate(&s_delegate);
+        if (commissioner->DiscoverCommissionableNodes(chip::Dnssd::DiscoveryFilter()) == CHIP_NO_ERROR) {
+            s_discovering = true;
+            s_discovery_started_us = now;
+        }
+    } else if (queued == 0 && s_discovering) {
+        commissioner->RegisterDeviceDiscoveryDelegate(nullptr);
+        s_discovering = false;
+    }
+
+    /* Commission the next device that already has a PASE session */
+    if (!s_commissioning_entry) {
+        for (int i = 0; i < QUEUE_LEN; i++) {
+            entry_t *entry = &s_entries[i];
+            if (entry->state != ENTRY_PASE_READY) {
+                continue;
+            }
+            chip::Controller::CommissioningParameters params;
+            commissioner->RegisterPairingDelegate(&s_delegate);
+            CHIP_ERROR err = commissioner->Commission(entry->node_id, params);
+            if (err != CHIP_NO_ERROR) {
+                fail(entry, "commissioning", err);
+                continue;
+            }
+            entry->state = ENTRY_COMMISSIONING;
+            entry->stage_started_us = now;
+            s_commissioning_entry = entry;
+            break;
+        }
+    }
+
+    /* Open the next PASE session ahead, bounded by the number of device proxies */
+    size_t active = count_in(ENTRY_PASE, ENTRY_COMMISSIONING);
+    if (!s_pase_entry && active < CHIP_CONFIG_CONTROLLER_MAX_ACTIVE_DEVICES) {
+        for (int i = 0; i < QUEUE_LEN; i++) {
+            entry_t *entry = &s_entries[i];
+            if (entry->state != ENTRY_DISCOVERED) {
+                continue;
+            }
+            chip::RendezvousParameters params =
+                chip::RendezvousParameters().SetSetupPINCode(entry->pincode).SetPeerAddress(entry->peer);
+            commissioner->RegisterPairingDelegate(&s_delegate);
+            CHIP_ERROR err = commissioner->EstablishPASEConnection(entry->node_id, params);
+            if (err != CHIP_NO_ERROR) {
+                fail(entry, "PASE", err);
+                continue;
+            }
+            entry->state = ENTRY_PASE;
+            entry->stage_started_us = now;
+            s_pase_entry = entry;
+            break;
+        }
+    }
+
+    if (count_in(ENTRY_QUEUED, ENTRY_COMMISSIONING) > 0) {
+        start_timer();
+    } else if (s_run_active) {
+        int64_t elapsed_us = s_run_last_done_us - s_run_started_us;
+        ESP_LOGI(TAG, "Queue empty: %u commissioned, %u failed, %.1f devices/min", s_run_done, s_run_failed,
+                 elapsed_us > 0 ? s_run_done * 60e6 / elapsed_us : 0.0);
+        s_run_active = false;
+    }
+}
+
+/*------------------------------ Persistence ------------------------------*/
+
+static esp_err_t persist_list()
+{
+    static persisted_entry_t list[QUEUE_LEN];
+    size_t count = 0;
+    for (int i = 0; i < QUEUE_LEN; i++) {
+        if (s_entries[i].persisted) {
+            list[count].node_id = s_entries[i].node_id;
+            memcpy(list[count].setup_code, s_entries[i].setup_code, SETUP_CODE_LEN);
+            count++;
+        }
+    }
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = count ? nvs_set_blob(handle, NVS_KEY_LIST, list, count * sizeof(list[0])) : nvs_erase_key(handle, NVS_KEY_LIST);
+    if (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+/* Nodes commissioned by this mediator, kept in the same namespace so a factory reset forgets them
+ * together with the fabric */
+static size_t load_done(uint64_t *nodes)
+{
+    nvs_handle_t handle;
+    size_t size = QUEUE_LEN * sizeof(nodes[0]);
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK) {
+        return 0;
+    }
+    err = nvs_get_blob(handle, NVS_KEY_DONE, nodes, &size);
+    nvs_close(handle);
+    return err == ESP_OK ? size / sizeof(nodes[0]) : 0;
+}
+
+static esp_err_t persist_done(uint64_t node_id)
+{
+    static uint64_t nodes[QUEUE_LEN];
+    size_t count = load_done(nodes);
+    for (size_t i = 0; i < count; i++) {
+        if (nodes[i] == node_id) {
+            return ESP_OK;
+        }
+    }
+    if (count == QUEUE_LEN) {
+        /* Forget the oldest */
+        memmove(nodes, nodes + 1, (QUEUE_LEN - 1) * sizeof(nodes[0]));
+        count--;
+    }
+    nodes[count++] = node_id;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(handle, NVS_KEY_DONE, nodes, count * sizeof(nodes[0]));
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+static esp_err_t enqueue(uint64_t node_id, const char *setup_code, bool persist, bool save)
+{
+    if (strlen(setup_code) >= SETUP_CODE_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    entry_t *slot = nullptr;
+    for (int i = 0; i < QUEUE_LEN; i++) {
+        entry_t *entry = &s_entries[i];
+        if (entry->state != ENTRY_FREE && entry->state != ENTRY_DONE && entry->state != ENTRY_FAILED &&
+            entry->node_id == node_id) {
+            ESP_LOGW(TAG, "Node 0x%llx is already queued", node_id);
+            return ESP_ERR_INVALID_STATE;
+        }
+        if (!slot && (entry->state == ENTRY_FREE || entry->state == ENTRY_DONE || entry->state == ENTRY_FAILED)) {
+            slot = entry;
+        }
+    }
+    if (!slot) {
+        return ESP_ERR_NO_MEM;
+    }
+    entry_t entry = {};
+    if (!parse_setup_code(setup_code, &entry)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    entry.state = ENTRY_QUEUED;
+    entry.node_id = node_id;
+    strcpy(entry.setup_code, setup_code);
+    entry.persisted = persist;
+    *slot = entry;
+
+    if (!s_run_active) {
+        s_run_active = true;
+        s_run_started_us = esp_timer_get_time();
+        s_run_last_done_us = s_run_started_us;
+        s_run_done = 0;
+        s_run_failed = 0;
+        start_timer();
+    }
+    return save ? persist_list() : ESP_OK;
+}
+
+/*------------------------------ API ------------------------------*/
+
+esp_err_t commission_queue_add(uint64_t node_id, const char *setup_code, bool persist)
+{
+    lock::chip_stack_lock(portMAX_DELAY);
+    esp_err_t err = enqueue(node_id, setup_code, persist, persist);
+    lock::chip_stack_unlock();
+    return err;
+}
+
+bool commission_queue_is_commissioned(uint64_t node_id)
+{
+    static uint64_t nodes[QUEUE_LEN];
+    size_t count = load_done(nodes);
+    for (size_t i = 0; i < count; i++) {
+        if (nodes[i] == node_id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+esp_err_t commission_queue_init()
+{
+    static persisted_entry_t list[QUEUE_LEN];
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_OK;
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    size_t size = sizeof(list);
+    err = nvs_get_blob(handle, NVS_KEY_LIST, list, &size);
+    nvs_close(handle);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_OK;
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    size_t count = size / sizeof(list[0]);
+    for (size_t i = 0; i < count; i++) {
+        list[i].setup_code[SETUP_CODE_LEN - 1] = '\0';
+        enqueue(list[i].node_id, list[i].setup_code, true, false);
+    }
+    ESP_LOGI(TAG, "Restored %u queued device(s) from NVS", count);
+    return ESP_OK;
+}
+
+/*------------------------------ Console ------------------------------*/
+
+static esp_err_t commission_console_handler(int argc, char **argv)
+{
+    if (argc >= 3 && strcmp(argv[0], "add") == 0) {
+        uint64_t node_id = strtoull(argv[1], NULL, 0);
+        bool persist = !(argc >= 4 && strcmp(argv[3], "--no-save") == 0);
+        esp_err_t err = commission_queue_add(node_id, argv[2], persist);
+        if (err != ESP_OK) {
+            printf("Failed to queue node 0x%llx: %s\n", node_id, esp_err_to_name(err));
+        }
+        return err;
+    }
+    if (argc >= 1 && strcmp(argv[0], "clear") == 0) {
+        lock::chip_stack_lock(portMAX_DELAY);
+        for (int i = 0; i < QUEUE_LEN; i++) {
+            entry_t *entry = &s_entries[i];
+            if (entry->state == ENTRY_QUEUED || entry->state == ENTRY_DISCOVERED || entry->state == ENTRY_DONE ||
+                entry->state == ENTRY_FAILED) {
+                entry->state = ENTRY_FREE;
+                entry->persisted = false;
+            }
+        }
+        esp_err_t err = persist_list();
+        lock::chip_stack_unlock();
+        return err;
+    }
+    if (argc >= 1 && strcmp(argv[0], "status") != 0) {
+        printf("Usage: matter esp commission [status | add <node_id> <setup_code> [--no-save] | clear]\n");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    lock::chip_stack_lock(portMAX_DELAY);
+    for (int i = 0; i < QUEUE_LEN; i++) {
+        const entry_t *entry = &s_entries[i];
+        if (entry->state != ENTRY_FREE) {
+            printf("0x%016llx  %-13s  attempts %u%s\n", entry->node_id, state_names[entry->state], entry->attempts,
+                   entry->persisted ? "  (nvs)" : "");
+        }
+    }
+    int64_t end_us = s_run_active ? esp_timer_get_time() : s_run_last_done_us;
+    int64_t elapsed_us = end_us - s_run_started_us;
+    printf("run: %u done, %u failed, %.1f devices/min, max active %d\n", s_run_done, s_run_failed,
+           elapsed_us > 0 ? s_run_done * 60e6 / elapsed_us : 0.0, CHIP_CONFIG_CONTROLLER_MAX_ACTIVE_DEVICES);
+    lock::chip_stack_unlock();
+    return ESP_OK;
+}
+
+esp_err_t commission_queue_register_commands()
+{
+    static const esp_matter::console::command_t command = {
+        .name = "commission",
+        .description = "Commissioning queue. Usage: matter esp commission [status | add <node_id> <setup_code> "
+                       "[--no-save] | clear]",
+        .handler = commission_console_handler,
+    };
+    return esp_matter::console::add_commands(&command, 1);
+}
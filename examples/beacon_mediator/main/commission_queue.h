@@ -0,0 +1,42 @@
+#pragma once
+
+#include <esp_err.h>
+#include <stdint.h>
+
+/** Initialize the commissioning queue
+ *
+ * Restores the entries persisted in NVS and starts working through them. Must be called
+ * after the commissioner is initialized, with the CHIP stack lock held.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t commission_queue_init();
+
+/** Queue a device for commissioning
+ *
+ * Takes the CHIP stack lock.
+ *
+ * @param[in] node_id Node ID to give the device.
+ * @param[in] setup_code Manual pairing code, QR code payload ("MT:...") or bare setup PIN.
+ * @param[in] persist Store the entry in NVS until it is commissioned.
+ *
+ * @return ESP_OK on success.
+ * @return ESP_ERR_INVALID_ARG if the setup code can not be parsed.
+ * @return ESP_ERR_NO_MEM if the queue is full.
+ */
+esp_err_t commission_queue_add(uint64_t node_id, const char *setup_code, bool persist);
+
+/** Whether a node was commissioned by this mediator
+ *
+ * Reads the nodes recorded in NVS when their commissioning completed, so the answer survives a
+ * reboot. Does not need the CHIP stack.
+ *
+ * @param[in] node_id Node ID to look up.
+ *
+ * @return true if the node was commissioned and the record was not erased since.
+ */
+bool commission_queue_is_commissioned(uint64_t node_id);
+
+/** Register the `commission` console command */
+esp_err_t commission_queue_register_commands();
@@ -0,0 +1,216 @@
+#include <string.h>
+
+#include "obs_ring.h"
+
+#define OBS_RING_MAGIC 0x3253424F /* "OBS2", bumped whenever obs_ring_rec_t changes */
+#define OBS_RING_MARKER 0x5A
+#define OBS_RING_NOT_DRAINED 0xFFFFFFFF
+
+typedef struct {
+    uint32_t magic;
+    uint32_t generation;
+    uint32_t drained;       /* Cleared to 0 once the reader has left the sector */
+    uint32_t reserved;
+} obs_ring_head_t;
+
+static uint32_t sector_offset(const obs_ring_t *ring, uint32_t generation)
+{
+    return (generation % ring->sector_count) * ring->flash.sector_size;
+}
+
+static uint32_t record_offset(const obs_ring_t *ring, uint64_t pos)
+{
+    uint32_t generation = (uint32_t)(pos / ring->recs_per_sector);
+    uint32_t slot = (uint32_t)(pos % ring->recs_per_sector);
+    return sector_offset(ring, generation) + sizeof(obs_ring_head_t) + slot * sizeof(obs_ring_rec_t);
+}
+
+static int read_head(const obs_ring_t *ring, uint32_t index, obs_ring_head_t *head)
+{
+    int rc = ring->flash.read(ring->flash.ctx, index * ring->flash.sector_size, head, sizeof(*head));
+    if (rc != 0) {
+        return rc;
+    }
+    if (head->magic != OBS_RING_MAGIC || head->generation % ring->sector_count != index) {
+        head->magic = 0;
+    }
+    return 0;
+}
+
+static int is_erased(const void *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] != 0xFF) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int open_sector(obs_ring_t *ring, uint32_t generation)
+{
+    uint32_t offset = sector_offset(ring, generation);
+    int rc = ring->flash.erase(ring->flash.ctx, offset, ring->flash.sector_size);
+    if (rc != 0) {
+        return rc;
+    }
+    ring->stats.erases++;
+
+    /* The sector held generation - sector_count, whatever was left unread there is gone */
+    if (generation >= ring->sector_count) {
+        uint64_t first_kept = (uint64_t)(generation - ring->sector_count + 1) * ring->recs_per_sector;
+        if (ring->read_pos < first_kept) {
+            ring->stats.overwritten += (uint32_t)(first_kept - ring->read_pos);
+            ring->read_pos = first_kept;
+        }
+    }
+
+    obs_ring_head_t head = {
+        .magic = OBS_RING_MAGIC,
+        .generation = generation,
+        .drained = OBS_RING_NOT_DRAINED,
+        .reserved = 0xFFFFFFFF,
+    };
+    return ring->flash.write(ring->flash.ctx, offset, &head, sizeof(head));
+}
+
+static int mark_drained(obs_ring_t *ring, uint32_t generation)
+{
+    uint32_t drained = 0;
+    return ring->flash.write(ring->flash.ctx, sector_offset(ring, generation) + offsetof(obs_ring_head_t, drained),
+                             &drained, sizeof(drained));
+}
+
+int obs_ring_init(obs_ring_t *ring, const obs_ring_flash_t *flash)
+{
+    memset(ring, 0, sizeof(*ring));
+    ring->flash = *flash;
+    if (flash->sector_size <= sizeof(obs_ring_head_t) + sizeof(obs_ring_rec_t) || flash->size % flash->sector_size) {
+        return -1;
+    }
+    ring->sector_count = flash->size / flash->sector_size;
+    ring->recs_per_sector = (flash->sector_size - sizeof(obs_ring_head_t)) / sizeof(obs_ring_rec_t);
+    if (ring->sector_count < 2) {
+        return -1;
+    }
+
+    /* Find the newest sector, it holds the write position */
+    obs_ring_head_t head;
+    int found = 0;
+    uint32_t newest = 0;
+    for (uint32_t i = 0; i < ring->sector_count; i++) {
+        int rc = read_head(ring, i, &head);
+        if (rc != 0) {
+            return rc;
+        }
+        if (head.magic && (!found || head.generation > newest)) {
+            newest = head.generation;
+            found = 1;
+        }
+    }
+    if (!found) {
+        return 0;
+    }
+
+    uint32_t slot = 0;
+    for (; slot < ring->recs_per_sector; slot++) {
+        obs_ring_rec_t rec;
+        int rc = ring->flash.read(ring->flash.ctx, record_offset(ring, (uint64_t)newest * ring->recs_per_sector + slot),
+                                  &rec, sizeof(rec));
+        if (rc != 0) {
+            return rc;
+        }
+        if (is_erased(&rec, sizeof(rec))) {
+            break;
+        }
+        if (rec.marker != OBS_RING_MARKER) {
+            ring->stats.corrupt++;
+        }
+    }
+    ring->write_pos = (uint64_t)newest * ring->recs_per_sector + slot;
+
+    /* Walk back through the contiguous run of sectors ending at the newest one. The oldest of
+     * them that is not drained yet is where the reader resumes. */
+    uint32_t oldest_pending = newest;
+    int pending = 0;
+    for (uint32_t back = 0; back < ring->sector_count && back <= newest; back++) {
+        uint32_t generation = newest - back;
+        int rc = read_head(ring, generation % ring->sector_count, &head);
+        if (rc != 0) {
+            return rc;
+        }
+        if (!head.magic || head.generation != generation || head.drained != OBS_RING_NOT_DRAINED) {
+            break;
+        }
+        oldest_pending = generation;
+        pending = 1;
+    }
+    ring->read_pos = pending ? (uint64_t)oldest_pending * ring->recs_per_sector : ring->write_pos;
+    ring->boot_pos = ring->write_pos;
+    return 0;
+}
+
+int obs_ring_push(obs_ring_t *ring, const obs_ring_rec_t *rec)
+{
+    if (ring->write_pos % ring->recs_per_sector == 0) {
+        int rc = open_sector(ring, (uint32_t)(ring->write_pos / ring->recs_per_sector));
+        if (rc != 0) {
+            return rc;
+        }
+    }
+
+    obs_ring_rec_t stored = *rec;
+    stored.marker = OBS_RING_MARKER;
+    int rc = ring->flash.write(ring->flash.ctx, record_offset(ring, ring->write_pos), &stored, sizeof(stored));
+    if (rc != 0) {
+        return rc;
+    }
+    ring->write_pos++;
+    ring->stats.pushed++;
+    return 0;
+}
+
+size_t obs_ring_peek(obs_ring_t *ring, obs_ring_rec_t *out, size_t max, uint32_t *span, size_t *from_boot)
+{
+    size_t count = 0;
+    size_t old = 0;
+    uint64_t pos = ring->read_pos;
+    for (; count < max && pos < ring->write_pos; pos++) {
+        if (ring->flash.read(ring->flash.ctx, record_offset(ring, pos), &out[count], sizeof(out[count])) != 0) {
+            break;
+        }
+        if (out[count].marker != OBS_RING_MARKER) {
+            continue;
+        }
+        if (pos < ring->boot_pos) {
+            old++;
+        }
+        count++;
+    }
+    *span = (uint32_t)(pos - ring->read_pos);
+    if (from_boot) {
+        *from_boot = old;
+    }
+    return count;
+}
+
+int obs_ring_consume(obs_ring_t *ring, uint32_t span)
+{
+    uint64_t target = ring->read_pos + span;
+    if (target > ring->write_pos) {
+        target = ring->write_pos;
+    }
+    uint32_t from = (uint32_t)(ring->read_pos / ring->recs_per_sector);
+    uint32_t to = (uint32_t)(target / ring->recs_per_sector);
+    ring->stats.consumed += (uint32_t)(target - ring->read_pos);
+    ring->read_pos = target;
+
+    for (uint32_t generation = from; generation < to; generation++) {
+        int rc = mark_drained(ring, generation);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Store-and-forward ring of observations kept in a raw flash partition.
+ *
+ * The partition is split into sectors which are filled strictly in rotation, so every sector
+ * is erased once per lap and wear is spread evenly. Each sector starts with a header carrying
+ * a generation number; the sector used by generation g is g % sector_count, which lets the
+ * read and write positions be recovered after a reboot by scanning the headers only.
+ *
+ * The ring has no ESP-IDF dependency: flash access goes through `obs_ring_flash_t`, so it can
+ * be driven from a RAM-backed implementation on the host.
+ */
+
+typedef struct {
+    int (*read)(void *ctx, uint32_t offset, void *dst, size_t len);
+    int (*write)(void *ctx, uint32_t offset, const void *src, size_t len);
+    int (*erase)(void *ctx, uint32_t offset, size_t len);
+    void *ctx;
+    uint32_t size;          /* Multiple of sector_size, at least two sectors */
+    uint32_t sector_size;
+} obs_ring_flash_t;
+
+typedef struct {
+    uint32_t beacon;
+    uint16_t distance_cm;   /* Or beacon_obs_t raw levels, with BEACON_OBS_FLAG_RAW_RSSI */
+    uint8_t flags;
+    uint8_t marker;         /* Set by obs_ring_push(), tells a complete record from a torn one */
+    uint32_t captured_ms;
+    uint32_t seq;
+} obs_ring_rec_t;
+
+typedef struct {
+    uint32_t pushed;
+    uint32_t consumed;
+    uint32_t overwritten;   /* Oldest records lost because the ring was full */
+    uint32_t corrupt;       /* Torn records skipped while reading */
+    uint32_t erases;
+} obs_ring_stats_t;
+
+typedef struct {
+    obs_ring_flash_t flash;
+    uint32_t sector_count;
+    uint32_t recs_per_sector;
+    uint64_t read_pos;      /* Absolute record positions, generation * recs_per_sector + slot */
+    uint64_t write_pos;
+    uint64_t boot_pos;      /* Records before this position were written by a previous boot */
+    obs_ring_stats_t stats;
+} obs_ring_t;
+
+/** Initialize the ring
+ *
+ * Scans the sector headers to recover the read and write positions. Sectors without a valid
+ * header are treated as erased.
+ *
+ * @return 0 on success.
+ * @return negative value if the flash geometry is unusable or a flash access failed.
+ */
+int obs_ring_init(obs_ring_t *ring, const obs_ring_flash_t *flash);
+
+/** Append a record, overwriting the oldest sector when the ring is full
+ *
+ * @return 0 on success.
+ * @return negative value if a flash access failed.
+ */
+int obs_ring_push(obs_ring_t *ring, const obs_ring_rec_t *rec);
+
+/** Read records from the read position without consuming them
+ *
+ * @param[out] out Records read, torn records are skipped.
+ * @param[in] max Capacity of `out`.
+ * @param[out] span Number of ring positions covered, to be passed to obs_ring_consume().
+ * @param[out] from_boot Number of leading records in `out` written by a previous boot. Optional.
+ *
+ * @return number of records stored in `out`.
+ */
+size_t obs_ring_peek(obs_ring_t *ring, obs_ring_rec_t *out, size_t max, uint32_t *span, size_t *from_boot);
+
+/** Release records returned by obs_ring_peek()
+ *
+ * A sector is flagged as drained once the read position leaves it, so it is not replayed
+ * after a reboot.
+ *
+ * @return 0 on success.
+ * @return negative value if a flash access failed.
+ */
+int obs_ring_consume(obs_ring_t *ring, uint32_t span);
+
+/** Number of ring positions waiting to be drained */
+static inline uint32_t obs_ring_count(const obs_ring_t *ring)
+{
+    return (uint32_t)(ring->write_pos - ring->read_pos);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,538 @@
+#include <esp_log.h>
+#include <esp_mac.h>
+#include <esp_partition.h>
+#include <esp_spi_flash.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <nvs.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_matter.h>
+#include <esp_matter_commissioner.h>
+#include <esp_matter_console.h>
+
+#include <controller/WriteInteraction.h>
+
+#include <beacon_proto.h>
+#include <obs_ring.h>
+#include <obs_uplink.h>
+#include <shard_ring.h>
+#include <uplink_sched.h>
+
+static const char *TAG = "obs_uplink";
+
+using namespace esp_matter;
+
+#define LIVE_QUEUE_LEN (BEACON_PROTO_MAX_OBS * 2)
+
+/* Sequence numbers are reserved from NVS in blocks, so a reboot skips at most one block
+ * instead of restarting from zero. */
+#define SEQ_BLOCK 1024
+#define NVS_NAMESPACE "obs_uplink"
+#define NVS_KEY_SEQ "seq_base"
+#define NVS_KEY_SHARDS "shards"
+
+/* Report being written to one shard. From send_report() until a result with its context comes
+ * back the report belongs to the CHIP thread, even if the scheduler gave up on the write: the
+ * connection may still be set up and read the buffer. The next report of the shard goes into
+ * its other buffer, and the CHIP thread cancels the callbacks of one still connecting. */
+typedef struct {
+    uint64_t node_id;
+    uint8_t buf[BEACON_PROTO_REPORT_MAX_SIZE];
+    size_t len;
+    uint32_t context;
+    bool busy;                  /* Uplink task side, set until the result came back */
+    bool connecting;            /* CHIP thread side, callbacks registered and not run */
+    chip::Callback::Callback<chip::OnDeviceConnected> on_connected{nullptr, nullptr};
+    chip::Callback::Callback<chip::OnDeviceConnectionFailure> on_failure{nullptr, nullptr};
+} report_t;
+
+#define REPORT_BUFFERS 2
+
+/* Result posted back from the CHIP thread, `context` is the report ID << 4 | buffer << 3 | shard */
+typedef struct {
+    uint32_t context;
+    bool ok;
+} result_t;
+
+static QueueHandle_t s_live_queue;
+static QueueHandle_t s_result_queue;
+static const esp_partition_t *s_partition;
+static obs_ring_t s_ring;
+static uint16_t s_mediator_id;
+static uint32_t s_boot_seq;
+static uint32_t s_next_seq;
+static uint32_t s_seq_limit;
+static uint32_t s_queue_full;
+
+/* Beacon to aggregator routing, the lock guards s_shards and s_sched against console edits */
+static SemaphoreHandle_t s_shard_lock;
+static shard_ring_t s_shards;
+static uplink_sched_t s_sched;
+static report_t s_reports[SHARD_RING_MAX_SHARDS][REPORT_BUFFERS];
+
+static_assert(SHARD_RING_MAX_SHARDS == 8 && REPORT_BUFFERS == 2, "shard and buffer take the low 4 bits of a context");
+
+static constexpr uint32_t k_flight_timeout_ms = 15 * 1000;
+
+static uint32_t now_ms()
+{
+    return static_cast<uint32_t>(esp_timer_get_time() / 1000);
+}
+
+/*------------------------------ Flash ------------------------------*/
+
+static int flash_read(void *ctx, uint32_t offset, void *dst, size_t len)
+{
+    return esp_partition_read((const esp_partition_t *)ctx, offset, dst, len) == ESP_OK ? 0 : -1;
+}
+
+static int flash_write(void *ctx, uint32_t offset, const void *src, size_t len)
+{
+    return esp_partition_write((const esp_partition_t *)ctx, offset, src, len) == ESP_OK ? 0 : -1;
+}
+
+static int flash_erase(void *ctx, uint32_t offset, size_t len)
+{
+    return esp_partition_erase_range((const esp_partition_t *)ctx, offset, len) == ESP_OK ? 0 : -1;
+}
+
+/*------------------------------ Matter write ------------------------------*/
+
+static uint32_t report_context(uint32_t id, int buffer, uint8_t shard)
+{
+    return (id << 4) | (buffer << 3) | shard;
+}
+
+static report_t *context_report(uint32_t context)
+{
+    return &s_reports[context % SHARD_RING_MAX_SHARDS][(context >> 3) % REPORT_BUFFERS];
+}
+
+static void post_result(uint32_t context, bool ok)
+{
+    result_t result = {context, ok};
+    xQueueSend(s_result_queue, &result, 0);
+}
+
+static void on_device_connected(void *context, chip::Messaging::ExchangeManager &exchangeMgr,
+                                chip::SessionHandle &sessionHandle)
+{
+    uint32_t id = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(context));
+    report_t *report = context_report(id);
+    report->connecting = false;
+    auto on_success = [id](const chip::app::ConcreteAttributePath &path) { post_result(id, true); };
+    auto on_failure = [id](const chip::app::ConcreteAttributePath *path, CHIP_ERROR error) {
+        ESP_LOGE(TAG, "Report write failed, err:%" CHIP_ERROR_FORMAT, error.Format());
+        post_result(id, false);
+    };
+    CHIP_ERROR err = chip::Controller::WriteAttribute<chip::ByteSpan>(
+        sessionHandle, BEACON_PROTO_ENDPOINT_ID, BEACON_PROTO_CLUSTER_ID, BEACON_PROTO_ATTR_REPORT_ID,
+        chip::ByteSpan(report->buf, report->len), on_success, on_failure, chip::NullOptional);
+    if (err != CHIP_NO_ERROR) {
+        post_result(id, false);
+    }
+}
+
+static void on_device_connection_failure(void *context, const chip::ScopedNodeId &peerId, CHIP_ERROR error)
+{
+    ESP_LOGW(TAG, "Aggregator 0x%llx unreachable, err:%" CHIP_ERROR_FORMAT, peerId.GetNodeId(), error.Format());
+    uint32_t id = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(context));
+    context_report(id)->connecting = false;
+    post_result(id, false);
+}
+
+static void send_work(intptr_t arg)
+{
+    void *context = reinterpret_cast<void *>(arg);
+    uint32_t id = static_cast<uint32_t>(arg);
+    report_t *report = context_report(id);
+    /* The scheduler timed the other report out, typically while CASE was still being set up.
+     * Its callbacks must not run for a write nobody waits for; the result posted here hands its
+     * buffer back to the uplink task. */
+    report_t *other = context_report(id ^ (1u << 3));
+    if (other->connecting) {
+        other->on_connected.Cancel();
+        other->on_failure.Cancel();
+        other->connecting = false;
+        post_result(other->context, false);
+    }
+    report->connecting = true;
+    report->on_connected.mCall = on_device_connected;
+    report->on_connected.mContext = context;
+    report->on_failure.mCall = on_device_connection_failure;
+    report->on_failure.mContext = context;
+    CHIP_ERROR err = commissioner::get_device_commissioner()->GetConnectedDevice(report->node_id, &report->on_connected,
+                                                                                  &report->on_failure);
+    if (err != CHIP_NO_ERROR) {
+        report->connecting = false;
+        post_result(id, false);
+    }
+}
+
+/* uplink_sched send hook, called with s_shard_lock held */
+static int send_report(void *ctx, uint8_t shard, uint32_t id, uplink_kind_t kind, const obs_ring_rec_t *recs,
+                       size_t count)
+{
+    int buffer = 0;
+    while (buffer < REPORT_BUFFERS && s_reports[shard][buffer].busy) {
+        buffer++;
+    }
+    if (buffer == REPORT_BUFFERS) {
+        /* Both still with the CHIP thread, the scheduler treats this as a failed write */
+        return -1;
+    }
+    report_t *report = &s_reports[shard][buffer];
+    uint32_t now = now_ms();
+    beacon_report_head_t *head = (beacon_report_head_t *)report->buf;
+    beacon_obs_t *obs = (beacon_obs_t *)(head + 1);
+    head->version = BEACON_PROTO_VERSION;
+    head->count = static_cast<uint8_t>(count);
+    head->mediator = s_mediator_id;
+    head->boot_seq = s_boot_seq;
+    for (size_t i = 0; i < count; i++) {
+        const obs_ring_rec_t *rec = &recs[i];
+        obs[i].beacon = rec->beacon;
+        obs[i].distance_cm = rec->distance_cm;
+        obs[i].flags = rec->flags;
+        obs[i].reserved = 0;
+        obs[i].age_ms = (rec->flags & BEACON_OBS_FLAG_AGE_UNKNOWN) ? 0 : now - rec->captured_ms;
+        obs[i].seq = rec->seq;
+        if (kind == UPLINK_BACKLOG) {
+            obs[i].flags |= BEACON_OBS_FLAG_BACKLOG;
+        }
+    }
+    report->len = BEACON_PROTO_REPORT_SIZE(count);
+    report->node_id = s_shards.nodes[shard];
+    /* Probes are empty reports, the aggregator accepts them and the write tells if it is back */
+    report->context = report_context(id, buffer, shard);
+    report->busy = true;
+    chip::DeviceLayer::PlatformMgr().ScheduleWork(send_work, static_cast<intptr_t>(report->context));
+    return 0;
+}
+
+/* Caller holds s_shard_lock */
+static void handle_result(const result_t *result)
+{
+    report_t *report = context_report(result->context);
+    if (report->busy && report->context == result->context) {
+        report->busy = false;
+    }
+    uint8_t shard = result->context % SHARD_RING_MAX_SHARDS;
+    int buffer = (result->context >> 3) % REPORT_BUFFERS;
+    uint32_t id = s_sched.links[shard].id;
+    if (report_context(id, buffer, shard) == result->context) {
+        uplink_sched_complete(&s_sched, shard, id, result->ok, now_ms());
+    }
+}
+
+/*------------------------------ Task ------------------------------*/
+
+/* Caller holds s_shard_lock */
+static void log_changes(const uint8_t *was_up, uint32_t drains)
+{
+    for (int shard = 0; shard < SHARD_RING_MAX_SHARDS; shard++) {
+        const uplink_link_t *link = &s_sched.links[shard];
+        if (!s_shards.used[shard] || link->up == was_up[shard]) {
+            continue;
+        }
+        if (link->up) {
+            ESP_LOGI(TAG, "Aggregator 0x%llx reachable again, %u observations in backlog", s_shards.nodes[shard],
+                     obs_ring_count(&s_ring));
+        } else {
+            ESP_LOGW(TAG, "Aggregator 0x%llx unreachable, storing its observations in flash", s_shards.nodes[shard]);
+        }
+    }
+    if (s_sched.stats.drains != drains) {
+        uint32_t elapsed_ms = s_sched.stats.last_drain_ms;
+        ESP_LOGI(TAG, "Backlog drained: %u observations in %u ms (%u obs/s)", s_sched.stats.last_drain_sent,
+                 elapsed_ms, elapsed_ms > 0 ? static_cast<uint32_t>(s_sched.stats.last_drain_sent * 1000ULL / elapsed_ms) : 0);
+    }
+}
+
+static void uplink_task(void *arg)
+{
+    for (;;) {
+        result_t result;
+        bool got = xQueueReceive(s_result_queue, &result, pdMS_TO_TICKS(CONFIG_BEACON_MEDIATOR_UPLINK_PERIOD_MS)) == pdTRUE;
+        xSemaphoreTake(s_shard_lock, portMAX_DELAY);
+        uint8_t was_up[SHARD_RING_MAX_SHARDS];
+        for (int shard = 0; shard < SHARD_RING_MAX_SHARDS; shard++) {
+            was_up[shard] = s_sched.links[shard].up;
+        }
+        uint32_t drains = s_sched.stats.drains;
+
+        while (got) {
+            handle_result(&result);
+            got = xQueueReceive(s_result_queue, &result, 0) == pdTRUE;
+        }
+        /* The live queue is drained even while reports are in flight, what does not fit the next
+         * report of its shard goes to flash rather than being dropped */
+        obs_ring_rec_t rec;
+        while (xQueueReceive(s_live_queue, &rec, 0) == pdTRUE) {
+            uplink_sched_route(&s_sched, &rec);
+        }
+        uplink_sched_poll(&s_sched, now_ms());
+
+        log_changes(was_up, drains);
+        xSemaphoreGive(s_shard_lock);
+    }
+}
+
+/*------------------------------ Shards ------------------------------*/
+
+static esp_err_t persist_shards()
+{
+    uint64_t nodes[SHARD_RING_MAX_SHARDS];
+    size_t count = 0;
+    for (int shard = 0; shard < SHARD_RING_MAX_SHARDS; shard++) {
+        if (s_shards.used[shard]) {
+            nodes[count++] = s_shards.nodes[shard];
+        }
+    }
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(handle, NVS_KEY_SHARDS, nodes, count * sizeof(nodes[0]));
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+static void load_shards()
+{
+    uint64_t nodes[SHARD_RING_MAX_SHARDS];
+    size_t size = sizeof(nodes);
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err == ESP_OK) {
+        err = nvs_get_blob(handle, NVS_KEY_SHARDS, nodes, &size);
+        nvs_close(handle);
+    }
+    shard_ring_init(&s_shards);
+    if (err != ESP_OK) {
+        /* Nothing configured yet, everything goes to the single aggregator */
+        nodes[0] = CONFIG_BEACON_MEDIATOR_AGGREGATOR_NODE_ID;
+        size = sizeof(nodes[0]);
+    }
+    for (size_t i = 0; i < size / sizeof(nodes[0]); i++) {
+        shard_ring_add(&s_shards, nodes[i]);
+    }
+}
+
+static esp_err_t shard_update(uint64_t node_id, bool add)
+{
+    xSemaphoreTake(s_shard_lock, portMAX_DELAY);
+    uint8_t count = s_shards.count;
+    int shard = add ? shard_ring_add(&s_shards, node_id) : shard_ring_remove(&s_shards, node_id);
+    if (shard >= 0 && add && s_shards.count != count) {
+        uplink_sched_link_reset(&s_sched, static_cast<uint8_t>(shard));
+    }
+    esp_err_t err = shard < 0 ? (add ? ESP_ERR_NO_MEM : ESP_ERR_NOT_FOUND) : persist_shards();
+    xSemaphoreGive(s_shard_lock);
+    return err;
+}
+
+/*------------------------------ Console ------------------------------*/
+
+static void print_shards()
+{
+    xSemaphoreTake(s_shard_lock, portMAX_DELAY);
+    for (int shard = 0; shard < SHARD_RING_MAX_SHARDS; shard++) {
+        if (!s_shards.used[shard]) {
+            continue;
+        }
+        const uplink_link_t *link = &s_sched.links[shard];
+        printf("shard %d: node 0x%llx link %s sent %u failures %u\n", shard, s_shards.nodes[shard],
+               link->up ? "up" : "down", link->sent, link->failures);
+    }
+    xSemaphoreGive(s_shard_lock);
+}
+
+static esp_err_t uplink_console_handler(int argc, char **argv)
+{
+    if (argc >= 3 && strcmp(argv[0], "shard") == 0) {
+        uint64_t node_id = strtoull(argv[2], NULL, 0);
+        bool add = strcmp(argv[1], "add") == 0;
+        if (!add && strcmp(argv[1], "remove") != 0) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        esp_err_t err = shard_update(node_id, add);
+        if (err != ESP_OK) {
+            printf("Failed to %s aggregator 0x%llx: %s\n", argv[1], node_id, esp_err_to_name(err));
+        }
+        return err;
+    }
+    if (argc >= 1 && strcmp(argv[0], "shards") == 0) {
+        print_shards();
+        return ESP_OK;
+    }
+    if (argc >= 1) {
+        printf("Usage: matter esp uplink [shards | shard add <node_id> | shard remove <node_id>]\n");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    printf("mediator: 0x%04x\n", s_mediator_id);
+    printf("boot_seq: %u\nnext_seq: %u\n", s_boot_seq, s_next_seq);
+    xSemaphoreTake(s_shard_lock, portMAX_DELAY);
+    const uplink_sched_stats_t stats = s_sched.stats;
+    xSemaphoreGive(s_shard_lock);
+    printf("live_sent: %u\nbacklog_sent: %u\nspilled: %u\nparked: %u\nqueue_full: %u\n", stats.live_sent,
+           stats.backlog_sent, stats.spilled, stats.parked, s_queue_full);
+    printf("write_failures: %u\ntimeouts: %u\nprobes: %u\nreconnects: %u\nflash_failures: %u\n",
+           stats.write_failures, stats.timeouts, stats.probes, stats.reconnects, stats.flash_failures);
+    printf("backlog: %u\nring_overwritten: %u\nring_corrupt: %u\nring_erases: %u\n", obs_ring_count(&s_ring),
+           s_ring.stats.overwritten, s_ring.stats.corrupt, s_ring.stats.erases);
+    print_shards();
+    return ESP_OK;
+}
+
+esp_err_t obs_uplink_register_commands()
+{
+    static const esp_matter::console::command_t command = {
+        .name = "uplink",
+        .description = "Observation uplink statistics and aggregator shards. "
+                       "Usage: matter esp uplink [shards | shard add <node_id> | shard remove <node_id>]",
+        .handler = uplink_console_handler,
+    };
+    return esp_matter::console::add_commands(&command, 1);
+}
+
+/*------------------------------ Sequence ------------------------------*/
+
+static esp_err_t reserve_seq_block(uint32_t *base)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    uint32_t stored = 0;
+    err = nvs_get_u32(handle, NVS_KEY_SEQ, &stored);
+    if (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND) {
+        if (stored < *base) {
+            stored = *base;
+        }
+        err = nvs_set_u32(handle, NVS_KEY_SEQ, stored + SEQ_BLOCK);
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+    }
+    nvs_close(handle);
+    if (err == ESP_OK) {
+        *base = stored;
+    }
+    return err;
+}
+
+/*------------------------------ API ------------------------------*/
+
+static esp_err_t push(obs_ring_rec_t &rec)
+{
+    rec.captured_ms = now_ms();
+    if (s_next_seq == s_seq_limit) {
+        uint32_t base = s_seq_limit;
+        if (reserve_seq_block(&base) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to persist sequence block");
+        }
+        s_next_seq = base;
+        s_seq_limit = base + SEQ_BLOCK;
+    }
+    /* Numbered before queueing, so a full queue shows up as loss on the aggregator */
+    rec.seq = s_next_seq++;
+    if (xQueueSend(s_live_queue, &rec, 0) != pdTRUE) {
+        s_queue_full++;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t obs_uplink_push(uint32_t beacon, uint16_t distance_cm)
+{
+    obs_ring_rec_t rec = {};
+    rec.beacon = beacon;
+    rec.distance_cm = distance_cm;
+    return push(rec);
+}
+
+esp_err_t obs_uplink_push_rssi(uint32_t beacon, int8_t rssi, int8_t measured_power)
+{
+    beacon_obs_t obs = {};
+    obs.raw.rssi = rssi;
+    obs.raw.measured_power = measured_power;
+    obs_ring_rec_t rec = {};
+    rec.beacon = beacon;
+    rec.distance_cm = obs.distance_cm;
+    rec.flags = BEACON_OBS_FLAG_RAW_RSSI;
+    return push(rec);
+}
+
+uint16_t obs_uplink_mediator_id()
+{
+    return s_mediator_id;
+}
+
+esp_err_t obs_uplink_init()
+{
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    s_mediator_id = static_cast<uint16_t>(mac[4] << 8 | mac[5]);
+
+    if (reserve_seq_block(&s_boot_seq) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to restore the sequence number");
+    }
+    s_next_seq = s_boot_seq;
+    s_seq_limit = s_boot_seq + SEQ_BLOCK;
+
+    s_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "obs_ring");
+    if (!s_partition) {
+        ESP_LOGE(TAG, "obs_ring partition not found");
+        return ESP_ERR_NOT_FOUND;
+    }
+    obs_ring_flash_t flash = {
+        .read = flash_read,
+        .write = flash_write,
+        .erase = flash_erase,
+        .ctx = (void *)s_partition,
+        .size = s_partition->size,
+        .sector_size = SPI_FLASH_SEC_SIZE,
+    };
+    if (obs_ring_init(&s_ring, &flash) != 0) {
+        ESP_LOGE(TAG, "Failed to initialize the observation ring");
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Mediator 0x%04x, sequence %u, %u observations in backlog", s_mediator_id, s_boot_seq,
+             obs_ring_count(&s_ring));
+
+    s_shard_lock = xSemaphoreCreateMutex();
+    if (!s_shard_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+    load_shards();
+    uplink_sched_config_t config = {
+        .send = send_report,
+        .ctx = nullptr,
+        .probe_period_ms = CONFIG_BEACON_MEDIATOR_PROBE_PERIOD_MS,
+        .flight_timeout_ms = k_flight_timeout_ms,
+        .backlog_rate = CONFIG_BEACON_MEDIATOR_BACKLOG_RATE,
+    };
+    uplink_sched_init(&s_sched, &config, &s_ring, &s_shards, now_ms());
+
+    s_live_queue = xQueueCreate(LIVE_QUEUE_LEN, sizeof(obs_ring_rec_t));
+    s_result_queue = xQueueCreate(SHARD_RING_MAX_SHARDS * 2, sizeof(result_t));
+    if (!s_live_queue || !s_result_queue) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(uplink_task, "obs_uplink", 4096, NULL, 5, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <esp_err.h>
+#include <stdint.h>
+
+/** Initialize the observation uplink
+ *
+ * Opens the `obs_ring` flash partition and starts the task which batches observations into
+ * reports for the aggregator. While the aggregator is unreachable observations are stored in
+ * flash and replayed, rate limited, once writes succeed again.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t obs_uplink_init();
+
+/** Queue an observation for the aggregator
+ *
+ * The observation gets the next per-mediator sequence number. Must only be called from one
+ * task, the BLE host task.
+ *
+ * @param[in] beacon iBeacon major << 16 | minor.
+ * @param[in] distance_cm Estimated distance between the beacon and this mediator.
+ *
+ * @return ESP_OK on success.
+ * @return ESP_ERR_NO_MEM if the live queue is full and the observation was dropped.
+ */
+esp_err_t obs_uplink_push(uint32_t beacon, uint16_t distance_cm);
+
+/** Queue a raw observation for the aggregator
+ *
+ * Like obs_uplink_push(), but the aggregator turns the levels into a distance with its model of
+ * this mediator.
+ *
+ * @param[in] beacon iBeacon major << 16 | minor.
+ * @param[in] rssi Level the beacon was heard at.
+ * @param[in] measured_power Level the beacon advertises for 1 m.
+ *
+ * @return ESP_OK on success.
+ * @return ESP_ERR_NO_MEM if the live queue is full and the observation was dropped.
+ */
+esp_err_t obs_uplink_push_rssi(uint32_t beacon, int8_t rssi, int8_t measured_power);
+
+/** Mediator ID carried in every report, derived from the station MAC address */
+uint16_t obs_uplink_mediator_id();
+
+/** Register the `uplink` console command */
+esp_err_t obs_uplink_register_commands();
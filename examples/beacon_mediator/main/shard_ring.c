@@ -0,0 +1,95 @@
+#include <string.h>
+
+#include "shard_ring.h"
+
+/* splitmix64 finalizer, spreads sequential beacon and node IDs evenly over the ring */
+static uint32_t mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return (uint32_t)(x >> 32);
+}
+
+static void rebuild(shard_ring_t *ring)
+{
+    ring->point_count = 0;
+    for (int shard = 0; shard < SHARD_RING_MAX_SHARDS; shard++) {
+        if (!ring->used[shard]) {
+            continue;
+        }
+        for (uint32_t v = 0; v < SHARD_RING_VNODES; v++) {
+            shard_ring_point_t point = {
+                .hash = mix(ring->nodes[shard] * SHARD_RING_VNODES + v + 1),
+                .shard = (uint8_t)shard,
+            };
+            /* Insertion sort, the ring is rebuilt only when the aggregator set changes */
+            int i = ring->point_count++;
+            while (i > 0 && ring->points[i - 1].hash > point.hash) {
+                ring->points[i] = ring->points[i - 1];
+                i--;
+            }
+            ring->points[i] = point;
+        }
+    }
+}
+
+void shard_ring_init(shard_ring_t *ring)
+{
+    memset(ring, 0, sizeof(*ring));
+}
+
+int shard_ring_add(shard_ring_t *ring, uint64_t node_id)
+{
+    int free_slot = -1;
+    for (int shard = 0; shard < SHARD_RING_MAX_SHARDS; shard++) {
+        if (ring->used[shard] && ring->nodes[shard] == node_id) {
+            return shard;
+        }
+        if (!ring->used[shard] && free_slot < 0) {
+            free_slot = shard;
+        }
+    }
+    if (free_slot < 0) {
+        return -1;
+    }
+    ring->nodes[free_slot] = node_id;
+    ring->used[free_slot] = 1;
+    ring->count++;
+    rebuild(ring);
+    return free_slot;
+}
+
+int shard_ring_remove(shard_ring_t *ring, uint64_t node_id)
+{
+    for (int shard = 0; shard < SHARD_RING_MAX_SHARDS; shard++) {
+        if (ring->used[shard] && ring->nodes[shard] == node_id) {
+            ring->used[shard] = 0;
+            ring->count--;
+            rebuild(ring);
+            return shard;
+        }
+    }
+    return -1;
+}
+
+int shard_ring_lookup(const shard_ring_t *ring, uint32_t beacon)
+{
+    if (ring->point_count == 0) {
+        return -1;
+    }
+    uint32_t hash = mix(beacon);
+    int lo = 0;
+    int hi = ring->point_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (ring->points[mid].hash < hash) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return ring->points[lo == ring->point_count ? 0 : lo].shard;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Consistent hash ring mapping beacons to aggregators.
+ *
+ * Each aggregator owns SHARD_RING_VNODES points on a 32-bit ring, placed by hashing its node
+ * ID, and a beacon belongs to the owner of the first point at or after the hash of its ID.
+ * Adding or removing an aggregator therefore only moves the beacons next to its points, about
+ * 1/N of them, while every other beacon keeps its shard.
+ *
+ * Shard indices are slots and stay stable while other aggregators come and go.
+ */
+
+#define SHARD_RING_MAX_SHARDS 8
+#define SHARD_RING_VNODES 128
+
+typedef struct {
+    uint32_t hash;
+    uint8_t shard;
+} shard_ring_point_t;
+
+typedef struct {
+    uint64_t nodes[SHARD_RING_MAX_SHARDS];
+    uint8_t used[SHARD_RING_MAX_SHARDS];
+    uint8_t count;
+    uint16_t point_count;
+    shard_ring_point_t points[SHARD_RING_MAX_SHARDS * SHARD_RING_VNODES];
+} shard_ring_t;
+
+void shard_ring_init(shard_ring_t *ring);
+
+/** Add an aggregator
+ *
+ * @return shard index of the aggregator, also if it was already present.
+ * @return -1 if the ring is full.
+ */
+int shard_ring_add(shard_ring_t *ring, uint64_t node_id);
+
+/** Remove an aggregator
+ *
+ * @return shard index the aggregator had.
+ * @return -1 if it was not present.
+ */
+int shard_ring_remove(shard_ring_t *ring, uint64_t node_id);
+
+/** Shard owning a beacon
+ *
+ * @return shard index.
+ * @return -1 if the ring is empty.
+ */
+int shard_ring_lookup(const shard_ring_t *ring, uint32_t beacon);
+
+#ifdef __cplusplus
+}
+#endif
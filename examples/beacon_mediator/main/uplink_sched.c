@@ -0,0 +1,253 @@
+#include <string.h>
+
+#include "uplink_sched.h"
+
+static void store(uplink_sched_t *sched, const obs_ring_rec_t *recs, size_t count, uint32_t *counter)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (obs_ring_push(sched->ring, &recs[i]) != 0) {
+            sched->stats.flash_failures += (uint32_t)(count - i);
+            return;
+        }
+        (*counter)++;
+    }
+}
+
+static void finish_round(uplink_sched_t *sched)
+{
+    /* The oldest sector may have been overwritten meanwhile, which moved the read position */
+    if (sched->ring->read_pos < sched->round.end) {
+        obs_ring_consume(sched->ring, (uint32_t)(sched->round.end - sched->ring->read_pos));
+    }
+    sched->round.active = 0;
+}
+
+/* Moves the part of the round which belongs to a shard to the ring tail */
+static void park(uplink_sched_t *sched, int shard)
+{
+    for (size_t i = 0; i < sched->round.count; i++) {
+        if (sched->round.shard[i] == shard) {
+            store(sched, &sched->round.recs[i], 1, &sched->stats.parked);
+            sched->parked_run++;
+        }
+    }
+    if (shard >= 0) {
+        sched->round.pending &= ~(1u << shard);
+    }
+}
+
+static void start(uplink_sched_t *sched, uint8_t shard, uplink_kind_t kind, uint32_t now_ms)
+{
+    uplink_link_t *link = &sched->links[shard];
+    link->kind = (uint8_t)kind;
+    link->id = sched->next_id++;
+    link->started_ms = now_ms;
+    if (kind == UPLINK_PROBE) {
+        link->last_probe_ms = now_ms;
+        sched->stats.probes++;
+    }
+    if (sched->config.send(sched->config.ctx, shard, link->id, kind, link->flight, link->flight_count) != 0) {
+        uplink_sched_complete(sched, shard, link->id, 0, now_ms);
+    }
+}
+
+static void start_round(uplink_sched_t *sched, uint32_t now_ms)
+{
+    uint32_t count = obs_ring_count(sched->ring);
+    if (sched->parked_run >= count) {
+        sched->resting = 1;
+        return;
+    }
+    size_t limit = sched->tokens < BEACON_PROTO_MAX_OBS ? sched->tokens : BEACON_PROTO_MAX_OBS;
+    uint64_t from = sched->ring->read_pos;
+    uint32_t span = 0;
+    size_t from_boot = 0;
+    sched->round.count = obs_ring_peek(sched->ring, sched->round.recs, limit, &span, &from_boot);
+    sched->round.end = from + span;
+    sched->round.pending = 0;
+    sched->round.active = 1;
+    sched->tokens -= (uint32_t)sched->round.count;
+    if (sched->drain_sent == 0) {
+        sched->drain_started_ms = now_ms;
+    }
+
+    int parked = 0;
+    for (size_t i = 0; i < sched->round.count; i++) {
+        if (i < from_boot) {
+            sched->round.recs[i].flags |= BEACON_OBS_FLAG_AGE_UNKNOWN;
+        }
+        int shard = shard_ring_lookup(sched->shards, sched->round.recs[i].beacon);
+        sched->round.shard[i] = (int8_t)shard;
+        if (shard >= 0 && sched->links[shard].up) {
+            sched->round.pending |= 1u << shard;
+        } else {
+            parked = 1;
+        }
+    }
+    if (parked) {
+        /* Whatever is not pending now has no reachable shard */
+        for (size_t i = 0; i < sched->round.count; i++) {
+            int shard = sched->round.shard[i];
+            if (shard < 0 || !(sched->round.pending & (1u << shard))) {
+                store(sched, &sched->round.recs[i], 1, &sched->stats.parked);
+                sched->parked_run++;
+                sched->round.shard[i] = -1;
+            }
+        }
+    }
+}
+
+void uplink_sched_init(uplink_sched_t *sched, const uplink_sched_config_t *config, obs_ring_t *ring,
+                       const shard_ring_t *shards, uint32_t now_ms)
+{
+    memset(sched, 0, sizeof(*sched));
+    sched->config = *config;
+    sched->ring = ring;
+    sched->shards = shards;
+    sched->tokens = BEACON_PROTO_MAX_OBS;
+    sched->refill_ms = now_ms;
+    for (int shard = 0; shard < SHARD_RING_MAX_SHARDS; shard++) {
+        sched->links[shard].up = 1;
+    }
+}
+
+void uplink_sched_link_reset(uplink_sched_t *sched, uint8_t shard)
+{
+    memset(&sched->links[shard], 0, sizeof(sched->links[shard]));
+    sched->links[shard].up = 1;
+    sched->parked_run = 0;
+    sched->resting = 0;
+}
+
+void uplink_sched_route(uplink_sched_t *sched, const obs_ring_rec_t *rec)
+{
+    int shard = shard_ring_lookup(sched->shards, rec->beacon);
+    uplink_link_t *link = shard >= 0 ? &sched->links[shard] : NULL;
+    if (!link || !link->up || link->staged_count == BEACON_PROTO_MAX_OBS) {
+        store(sched, rec, 1, &sched->stats.spilled);
+        if (link && link->up) {
+            /* Overflow of a reachable shard, the backlog has work again */
+            sched->parked_run = 0;
+            sched->resting = 0;
+        }
+        return;
+    }
+    link->staged[link->staged_count++] = *rec;
+}
+
+void uplink_sched_complete(uplink_sched_t *sched, uint8_t shard, uint32_t id, int ok, uint32_t now_ms)
+{
+    uplink_link_t *link = &sched->links[shard];
+    if (link->kind == UPLINK_IDLE || link->id != id) {
+        return;
+    }
+    uplink_kind_t kind = (uplink_kind_t)link->kind;
+    size_t count = link->flight_count;
+    link->kind = UPLINK_IDLE;
+    link->flight_count = 0;
+
+    if (ok) {
+        if (!link->up) {
+            link->up = 1;
+            sched->stats.reconnects++;
+            sched->parked_run = 0;
+            sched->resting = 0;
+        }
+        link->sent += (uint32_t)count;
+        if (kind == UPLINK_LIVE) {
+            sched->stats.live_sent += (uint32_t)count;
+        } else if (kind == UPLINK_BACKLOG) {
+            sched->stats.backlog_sent += (uint32_t)count;
+            sched->drain_sent += (uint32_t)count;
+            sched->parked_run = 0;
+            sched->round.pending &= ~(1u << shard);
+            if (sched->round.pending == 0) {
+                finish_round(sched);
+            }
+        }
+        return;
+    }
+
+    sched->stats.write_failures++;
+    link->failures++;
+    if (link->up) {
+        link->up = 0;
+        link->last_probe_ms = now_ms;
+    }
+    if (kind == UPLINK_LIVE) {
+        store(sched, link->flight, count, &sched->stats.spilled);
+    } else if (kind == UPLINK_BACKLOG) {
+        /* The other parts of the round may already be delivered, only this one waits */
+        park(sched, shard);
+        if (sched->round.pending == 0) {
+            finish_round(sched);
+        }
+    }
+}
+
+void uplink_sched_poll(uplink_sched_t *sched, uint32_t now_ms)
+{
+    for (int shard = 0; shard < SHARD_RING_MAX_SHARDS; shard++) {
+        uplink_link_t *link = &sched->links[shard];
+        if (link->kind != UPLINK_IDLE && (int32_t)(now_ms - link->started_ms) > (int32_t)sched->config.flight_timeout_ms) {
+            sched->stats.timeouts++;
+            uplink_sched_complete(sched, (uint8_t)shard, link->id, 0, now_ms);
+        }
+    }
+
+    uint32_t refill = (uint32_t)((uint64_t)(now_ms - sched->refill_ms) * sched->config.backlog_rate / 1000);
+    if (refill > 0) {
+        sched->tokens = sched->tokens + refill > BEACON_PROTO_MAX_OBS ? BEACON_PROTO_MAX_OBS : sched->tokens + refill;
+        sched->refill_ms = now_ms;
+    }
+
+    if (!sched->round.active && !sched->resting && obs_ring_count(sched->ring) > 0 && sched->tokens > 0) {
+        start_round(sched, now_ms);
+    }
+
+    for (int shard = 0; shard < SHARD_RING_MAX_SHARDS; shard++) {
+        uplink_link_t *link = &sched->links[shard];
+        uint32_t bit = 1u << shard;
+        if (!sched->shards->used[shard] || !link->up) {
+            /* Removed or unreachable, its observations wait in flash */
+            store(sched, link->staged, link->staged_count, &sched->stats.spilled);
+            link->staged_count = 0;
+            if (link->kind == UPLINK_IDLE && (sched->round.pending & bit)) {
+                park(sched, shard);
+            }
+        }
+        if (!sched->shards->used[shard] || link->kind != UPLINK_IDLE) {
+            continue;
+        }
+        if (!link->up) {
+            if ((int32_t)(now_ms - link->last_probe_ms) >= (int32_t)sched->config.probe_period_ms) {
+                start(sched, (uint8_t)shard, UPLINK_PROBE, now_ms);
+            }
+        } else if (link->staged_count > 0 && !(link->last_live && (sched->round.pending & bit))) {
+            memcpy(link->flight, link->staged, link->staged_count * sizeof(link->staged[0]));
+            link->flight_count = link->staged_count;
+            link->staged_count = 0;
+            link->last_live = 1;
+            start(sched, (uint8_t)shard, UPLINK_LIVE, now_ms);
+        } else if (sched->round.pending & bit) {
+            link->flight_count = 0;
+            for (size_t i = 0; i < sched->round.count; i++) {
+                if (sched->round.shard[i] == shard) {
+                    link->flight[link->flight_count++] = sched->round.recs[i];
+                }
+            }
+            link->last_live = 0;
+            start(sched, (uint8_t)shard, UPLINK_BACKLOG, now_ms);
+        }
+    }
+
+    if (sched->round.active && sched->round.pending == 0) {
+        finish_round(sched);
+    }
+    if (!sched->round.active && obs_ring_count(sched->ring) == 0 && sched->drain_sent > 0) {
+        sched->stats.drains++;
+        sched->stats.last_drain_sent = sched->drain_sent;
+        sched->stats.last_drain_ms = now_ms - sched->drain_started_ms;
+        sched->drain_sent = 0;
+    }
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "beacon_proto.h"
+#include "obs_ring.h"
+#include "shard_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Scheduling of observation reports over the aggregator shards.
+ *
+ * Every shard has its own report in flight, so an unreachable aggregator only holds up the
+ * beacons it owns. Live observations go first on each shard. Observations of a shard which is
+ * down are kept in the flash ring; the backlog is replayed in rounds of records peeked from the
+ * ring, and the records of a round which belong to a down shard are parked, pushed again at the
+ * tail of the ring, so the rest of the backlog keeps draining. A round is consumed once every
+ * part of it was delivered or parked, nothing is sent twice. Down shards are probed with empty
+ * reports.
+ *
+ * No ESP-IDF dependency: reports go out through `send` and their results come back through
+ * uplink_sched_complete(), so the scheduler can be driven by a simulation on the host.
+ */
+
+typedef enum {
+    UPLINK_IDLE,
+    UPLINK_LIVE,
+    UPLINK_BACKLOG,
+    UPLINK_PROBE,
+} uplink_kind_t;
+
+typedef struct {
+    /** Start writing a report, the result is passed to uplink_sched_complete() with `id`
+     *
+     * @return 0 if the write was started, negative value if it failed right away.
+     */
+    int (*send)(void *ctx, uint8_t shard, uint32_t id, uplink_kind_t kind, const obs_ring_rec_t *recs,
+                size_t count);
+    void *ctx;
+    uint32_t probe_period_ms;
+    uint32_t flight_timeout_ms;
+    uint32_t backlog_rate;      /* Backlog observations per second */
+} uplink_sched_config_t;
+
+typedef struct {
+    uint32_t live_sent;
+    uint32_t backlog_sent;
+    uint32_t spilled;           /* Live observations stored in flash */
+    uint32_t parked;            /* Backlog observations moved to the ring tail */
+    uint32_t flash_failures;
+    uint32_t write_failures;
+    uint32_t timeouts;
+    uint32_t probes;
+    uint32_t reconnects;
+    uint32_t drains;            /* Backlog emptied, last_drain_* describe the latest one */
+    uint32_t last_drain_sent;
+    uint32_t last_drain_ms;
+} uplink_sched_stats_t;
+
+/* One aggregator of the shard set */
+typedef struct {
+    uint8_t up;
+    uint8_t kind;               /* uplink_kind_t of the report in flight */
+    uint8_t last_live;          /* Live went last, a pending backlog part goes next */
+    uint32_t id;
+    uint32_t started_ms;
+    uint32_t last_probe_ms;
+    obs_ring_rec_t staged[BEACON_PROTO_MAX_OBS];
+    size_t staged_count;
+    obs_ring_rec_t flight[BEACON_PROTO_MAX_OBS];
+    size_t flight_count;
+    uint32_t sent;
+    uint32_t failures;
+} uplink_link_t;
+
+typedef struct {
+    uplink_sched_config_t config;
+    obs_ring_t *ring;
+    const shard_ring_t *shards;
+    uplink_link_t links[SHARD_RING_MAX_SHARDS];
+    uint32_t next_id;
+
+    /* Backlog round, `end` is the absolute ring position it was peeked up to */
+    struct {
+        uint8_t active;
+        obs_ring_rec_t recs[BEACON_PROTO_MAX_OBS];
+        int8_t shard[BEACON_PROTO_MAX_OBS];
+        size_t count;
+        uint64_t end;
+        uint32_t pending;       /* Bit per shard whose part is still to be delivered */
+    } round;
+
+    uint32_t tokens;
+    uint32_t refill_ms;
+    /* Records parked in a row. Once that covers the whole ring nothing in it belongs to an up
+     * shard, and the backlog rests until a shard comes back or an up shard spills. */
+    uint32_t parked_run;
+    uint8_t resting;
+    uint32_t drain_started_ms;
+    uint32_t drain_sent;
+    uplink_sched_stats_t stats;
+} uplink_sched_t;
+
+/** Initialize the scheduler
+ *
+ * Shards used in `shards` start up. The ring and the shard ring stay owned by the caller, who
+ * calls uplink_sched_link_reset() after changing the shard set.
+ */
+void uplink_sched_init(uplink_sched_t *sched, const uplink_sched_config_t *config, obs_ring_t *ring,
+                       const shard_ring_t *shards, uint32_t now_ms);
+
+/** Forget the state of a shard, for an aggregator just added to the shard set */
+void uplink_sched_link_reset(uplink_sched_t *sched, uint8_t shard);
+
+/** Queue a live observation
+ *
+ * It is staged for the next report of its shard, or stored in flash if the shard is down or
+ * already has a full report staged.
+ */
+void uplink_sched_route(uplink_sched_t *sched, const obs_ring_rec_t *rec);
+
+/** Result of a report started through `send`
+ *
+ * Results of reports which timed out meanwhile are ignored.
+ */
+void uplink_sched_complete(uplink_sched_t *sched, uint8_t shard, uint32_t id, int ok, uint32_t now_ms);
+
+/** Time out stale reports and start new ones on every idle shard */
+void uplink_sched_poll(uplink_sched_t *sched, uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Observation report sent from a mediator to the aggregator.
+ *
+ * A mediator batches the beacons it heard over BLE and writes them to the Report attribute
+ * (long octet string) of a vendor cluster on the aggregator. Both ends are little endian
+ * ESP32s, so the packed structs below go on the wire as they are.
+ */
+
+/** Vendor specific cluster on the aggregator light endpoint (test vendor 0xFFF1) */
+#define BEACON_PROTO_CLUSTER_ID 0xFFF1FC00
+#define BEACON_PROTO_ATTR_REPORT_ID 0x0000
+#define BEACON_PROTO_ATTR_LINK_STATS_ID 0x0001
+#define BEACON_PROTO_ATTR_ANCHORS_ID 0x0002
+#define BEACON_PROTO_ATTR_POSITIONS_ID 0x0003
+#define BEACON_PROTO_ENDPOINT_ID 1
+
+#define BEACON_PROTO_VERSION 3
+/** Oldest version the aggregator still accepts, it differs only in lacking raw RSSI mode */
+#define BEACON_PROTO_MIN_VERSION 2
+
+/** Max observations in a single report, keeps one write inside a single IPv6 MTU */
+#define BEACON_PROTO_MAX_OBS 48
+
+/** Observation was replayed from the mediator flash backlog */
+#define BEACON_OBS_FLAG_BACKLOG 0x01
+/** Capture time is from a previous mediator boot, `age_ms` is meaningless */
+#define BEACON_OBS_FLAG_AGE_UNKNOWN 0x02
+/** `raw` holds what the mediator heard, the aggregator turns it into a distance (version 3) */
+#define BEACON_OBS_FLAG_RAW_RSSI 0x04
+
+typedef struct {
+    uint8_t version;
+    uint8_t count;
+    uint16_t mediator;
+    uint32_t boot_seq;      /* First sequence number assigned since the mediator booted */
+} __attribute__((packed)) beacon_report_head_t;
+
+typedef struct {
+    uint32_t beacon;        /* iBeacon major << 16 | minor */
+    union {
+        uint16_t distance_cm;
+        struct {
+            int8_t rssi;
+            int8_t measured_power;  /* iBeacon calibrated RSSI at 1 m */
+        } raw;
+    };
+    uint8_t flags;
+    uint8_t reserved;
+    uint32_t age_ms;        /* Time between capture and send on the mediator */
+    uint32_t seq;           /* Per-mediator sequence number, assigned at capture */
+} __attribute__((packed)) beacon_obs_t;
+
+#define BEACON_PROTO_REPORT_SIZE(n) (sizeof(beacon_report_head_t) + (n) * sizeof(beacon_obs_t))
+#define BEACON_PROTO_REPORT_MAX_SIZE BEACON_PROTO_REPORT_SIZE(BEACON_PROTO_MAX_OBS)
+
+/** Entry of the LinkStats attribute (read only), one per mediator heard by the aggregator */
+typedef struct {
+    uint16_t mediator;
+    uint16_t loss_permille;
+    uint32_t received;
+    uint32_t lost;
+    uint32_t reordered;
+    uint32_t duplicate;
+    uint32_t recovered;
+} __attribute__((packed)) beacon_link_stats_t;
+
+/** Entry of the Anchors attribute (writable), the position of a mediator on the site
+ *
+ * A write replaces the whole table; entries which did not change keep their solver state.
+ */
+typedef struct {
+    uint16_t mediator;
+    uint16_t reserved;
+    int32_t pos_mm[3];
+} __attribute__((packed)) beacon_anchor_t;
+
+#define BEACON_PROTO_MAX_ANCHORS 16
+
+/** Entry of the Positions attribute (read only), the last fix of each beacon the aggregator holds */
+typedef struct {
+    uint32_t beacon;
+    int32_t pos_mm[3];
+    uint32_t age_ms;        /* Time since the capture the fix is aligned to, when published */
+    uint16_t age_spread_ms; /* How much older the oldest range of the fix was, saturated */
+    uint16_t gdop_centi;    /* x/y GDOP x 100 at the fix, saturated */
+    uint8_t anchors;        /* Anchors the fix was solved from, outliers not counted */
+    uint8_t flags;
+    uint8_t outliers;       /* Ranges RANSAC left out of the fix */
+    uint8_t confidence_pct; /* RANSAC confidence that the fix holds no outlier, 0 if it did not run */
+} __attribute__((packed)) beacon_position_t;
+
+/** x and y are the tracked position at publish time, not the last fix */
+#define BEACON_POSITION_FLAG_TRACKED 0x01
+/** The fix came from the grid locator, the anchors heard could not be solved by least squares;
+ *  gdop_centi is then the likelihood spread of the fix in centimetres */
+#define BEACON_POSITION_FLAG_GRID 0x02
+/** z was solved from the ranges (dims 3); without it pos_mm[2] is the configured beacon height */
+#define BEACON_POSITION_FLAG_3D 0x04
+/** x and y are the particle filter estimate at the last fix, in place of the tracked position */
+#define BEACON_POSITION_FLAG_PARTICLES 0x08
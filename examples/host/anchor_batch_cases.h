@@ -0,0 +1,106 @@
+#pragma once
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "anchor_set.h"
+#include "host.h"
+
+/* Beacons for anchor_set_solve_batch(): 16 anchors on a 60 x 60 m site at an offset of 1000 m,
+ * every beacon heard by one of `subsets` recurring masks of 3 to 12 anchors. Ranges are kept
+ * both as batch rows by anchor index and per beacon as anchor_set_solve() takes them. */
+
+typedef struct {
+    size_t count;
+    uint16_t *masks;
+    float *rows;                /* [ANCHOR_SET_MAX_ANCHORS][count] */
+    float (*ranges)[ANCHOR_SET_MAX_ANCHORS];
+    float *z;
+    float *x;
+    float *y;
+} batch_cases_t;
+
+static void batch_layout(anchor_set_t *set)
+{
+    float anchors[ANCHOR_SET_MAX_ANCHORS][3];
+    for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+        anchors[i][0] = 1000 + (i % 4) * 20 + host_uniform() * 3;
+        anchors[i][1] = 1000 + (i / 4) * 20 + host_uniform() * 3;
+        anchors[i][2] = 3 + host_uniform();
+    }
+    anchor_set_load(set, anchors, 0xFFFF);
+}
+
+static int compare_mask(const void *a, const void *b)
+{
+    return (int)*(const uint16_t *)a - (int)*(const uint16_t *)b;
+}
+
+/* `sorted` orders the beacons by mask, as a caller grouping them would */
+static batch_cases_t batch_cases(const anchor_set_t *set, size_t count, int subsets, int sorted)
+{
+    batch_cases_t cases = {
+        .count = count,
+        .masks = (uint16_t *)malloc(count * sizeof(uint16_t)),
+        .rows = (float *)malloc(ANCHOR_SET_MAX_ANCHORS * count * sizeof(float)),
+        .ranges = (float (*)[ANCHOR_SET_MAX_ANCHORS])malloc(count * sizeof(cases.ranges[0])),
+        .z = (float *)malloc(count * sizeof(float)),
+        .x = (float *)malloc(count * sizeof(float)),
+        .y = (float *)malloc(count * sizeof(float)),
+    };
+    uint16_t *pool = (uint16_t *)malloc(subsets * sizeof(uint16_t));
+    for (int k = 0; k < subsets; k++) {
+        pool[k] = 0;
+        while (__builtin_popcount(pool[k]) < 3 + k % 10) {
+            pool[k] |= 1u << (host_rand() % ANCHOR_SET_MAX_ANCHORS);
+        }
+    }
+    for (size_t b = 0; b < count; b++) {
+        cases.masks[b] = pool[host_rand() % subsets];
+    }
+    if (sorted) {
+        qsort(cases.masks, count, sizeof(uint16_t), compare_mask);
+    }
+    for (size_t b = 0; b < count; b++) {
+        float pos[3] = {1000 + host_uniform() * 60, 1000 + host_uniform() * 60, 1 + host_uniform()};
+        cases.z[b] = pos[2];
+        for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+            float d[3];
+            for (int k = 0; k < 3; k++) {
+                d[k] = pos[k] - (set->origin[k] + set->pos[i][k]);
+            }
+            float r = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]) + 0.2f * (host_uniform() - 0.5f);
+            cases.ranges[b][i] = r;
+            cases.rows[i * count + b] = r;
+        }
+    }
+    free(pool);
+    return cases;
+}
+
+static void batch_cases_free(batch_cases_t *cases)
+{
+    free(cases->masks);
+    free(cases->rows);
+    free(cases->ranges);
+    free(cases->z);
+    free(cases->x);
+    free(cases->y);
+}
+
+/* Beacons whose batch position differs in any bit from anchor_set_solve() */
+static size_t batch_mismatches(anchor_set_t *set, const batch_cases_t *cases)
+{
+    size_t mismatches = 0;
+    for (size_t b = 0; b < cases->count; b++) {
+        float pos[3];
+        if (anchor_set_solve(set, cases->masks[b], cases->ranges[b], cases->z[b], pos) != 0) {
+            mismatches += !(isnan(cases->x[b]) && isnan(cases->y[b]));
+            continue;
+        }
+        mismatches += memcmp(&pos[0], &cases->x[b], sizeof(float)) != 0 ||
+                      memcmp(&pos[1], &cases->y[b], sizeof(float)) != 0;
+    }
+    return mismatches;
+}
@@ -0,0 +1,201 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "anchor_set.h"
+#include "host.h"
+#include "multilat.h"
+#include "trilateration.h"
+
+/* anchor_set_solve() with cached subset factors against re-solving with multilat_solve(), and its
+ * Q16 kernel: 16 anchors in a 40 x 40 m hall around a site offset of 1000 m, 24 recurring subsets
+ * per anchor count, 0.2 m range noise. */
+
+#define CASES 4096
+#define REPS 100
+#define SUBSETS 24
+#define OFFSET 1000.0f
+
+static anchor_set_t s_set;
+static float s_anchors[ANCHOR_SET_MAX_ANCHORS][3];
+static uint16_t s_mask[CASES];
+static float s_ranges[CASES][ANCHOR_SET_MAX_ANCHORS];
+static q16_t s_ranges_q16[CASES][ANCHOR_SET_MAX_ANCHORS];
+/* The anchors and ranges of each case's subset, packed for multilat_solve() */
+static float s_packed_anchors[CASES][ANCHOR_SET_MAX_ANCHORS][3];
+static float s_packed_ranges[CASES][ANCHOR_SET_MAX_ANCHORS];
+
+static void make_cases(int count)
+{
+    uint16_t subsets[SUBSETS];
+    for (int k = 0; k < SUBSETS; k++) {
+        uint16_t mask = 0;
+        while (__builtin_popcount(mask) < count) {
+            mask |= 1u << (host_rand() % ANCHOR_SET_MAX_ANCHORS);
+        }
+        subsets[k] = mask;
+    }
+    for (int c = 0; c < CASES; c++) {
+        s_mask[c] = subsets[host_rand() % SUBSETS];
+        float x = OFFSET + host_uniform() * 40;
+        float y = OFFSET + host_uniform() * 40;
+        int packed = 0;
+        for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+            float dx = x - s_anchors[i][0];
+            float dy = y - s_anchors[i][1];
+            float dz = 1 - s_anchors[i][2];
+            s_ranges[c][i] = sqrtf(dx * dx + dy * dy + dz * dz) + 0.2f * (host_uniform() - 0.5f);
+            s_ranges_q16[c][i] = (q16_t)lrint(s_ranges[c][i] * (double)Q16_ONE);
+            if (s_mask[c] & (1u << i)) {
+                for (int d = 0; d < 3; d++) {
+                    s_packed_anchors[c][packed][d] = s_anchors[i][d];
+                }
+                s_packed_ranges[c][packed++] = s_ranges[c][i];
+            }
+        }
+    }
+}
+
+static double time_closed_form(void)
+{
+    double started = host_now_s();
+    for (int r = 0; r < REPS; r++) {
+        for (int c = 0; c < CASES; c++) {
+            float ab[3], ac[3], x, y;
+            calc_line_eq(s_packed_anchors[c][0], s_packed_anchors[c][1], s_packed_ranges[c][0],
+                         s_packed_ranges[c][1], 1, ab);
+            calc_line_eq(s_packed_anchors[c][0], s_packed_anchors[c][2], s_packed_ranges[c][0],
+                         s_packed_ranges[c][2], 1, ac);
+            calc_x_from_lines(ab, ac, &x);
+            calc_y_from_x(ab, x, &y);
+            host_sink = x + y;
+        }
+    }
+    return (host_now_s() - started) / REPS / CASES * 1e9;
+}
+
+static double time_multilat(int count)
+{
+    multilat_fix_t fix;
+    double started = host_now_s();
+    for (int r = 0; r < REPS; r++) {
+        for (int c = 0; c < CASES; c++) {
+            if (multilat_solve(s_packed_anchors[c], s_packed_ranges[c], count, 1, MULTILAT_LINEAR_ONLY, &fix) == 0) {
+                host_sink = fix.pos[0];
+            }
+        }
+    }
+    return (host_now_s() - started) / REPS / CASES * 1e9;
+}
+
+static double time_anchor_set(void)
+{
+    float pos[3];
+    double started = host_now_s();
+    for (int r = 0; r < REPS; r++) {
+        for (int c = 0; c < CASES; c++) {
+            if (anchor_set_solve(&s_set, s_mask[c], s_ranges[c], 1, pos) == 0) {
+                host_sink = pos[0];
+            }
+        }
+    }
+    return (host_now_s() - started) / REPS / CASES * 1e9;
+}
+
+static double time_anchor_set_q16(void)
+{
+    q16_t pos[3];
+    double started = host_now_s();
+    for (int r = 0; r < REPS; r++) {
+        for (int c = 0; c < CASES; c++) {
+            if (anchor_set_solve_q16(&s_set, s_mask[c], s_ranges_q16[c], Q16_ONE, pos) == 0) {
+                host_sink = (float)pos[0];
+            }
+        }
+    }
+    return (host_now_s() - started) / REPS / CASES * 1e9;
+}
+
+/* Largest x + y difference between anchor_set_solve() and the linear multilat_solve() */
+static double max_difference(int count)
+{
+    double max = 0;
+    for (int c = 0; c < CASES; c++) {
+        float pos[3];
+        multilat_fix_t fix;
+        if (anchor_set_solve(&s_set, s_mask[c], s_ranges[c], 1, pos) == 0 &&
+            multilat_solve(s_packed_anchors[c], s_packed_ranges[c], count, 1, MULTILAT_LINEAR_ONLY, &fix) == 0) {
+            double d = fabs(pos[0] - fix.pos[0]) + fabs(pos[1] - fix.pos[1]);
+            max = d > max && d < 1e3 ? d : max;
+        }
+    }
+    return max;
+}
+
+/* Mean error of both solves on noiseless ranges, in double precision */
+static void precision(void)
+{
+    double error_multilat = 0;
+    double error_set = 0;
+    int solved = 0;
+    for (int c = 0; c < 2000; c++) {
+        uint16_t mask = 0;
+        while (__builtin_popcount(mask) < 6) {
+            mask |= 1u << (host_rand() % ANCHOR_SET_MAX_ANCHORS);
+        }
+        double x = OFFSET + host_uniform() * 40;
+        double y = OFFSET + host_uniform() * 40;
+        float ranges[ANCHOR_SET_MAX_ANCHORS];
+        float packed_anchors[ANCHOR_SET_MAX_ANCHORS][3];
+        float packed_ranges[ANCHOR_SET_MAX_ANCHORS];
+        int packed = 0;
+        for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+            double dx = x - s_anchors[i][0];
+            double dy = y - s_anchors[i][1];
+            double dz = 1 - s_anchors[i][2];
+            ranges[i] = (float)sqrt(dx * dx + dy * dy + dz * dz);
+            if (mask & (1u << i)) {
+                for (int d = 0; d < 3; d++) {
+                    packed_anchors[packed][d] = s_anchors[i][d];
+                }
+                packed_ranges[packed++] = ranges[i];
+            }
+        }
+        float pos[3];
+        multilat_fix_t fix;
+        if (anchor_set_solve(&s_set, mask, ranges, 1, pos) == 0 &&
+            multilat_solve(packed_anchors, packed_ranges, packed, 1, 0, &fix) == 0) {
+            error_set += hypot(pos[0] - x, pos[1] - y);
+            error_multilat += hypot(fix.pos[0] - x, fix.pos[1] - y);
+            solved++;
+        }
+    }
+    printf("noiseless, site offset %.0f m: mean error multilat_solve %.4f mm, anchor_set_solve %.4f mm\n", OFFSET,
+           error_multilat / solved * 1e3, error_set / solved * 1e3);
+}
+
+int main(void)
+{
+    host_seed(2);
+    for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+        s_anchors[i][0] = OFFSET + host_uniform() * 40;
+        s_anchors[i][1] = OFFSET + host_uniform() * 40;
+        s_anchors[i][2] = 3 + host_uniform();
+    }
+    anchor_set_load(&s_set, s_anchors, 0xFFFF);
+
+    printf("ns per solve\n");
+    printf("anchors  calc_* closed form  multilat_solve  anchor_set_solve  anchor_set_solve_q16  max diff (m)\n");
+    for (int count = 3; count <= ANCHOR_SET_MAX_ANCHORS; count++) {
+        make_cases(count);
+        if (count == 3) {
+            printf("%7d  %18.1f  ", count, time_closed_form());
+        } else {
+            printf("%7d  %18s  ", count, "");
+        }
+        printf("%14.1f  %16.1f  %20.1f  %12.5f\n", time_multilat(count), time_anchor_set(), time_anchor_set_q16(),
+               max_difference(count));
+    }
+    printf("cache: %u hits, %u misses, %u degenerate\n", s_set.stats.hits, s_set.stats.misses, s_set.stats.degenerate);
+    precision();
+    return 0;
+}
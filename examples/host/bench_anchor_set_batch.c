@@ -0,0 +1,47 @@
+#include <stdio.h>
+
+#include "anchor_batch_cases.h"
+
+/* Site-wide solves with anchor_set_solve_batch() against anchor_set_solve() per beacon, beacons
+ * grouped by mask or in random order, 32 recurring subsets of 3 to 12 anchors. Every batch result
+ * is also compared with anchor_set_solve() bit for bit. */
+
+static anchor_set_t s_set;
+
+static void run(size_t count, int sorted)
+{
+    batch_cases_t cases = batch_cases(&s_set, count, 32, sorted);
+    int reps = (int)(2000000 / count) + 1;
+    double started = host_now_s();
+    for (int r = 0; r < reps; r++) {
+        anchor_set_solve_batch(&s_set, cases.masks, cases.rows, count, cases.z, count, cases.x, cases.y);
+    }
+    double batch_s = (host_now_s() - started) / reps;
+
+    started = host_now_s();
+    for (int r = 0; r < reps; r++) {
+        for (size_t b = 0; b < count; b++) {
+            float pos[3];
+            anchor_set_solve(&s_set, cases.masks[b], cases.ranges[b], cases.z[b], pos);
+            host_sink = pos[0];
+        }
+    }
+    double single_s = (host_now_s() - started) / reps;
+    printf("  %7zu  %-12s  %8.1f  %8.1f  %5.1fx  %zu\n", count, sorted ? "grouped" : "random order",
+           count / batch_s / 1e6, count / single_s / 1e6, single_s / batch_s, batch_mismatches(&s_set, &cases));
+    batch_cases_free(&cases);
+}
+
+int main(void)
+{
+    host_seed(6);
+    batch_layout(&s_set);
+    printf("kernel %s\n", anchor_set_batch_isa());
+    printf("  beacons  order         batch M/s  single M/s  speedup  mismatches\n");
+    size_t counts[] = {10000, 30000, 100000};
+    for (int i = 0; i < 3; i++) {
+        run(counts[i], 1);
+    }
+    run(100000, 0);
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "beacon_track.h"
+#include "host.h"
+#include "multilat.h"
+
+/* Raw fixes against beacon_track.c fed as the aggregator feeds it: 64 people walking at up to
+ * 1.4 m/s in a 30 x 30 m hall, 8 anchors on a circle, one fix per beacon per period with the
+ * fix sigma taken as range noise times GDOP, every track predicted to the 100 ms solve tick.
+ * Jitter is how far each reported position moved between two fixes, less how far the beacon
+ * really moved. */
+
+#define BEACONS 64
+#define ANCHORS 8
+#define SECONDS 600
+#define WARMUP_S 10
+#define TICK_MS 100
+
+static beacon_tracks_t s_tracks;
+static float s_anchors[ANCHORS][3];
+
+typedef struct {
+    float pos[2];
+    float vel[2];
+    float raw[2];
+    float tracked[2];
+    float last_truth[2];
+    float last_raw[2];
+    float last_tracked[2];
+} walker_t;
+
+static walker_t s_walkers[BEACONS];
+
+static void walk(walker_t *w, float dt)
+{
+    for (int i = 0; i < 2; i++) {
+        w->vel[i] += 0.5f * host_gauss() * sqrtf(dt);
+    }
+    float speed = hypotf(w->vel[0], w->vel[1]);
+    if (speed > 1.4f) {
+        w->vel[0] *= 1.4f / speed;
+        w->vel[1] *= 1.4f / speed;
+    }
+    for (int i = 0; i < 2; i++) {
+        w->pos[i] += w->vel[i] * dt;
+        if (w->pos[i] < 1 || w->pos[i] > 29) {
+            w->vel[i] = -w->vel[i];
+        }
+    }
+}
+
+static void run(float noise, uint32_t period_ms)
+{
+    host_seed(5);
+    beacon_tracks_init(&s_tracks, 2, 0.5f);
+    for (int k = 0; k < BEACONS; k++) {
+        walker_t *w = &s_walkers[k];
+        w->pos[0] = 5 + host_uniform() * 20;
+        w->pos[1] = 5 + host_uniform() * 20;
+        w->vel[0] = w->vel[1] = 0;
+    }
+
+    double raw_error = 0, tracked_error = 0, raw_jitter = 0, tracked_jitter = 0;
+    double predict_s = 0;
+    long samples = 0, ticks = 0;
+    for (uint32_t now_ms = 0; now_ms < SECONDS * 1000; now_ms += TICK_MS) {
+        for (int k = 0; k < BEACONS; k++) {
+            walker_t *w = &s_walkers[k];
+            walk(w, TICK_MS * 0.001f);
+            /* Beacons are heard spread over the period, as reports come in */
+            if ((now_ms + k * 37) % period_ms >= TICK_MS) {
+                continue;
+            }
+            float ranges[ANCHORS];
+            for (int i = 0; i < ANCHORS; i++) {
+                float dx = w->pos[0] - s_anchors[i][0];
+                float dy = w->pos[1] - s_anchors[i][1];
+                ranges[i] = fmaxf(0.1f, sqrtf(dx * dx + dy * dy + 4) + noise * host_gauss());
+            }
+            multilat_fix_t fix;
+            if (multilat_solve(s_anchors, ranges, ANCHORS, 1, 5, &fix) != 0) {
+                continue;
+            }
+            beacon_tracks_fix(&s_tracks, k, fix.pos, noise * fix.gdop, now_ms);
+            w->raw[0] = fix.pos[0];
+            w->raw[1] = fix.pos[1];
+        }
+
+        double started = host_now_s();
+        beacon_tracks_predict_all(&s_tracks, now_ms);
+        predict_s += host_now_s() - started;
+        ticks++;
+
+        for (int k = 0; k < BEACONS; k++) {
+            walker_t *w = &s_walkers[k];
+            if ((now_ms + k * 37) % period_ms >= TICK_MS) {
+                continue;
+            }
+            const beacon_track_t *track = beacon_tracks_find(&s_tracks, k);
+            w->tracked[0] = track->x[0];
+            w->tracked[1] = track->x[1];
+            if (now_ms >= WARMUP_S * 1000) {
+                float moved[2] = {w->pos[0] - w->last_truth[0], w->pos[1] - w->last_truth[1]};
+                raw_error += hypotf(w->raw[0] - w->pos[0], w->raw[1] - w->pos[1]);
+                tracked_error += hypotf(w->tracked[0] - w->pos[0], w->tracked[1] - w->pos[1]);
+                raw_jitter += hypotf(w->raw[0] - w->last_raw[0] - moved[0], w->raw[1] - w->last_raw[1] - moved[1]);
+                tracked_jitter += hypotf(w->tracked[0] - w->last_tracked[0] - moved[0],
+                                         w->tracked[1] - w->last_tracked[1] - moved[1]);
+                samples++;
+            }
+            for (int i = 0; i < 2; i++) {
+                w->last_truth[i] = w->pos[i];
+                w->last_raw[i] = w->raw[i];
+                w->last_tracked[i] = w->tracked[i];
+            }
+        }
+    }
+    printf("  %5.1f m  %6u ms  %5.2f m  %5.2f m  %5.2f m  %5.2f m  %4.0f%%  %5.0f ns  %u\n", noise, period_ms,
+           raw_error / samples, tracked_error / samples, raw_jitter / samples, tracked_jitter / samples,
+           100 * (1 - tracked_jitter / raw_jitter), predict_s / ticks / BEACONS * 1e9, s_tracks.stats.rejected);
+}
+
+int main(void)
+{
+    for (int i = 0; i < ANCHORS; i++) {
+        float angle = 6.2831853f * i / ANCHORS;
+        s_anchors[i][0] = 15 + 15 * cosf(angle);
+        s_anchors[i][1] = 15 + 15 * sinf(angle);
+        s_anchors[i][2] = 3;
+    }
+    printf("  noise    period    error raw  tracked  jitter raw  tracked  reduction  predict/track  rejected\n");
+    run(0.5f, 1000);
+    run(1.0f, 1000);
+    run(1.0f, 500);
+    run(2.0f, 1000);
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "anchor_set.h"
+#include "grid_locator.h"
+#include "host.h"
+
+/* grid_locator.c at 0.25, 0.5 and 1 m cells against anchor_set_solve() on the same ranges.
+ *
+ * Hall: the 4 x 4 anchors on a 10 m grid of `matter esp solver bench`, beacons at 1 m heard by 3
+ * to 8 of them, 0.3 m range noise, and a quarter of the beacons with one range reflected 5 m
+ * long. Corridor: 8 anchors in a line down a 40 x 4 m corridor, which least squares can not
+ * solve at all; this is the set obs_ingest.cpp hands to the grid. The table is the RAM the
+ * aggregator gives the locator, cost the coarse to fine solve, and the full surface is
+ * grid_locator_surface() for comparison.
+ */
+
+#define CASES 4000
+#define NOISE 0.3f
+#define REFLECTED 5.0f
+
+typedef struct {
+    uint16_t mask;
+    float ranges[ANCHOR_SET_MAX_ANCHORS];
+    float truth[2];
+} grid_case_t;
+
+static anchor_set_t s_set;
+static float s_anchors[ANCHOR_SET_MAX_ANCHORS][3];
+static grid_case_t s_cases[CASES];
+
+static void make_cases(float width, float height, int heard, float reflected_share)
+{
+    int anchors = __builtin_popcount(s_set.present);
+    for (int c = 0; c < CASES; c++) {
+        grid_case_t *g = &s_cases[c];
+        g->truth[0] = host_uniform() * width;
+        g->truth[1] = host_uniform() * height;
+        int count = heard ? heard : 3 + c % 6;
+        g->mask = 0;
+        while (__builtin_popcount(g->mask) < count) {
+            g->mask |= 1u << (host_rand() % anchors);
+        }
+        for (int i = 0; i < anchors; i++) {
+            float dx = g->truth[0] - s_anchors[i][0];
+            float dy = g->truth[1] - s_anchors[i][1];
+            float dz = 1.0f - s_anchors[i][2];
+            g->ranges[i] = fmaxf(0.1f, sqrtf(dx * dx + dy * dy + dz * dz) + NOISE * host_gauss());
+        }
+        if (host_uniform() < reflected_share) {
+            g->ranges[__builtin_ctz(g->mask)] += REFLECTED;
+        }
+    }
+}
+
+static void run_least_squares(void)
+{
+    double error = 0, started = host_now_s();
+    int solved = 0;
+    for (int c = 0; c < CASES; c++) {
+        float pos[3];
+        if (anchor_set_solve(&s_set, s_cases[c].mask, s_cases[c].ranges, 1.0f, pos) == 0) {
+            error += hypotf(pos[0] - s_cases[c].truth[0], pos[1] - s_cases[c].truth[1]);
+            solved++;
+        }
+    }
+    double ns = (host_now_s() - started) / CASES * 1e9;
+    printf("  least squares                  %9.0f ns            %5.2f m          %5.1f%% solved\n", ns,
+           solved ? error / solved : NAN, 100.0 * solved / CASES);
+}
+
+static void run_grid(float cell, float width, float height)
+{
+    const floor_grid_t grid = {{-1.0f, -1.0f}, cell, (uint16_t)ceilf((width + 2) / cell),
+                               (uint16_t)ceilf((height + 2) / cell), 0, NULL};
+    int anchors = __builtin_popcount(s_set.present);
+    size_t entries = GRID_LOCATOR_STORAGE(grid.width, grid.height, anchors);
+    uint16_t *storage = malloc(entries * sizeof(uint16_t));
+    float *surface = malloc((size_t)grid.width * grid.height * sizeof(float));
+    grid_locator_t loc;
+    double started = host_now_s();
+    grid_locator_build(&loc, &s_set, &grid, 1.0f, storage);
+    double build_s = host_now_s() - started;
+
+    float sigmas[ANCHOR_SET_MAX_ANCHORS];
+    for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+        sigmas[i] = NOISE;
+    }
+    double error = 0, spread = 0, evaluated = 0;
+    int solved = 0;
+    started = host_now_s();
+    for (int c = 0; c < CASES; c++) {
+        grid_locator_fix_t fix;
+        if (grid_locator_solve(&loc, s_cases[c].mask, s_cases[c].ranges, sigmas, &fix) == 0) {
+            error += hypotf(fix.pos[0] - s_cases[c].truth[0], fix.pos[1] - s_cases[c].truth[1]);
+            spread += fix.spread;
+            evaluated += fix.evaluated;
+            solved++;
+        }
+    }
+    double solve_ns = (host_now_s() - started) / CASES * 1e9;
+
+    /* The full surface is slow at small cells, a tenth of the cases is enough */
+    double surface_error = 0;
+    started = host_now_s();
+    for (int c = 0; c < CASES / 10; c++) {
+        int peak = grid_locator_surface(&loc, s_cases[c].mask, s_cases[c].ranges, sigmas, surface);
+        float x = grid.origin[0] + (peak % grid.width + 0.5f) * cell;
+        float y = grid.origin[1] + (peak / grid.width + 0.5f) * cell;
+        surface_error += hypotf(x - s_cases[c].truth[0], y - s_cases[c].truth[1]);
+    }
+    double surface_ns = (host_now_s() - started) / (CASES / 10) * 1e9;
+    printf("  grid %4.2f m  %3ux%-3u  %5zu KB  %6.2f ms  %9.0f ns  %5.0f  %5.2f m  %5.2f m  %9.0f ns  %5.2f m\n", cell,
+           grid.width, grid.height, entries * sizeof(uint16_t) / 1024, build_s * 1e3, solve_ns, evaluated / solved,
+           error / solved, spread / solved, surface_ns, surface_error / (CASES / 10));
+    free(storage);
+    free(surface);
+}
+
+static void run(const char *name, float width, float height, int heard, float reflected_share)
+{
+    static const float cells[] = {1.0f, 0.5f, 0.25f};
+    host_seed(2);
+    make_cases(width, height, heard, reflected_share);
+    printf("%s\n", name);
+    printf("  cells         size       table    build        solve        cells  error    spread"
+           "   surface      error\n");
+    run_least_squares();
+    for (int k = 0; k < 3; k++) {
+        run_grid(cells[k], width, height);
+    }
+}
+
+int main(void)
+{
+    uint16_t present = 0;
+    for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+        s_anchors[i][0] = (i % 4) * 10.0f;
+        s_anchors[i][1] = (i / 4) * 10.0f;
+        s_anchors[i][2] = 3.0f;
+        present |= 1u << i;
+    }
+    anchor_set_load(&s_set, s_anchors, present);
+    run("hall 30 x 30 m, 16 anchors, 3 to 8 heard, no reflections", 30, 30, 0, 0);
+    run("hall 30 x 30 m, 16 anchors, 3 to 8 heard, a quarter with one reflected range", 30, 30, 0, 0.25f);
+
+    present = 0;
+    for (int i = 0; i < 8; i++) {
+        s_anchors[i][0] = 2.5f + i * 5.0f;
+        s_anchors[i][1] = 2.0f;
+        s_anchors[i][2] = 3.0f;
+        present |= 1u << i;
+    }
+    anchor_set_load(&s_set, s_anchors, present);
+    run("corridor 40 x 4 m, 8 anchors in a line, 3 heard", 40, 4, 3, 0);
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "host.h"
+#include "multilat.h"
+
+/* multilat_solve() cost and accuracy by anchor count: random anchors in a 20 x 20 m hall at 3 m,
+ * beacons at 1 m, 0.3 m range noise. Three anchors without refinement take the closed form; a
+ * negative iteration count puts them through the linear solve instead. */
+
+#define CASES 4096
+#define REPS 100
+#define GN_ITERATIONS 3
+
+static float s_anchors[CASES][MULTILAT_MAX_ANCHORS][3];
+static float s_ranges[CASES][MULTILAT_MAX_ANCHORS];
+static float s_truth[CASES][2];
+
+/* ns per solve and mean x-y error */
+static void run(int count, int gn_iterations, double *ns, double *error)
+{
+    multilat_fix_t fix;
+    double started = host_now_s();
+    for (int r = 0; r < REPS; r++) {
+        for (int c = 0; c < CASES; c++) {
+            if (multilat_solve(s_anchors[c], s_ranges[c], count, 1, gn_iterations, &fix) == 0) {
+                host_sink = fix.pos[0];
+            }
+        }
+    }
+    *ns = (host_now_s() - started) / REPS / CASES * 1e9;
+
+    double sum = 0;
+    int solved = 0;
+    for (int c = 0; c < CASES; c++) {
+        if (multilat_solve(s_anchors[c], s_ranges[c], count, 1, gn_iterations, &fix) == 0) {
+            /* A nearly collinear draw can land kilometres away, it would swamp the mean */
+            double e = hypot(fix.pos[0] - s_truth[c][0], fix.pos[1] - s_truth[c][1]);
+            if (e < 100) {
+                sum += e;
+                solved++;
+            }
+        }
+    }
+    *error = solved ? sum / solved : NAN;
+}
+
+int main(void)
+{
+    host_seed(1);
+    for (int c = 0; c < CASES; c++) {
+        s_truth[c][0] = host_uniform() * 20;
+        s_truth[c][1] = host_uniform() * 20;
+        for (int i = 0; i < MULTILAT_MAX_ANCHORS; i++) {
+            float *a = s_anchors[c][i];
+            a[0] = host_uniform() * 20;
+            a[1] = host_uniform() * 20;
+            a[2] = 3;
+            float dx = s_truth[c][0] - a[0];
+            float dy = s_truth[c][1] - a[1];
+            s_ranges[c][i] = sqrtf(dx * dx + dy * dy + 4) + 0.3f * host_gauss();
+        }
+    }
+
+    printf("ns per solve / mean x-y error, sigma 0.3 m\n");
+    printf("anchors  closed form      LS               LS + GN (<=%d it.)\n", GN_ITERATIONS);
+    for (int count = 3; count <= MULTILAT_MAX_ANCHORS; count++) {
+        double ns, error, gn_ns, gn_error;
+        run(count, MULTILAT_LINEAR_ONLY, &ns, &error);
+        run(count, GN_ITERATIONS, &gn_ns, &gn_error);
+        if (count == 3) {
+            double closed_ns, closed_error;
+            run(count, 0, &closed_ns, &closed_error);
+            printf("%7d  %4.0f / %5.2f m  ", count, closed_ns, closed_error);
+        } else {
+            printf("%7d  %16s ", count, "");
+        }
+        printf("%4.0f / %5.2f m  %4.0f / %5.2f m\n", ns, error, gn_ns, gn_error);
+    }
+    return 0;
+}
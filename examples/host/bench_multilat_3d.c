@@ -0,0 +1,68 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "host.h"
+#include "multilat.h"
+
+/* multilat_solve_3d() against multilat_solve() at a fixed 1 m, beacons anywhere from the floor
+ * to 4 m in a 30 x 30 m hall, 8 anchors. A 3D fix counts only when it was labelled 3D; the
+ * others fell back to 2D. Without Gauss-Newton iterations z is not solved at all. */
+
+#define CASES 20000
+#define ANCHORS 8
+
+static void run(const char *name, const float anchors[][3], float noise, int gn_iterations)
+{
+    host_seed(8);
+    double error_2d = 0, error_3d = 0, error_z = 0, error_z_fixed = 0;
+    double cost_2d = 0, cost_3d = 0;
+    int solved_3d = 0;
+    for (int c = 0; c < CASES; c++) {
+        float truth[3] = {host_uniform() * 30, host_uniform() * 30, host_uniform() * 4};
+        float ranges[ANCHORS];
+        for (int i = 0; i < ANCHORS; i++) {
+            float dx = truth[0] - anchors[i][0];
+            float dy = truth[1] - anchors[i][1];
+            float dz = truth[2] - anchors[i][2];
+            ranges[i] = sqrtf(dx * dx + dy * dy + dz * dz) + noise * host_gauss();
+        }
+        multilat_fix_t fix;
+        double started = host_now_s();
+        multilat_solve(anchors, ranges, ANCHORS, 1.0f, gn_iterations, &fix);
+        cost_2d += host_now_s() - started;
+        error_2d += fminf(hypotf(fix.pos[0] - truth[0], fix.pos[1] - truth[1]), 50);
+        error_z_fixed += fabsf(1.0f - truth[2]);
+
+        started = host_now_s();
+        multilat_solve_3d(anchors, ranges, NULL, ANCHORS, 1.0f, gn_iterations, &fix);
+        cost_3d += host_now_s() - started;
+        error_3d += fminf(hypotf(fix.pos[0] - truth[0], fix.pos[1] - truth[1]), 50);
+        error_z += fminf(fabsf(fix.pos[2] - truth[2]), 50);
+        solved_3d += fix.dims == 3;
+    }
+    printf("  %-26s  %4.2f m  %2d  %5.2f m  %4.0f ns  %5.2f m  %5.2f m  %4.0f ns  %5.1f%%  (z at 1 m: %.2f m)\n", name,
+           noise, gn_iterations, error_2d / CASES, cost_2d / CASES * 1e9, error_3d / CASES, error_z / CASES,
+           cost_3d / CASES * 1e9, 100.0 * solved_3d / CASES, error_z_fixed / CASES);
+}
+
+int main(void)
+{
+    static const float mixed[ANCHORS][3] = {
+        {0, 0, 6}, {30, 0, 1}, {0, 30, 1}, {30, 30, 6}, {15, 0, 3}, {0, 15, 5}, {30, 15, 1.5f}, {15, 30, 4},
+    };
+    static const float near_flat[ANCHORS][3] = {
+        {0, 0, 3}, {30, 0, 3.3f}, {0, 30, 2.8f}, {30, 30, 3.1f}, {15, 0, 3}, {0, 15, 3.2f}, {30, 15, 2.9f}, {15, 30, 3},
+    };
+    static const float flat[ANCHORS][3] = {
+        {0, 0, 3}, {30, 0, 3}, {0, 30, 3}, {30, 30, 3}, {15, 0, 3}, {0, 15, 3}, {30, 15, 3}, {15, 30, 3},
+    };
+    printf("  anchors                     noise  GN  2D: xy err  cost    3D: xy err  z err  cost    3D share\n");
+    const float noises[] = {0.02f, 0.1f, 0.3f};
+    for (int k = 0; k < 3; k++) {
+        run("heights 1-6 m", mixed, noises[k], 5);
+        run("ceiling 2.8-3.3 m", near_flat, noises[k], 5);
+        run("flat ceiling 3 m", flat, noises[k], 5);
+    }
+    run("heights 1-6 m", mixed, 0.1f, 0);
+    return 0;
+}
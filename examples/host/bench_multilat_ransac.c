@@ -0,0 +1,98 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "host.h"
+#include "multilat.h"
+#include "multilat_ransac.h"
+
+/* multilat_ransac() against least squares with reflected ranges: anchors on a 30 m circle at 3 m,
+ * beacons at 1 m, 0.2 m range noise, each outlier 3-10 m too long. */
+
+#define POSITIONS 20000
+
+static int64_t clock_us(void)
+{
+    return (int64_t)(host_now_s() * 1e6);
+}
+
+static void run(int count, int outliers, int max_hypotheses, uint32_t budget_us)
+{
+    float anchors[MULTILAT_MAX_ANCHORS][3];
+    for (int i = 0; i < count; i++) {
+        float angle = 6.2831853f * i / count;
+        anchors[i][0] = 15 + 15 * cosf(angle);
+        anchors[i][1] = 15 + 15 * sinf(angle);
+        anchors[i][2] = 3;
+    }
+    multilat_ransac_config_t config = MULTILAT_RANSAC_CONFIG_DEFAULT();
+    config.max_hypotheses = max_hypotheses;
+    config.budget_us = budget_us;
+    config.clock_us = budget_us ? clock_us : NULL;
+
+    host_seed(7);
+    double ls_error = 0, ls_s = 0, error = 0, s = 0, hypotheses = 0, confidence = 0;
+    int failed = 0, found = 0;
+    for (int t = 0; t < POSITIONS; t++) {
+        float x = host_uniform() * 30;
+        float y = host_uniform() * 30;
+        float ranges[MULTILAT_MAX_ANCHORS];
+        for (int i = 0; i < count; i++) {
+            float dx = x - anchors[i][0];
+            float dy = y - anchors[i][1];
+            ranges[i] = fmaxf(sqrtf(dx * dx + dy * dy + 4) + 0.2f * host_gauss(), 0.1f);
+        }
+        uint16_t reflected = 0;
+        for (int o = 0; o < outliers; o++) {
+            int k;
+            do {
+                k = host_rand() % count;
+            } while (reflected & (1u << k));
+            reflected |= 1u << k;
+            ranges[k] += 3 + host_uniform() * 7;
+        }
+
+        multilat_fix_t fix;
+        double started = host_now_s();
+        multilat_solve(anchors, ranges, count, 1, 5, &fix);
+        ls_s += host_now_s() - started;
+        ls_error += fminf(hypotf(fix.pos[0] - x, fix.pos[1] - y), 50);
+
+        multilat_ransac_fix_t out;
+        started = host_now_s();
+        int rc = multilat_ransac(anchors, ranges, NULL, count, 1, &config, &out);
+        s += host_now_s() - started;
+        if (rc != 0) {
+            failed++;
+            continue;
+        }
+        error += fminf(hypotf(out.fix.pos[0] - x, out.fix.pos[1] - y), 50);
+        hypotheses += out.hypotheses;
+        confidence += out.confidence;
+        found += (uint16_t)(~out.inliers & ((1u << count) - 1)) == reflected;
+    }
+    int solved = POSITIONS - failed;
+    printf("  %2d       %d        %4.2f m  %4.2f us  %4.2f m      %4.1f us  %5.1f  %5.3f       ", count, outliers,
+           ls_error / POSITIONS, ls_s / POSITIONS * 1e6, error / solved, s / POSITIONS * 1e6, hypotheses / solved,
+           confidence / solved);
+    if (outliers) {
+        printf("%5.1f%%", 100.0 * found / solved);
+    } else {
+        printf("    -");
+    }
+    printf("  (max %d, budget %u us, %d failed)\n", max_hypotheses, budget_us, failed);
+}
+
+int main(void)
+{
+    printf("anchors  outliers  LS err  cost     RANSAC err  cost     hyp    confidence  outliers found\n");
+    run(5, 1, 64, 0);
+    run(8, 0, 64, 0);
+    run(8, 1, 64, 0);
+    run(8, 2, 64, 0);
+    run(16, 2, 64, 0);
+    run(16, 5, 64, 0);
+    run(16, 5, 256, 0);
+    run(16, 5, 256, 3);
+    run(16, 5, 256, 10);
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host.h"
+#include "multilat.h"
+
+/* multilat_solve_weighted() against multilat_solve() on RSSI ranges: 9 anchors on a 15 m grid at
+ * 3 m, path loss exponent 2, 4 samples averaged per link with 4 dB sample noise and a 2 dB bias
+ * per link. Then the mean error of k averaged fixes of a static beacon. */
+
+#define POSITIONS 20000
+#define ANCHORS 9
+#define SAMPLES 4
+#define SAMPLE_DB 4.0f
+#define BIAS_DB 2.0f
+#define EXPONENT 2.0f
+#define GN_ITERATIONS 5
+
+static float s_anchors[ANCHORS][3];
+
+static int compare_float(const void *a, const void *b)
+{
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Range and sigma of each link as the aggregator gets them: mean and variance of the samples */
+static void measure(float x, float y, const float bias_db[], float ranges[], float sigmas[])
+{
+    for (int i = 0; i < ANCHORS; i++) {
+        float dx = x - s_anchors[i][0];
+        float dy = y - s_anchors[i][1];
+        float dz = 1 - s_anchors[i][2];
+        float d = sqrtf(dx * dx + dy * dy + dz * dz);
+        float samples[SAMPLES];
+        float sum = 0;
+        for (int k = 0; k < SAMPLES; k++) {
+            samples[k] = d * powf(10, (bias_db[i] + SAMPLE_DB * host_gauss()) / (10 * EXPONENT));
+            sum += samples[k];
+        }
+        float mean = sum / SAMPLES;
+        float var = 0;
+        for (int k = 0; k < SAMPLES; k++) {
+            var += (samples[k] - mean) * (samples[k] - mean);
+        }
+        ranges[i] = mean;
+        sigmas[i] = multilat_range_sigma(mean, var / (SAMPLES - 1), SAMPLES, BIAS_DB, EXPONENT);
+    }
+}
+
+static int solve(int weighted, const float ranges[], const float sigmas[], multilat_fix_t *fix)
+{
+    return weighted ? multilat_solve_weighted(s_anchors, ranges, sigmas, ANCHORS, 1, GN_ITERATIONS, fix)
+                    : multilat_solve(s_anchors, ranges, ANCHORS, 1, GN_ITERATIONS, fix);
+}
+
+static void print_errors(const char *name, float *errors, double seconds)
+{
+    double sum = 0;
+    for (int t = 0; t < POSITIONS; t++) {
+        sum += fminf(errors[t], 100);
+    }
+    qsort(errors, POSITIONS, sizeof(errors[0]), compare_float);
+    printf("  %-17s mean %.2f m  median %.2f  p90 %.2f  %.0f ns\n", name, sum / POSITIONS, errors[POSITIONS / 2],
+           errors[POSITIONS * 9 / 10], seconds / POSITIONS * 1e9);
+}
+
+int main(void)
+{
+    static float errors[2][POSITIONS];
+    double seconds[2] = {0, 0};
+    host_seed(7);
+    for (int i = 0; i < ANCHORS; i++) {
+        s_anchors[i][0] = (i % 3) * 15;
+        s_anchors[i][1] = (i / 3) * 15;
+        s_anchors[i][2] = 3;
+    }
+
+    for (int t = 0; t < POSITIONS; t++) {
+        float x = host_uniform() * 30;
+        float y = host_uniform() * 30;
+        float bias_db[ANCHORS];
+        for (int i = 0; i < ANCHORS; i++) {
+            bias_db[i] = BIAS_DB * host_gauss();
+        }
+        float ranges[ANCHORS];
+        float sigmas[ANCHORS];
+        measure(x, y, bias_db, ranges, sigmas);
+        for (int weighted = 0; weighted < 2; weighted++) {
+            multilat_fix_t fix;
+            double started = host_now_s();
+            int rc = solve(weighted, ranges, sigmas, &fix);
+            seconds[weighted] += host_now_s() - started;
+            errors[weighted][t] = rc == 0 ? hypotf(fix.pos[0] - x, fix.pos[1] - y) : INFINITY;
+        }
+    }
+    printf("%d positions, %d anchors on a 15 m grid, %d samples per link, %.0f dB sample noise, %.0f dB link bias\n",
+           POSITIONS, ANCHORS, SAMPLES, SAMPLE_DB, BIAS_DB);
+    print_errors("unweighted LS+GN", errors[0], seconds[0]);
+    print_errors("weighted LS+GN", errors[1], seconds[1]);
+
+    /* A static beacon: the sample noise averages out over fixes, the model error does not */
+    static const int fixes[] = {1, 2, 4, 8, 16};
+    const float no_bias[ANCHORS] = {0};
+    printf("averaging k fixes of a static beacon, mean error (m):\n  k          ");
+    for (size_t q = 0; q < sizeof(fixes) / sizeof(fixes[0]); q++) {
+        printf("  %5d", fixes[q]);
+    }
+    printf("\n");
+    for (int weighted = 0; weighted < 2; weighted++) {
+        printf("  %-10s ", weighted ? "weighted" : "unweighted");
+        for (size_t q = 0; q < sizeof(fixes) / sizeof(fixes[0]); q++) {
+            double error = 0;
+            const int runs = 2000;
+            for (int run = 0; run < runs; run++) {
+                double sum_x = 0;
+                double sum_y = 0;
+                for (int j = 0; j < fixes[q];) {
+                    float ranges[ANCHORS];
+                    float sigmas[ANCHORS];
+                    multilat_fix_t fix;
+                    measure(11, 17, no_bias, ranges, sigmas);
+                    if (solve(weighted, ranges, sigmas, &fix) == 0) {
+                        sum_x += fix.pos[0];
+                        sum_y += fix.pos[1];
+                        j++;
+                    }
+                }
+                error += hypot(sum_x / fixes[q] - 11, sum_y / fixes[q] - 17);
+            }
+            printf("  %5.2f", error / runs);
+        }
+        printf("\n");
+    }
+    return 0;
+}
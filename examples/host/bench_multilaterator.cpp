@@ -0,0 +1,118 @@
+#include <cmath>
+#include <cstdio>
+
+#include "host.h"
+#include "multilaterator.h"
+
+extern "C" {
+#include "anchor_set.h"
+}
+
+/* Multilaterator specializations: float and double, 3 to 16 anchors, given height (Dims 2) and
+ * solved height (Dims 3), against the run time count variant on the same anchors, and against
+ * anchor_set_solve() where it applies (float, Dims 2). Anchors at 2 to 6 m in a 40 x 40 m hall,
+ * exact ranges, so the error is the rounding of the folded factors. */
+
+#define CASES 1024
+#define REPS 2000
+
+template <typename Scalar, std::size_t N, std::size_t Dims>
+static void run()
+{
+    using Solver = Multilaterator<Scalar, N, Dims>;
+    typename Solver::Anchors anchors;
+    for (std::size_t i = 0; i < N; i++) {
+        anchors[i] = {Scalar(host_uniform() * 40), Scalar(host_uniform() * 40), Scalar(2 + host_uniform() * 4)};
+    }
+    Solver solver(anchors);
+    Multilaterator<Scalar, multilaterator::Dynamic, Dims> dynamic(anchors.data(), N);
+
+    static typename Solver::Ranges ranges[CASES];
+    static double truth[CASES][3];
+    for (int c = 0; c < CASES; c++) {
+        truth[c][0] = host_uniform() * 40;
+        truth[c][1] = host_uniform() * 40;
+        truth[c][2] = Dims == 3 ? host_uniform() * 5 : 1.0;
+        for (std::size_t i = 0; i < N; i++) {
+            double dx = truth[c][0] - anchors[i][0];
+            double dy = truth[c][1] - anchors[i][1];
+            double dz = truth[c][2] - anchors[i][2];
+            ranges[c][i] = Scalar(std::sqrt(dx * dx + dy * dy + dz * dz));
+        }
+    }
+
+    double error = 0;
+    for (int c = 0; c < CASES; c++) {
+        typename Solver::Point pos = solver.solve(ranges[c], Scalar(1));
+        for (int k = 0; k < 3; k++) {
+            error = std::fmax(error, std::fabs(pos[k] - truth[c][k]));
+        }
+    }
+
+    double started = host_now_s();
+    for (int r = 0; r < REPS; r++) {
+        for (int c = 0; c < CASES; c++) {
+            host_sink = solver.solve(ranges[c], Scalar(1))[0];
+        }
+    }
+    double fixed_ns = (host_now_s() - started) / REPS / CASES * 1e9;
+
+    started = host_now_s();
+    for (int r = 0; r < REPS; r++) {
+        for (int c = 0; c < CASES; c++) {
+            host_sink = dynamic.solve(ranges[c].data(), Scalar(1))[0];
+        }
+    }
+    double dynamic_ns = (host_now_s() - started) / REPS / CASES * 1e9;
+
+    printf("  %-6s  %2zu  %zu  %6.1f ns  %6.1f ns  ", sizeof(Scalar) == 4 ? "float" : "double", N, Dims, fixed_ns,
+           dynamic_ns);
+    if (Dims == 2 && sizeof(Scalar) == 4) {
+        static anchor_set_t set;
+        float pos[ANCHOR_SET_MAX_ANCHORS][3];
+        for (std::size_t i = 0; i < N; i++) {
+            for (int k = 0; k < 3; k++) {
+                pos[i][k] = float(anchors[i][k]);
+            }
+        }
+        uint16_t mask = uint16_t((1u << N) - 1);
+        anchor_set_load(&set, pos, mask);
+        static float set_ranges[CASES][ANCHOR_SET_MAX_ANCHORS];
+        for (int c = 0; c < CASES; c++) {
+            for (std::size_t i = 0; i < N; i++) {
+                set_ranges[c][i] = float(ranges[c][i]);
+            }
+        }
+        started = host_now_s();
+        for (int r = 0; r < REPS; r++) {
+            for (int c = 0; c < CASES; c++) {
+                float out[3];
+                anchor_set_solve(&set, mask, set_ranges[c], 1, out);
+                host_sink = out[0];
+            }
+        }
+        printf("%6.1f ns", (host_now_s() - started) / REPS / CASES * 1e9);
+    } else {
+        printf("       -  ");
+    }
+    printf("  %.1e m%s\n", error, solver.valid() ? "" : "  (degenerate)");
+}
+
+int main()
+{
+    host_seed(4);
+    printf("  scalar  N   Dims  fixed N    Dynamic    anchor_set  max error\n");
+    run<float, 3, 2>();
+    run<float, 4, 2>();
+    run<float, 8, 2>();
+    run<float, 16, 2>();
+    run<double, 3, 2>();
+    run<double, 8, 2>();
+    run<double, 16, 2>();
+    run<float, 4, 3>();
+    run<float, 8, 3>();
+    run<float, 16, 3>();
+    run<double, 8, 3>();
+    run<double, 16, 3>();
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host.h"
+#include "obs_store.h"
+
+/* obs_store insert and find + query: random (beacon, mediator) pairs over 16 mediators, as
+ * many beacons as there are slots, then 1000 beacons against the slots to measure eviction.
+ * Built twice, with the device default of 64 beacon slots and with 1024. */
+
+#define INSERTS 20000000
+#define QUERIES 2000000
+#define MEDIATORS 16
+
+static obs_store_t s_store;
+
+static void run(int beacons)
+{
+    uint32_t *ids = (uint32_t *)malloc(beacons * sizeof(uint32_t));
+    for (int i = 0; i < beacons; i++) {
+        ids[i] = (uint32_t)((i / 100) << 16 | (i % 100));
+    }
+    obs_store_init(&s_store);
+    for (int m = 0; m < MEDIATORS; m++) {
+        obs_store_mediator_slot(&s_store, 0x1000 + m);
+    }
+
+    host_seed(3);
+    double started = host_now_s();
+    for (int i = 0; i < INSERTS; i++) {
+        uint32_t r = host_rand();
+        obs_store_insert(&s_store, ids[r % beacons], (r >> 20) % MEDIATORS, 100 + (r & 255), i / 1000);
+    }
+    double insert_s = host_now_s() - started;
+
+    obs_store_anchor_t anchors[OBS_STORE_MAX_MEDIATORS];
+    size_t found = 0;
+    int queried = 0;
+    started = host_now_s();
+    for (int i = 0; i < QUERIES; i++) {
+        int slot = obs_store_find(&s_store, ids[i % beacons]);
+        if (slot >= 0) {
+            found += obs_store_query(&s_store, slot, INSERTS / 1000, 2000, anchors);
+            queried++;
+        }
+    }
+    double query_s = host_now_s() - started;
+    printf("  %5d  %7d  %6.1f ns (%4.1f M/s)  %6.1f ns (%4.1f M/s)  %5.1f  %8u\n", OBS_STORE_MAX_BEACONS, beacons,
+           insert_s / INSERTS * 1e9, INSERTS / insert_s / 1e6, query_s / QUERIES * 1e9, QUERIES / query_s / 1e6,
+           queried ? (double)found / queried : 0.0, s_store.stats.evicted);
+    free(ids);
+}
+
+int main(void)
+{
+    printf("  slots  beacons  insert                find + query          anchors  evicted\n");
+    run(OBS_STORE_MAX_BEACONS);
+    run(1000);
+    printf("store: %zu bytes\n", sizeof(s_store));
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "floor_grid.h"
+#include "host.h"
+#include "multilat.h"
+#include "particle_filter.h"
+
+/* Particle filter on a floor plan against least squares fixes: 16 walkers in a 30 m hall split
+ * by a wall with a door, with three machines, 8 anchors on a 14 m circle, 0.25 m cells, one
+ * tick per step of about 0.7 m.
+ *
+ *     bench_particle_filter [particles]
+ */
+
+#define CELL 0.25f
+#define WIDTH 120
+#define STRIDE (WIDTH / 8)
+#define ANCHORS 8
+#define WALKERS 16
+#define STEPS 300
+#define STEP_SIGMA 0.7f
+#define MAX_PARTICLES 4096
+
+static uint8_t s_bits[WIDTH * STRIDE];
+static const floor_grid_t s_grid = {{0, 0}, CELL, WIDTH, WIDTH, STRIDE, s_bits};
+static float s_anchors[ANCHORS][3];
+static float s_storage[WALKERS][PARTICLE_FILTER_STORAGE(MAX_PARTICLES)];
+
+static void block(float x0, float y0, float x1, float y1)
+{
+    for (int cy = (int)(y0 / CELL); cy < (int)(y1 / CELL); cy++) {
+        for (int cx = (int)(x0 / CELL); cx < (int)(x1 / CELL); cx++) {
+            s_bits[cy * STRIDE + cx / 8] |= 1 << (cx & 7);
+        }
+    }
+}
+
+static int crosses(float x0, float y0, float x1, float y1)
+{
+    for (int i = 1; i <= 20; i++) {
+        float t = i / 20.0f;
+        if (floor_grid_blocked(&s_grid, x0 + t * (x1 - x0), y0 + t * (y1 - y0))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void run(uint32_t particles, float noise, int grid)
+{
+    particle_filter_t pf[WALKERS];
+    float walker[WALKERS][2];
+    float sigmas[ANCHORS];
+    host_seed(9);
+    for (int i = 0; i < ANCHORS; i++) {
+        sigmas[i] = noise;
+    }
+    for (int k = 0; k < WALKERS; k++) {
+        do {
+            walker[k][0] = host_uniform() * 30;
+            walker[k][1] = host_uniform() * 30;
+        } while (floor_grid_blocked(&s_grid, walker[k][0], walker[k][1]));
+        particle_filter_init(&pf[k], grid ? &s_grid : NULL, s_storage[k], particles, 1, k + 1);
+    }
+
+    double ls_error = 0, pf_error = 0, seconds = 0;
+    long counted = 0, ls_blocked = 0, pf_blocked = 0;
+    for (int step = 0; step < STEPS; step++) {
+        for (int k = 0; k < WALKERS; k++) {
+            float *p = walker[k];
+            for (int tries = 0; tries < 50; tries++) {
+                float x = p[0] + STEP_SIGMA * host_gauss();
+                float y = p[1] + STEP_SIGMA * host_gauss();
+                if (!crosses(p[0], p[1], x, y)) {
+                    p[0] = x;
+                    p[1] = y;
+                    break;
+                }
+            }
+            float ranges[ANCHORS];
+            for (int i = 0; i < ANCHORS; i++) {
+                float dx = p[0] - s_anchors[i][0];
+                float dy = p[1] - s_anchors[i][1];
+                ranges[i] = sqrtf(dx * dx + dy * dy + 4) + noise * host_gauss();
+            }
+            multilat_fix_t fix;
+            multilat_solve(s_anchors, ranges, ANCHORS, 1, 5, &fix);
+
+            double started = host_now_s();
+            if (step == 0) {
+                particle_filter_seed(&pf[k], fix.pos[0], fix.pos[1], 2 * noise);
+            } else {
+                particle_filter_predict(&pf[k], STEP_SIGMA);
+            }
+            if (particle_filter_update(&pf[k], s_anchors, ranges, sigmas, ANCHORS) != 0) {
+                particle_filter_seed(&pf[k], fix.pos[0], fix.pos[1], 2 * noise);
+            }
+            float estimate[3];
+            particle_filter_estimate(&pf[k], estimate, NULL);
+            seconds += host_now_s() - started;
+
+            /* The first ticks are the filter settling */
+            if (step >= 10) {
+                ls_error += hypotf(fix.pos[0] - p[0], fix.pos[1] - p[1]);
+                pf_error += hypotf(estimate[0] - p[0], estimate[1] - p[1]);
+                ls_blocked += floor_grid_blocked(&s_grid, fix.pos[0], fix.pos[1]);
+                pf_blocked += floor_grid_blocked(&s_grid, estimate[0], estimate[1]);
+                counted++;
+            }
+        }
+    }
+    double tick_s = seconds / (STEPS * WALKERS);
+    printf("  %4u  %s  %.1f m   %.2f m  %4.1f%%          %.2f m  %4.2f%%          %6.1f us  %5.1f M/s\n", particles,
+           grid ? "yes" : "no ", noise, ls_error / counted, 100.0 * ls_blocked / counted, pf_error / counted,
+           100.0 * pf_blocked / counted, tick_s * 1e6, particles / tick_s / 1e6);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t particles = argc > 1 ? (uint32_t)atoi(argv[1]) : 256;
+    if (particles == 0 || particles > MAX_PARTICLES) {
+        printf("particles: 1 to %d\n", MAX_PARTICLES);
+        return 1;
+    }
+    /* Wall across the hall with a 4 m door, and three machines */
+    block(14.75f, 0, 15.25f, 13);
+    block(14.75f, 17, 15.25f, 30);
+    block(5, 5, 9, 9);
+    block(20, 20, 25, 24);
+    block(3, 18, 11, 22);
+    for (int i = 0; i < ANCHORS; i++) {
+        float angle = 6.2831853f * i / ANCHORS;
+        s_anchors[i][0] = 15 + 14 * cosf(angle);
+        s_anchors[i][1] = 15 + 14 * sinf(angle);
+        s_anchors[i][2] = 3;
+    }
+
+    printf("  particles grid noise  LS err  LS in blocked  PF err  PF in blocked  per beacon per tick\n");
+    run(particles, 1.0f, 1);
+    run(particles, 2.0f, 1);
+    if (argc <= 1) {
+        static const uint32_t budgets[] = {128, 1024, 4096};
+        for (size_t i = 0; i < sizeof(budgets) / sizeof(budgets[0]); i++) {
+            run(budgets[i], 1.0f, 1);
+        }
+        run(1024, 1.0f, 0);
+    }
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "anchor_set.h"
+#include "host.h"
+#include "pathloss_cal.h"
+
+/* Per mediator path loss calibration from reference beacons. No recorded traces ship with the
+ * tree, so they are simulated: 8 mediators around a 40 x 24 m hall at 3 m, each with its own
+ * exponent (2.2-3.2) and offset (+-4 dB), log-normal shadowing, 10 minutes of reference traffic
+ * at 1 Hz per mediator. Test beacons then average 5 samples per mediator, as obs_store does,
+ * and are solved by least squares with the free space and the calibrated distances. */
+
+#define MEDIATORS 8
+#define MAX_REFERENCES 8
+#define TEST_BEACONS 2000
+#define TEST_SAMPLES 5
+
+static float s_anchors[ANCHOR_SET_MAX_ANCHORS][3] = {
+    {0, 0, 3}, {20, 0, 3}, {40, 0, 3}, {40, 12, 3}, {40, 24, 3}, {20, 24, 3}, {0, 24, 3}, {0, 12, 3},
+};
+static const float s_references[MAX_REFERENCES][3] = {
+    {10, 6, 1}, {30, 18, 1}, {10, 18, 1}, {30, 6, 1}, {20, 12, 1}, {5, 12, 1}, {35, 12, 1}, {20, 3, 1},
+};
+static float s_exponent[MEDIATORS];
+static float s_offset_db[MEDIATORS];
+
+static float distance(int mediator, const float pos[3])
+{
+    float dx = pos[0] - s_anchors[mediator][0];
+    float dy = pos[1] - s_anchors[mediator][1];
+    float dz = pos[2] - s_anchors[mediator][2];
+    return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+/* Distance a mediator reports: free space from the level it heard, in whole centimetres */
+static float reported(int mediator, const float pos[3], float shadowing_db)
+{
+    float level_db = s_offset_db[mediator] + 10 * s_exponent[mediator] * log10f(distance(mediator, pos)) +
+                     shadowing_db * host_gauss();
+    return roundf(powf(10, level_db / 20) * 100) / 100;
+}
+
+static void run(int references, float shadowing_db)
+{
+    host_seed(11);
+    for (int m = 0; m < MEDIATORS; m++) {
+        s_exponent[m] = 2.2f + host_uniform();
+        s_offset_db[m] = -4 + 8 * host_uniform();
+    }
+    pathloss_cal_t cal;
+    pathloss_cal_init(&cal, 0.999f, 5.0f);
+    for (int t = 0; t < 600; t++) {
+        for (int r = 0; r < references; r++) {
+            for (int m = 0; m < MEDIATORS; m++) {
+                float level_db = pathloss_level_from_distance(reported(m, s_references[r], shadowing_db));
+                pathloss_cal_observe(&cal, m, distance(m, s_references[r]), level_db);
+            }
+        }
+    }
+    float exponent_error = 0;
+    for (int m = 0; m < MEDIATORS; m++) {
+        exponent_error = fmaxf(exponent_error, fabsf(pathloss_cal_model(&cal, m).exponent - s_exponent[m]));
+    }
+
+    static anchor_set_t set;
+    const uint16_t mask = (1u << MEDIATORS) - 1;
+    anchor_set_load(&set, s_anchors, mask);
+    double range_free = 0, range_cal = 0, pos_free = 0, pos_cal = 0;
+    int ranges = 0, solved = 0;
+    for (int b = 0; b < TEST_BEACONS; b++) {
+        float pos[3] = {host_uniform() * 40, host_uniform() * 24, 1};
+        float free[ANCHOR_SET_MAX_ANCHORS];
+        float calibrated[ANCHOR_SET_MAX_ANCHORS];
+        for (int m = 0; m < MEDIATORS; m++) {
+            pathloss_model_t model = pathloss_cal_model(&cal, m);
+            float sum_free = 0;
+            float sum_cal = 0;
+            for (int k = 0; k < TEST_SAMPLES; k++) {
+                float d = reported(m, pos, shadowing_db);
+                sum_free += d;
+                sum_cal += pathloss_model_distance(&model, pathloss_level_from_distance(d));
+            }
+            free[m] = sum_free / TEST_SAMPLES;
+            calibrated[m] = sum_cal / TEST_SAMPLES;
+            range_free += fabsf(free[m] - distance(m, pos));
+            range_cal += fabsf(calibrated[m] - distance(m, pos));
+            ranges++;
+        }
+        float fix_free[3];
+        float fix_cal[3];
+        if (anchor_set_solve(&set, mask, free, 1, fix_free) == 0 &&
+            anchor_set_solve(&set, mask, calibrated, 1, fix_cal) == 0) {
+            pos_free += hypotf(fix_free[0] - pos[0], fix_free[1] - pos[1]);
+            pos_cal += hypotf(fix_cal[0] - pos[0], fix_cal[1] - pos[1]);
+            solved++;
+        }
+    }
+    printf("  %10d  %6.0f dB  %6.1f m / %5.2f m      %5.0f m / %5.2f m      %.2f\n", references, shadowing_db,
+           range_free / ranges, range_cal / ranges, pos_free / solved, pos_cal / solved, exponent_error);
+}
+
+int main(void)
+{
+    printf("  references  shadowing  range err free/cal   position err free/cal   max exponent error\n");
+    run(1, 3);
+    run(2, 3);
+    run(4, 3);
+    run(8, 3);
+    run(4, 6);
+    return 0;
+}
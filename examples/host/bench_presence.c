@@ -0,0 +1,232 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "anchor_set.h"
+#include "host.h"
+#include "presence.h"
+
+/* presence.c on synthetic RSSI: 8 rooms of 10 x 8 m in two rows of four, one mediator on the
+ * ceiling of each, 6 dB lost per wall between the beacon's room and the mediator's, 4 dB of
+ * shadowing per sample. 64 people walk at 1.2 m/s between random work places and stay at each
+ * for 10 s to 5 min, for an hour; each mediator within 25 m hears each beacon about twice a
+ * second.
+ *
+ * Accuracy is the share of 250 ms ticks a beacon is assigned to the room it is in, a flap a
+ * transition back to the previous room within 10 s, lag the time from entering a room until the
+ * beacon is assigned to it. The cost is per beacon and tick, every observation of the tick,
+ * against anchor_set_solve() on the same mediators as anchors. */
+
+#define ROOM_W 10.0f
+#define ROOM_H 8.0f
+#define COLS 4
+#define ROWS 2
+#define ROOMS (COLS * ROWS)
+#define WALKERS 64
+#define TICK_MS 250
+#define SECONDS 3600
+#define WALL_DB 6.0f
+#define SHADOW_DB 4.0f
+#define HEARD_M 25.0f
+#define FLAP_MS 10000
+#define COST_CASES 4096
+#define COST_REPS 50
+
+typedef struct {
+    float pos[2];
+    float target[2];
+    uint32_t busy_until_ms;
+    int room;
+    int8_t last_from;           /* Previous transition, for flaps */
+    uint32_t last_ms;
+    uint32_t entered_ms;        /* Entered `room`, not yet assigned to it */
+    int pending;
+} walker_t;
+
+static float s_mediators[ROOMS][3];
+static walker_t s_walkers[WALKERS];
+static presence_t s_presence;
+
+static int room_of(const float pos[2])
+{
+    int col = (int)(pos[0] / ROOM_W);
+    int row = (int)(pos[1] / ROOM_H);
+    col = col < 0 ? 0 : col >= COLS ? COLS - 1 : col;
+    row = row < 0 ? 0 : row >= ROWS ? ROWS - 1 : row;
+    return row * COLS + col;
+}
+
+static int walls(int a, int b)
+{
+    return abs(a % COLS - b % COLS) + abs(a / COLS - b / COLS);
+}
+
+static void walk(walker_t *w, float dt, uint32_t now_ms)
+{
+    if ((int32_t)(now_ms - w->busy_until_ms) < 0) {
+        return;
+    }
+    float dx = w->target[0] - w->pos[0];
+    float dy = w->target[1] - w->pos[1];
+    float left = hypotf(dx, dy);
+    float step = 1.2f * dt;
+    if (left < step) {
+        w->target[0] = host_uniform() * COLS * ROOM_W;
+        w->target[1] = host_uniform() * ROWS * ROOM_H;
+        w->busy_until_ms = now_ms + 10000 + host_rand() % 290000;
+        return;
+    }
+    w->pos[0] += dx / left * step;
+    w->pos[1] += dy / left * step;
+}
+
+typedef struct {
+    const char *name;
+    presence_config_t config;
+} bench_config_t;
+
+static void run(const bench_config_t *bench)
+{
+    host_seed(6);
+    presence_init(&s_presence, &bench->config);
+    for (int k = 0; k < WALKERS; k++) {
+        walker_t *w = &s_walkers[k];
+        w->pos[0] = host_uniform() * COLS * ROOM_W;
+        w->pos[1] = host_uniform() * ROWS * ROOM_H;
+        w->target[0] = w->pos[0];
+        w->target[1] = w->pos[1];
+        w->busy_until_ms = 0;
+        w->room = room_of(w->pos);
+        w->last_from = PRESENCE_NOWHERE;
+        w->last_ms = 0;
+        w->pending = 0;
+    }
+
+    long right = 0, samples = 0, changes = 0, events = 0, flaps = 0, lags = 0;
+    double lag_ms = 0;
+    for (uint32_t now_ms = TICK_MS; now_ms <= SECONDS * 1000; now_ms += TICK_MS) {
+        for (int k = 0; k < WALKERS; k++) {
+            walker_t *w = &s_walkers[k];
+            walk(w, TICK_MS * 0.001f, now_ms);
+            int room = room_of(w->pos);
+            if (room != w->room) {
+                w->room = room;
+                w->entered_ms = now_ms;
+                w->pending = 1;
+                changes++;
+            }
+            for (int m = 0; m < ROOMS; m++) {
+                float dx = w->pos[0] - s_mediators[m][0];
+                float dy = w->pos[1] - s_mediators[m][1];
+                float d = sqrtf(dx * dx + dy * dy + 1.5f * 1.5f);
+                if (d > HEARD_M || host_uniform() >= 2.0f * TICK_MS / 1000) {
+                    continue;
+                }
+                float level_db = -20.0f * log10f(d) - WALL_DB * walls(room, m) + SHADOW_DB * host_gauss();
+                presence_event_t event;
+                if (!presence_observe(&s_presence, k, (uint8_t)m, level_db, now_ms, &event)) {
+                    continue;
+                }
+                events++;
+                if (event.to == w->last_from && now_ms - w->last_ms < FLAP_MS) {
+                    flaps++;
+                }
+                w->last_from = event.from;
+                w->last_ms = now_ms;
+            }
+            int assigned = presence_room(&s_presence, k);
+            if (now_ms >= 60000) {
+                right += assigned == room;
+                samples++;
+            }
+            if (w->pending && assigned == room) {
+                lag_ms += now_ms - w->entered_ms;
+                lags++;
+                w->pending = 0;
+            }
+        }
+        if (now_ms % 1000 == 0) {
+            presence_event_t expired[8];
+            events += presence_expire(&s_presence, now_ms, expired, 8);
+        }
+    }
+    printf("  %-24s  %6.1f%%  %7ld  %7ld  %9ld  %4.1f s\n", bench->name, 100.0 * right / samples, changes, events,
+           flaps, lag_ms / lags / 1000);
+}
+
+/* One beacon heard by the mediators within range, the observations of a tick at once */
+static void cost(void)
+{
+    static anchor_set_t set;
+    anchor_set_load(&set, s_mediators, (1u << ROOMS) - 1);
+    const presence_config_t config = PRESENCE_CONFIG_DEFAULT();
+    presence_init(&s_presence, &config);
+    host_seed(7);
+
+    static uint16_t masks[COST_CASES];
+    static float ranges[COST_CASES][ANCHOR_SET_MAX_ANCHORS];
+    long observations = 0;
+    for (int c = 0; c < COST_CASES; c++) {
+        float pos[2] = {host_uniform() * COLS * ROOM_W, host_uniform() * ROWS * ROOM_H};
+        masks[c] = 0;
+        for (int m = 0; m < ROOMS; m++) {
+            float dx = pos[0] - s_mediators[m][0];
+            float dy = pos[1] - s_mediators[m][1];
+            ranges[c][m] = sqrtf(dx * dx + dy * dy + 1.5f * 1.5f);
+            if (ranges[c][m] <= HEARD_M) {
+                masks[c] |= 1u << m;
+                observations++;
+            }
+        }
+    }
+
+    double started = host_now_s();
+    for (int r = 0; r < COST_REPS; r++) {
+        for (int c = 0; c < COST_CASES; c++) {
+            uint32_t time_ms = (r * COST_CASES + c) * 10;
+            for (int m = 0; m < ROOMS; m++) {
+                if (masks[c] & (1u << m)) {
+                    presence_event_t event;
+                    float level_db = -20.0f * log10f(ranges[c][m]);
+                    presence_observe(&s_presence, c % WALKERS, (uint8_t)m, level_db, time_ms, &event);
+                }
+            }
+        }
+    }
+    double presence_ns = (host_now_s() - started) / COST_REPS / COST_CASES * 1e9;
+
+    started = host_now_s();
+    for (int r = 0; r < COST_REPS; r++) {
+        for (int c = 0; c < COST_CASES; c++) {
+            float pos[3];
+            anchor_set_solve(&set, masks[c], ranges[c], 1.0f, pos);
+            host_sink = pos[0];
+        }
+    }
+    double solve_ns = (host_now_s() - started) / COST_REPS / COST_CASES * 1e9;
+    printf("\n  per beacon and tick, %.1f mediators: presence %.0f ns (%.0f ns per observation),"
+           " anchor_set_solve %.0f ns\n",
+           (double)observations / COST_CASES, presence_ns, presence_ns * COST_CASES / observations, solve_ns);
+}
+
+int main(void)
+{
+    for (int m = 0; m < ROOMS; m++) {
+        s_mediators[m][0] = (m % COLS + 0.5f) * ROOM_W;
+        s_mediators[m][1] = (m / COLS + 0.5f) * ROOM_H;
+        s_mediators[m][2] = 2.5f;
+    }
+    const bench_config_t configs[] = {
+        {"raw strongest", {.hysteresis_db = 0, .dwell_ms = 0, .timeout_ms = 10000, .smoothing = 1.0f}},
+        {"filtered (a = 0.5)", {.hysteresis_db = 0, .dwell_ms = 0, .timeout_ms = 10000, .smoothing = 0.5f}},
+        {"+ 4 dB hysteresis", {.hysteresis_db = 4.0f, .dwell_ms = 0, .timeout_ms = 10000, .smoothing = 0.5f}},
+        {"+ 1 s dwell (default)", PRESENCE_CONFIG_DEFAULT()},
+    };
+    printf("  config                    accuracy  changes   events  flaps<10s  lag\n");
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+        run(&configs[i]);
+    }
+    cost();
+    return 0;
+}
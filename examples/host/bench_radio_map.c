@@ -0,0 +1,100 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host.h"
+#include "radio_map.h"
+
+/* k-d tree queries against a linear scan, on an image built by tools/radio_map.py:
+ *
+ *     radio_map.py synth --points 2000 --mediators 8 -o survey.csv
+ *     radio_map.py build survey.csv -o radiomap.bin
+ *     bench_radio_map radiomap.bin [k]
+ *
+ * Queries are map fingerprints with +-4 dB of noise. Each query's nearest point must match the
+ * linear scan's; the program fails otherwise, which is how ctest runs it. */
+
+#define QUERIES 20000
+#define MAX_IMAGE (4 * 1024 * 1024)
+
+static uint8_t s_image[MAX_IMAGE];
+
+static uint32_t linear_nearest(const radio_map_t *map, const int8_t query[])
+{
+    int dims = map->header->mediators;
+    uint32_t best = UINT32_MAX;
+    for (int p = 0; p < map->header->points; p++) {
+        uint32_t d2 = 0;
+        for (int d = 0; d < dims; d++) {
+            int e = query[d] - map->rssi[p * dims + d];
+            d2 += e * e;
+        }
+        best = d2 < best ? d2 : best;
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        printf("Usage: bench_radio_map <image> [k]\n");
+        return 1;
+    }
+    int k = argc > 2 ? atoi(argv[2]) : 4;
+    FILE *f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+    size_t size = fread(s_image, 1, sizeof(s_image), f);
+    fclose(f);
+    radio_map_t map;
+    if (radio_map_open(&map, s_image, size) != 0 || k < 1 || k > RADIO_MAP_MAX_K) {
+        printf("%s: not a radio map image, or k out of range\n", argv[1]);
+        return 1;
+    }
+
+    int dims = map.header->mediators;
+    int points = map.header->points;
+    static int8_t queries[QUERIES][RADIO_MAP_MAX_MEDIATORS];
+    static int source[QUERIES];
+    static uint32_t nearest[QUERIES];
+    host_seed(1);
+    for (int q = 0; q < QUERIES; q++) {
+        source[q] = host_rand() % points;
+        for (int d = 0; d < dims; d++) {
+            int v = map.rssi[source[q] * dims + d] + (int)(host_rand() % 9) - 4;
+            queries[q][d] = (int8_t)(v < map.header->floor_dbm ? map.header->floor_dbm : v > 127 ? 127 : v);
+        }
+    }
+
+    radio_map_match_t out[RADIO_MAP_MAX_K];
+    double visited = 0;
+    double started = host_now_s();
+    for (int q = 0; q < QUERIES; q++) {
+        radio_map_knn(&map, queries[q], k, out);
+        visited += map.visited;
+        host_sink = (float)out[0].distance2;
+    }
+    double tree_s = host_now_s() - started;
+    started = host_now_s();
+    for (int q = 0; q < QUERIES; q++) {
+        nearest[q] = linear_nearest(&map, queries[q]);
+    }
+    double linear_s = host_now_s() - started;
+
+    int mismatches = 0;
+    double error = 0;
+    for (int q = 0; q < QUERIES; q++) {
+        radio_map_knn(&map, queries[q], k, out);
+        mismatches += out[0].distance2 != nearest[q];
+        float pos[2];
+        radio_map_locate(&map, queries[q], k, pos);
+        error += hypotf(pos[0] - map.x_dm[source[q]] * 0.1f, pos[1] - map.y_dm[source[q]] * 0.1f);
+    }
+    printf("%6d points %2d mediators k=%d: k-d tree %6.1f us (%4.0f visited), linear %6.1f us, speedup %.1fx, "
+           "locate error %.2f m, %d mismatches\n",
+           points, dims, k, tree_s / QUERIES * 1e6, visited / QUERIES, linear_s / QUERIES * 1e6, linear_s / tree_s,
+           error / QUERIES, mismatches);
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "beacon_proto.h"
+#include "host.h"
+#include "obs_store.h"
+#include "pathloss_cal.h"
+#include "presence.h"
+#include "seq_tracker.h"
+#include "solve_sched.h"
+
+/* The pure C part of obs_ingest_report(), which is all the RAM-only report path does once the
+ * override callback has the bytes: decode, loss accounting, store insert, solve mark and
+ * presence, per report of 8 and 48 observations. 16 mediators report as many beacons as the
+ * store holds, then 1000, which evicts on most inserts. The range
+ * model lookup of range_models.cpp and the Matter write itself are not included; the persisted
+ * path adds an NVS write of the whole report on top, measured on the device with
+ * `matter esp ingest bench`. */
+
+#define MEDIATORS 16
+#define REPORTS 200000
+
+static seq_tracker_t s_seq_tracker;
+static obs_store_t s_store;
+static solve_sched_t s_sched;
+static presence_t s_presence;
+static uint8_t s_reports[MEDIATORS][BEACON_PROTO_REPORT_MAX_SIZE];
+
+static void handle(const uint8_t *buf, uint32_t now_ms)
+{
+    beacon_report_head_t head;
+    memcpy(&head, buf, sizeof(head));
+    int mediator = obs_store_mediator_slot(&s_store, head.mediator);
+    for (uint8_t i = 0; i < head.count; i++) {
+        beacon_obs_t obs;
+        memcpy(&obs, buf + sizeof(head) + i * sizeof(obs), sizeof(obs));
+        seq_tracker_observe(&s_seq_tracker, head.mediator, head.boot_seq, obs.seq);
+        float level_db = pathloss_level_from_distance(obs.distance_cm * 0.01f);
+        int slot = obs_store_insert(&s_store, obs.beacon, (uint8_t)mediator, obs.distance_cm, now_ms - obs.age_ms);
+        solve_sched_mark(&s_sched, slot, now_ms);
+        presence_event_t event;
+        presence_observe(&s_presence, obs.beacon, (uint8_t)mediator, level_db, now_ms - obs.age_ms, &event);
+    }
+}
+
+static void run(uint8_t per_report, int beacons)
+{
+    memset(&s_seq_tracker, 0, sizeof(s_seq_tracker));
+    obs_store_init(&s_store);
+    solve_sched_init(&s_sched);
+    const presence_config_t config = PRESENCE_CONFIG_DEFAULT();
+    presence_init(&s_presence, &config);
+    host_seed(4);
+
+    uint32_t seq[MEDIATORS] = {0};
+    double total_s = 0;
+    for (uint32_t r = 0; r < REPORTS; r++) {
+        int m = r % MEDIATORS;
+        uint32_t now_ms = r * 2;
+        beacon_report_head_t head = {
+            .version = BEACON_PROTO_VERSION,
+            .count = per_report,
+            .mediator = (uint16_t)(0x100 + m),
+            .boot_seq = 0,
+        };
+        memcpy(s_reports[m], &head, sizeof(head));
+        for (uint8_t i = 0; i < per_report; i++) {
+            beacon_obs_t obs = {0};
+            obs.beacon = 0x10000 + host_rand() % beacons;
+            obs.distance_cm = (uint16_t)(100 + host_rand() % 2000);
+            obs.age_ms = host_rand() % 500;
+            obs.seq = seq[m]++;
+            memcpy(s_reports[m] + sizeof(head) + i * sizeof(obs), &obs, sizeof(obs));
+        }
+        double started = host_now_s();
+        handle(s_reports[m], now_ms);
+        total_s += host_now_s() - started;
+        if (r % 50 == 0) {
+            /* Keep the dirty set as short as the solve tick would */
+            memset(s_sched.dirty, 0, sizeof(s_sched.dirty));
+        }
+    }
+    printf("  %7d  %12u  %7.0f ns  %12.0f ns  %6.2f M obs/s\n", beacons, per_report, total_s / REPORTS * 1e9,
+           total_s / REPORTS / per_report * 1e9, REPORTS * per_report / total_s / 1e6);
+}
+
+int main(void)
+{
+    printf("  beacons  observations  per report  per observation  throughput\n");
+    run(8, OBS_STORE_MAX_BEACONS);
+    run(BEACON_PROTO_MAX_OBS, OBS_STORE_MAX_BEACONS);
+    run(8, 1000);
+    run(BEACON_PROTO_MAX_OBS, 1000);
+    return 0;
+}
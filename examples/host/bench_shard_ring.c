@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "host.h"
+#include "shard_ring.h"
+
+/* shard_ring.c over 100k random beacon IDs for 2 to 8 aggregators: the largest and smallest
+ * shard against the mean, the share of beacons that change shard when one more aggregator joins
+ * and when the last one leaves, against the 1/(N+1) and 1/N a perfect ring moves, and the cost
+ * of a lookup. */
+
+#define BEACONS 100000
+#define LOOKUPS 20
+
+static uint32_t s_beacons[BEACONS];
+static int8_t s_owner[BEACONS];
+static shard_ring_t s_ring;
+
+static uint64_t node_id(int n)
+{
+    return 0x1000 + n * 0x11;
+}
+
+/* Share of beacons whose shard differs from s_owner, which is then updated */
+static double remapped(void)
+{
+    int moved = 0;
+    for (int b = 0; b < BEACONS; b++) {
+        int shard = shard_ring_lookup(&s_ring, s_beacons[b]);
+        moved += shard != s_owner[b];
+        s_owner[b] = (int8_t)shard;
+    }
+    return (double)moved / BEACONS;
+}
+
+int main(void)
+{
+    host_seed(9);
+    for (int b = 0; b < BEACONS; b++) {
+        s_beacons[b] = host_rand();
+    }
+
+    printf("  N  max/mean  min/mean  add N+1: moved  ideal    remove N: moved  ideal    lookup\n");
+    for (int n = 2; n <= SHARD_RING_MAX_SHARDS; n++) {
+        shard_ring_init(&s_ring);
+        for (int k = 0; k < n; k++) {
+            shard_ring_add(&s_ring, node_id(k));
+        }
+        int load[SHARD_RING_MAX_SHARDS] = {0};
+        for (int b = 0; b < BEACONS; b++) {
+            s_owner[b] = (int8_t)shard_ring_lookup(&s_ring, s_beacons[b]);
+            load[s_owner[b]]++;
+        }
+        int max = 0, min = BEACONS;
+        for (int k = 0; k < n; k++) {
+            max = load[k] > max ? load[k] : max;
+            min = load[k] < min ? load[k] : min;
+        }
+        double mean = (double)BEACONS / n;
+
+        double started = host_now_s();
+        for (int r = 0; r < LOOKUPS; r++) {
+            for (int b = 0; b < BEACONS; b++) {
+                host_sink = (float)shard_ring_lookup(&s_ring, s_beacons[b]);
+            }
+        }
+        double lookup_ns = (host_now_s() - started) / LOOKUPS / BEACONS * 1e9;
+
+        printf("  %d  %8.2f  %8.2f  ", n, max / mean, min / mean);
+        if (n < SHARD_RING_MAX_SHARDS) {
+            shard_ring_add(&s_ring, node_id(n));
+            printf("       %5.1f%%  %5.1f%%  ", 100 * remapped(), 100.0 / (n + 1));
+            shard_ring_remove(&s_ring, node_id(n));
+            remapped();
+        } else {
+            printf("           -       -  ");
+        }
+        shard_ring_remove(&s_ring, node_id(n - 1));
+        printf("        %5.1f%%  %5.1f%%  %5.0f ns\n", 100 * remapped(), 100.0 / n, lookup_ns);
+    }
+    return 0;
+}
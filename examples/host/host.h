@@ -0,0 +1,72 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/* Helpers shared by the host tests and benchmarks.
+ *
+ * Random numbers come from a seeded xorshift generator instead of rand(), so a run gives the
+ * same cases on every libc. Tests report failed checks through CHECK() and return
+ * host_test_result() from main(), which ctest reads as the exit code.
+ */
+
+static uint32_t host_rng_state __attribute__((unused)) = 1;
+
+static inline void host_seed(uint32_t seed)
+{
+    host_rng_state = seed ? seed : 1;
+}
+
+static inline uint32_t host_rand(void)
+{
+    uint32_t x = host_rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    host_rng_state = x;
+    return x;
+}
+
+/* Uniform in [0, 1) */
+static inline float host_uniform(void)
+{
+    return (host_rand() >> 8) * (1.0f / 16777216.0f);
+}
+
+/* Standard normal, Box-Muller */
+static inline float host_gauss(void)
+{
+    float u = host_uniform() + 1e-9f;
+    float v = host_uniform();
+    return sqrtf(-2.0f * logf(u)) * cosf(6.2831853f * v);
+}
+
+static inline double host_now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Keeps results of timed loops alive */
+static volatile float host_sink __attribute__((unused));
+
+static int host_failures __attribute__((unused));
+
+#define CHECK(cond)                                                             \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);     \
+            host_failures++;                                                    \
+        }                                                                       \
+    } while (0)
+
+static inline int host_test_result(void)
+{
+    if (host_failures) {
+        printf("%d checks failed\n", host_failures);
+    }
+    return host_failures ? 1 : 0;
+}
@@ -0,0 +1,49 @@
+#include <stdio.h>
+
+#include "anchor_batch_cases.h"
+
+/* anchor_set_solve_batch() bit for bit against anchor_set_solve(), on whichever kernel this CPU
+ * selects: beacons grouped by mask and in random order, with more masks in random order than
+ * one block of the batch groups, counts which leave vector tails, and subsets which can not be
+ * solved. */
+
+static anchor_set_t s_set;
+
+static void check(size_t count, int subsets, int sorted)
+{
+    batch_cases_t cases = batch_cases(&s_set, count, subsets, sorted);
+    size_t solved = anchor_set_solve_batch(&s_set, cases.masks, cases.rows, count, cases.z, count, cases.x, cases.y);
+    size_t mismatches = batch_mismatches(&s_set, &cases);
+    printf("%s: %6zu beacons, %3d subsets, %s: %zu solved, %zu mismatches\n", anchor_set_batch_isa(), count, subsets,
+           sorted ? "grouped" : "random order", solved, mismatches);
+    CHECK(mismatches == 0);
+    CHECK(solved > count * 9 / 10);
+    batch_cases_free(&cases);
+}
+
+/* Beacons heard by too few anchors come back NAN, the rest solve */
+static void check_unsolvable(void)
+{
+    batch_cases_t cases = batch_cases(&s_set, 100, 4, 0);
+    for (size_t b = 0; b < 100; b += 3) {
+        cases.masks[b] = 0x0003;    /* Two anchors */
+    }
+    size_t solved = anchor_set_solve_batch(&s_set, cases.masks, cases.rows, 100, cases.z, 100, cases.x, cases.y);
+    CHECK(solved == 100 - 34);
+    CHECK(isnan(cases.x[0]) && isnan(cases.y[99]));
+    CHECK(batch_mismatches(&s_set, &cases) == 0);
+    batch_cases_free(&cases);
+}
+
+int main(void)
+{
+    host_seed(6);
+    batch_layout(&s_set);
+    check(10000, 32, 1);
+    check(10000, 32, 0);
+    check(10000, 300, 0);
+    check(1003, 1, 1);
+    check(5, 2, 1);
+    check_unsolvable();
+    return host_test_result();
+}
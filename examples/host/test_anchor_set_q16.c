@@ -0,0 +1,177 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "anchor_set.h"
+#include "host.h"
+
+/* Checks the Q16 kernel of anchor_set.c against the float kernel and against a 128 bit
+ * reference of its own arithmetic. Also built with ANCHOR_SET_FIXED_POINT=1, which puts
+ * anchor_set_solve_cm() on the fixed point path as on the ESP32-C3. */
+
+#define CASES 8192
+#define MASKS 64
+
+static anchor_set_t s_set;
+static float s_anchors[ANCHOR_SET_MAX_ANCHORS][3];
+static uint16_t s_masks[MASKS];
+
+static void load_layout(float offset)
+{
+    for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+        s_anchors[i][0] = offset + host_uniform() * 40;
+        s_anchors[i][1] = offset + host_uniform() * 40;
+        s_anchors[i][2] = 3 + host_uniform();
+    }
+    anchor_set_load(&s_set, s_anchors, 0xFFFF);
+    for (int k = 0; k < MASKS; k++) {
+        uint16_t mask = 0;
+        while (__builtin_popcount(mask) < 3 + k % 10) {
+            mask |= 1u << (host_rand() % ANCHOR_SET_MAX_ANCHORS);
+        }
+        s_masks[k] = mask;
+    }
+}
+
+static void ranges_to(const float target[3], float noise, float ranges[ANCHOR_SET_MAX_ANCHORS])
+{
+    for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+        float dx = target[0] - s_anchors[i][0];
+        float dy = target[1] - s_anchors[i][1];
+        float dz = target[2] - s_anchors[i][2];
+        ranges[i] = sqrtf(dx * dx + dy * dy + dz * dz) + noise * (host_uniform() - 0.5f);
+    }
+}
+
+/* Round half up of v / 2^shift, as the kernel's (v + 2^(shift - 1)) >> shift */
+static __int128 round_shift(__int128 v, int shift)
+{
+    return (v + ((__int128)1 << (shift - 1))) >> shift;
+}
+
+/* The kernel's formula on the stored integer factors, without any 64 bit intermediate */
+static void reference_q16(const anchor_subset_t *subset, const q16_t ranges[], q16_t z, q16_t pos[2])
+{
+    __int128 zl = (__int128)z - s_set.origin_q16[2];
+    for (int axis = 0; axis < 2; axis++) {
+        __int128 sum = 0;
+        for (int k = 0; k < subset->count; k++) {
+            __int128 r = ranges[subset->index[k]];
+            r = r < 0 ? 0 : r > ANCHOR_SET_RANGE_MAX_Q16 ? ANCHOR_SET_RANGE_MAX_Q16 : r;
+            sum += subset->p_q24[axis][k] * round_shift(r * r, 16);
+        }
+        __int128 v = subset->k0_q16[axis] + round_shift(subset->kz_q16[axis] * zl, 16) - round_shift(sum, 24);
+        pos[axis] = (q16_t)(s_set.origin_q16[axis] + v);
+    }
+}
+
+static void check_against_float(float offset)
+{
+    host_seed(3);
+    load_layout(offset);
+    double sum_mm = 0;
+    double max_mm = 0;
+    int solved = 0;
+    for (int c = 0; c < CASES; c++) {
+        uint16_t mask = s_masks[host_rand() % MASKS];
+        float target[3] = {offset + host_uniform() * 40, offset + host_uniform() * 40, 1};
+        float ranges[ANCHOR_SET_MAX_ANCHORS];
+        q16_t ranges_q16[ANCHOR_SET_MAX_ANCHORS];
+        ranges_to(target, 0.1f, ranges);
+        for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+            ranges_q16[i] = (q16_t)lrint(ranges[i] * (double)Q16_ONE);
+        }
+        float pos[3];
+        q16_t pos_q16[3];
+        int float_rc = anchor_set_solve(&s_set, mask, ranges, 1, pos);
+        int fixed_rc = anchor_set_solve_q16(&s_set, mask, ranges_q16, Q16_ONE, pos_q16);
+        const anchor_subset_t *subset = anchor_set_subset(&s_set, mask);
+        /* Only subsets the fixed point factors can not hold may fail on that path alone */
+        CHECK(fixed_rc == 0 || (subset && !subset->fixed_ok));
+        if (float_rc != 0 || fixed_rc != 0) {
+            continue;
+        }
+        double mm = hypot(pos_q16[0] / (double)Q16_ONE - pos[0], pos_q16[1] / (double)Q16_ONE - pos[1]) * 1000;
+        sum_mm += mm;
+        max_mm = mm > max_mm ? mm : max_mm;
+        solved++;
+        CHECK(pos_q16[2] == Q16_ONE);
+    }
+    printf("offset %4.0f m: fixed vs float over %d solves, mean %.3f mm, max %.3f mm\n", offset, solved,
+           sum_mm / solved, max_mm);
+    CHECK(solved > CASES * 9 / 10);
+    CHECK(sum_mm / solved < 0.2);
+    CHECK(max_mm < 2.0);
+}
+
+/* Bit for bit against the 128 bit reference, ranges include negative and clamped ones */
+static void check_kernel_bits(void)
+{
+    host_seed(5);
+    load_layout(1000);
+    int compared = 0;
+    for (int c = 0; c < CASES; c++) {
+        uint16_t mask = s_masks[host_rand() % MASKS];
+        q16_t ranges[ANCHOR_SET_MAX_ANCHORS];
+        for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+            ranges[i] = (q16_t)(host_rand() % (130 * Q16_ONE)) - 10 * Q16_ONE;
+        }
+        q16_t z = (q16_t)(host_rand() % (4 * Q16_ONE));
+        q16_t pos[3];
+        if (anchor_set_solve_q16(&s_set, mask, ranges, z, pos) != 0) {
+            continue;
+        }
+        q16_t expect[2];
+        reference_q16(anchor_set_subset(&s_set, mask), ranges, z, expect);
+        CHECK(pos[0] == expect[0] && pos[1] == expect[1]);
+        compared++;
+    }
+    printf("kernel: %d solves bit-identical to the 128 bit reference\n", compared);
+    CHECK(compared > CASES * 9 / 10);
+}
+
+/* anchor_set_solve_cm() against the float solve rounded to centimetres, on whichever kernel
+ * this build puts it */
+static void check_cm(void)
+{
+    host_seed(7);
+    load_layout(0);
+    int off_by_one = 0;
+    int solved = 0;
+    for (int c = 0; c < CASES; c++) {
+        uint16_t mask = s_masks[host_rand() % MASKS];
+        float target[3] = {host_uniform() * 40, host_uniform() * 40, 1};
+        float ranges[ANCHOR_SET_MAX_ANCHORS];
+        uint16_t ranges_cm[ANCHOR_SET_MAX_ANCHORS];
+        ranges_to(target, 0.1f, ranges);
+        for (int i = 0; i < ANCHOR_SET_MAX_ANCHORS; i++) {
+            ranges_cm[i] = (uint16_t)lrintf(ranges[i] * 100);
+            ranges[i] = ranges_cm[i] * 0.01f;
+        }
+        float pos[3];
+        int32_t pos_cm[3];
+        if (anchor_set_solve(&s_set, mask, ranges, 1, pos) != 0 ||
+            anchor_set_solve_cm(&s_set, mask, ranges_cm, 100, pos_cm) != 0) {
+            continue;
+        }
+        for (int i = 0; i < 2; i++) {
+            long diff = labs(pos_cm[i] - lrintf(pos[i] * 100));
+            CHECK(diff <= 1);
+            off_by_one += diff != 0;
+        }
+        CHECK(pos_cm[2] == 100);
+        solved++;
+    }
+    printf("cm path (%s): %d solves, %d coordinates 1 cm off the float solve\n",
+           ANCHOR_SET_FIXED_POINT ? "fixed point" : "float", solved, off_by_one);
+    CHECK(off_by_one < solved / 10);
+}
+
+int main(void)
+{
+    check_against_float(0);
+    check_against_float(1000);
+    check_kernel_bits();
+    check_cm();
+    return host_test_result();
+}
@@ -0,0 +1,188 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "fusion.h"
+#include "host.h"
+#include "solve_sched.h"
+
+/* fusion.c alone, on the alignment of ranges and the age spread of each set, then driven by
+ * solve_sched.c as obs_ingest.cpp does: a beacon held by the holdoff is put back with its mark
+ * time, and its newest ranges are solved once the holdoff is over. */
+
+#define TICK_MS 100
+#define BEACON 0x10001
+
+static obs_store_t s_store;
+static fusion_t s_fusion;
+static solve_sched_t s_sched;
+static uint32_t s_now_ms;
+static uint32_t s_clock_us;
+static fusion_set_t s_last;
+static int s_sets;
+
+static uint32_t clock_us(void *ctx)
+{
+    return s_clock_us += 10;
+}
+
+static void solve_slot(void *ctx, int slot)
+{
+    fusion_set_t set;
+    switch (fusion_offer(&s_fusion, &s_store, slot, s_now_ms, &set)) {
+    case FUSION_READY:
+        s_last = set;
+        s_sets++;
+        break;
+    case FUSION_HELD:
+        solve_sched_defer(&s_sched, slot);
+        break;
+    default:
+        break;
+    }
+}
+
+static void hear(uint8_t mediator, uint16_t distance_cm, uint32_t time_ms)
+{
+    int slot = obs_store_insert(&s_store, BEACON, mediator, distance_cm, time_ms);
+    solve_sched_mark(&s_sched, slot, s_now_ms);
+}
+
+static void run_until(uint32_t until_ms)
+{
+    while ((int32_t)(s_now_ms - until_ms) < 0) {
+        s_now_ms += TICK_MS;
+        solve_sched_tick(&s_sched, s_now_ms, 5000, clock_us, solve_slot, NULL);
+    }
+}
+
+static void setup(void)
+{
+    const fusion_config_t config = FUSION_CONFIG_DEFAULT();
+    obs_store_init(&s_store);
+    fusion_init(&s_fusion, &config);
+    solve_sched_init(&s_sched);
+    for (int m = 0; m < 3; m++) {
+        obs_store_mediator_slot(&s_store, 0x100 + m);
+    }
+    s_now_ms = 1000;
+    s_sets = 0;
+}
+
+/* Fresh ranges are used as they are, the set is timed by the newest and spreads to the oldest */
+static void fresh_ranges(void)
+{
+    setup();
+    hear(0, 500, 1000);
+    hear(1, 600, 1100);
+    hear(2, 700, 1250);
+    fusion_set_t set;
+    int slot = obs_store_find(&s_store, BEACON);
+    CHECK(fusion_offer(&s_fusion, &s_store, slot, 1300, &set) == FUSION_READY);
+    CHECK(set.time_ms == 1250);
+    CHECK(set.age_spread_ms == 250);
+    CHECK(set.count == 3 && set.extrapolated == 0);
+    CHECK(set.ranges[0] == 5.0f && set.ranges[2] == 7.0f);
+    CHECK(s_fusion.stats.age_spread_ms == 250);
+    /* One sample each, only the path loss model: 2 dB at n = 2 is 23% of the range */
+    CHECK(fabsf(set.sigmas[0] - 0.23026f * 5.0f) < 0.001f);
+    CHECK(fabsf(set.sigmas[2] - 0.23026f * 7.0f) < 0.001f);
+}
+
+/* A range older than the window moves along its trend, one beyond max_extrapolate_ms is left out.
+ * Its sigma takes the spread of its samples. */
+static void stale_ranges(void)
+{
+    setup();
+    /* Walking away from mediator 0 at 1 m/s, last heard 800 ms before the others */
+    hear(0, 400, 0);
+    hear(0, 450, 500);
+    hear(0, 500, 1000);
+    hear(1, 300, 1800);
+    hear(2, 300, 1800);
+    fusion_set_t set;
+    int slot = obs_store_find(&s_store, BEACON);
+    CHECK(fusion_offer(&s_fusion, &s_store, slot, 1800, &set) == FUSION_READY);
+    printf("stale range: %.2f m extrapolated from 5.00 m over %u ms\n", set.ranges[0], set.age_spread_ms);
+    CHECK(set.extrapolated == 1);
+    CHECK(set.age_spread_ms == 800);
+    CHECK(fabsf(set.ranges[0] - 5.8f) < 0.01f);
+    /* Plus the 0.5 m spread of its three samples */
+    float model = 0.23026f * set.ranges[0];
+    CHECK(fabsf(set.sigmas[0] - sqrtf(model * model + 0.25f)) < 0.001f);
+
+    /* 2.5 s later only the two fresh ones are left, too few */
+    hear(1, 300, 3500);
+    hear(2, 300, 3500);
+    CHECK(fusion_offer(&s_fusion, &s_store, slot, 3500, &set) == FUSION_WAITING);
+    CHECK(set.count == 2);
+    CHECK(s_fusion.stats.discarded == 0);
+    CHECK(s_fusion.stats.waiting == 1);
+
+    /* Ranges rate capped at FUSION_MAX_SPEED */
+    setup();
+    hear(0, 100, 0);
+    hear(0, 600, 300);
+    hear(1, 300, 800);
+    hear(2, 300, 800);
+    slot = obs_store_find(&s_store, BEACON);
+    CHECK(fusion_offer(&s_fusion, &s_store, slot, 800, &set) == FUSION_READY);
+    CHECK(fabsf(set.ranges[0] - (6.0f + FUSION_MAX_SPEED * 0.5f)) < 0.01f);
+}
+
+/* The last ranges of a beacon arrive right after a set: held, then solved without any more
+ * samples coming in */
+static void held_ranges_solved(void)
+{
+    setup();
+    for (int m = 0; m < 3; m++) {
+        hear(m, 500, s_now_ms);
+    }
+    run_until(1100);
+    CHECK(s_sets == 1);
+
+    for (int m = 0; m < 3; m++) {
+        hear(m, 600, s_now_ms);
+    }
+    uint32_t marked_ms = s_now_ms;
+    run_until(1200);
+    CHECK(s_sets == 1);
+    CHECK(s_fusion.stats.held == 1);
+    CHECK(solve_sched_pending(&s_sched) == 1);
+
+    run_until(1500);
+    printf("held ranges: %d sets, %u held, %u put back, waited %u ms\n", s_sets, s_fusion.stats.held,
+           s_sched.stats.deferred, s_sched.stats.max_wait_ms);
+    CHECK(s_sets == 2);
+    CHECK(s_last.ranges[0] == 6.0f);
+    CHECK(solve_sched_pending(&s_sched) == 0);
+    /* Counted from the first mark, not from the last put back */
+    CHECK(s_sched.stats.max_wait_ms >= s_fusion.config.holdoff_ms);
+    CHECK(s_sched.stats.max_wait_ms <= s_now_ms - marked_ms);
+}
+
+/* A beacon waiting for ranges is not put back, its next sample marks it */
+static void waiting_not_put_back(void)
+{
+    setup();
+    hear(0, 500, s_now_ms);
+    hear(1, 500, s_now_ms);
+    run_until(1500);
+    CHECK(s_sets == 0);
+    CHECK(s_fusion.stats.waiting == 1);
+    CHECK(solve_sched_pending(&s_sched) == 0);
+    for (int m = 0; m < 3; m++) {
+        hear(m, 500, s_now_ms);
+    }
+    run_until(1600);
+    CHECK(s_sets == 1);
+}
+
+int main(void)
+{
+    fresh_ranges();
+    stale_ranges();
+    held_ranges_solved();
+    waiting_not_put_back();
+    return host_test_result();
+}
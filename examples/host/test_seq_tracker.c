@@ -0,0 +1,88 @@
+#include <string.h>
+
+#include "host.h"
+#include "seq_tracker.h"
+
+/* Loss accounting of replayed observations: only numbers counted as lost come back as
+ * recovered, the others are backlog. */
+
+static seq_tracker_t s_tracker;
+
+static const seq_counters_t *observe_range(uint32_t boot_seq, uint32_t from, uint32_t to)
+{
+    const seq_link_t *link = NULL;
+    for (uint32_t seq = from; seq < to; seq++) {
+        link = seq_tracker_observe(&s_tracker, 1, boot_seq, seq);
+    }
+    return &link->counters;
+}
+
+/* A hole in the live stream is lost, and recovered once the backlog fills it */
+static void hole_recovered(void)
+{
+    memset(&s_tracker, 0, sizeof(s_tracker));
+    observe_range(0, 0, 100);
+    observe_range(0, 150, 1000);
+    const seq_counters_t *c = observe_range(0, 100, 150);
+    CHECK(c->lost == 0);
+    CHECK(c->recovered == 50);
+    CHECK(c->backlog == 0);
+    CHECK(c->duplicate == 0);
+}
+
+/* The mediator reboots with 100 observations of its previous boot still in flash. They were
+ * never seen, so never counted as lost; replayed they must not eat into real losses. */
+static void replay_after_reboot(void)
+{
+    memset(&s_tracker, 0, sizeof(s_tracker));
+    observe_range(0, 0, 500);
+    observe_range(0, 600, 1000);         /* 100 lost */
+    observe_range(1024, 1024, 1200);
+    const seq_counters_t *c = observe_range(1024, 1000, 1020);
+    CHECK(c->lost == 100);
+    CHECK(c->recovered == 0);
+    CHECK(c->backlog == 20);
+    CHECK(c->reboots == 1);
+    CHECK(c->duplicate == 0);
+    /* Lost numbers of the previous boot still come back as recovered */
+    c = observe_range(1024, 500, 600);
+    CHECK(c->lost == 0);
+    CHECK(c->recovered == 100);
+    CHECK(c->backlog == 20);
+}
+
+/* Close to the new boot the replayed numbers land where the window was closed, they are not
+ * duplicates either */
+static void replay_inside_closed_window(void)
+{
+    memset(&s_tracker, 0, sizeof(s_tracker));
+    observe_range(0, 0, 1000);
+    observe_range(1024, 1024, 1100);
+    const seq_counters_t *c = observe_range(1024, 1000, 1023);
+    CHECK(c->duplicate == 0);
+    CHECK(c->backlog == 23);
+    CHECK(c->received == 1000 + 76 + 23);
+    CHECK(c->lost == 0);
+}
+
+/* The aggregator starts while the mediator drains its backlog: numbers before the first one
+ * seen were never counted */
+static void replay_before_first_seen(void)
+{
+    memset(&s_tracker, 0, sizeof(s_tracker));
+    observe_range(4096, 5000, 5100);
+    const seq_counters_t *c = observe_range(4096, 4100, 4900);
+    CHECK(c->recovered == 0);
+    CHECK(c->backlog == 800);
+    CHECK(c->duplicate == 0);
+    CHECK(c->lost == 0);
+}
+
+int main(void)
+{
+    hole_recovered();
+    replay_after_reboot();
+    replay_inside_closed_window();
+    replay_before_first_seen();
+    return host_test_result();
+}
@@ -0,0 +1,108 @@
+#include <stdio.h>
+
+#include "host.h"
+#include "uplink_sim.h"
+
+/* uplink_sched against simulated aggregators which go away and come back. Unreachable
+ * aggregators take 20 s to fail a write, longer than the 15 s flight timeout. */
+
+#define BEACONS 150
+
+/* One of three shards down for 50 s: the others keep their live latency, and once it is back
+ * everything arrives exactly once */
+static void one_shard_down(void)
+{
+    sim_t *sim = sim_create(3, BEACONS, 240);
+    sim_run(sim, 10000, 1);
+    sim->reachable[2] = 0;
+    sim_run(sim, 60000, 1);
+    printf("one shard down 50 s: live age %u / %u ms, %u missing, spilled %u, parked %u, probes %u\n",
+           sim->max_live_age_ms[0], sim->max_live_age_ms[1], sim_missing(sim, 0) + sim_missing(sim, 1),
+           sim->sched.stats.spilled, sim->sched.stats.parked, sim->sched.stats.probes);
+    CHECK(sim->max_live_age_ms[0] < 500);
+    CHECK(sim->max_live_age_ms[1] < 500);
+    /* At most what was heard since the last poll */
+    CHECK(sim_missing(sim, 0) + sim_missing(sim, 1) < BEACONS);
+    CHECK(sim->sched.stats.probes >= 2);
+    /* The backlog rests once only the down shard's records are left, instead of cycling them */
+    CHECK(sim->sched.stats.parked < sim->sched.stats.spilled);
+
+    sim->reachable[2] = 1;
+    sim_run(sim, 90000, 1);
+    sim_run(sim, 150000, 0);
+    printf("  after reconnect: %u missing, %u duplicates, %u reconnects, %u in flight at most\n", sim_missing(sim, -1),
+           sim->duplicates, sim->sched.stats.reconnects, sim->max_writes);
+    CHECK(sim_missing(sim, -1) == 0);
+    CHECK(sim->duplicates == 0);
+    CHECK(sim->sched.stats.reconnects == 1);
+    CHECK(sim->max_writes >= 2);
+    CHECK(obs_ring_count(&sim->ring) == 0);
+    free(sim);
+}
+
+/* Everything down for 20 s, then two shards come back while the third stays down: their
+ * backlog drains past the records of the down shard */
+static void backlog_past_down_shard(void)
+{
+    sim_t *sim = sim_create(3, BEACONS, 240);
+    sim_run(sim, 10000, 1);
+    sim->reachable[2] = 0;
+    sim_run(sim, 20000, 1);
+    sim->reachable[0] = 0;
+    sim->reachable[1] = 0;
+    sim_run(sim, 40000, 1);
+    sim->reachable[0] = 1;
+    sim->reachable[1] = 1;
+    sim_run(sim, 80000, 1);
+    uint32_t missing = sim_missing(sim, 0) + sim_missing(sim, 1);
+    printf("two shards back after 20 s, third still down: %u missing of theirs 40 s later, %u backlog delivered\n",
+           missing, sim->backlog_delivered);
+    CHECK(missing < BEACONS);
+    CHECK(sim->backlog_delivered > 0);
+
+    sim->reachable[2] = 1;
+    sim_run(sim, 100000, 1);
+    sim_run(sim, 200000, 0);
+    printf("  after reconnect: %u missing, %u duplicates\n", sim_missing(sim, -1), sim->duplicates);
+    CHECK(sim_missing(sim, -1) == 0);
+    CHECK(sim->duplicates == 0);
+    free(sim);
+}
+
+/* A shard fails while its part of a backlog round is in flight: only that part is parked, the
+ * parts already delivered are not sent again */
+static void failure_during_round(void)
+{
+    sim_t *sim = sim_create(3, BEACONS, 240);
+    sim_run(sim, 10000, 1);
+    for (int shard = 0; shard < 3; shard++) {
+        sim->reachable[shard] = 0;
+    }
+    sim_run(sim, 30000, 1);
+    for (int shard = 0; shard < 3; shard++) {
+        sim->reachable[shard] = 1;
+    }
+    /* Reconnect probes succeed within one period, then the drain is underway */
+    sim_run(sim, 33000, 1);
+    uint32_t backlog = sim->backlog_delivered;
+    sim->reachable[1] = 0;
+    sim->fail_ms = 300;
+    sim_run(sim, 60000, 1);
+    sim->reachable[1] = 1;
+    sim_run(sim, 90000, 1);
+    sim_run(sim, 200000, 0);
+    printf("shard fails during the drain: %u backlog delivered before, %u missing, %u duplicates, %u parked\n",
+           backlog, sim_missing(sim, -1), sim->duplicates, sim->sched.stats.parked);
+    CHECK(backlog > 0);
+    CHECK(sim_missing(sim, -1) == 0);
+    CHECK(sim->duplicates == 0);
+    free(sim);
+}
+
+int main(void)
+{
+    one_shard_down();
+    backlog_past_down_shard();
+    failure_during_round();
+    return host_test_result();
+}
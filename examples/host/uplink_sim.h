@@ -0,0 +1,199 @@
+#pragma once
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "uplink_sched.h"
+
+/* Simulation of a mediator uplink: uplink_sched over an obs_ring in RAM, and one simulated
+ * aggregator per shard. A reachable aggregator acknowledges a write after `latency_ms`; an
+ * unreachable one fails it after `fail_ms`, which beyond the flight timeout means the result
+ * arrives after the scheduler gave up on it. Every beacon is heard once per second and every
+ * delivered sequence number is counted, so loss and duplicates show directly. */
+
+#define SIM_SECTORS 64
+#define SIM_SECTOR_SIZE 4096
+#define SIM_MAX_WRITES 64
+#define SIM_MAX_SEQ 400000
+#define SIM_POLL_MS 200
+#define SIM_STEP_MS 10
+
+typedef struct {
+    uint8_t shard;
+    uint32_t id;
+    uint32_t due_ms;
+    int ok;
+    uplink_kind_t kind;
+    size_t count;
+    obs_ring_rec_t recs[BEACON_PROTO_MAX_OBS];
+} sim_write_t;
+
+typedef struct {
+    uint8_t flash[SIM_SECTORS * SIM_SECTOR_SIZE];
+    obs_ring_t ring;
+    shard_ring_t shards;
+    uplink_sched_t sched;
+    uint32_t now_ms;
+    int beacons;
+    uint8_t reachable[SHARD_RING_MAX_SHARDS];
+    uint32_t latency_ms;
+    uint32_t fail_ms;
+    sim_write_t writes[SIM_MAX_WRITES];
+    int write_count;
+    int max_writes;             /* Most reports in flight at once */
+    uint8_t delivered[SIM_MAX_SEQ];
+    uint32_t beacon[SIM_MAX_SEQ];
+    uint32_t next_seq;
+    uint32_t duplicates;
+    uint32_t max_live_age_ms[SHARD_RING_MAX_SHARDS];
+    uint32_t backlog_delivered;
+} sim_t;
+
+static int sim_flash_read(void *ctx, uint32_t offset, void *dst, size_t len)
+{
+    memcpy(dst, (uint8_t *)ctx + offset, len);
+    return 0;
+}
+
+static int sim_flash_write(void *ctx, uint32_t offset, const void *src, size_t len)
+{
+    /* NOR flash only clears bits */
+    uint8_t *p = (uint8_t *)ctx + offset;
+    for (size_t i = 0; i < len; i++) {
+        p[i] &= ((const uint8_t *)src)[i];
+    }
+    return 0;
+}
+
+static int sim_flash_erase(void *ctx, uint32_t offset, size_t len)
+{
+    memset((uint8_t *)ctx + offset, 0xFF, len);
+    return 0;
+}
+
+static int sim_send(void *ctx, uint8_t shard, uint32_t id, uplink_kind_t kind, const obs_ring_rec_t *recs,
+                    size_t count)
+{
+    sim_t *sim = (sim_t *)ctx;
+    if (sim->write_count == SIM_MAX_WRITES) {
+        return -1;
+    }
+    sim_write_t *write = &sim->writes[sim->write_count++];
+    write->shard = shard;
+    write->id = id;
+    write->ok = sim->reachable[shard];
+    write->due_ms = sim->now_ms + (write->ok ? sim->latency_ms : sim->fail_ms);
+    write->kind = kind;
+    write->count = count;
+    memcpy(write->recs, recs, count * sizeof(recs[0]));
+    sim->max_writes = sim->write_count > sim->max_writes ? sim->write_count : sim->max_writes;
+    return 0;
+}
+
+static sim_t *sim_create(int shards, int beacons, uint32_t backlog_rate)
+{
+    sim_t *sim = (sim_t *)calloc(1, sizeof(sim_t));
+    memset(sim->flash, 0xFF, sizeof(sim->flash));
+    obs_ring_flash_t flash = {
+        .read = sim_flash_read,
+        .write = sim_flash_write,
+        .erase = sim_flash_erase,
+        .ctx = sim->flash,
+        .size = sizeof(sim->flash),
+        .sector_size = SIM_SECTOR_SIZE,
+    };
+    obs_ring_init(&sim->ring, &flash);
+    shard_ring_init(&sim->shards);
+    for (int shard = 0; shard < shards; shard++) {
+        shard_ring_add(&sim->shards, 0x100 + shard);
+        sim->reachable[shard] = 1;
+    }
+    sim->beacons = beacons;
+    sim->latency_ms = 30;
+    sim->fail_ms = 20000;
+    uplink_sched_config_t config = {
+        .send = sim_send,
+        .ctx = sim,
+        .probe_period_ms = 5000,
+        .flight_timeout_ms = 15000,
+        .backlog_rate = backlog_rate,
+    };
+    uplink_sched_init(&sim->sched, &config, &sim->ring, &sim->shards, 0);
+    return sim;
+}
+
+static void sim_deliver(sim_t *sim, const sim_write_t *write)
+{
+    for (size_t i = 0; i < write->count; i++) {
+        const obs_ring_rec_t *rec = &write->recs[i];
+        if (sim->delivered[rec->seq]++) {
+            sim->duplicates++;
+        }
+        if (write->kind == UPLINK_LIVE) {
+            uint32_t age = sim->now_ms - rec->captured_ms;
+            uint32_t *max = &sim->max_live_age_ms[write->shard];
+            *max = age > *max ? age : *max;
+        } else {
+            sim->backlog_delivered++;
+        }
+    }
+}
+
+/* Advances the clock by one step: beacons heard, writes finished, and a poll every period or
+ * right after a result, as the uplink task does */
+static void sim_step(sim_t *sim, int hearing)
+{
+    int results = 0;
+    sim->now_ms += SIM_STEP_MS;
+    for (int i = 0; i < sim->write_count;) {
+        sim_write_t *write = &sim->writes[i];
+        if ((int32_t)(sim->now_ms - write->due_ms) < 0) {
+            i++;
+            continue;
+        }
+        sim_write_t done = *write;
+        *write = sim->writes[--sim->write_count];
+        /* The aggregator only saw the report if the write went through, whatever the
+         * scheduler thinks of it by now */
+        if (done.ok) {
+            sim_deliver(sim, &done);
+        }
+        uplink_sched_complete(&sim->sched, done.shard, done.id, done.ok, sim->now_ms);
+        results++;
+    }
+    if (hearing) {
+        for (int b = 0; b < sim->beacons; b++) {
+            if ((sim->now_ms + b * 7) % 1000 < SIM_STEP_MS && sim->next_seq < SIM_MAX_SEQ) {
+                obs_ring_rec_t rec = {0};
+                rec.beacon = 0x10000 + b;
+                rec.distance_cm = 100;
+                rec.captured_ms = sim->now_ms;
+                rec.seq = sim->next_seq++;
+                sim->beacon[rec.seq] = rec.beacon;
+                uplink_sched_route(&sim->sched, &rec);
+            }
+        }
+    }
+    if (results || sim->now_ms % SIM_POLL_MS == 0) {
+        uplink_sched_poll(&sim->sched, sim->now_ms);
+    }
+}
+
+static void sim_run(sim_t *sim, uint32_t until_ms, int hearing)
+{
+    while ((int32_t)(sim->now_ms - until_ms) < 0) {
+        sim_step(sim, hearing);
+    }
+}
+
+/* Sequence numbers never delivered, of one shard or of all of them with -1 */
+static uint32_t __attribute__((unused)) sim_missing(const sim_t *sim, int shard)
+{
+    uint32_t missing = 0;
+    for (uint32_t seq = 0; seq < sim->next_seq; seq++) {
+        if (!sim->delivered[seq] && (shard < 0 || shard_ring_lookup(&sim->shards, sim->beacon[seq]) == shard)) {
+            missing++;
+        }
+    }
+    return missing;
+}